@@ -15,6 +15,7 @@ var plog = require("pino")(dest);
 
 var logpp = require("../src/logger")("basic", { flushTarget: "stream", stream: dest, prefix: false });
 logpp.addFormat("hello", "#host #wallclock #timestamp hello world -- logpp");
+require("./blockmemory")(logpp, "basic");
 
 process.env.DEBUG = "dlog";
 var debug = require("debug");
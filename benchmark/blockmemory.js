@@ -0,0 +1,14 @@
+"use strict";
+
+//
+//Print the native bytes per message of the processed blocks when a benchmark exits
+//
+
+module.exports = function (logpp, name) {
+    process.on("exit", () => {
+        const usage = logpp.getMemoryUsage();
+        if (usage.queuedMessages !== 0) {
+            console.log(`${name} block memory: ${(usage.queuedBytes / usage.queuedMessages).toFixed(1)} bytes/msg over ${usage.queuedMessages} msgs`);
+        }
+    });
+};
@@ -0,0 +1,84 @@
+"use strict";
+
+//
+//Startup cost of registering 1000 formats -- parsing them with addFormats vs. loading a compiled catalog (each run in a fresh process)
+//  node benchmark/catalogbench.js
+//
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+const formatCount = 1000;
+const runs = 10;
+
+const formatfile = path.join(os.tmpdir(), "logpp_catalogbench_" + process.pid + ".json");
+const catalogfile = path.join(os.tmpdir(), "logpp_catalogbench_" + process.pid + ".bin");
+
+function timeStartup(mode, file) {
+    const logpp = require("../src/logger")("catalogbench", { flushMode: "NOP" });
+
+    const start = process.hrtime();
+    const ok = (mode === "json") ? logpp.addFormats(file) : logpp.loadFormatCatalog(file);
+    const elapsed = process.hrtime(start);
+
+    process.stdout.write(JSON.stringify({ ok: ok, ms: elapsed[0] * 1000 + elapsed[1] / 1000000 }));
+}
+
+function runChild(mode, file) {
+    const res = childProcess.spawnSync(process.execPath, [__filename, mode, file]);
+    const result = JSON.parse(res.stdout.toString());
+    if (!result.ok) {
+        throw new Error("Failed to load formats with " + mode);
+    }
+
+    return result.ms;
+}
+
+function median(values) {
+    const sorted = values.slice().sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+if (process.argv.length === 4) {
+    timeStartup(process.argv[2], process.argv[3]);
+}
+else {
+    const formats = {};
+    for (let i = 0; i < formatCount; ++i) {
+        switch (i % 4) {
+            case 0:
+                formats["Fmt" + i] = "request #request started for %s with %n items";
+                break;
+            case 1:
+                formats["Fmt" + i] = "#wallclock #callback value %j<2,10> after %n ms";
+                break;
+            case 2:
+                formats["Fmt" + i] = { kind: "event" + i, time: "#wallclock", data: "%j", ok: "%b" };
+                break;
+            default:
+                formats["Fmt" + i] = "format " + i + " at %di from #host with %s and %s";
+                break;
+        }
+    }
+    fs.writeFileSync(formatfile, JSON.stringify(formats));
+
+    const logpp = require("../src/logger")("catalogbench", { flushMode: "NOP" });
+    logpp.addFormats(formats);
+    logpp.saveFormatCatalog(catalogfile);
+
+    const jsonTimes = [];
+    const catalogTimes = [];
+    for (let i = 0; i < runs; ++i) {
+        jsonTimes.push(runChild("json", formatfile));
+        catalogTimes.push(runChild("catalog", catalogfile));
+    }
+
+    console.log(`Startup with ${formatCount} formats (median of ${runs} processes, catalog is ${fs.statSync(catalogfile).size} bytes):`);
+    console.log(`    addFormats:        ${median(jsonTimes).toFixed(2)}ms`);
+    console.log(`    loadFormatCatalog: ${median(catalogTimes).toFixed(2)}ms`);
+
+    fs.unlinkSync(formatfile);
+    fs.unlinkSync(catalogfile);
+}
@@ -15,6 +15,7 @@ var plog = require("pino")(dest);
 
 var logpp = require("../src/logger")("basic", { flushTarget: "stream", stream: dest, prefix: false });
 logpp.addFormat("hello1", "#host #wallclock #timestamp hello %s");
+require("./blockmemory")(logpp, "interpolate");
 
 process.env.DEBUG = "dlog";
 var debug = require("debug");
@@ -17,6 +17,7 @@ var logpp = require("../src/logger")("basic", { flushTarget: "stream", stream: d
 logpp.addFormat("deep", "%j");
 logpp.addFormat("deepall", "%j<*,*>");
 logpp.addFormat("long", "%s");
+require("./blockmemory")(logpp, "large");
 
 process.env.DEBUG = "dlog";
 var debug = require("debug");
@@ -0,0 +1,269 @@
+"use strict";
+
+//
+//Per-call and event loop latency percentiles (and native memory) under a sustained mixed load for each flush mode/target.
+//Each configuration runs in its own process (there is one root logger per process) and reports back over IPC.
+//  node benchmark/latencybench.js [CONFIG ...] [--seconds N] [--json FILE]
+//
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+const configs = {
+    "sync-console": { flushMode: "SYNC", flushTarget: "console" },
+    "async-console": { flushMode: "ASYNC", flushTarget: "console" },
+    "sync-stream": { flushMode: "SYNC", flushTarget: "stream" },
+    "async-stream": { flushMode: "ASYNC", flushTarget: "stream" },
+    "aggregate": { flushMode: "ASYNC", flushTarget: "aggregate" },
+    "columnar": { flushMode: "ASYNC", flushTarget: "columnar" },
+    "sinks": { flushMode: "ASYNC", flushTarget: "sinks" }
+};
+
+const steadyPerTick = 200;
+const burstSize = 5000;
+const burstEvery = 50;
+
+//percentiles of an (unsorted) Float64Array
+function percentiles(values, count) {
+    if (count === 0) {
+        return { p50: 0, p99: 0, p999: 0, max: 0 };
+    }
+
+    const sorted = values.slice(0, count).sort();
+    const at = (p) => sorted[Math.min(count - 1, Math.floor(count * p))];
+    return { p50: at(0.5), p99: at(0.99), p999: at(0.999), max: sorted[count - 1] };
+}
+
+//Event loop delay in ms -- uses perf_hooks when it is there and otherwise measures how late a 1ms timer fires
+function startLoopMonitor() {
+    let perfHooks = undefined;
+    try {
+        perfHooks = require("perf_hooks");
+    }
+    catch (ex) {
+        perfHooks = undefined;
+    }
+
+    if (perfHooks !== undefined && typeof (perfHooks.monitorEventLoopDelay) === "function") {
+        const histogram = perfHooks.monitorEventLoopDelay({ resolution: 1 });
+        histogram.enable();
+
+        return () => {
+            histogram.disable();
+            return { p50: histogram.percentile(50) / 1e6, p99: histogram.percentile(99) / 1e6, p999: histogram.percentile(99.9) / 1e6, max: histogram.max / 1e6 };
+        };
+    }
+
+    const delays = new Float64Array(1 << 20);
+    let count = 0;
+    let last = process.hrtime.bigint();
+    const timer = setInterval(() => {
+        const now = process.hrtime.bigint();
+        if (count < delays.length) {
+            delays[count++] = Math.max(0, Number(now - last) / 1e6 - 1);
+        }
+        last = now;
+    }, 1);
+
+    return () => {
+        clearInterval(timer);
+        return percentiles(delays, count);
+    };
+}
+
+function runConfig(name, seconds) {
+    const tmpdir = fs.mkdtempSync(path.join(os.tmpdir(), "logpp_latencybench_"));
+    const config = configs[name];
+
+    const options = { flushMode: config.flushMode, flushTarget: config.flushTarget };
+    if (config.flushTarget === "stream") {
+        options.stream = fs.createWriteStream(path.join(tmpdir, "out.txt"));
+    }
+    else if (config.flushTarget === "aggregate") {
+        options.aggregateFile = path.join(tmpdir, "out.txt");
+    }
+    else if (config.flushTarget === "columnar") {
+        options.columnarDir = tmpdir;
+    }
+    else if (config.flushTarget === "sinks") {
+        options.sinks = [{ output: "file", path: path.join(tmpdir, "out.txt") }, { output: "file", path: path.join(tmpdir, "out.ndjson"), level: "WARN", mode: "ndjson" }];
+    }
+
+    const logpp = require("../src/logger")("latencybench", options);
+    logpp.addFormat("Simple", "hello world");
+    logpp.addFormat("Request", "#wallclock request %s took %n ms with status %n");
+    logpp.addFormat("Payload", "%s iteration %n with payload %j");
+    logpp.addFormat("Failure", "failed %s after %n retries -- %j");
+
+    const payload = { name: "latency", values: [1, 2, 3, 4, 5], nested: { ok: true, text: "some more text to make the messages bigger" } };
+    const failure = { code: "ETIMEDOUT", host: "db.internal", attempts: [10, 20, 40] };
+
+    //up to 4M call samples (and every call after that is still made but not timed)
+    const calls = new Float64Array(1 << 22);
+    let callCount = 0;
+    let totalCalls = 0;
+
+    const timed = (fn) => {
+        const start = process.hrtime.bigint();
+        fn();
+        const end = process.hrtime.bigint();
+
+        totalCalls++;
+        if (callCount < calls.length) {
+            calls[callCount++] = Number(end - start) / 1000;
+        }
+    };
+
+    const logOne = (i) => {
+        switch (i % 8) {
+            case 0:
+                timed(() => logpp.info(logpp.$Simple));
+                break;
+            case 1:
+            case 2:
+            case 3:
+                timed(() => logpp.info(logpp.$Request, "/api/items", i % 97, 200));
+                break;
+            case 4:
+            case 5:
+                timed(() => logpp.info(logpp.$Payload, "bench", i, payload));
+                break;
+            case 6:
+                timed(() => logpp.debug(logpp.$Payload, "detail", i, payload));
+                break;
+            default:
+                timed(() => logpp.warn(logpp.$Failure, "query", i % 5, failure));
+                break;
+        }
+    };
+
+    let maxRss = 0;
+    let maxNative = 0;
+    let maxBlockBytes = 0;
+    const sample = () => {
+        const usage = logpp.getMemoryUsage();
+        maxRss = Math.max(maxRss, process.memoryUsage().rss);
+        maxNative = Math.max(maxNative, usage.used);
+        maxBlockBytes = Math.max(maxBlockBytes, usage.blockBytes);
+    };
+
+    const stopLoopMonitor = startLoopMonitor();
+    const endTime = Date.now() + seconds * 1000;
+
+    let tick = 0;
+    let msg = 0;
+    const logTick = () => {
+        const count = (tick % burstEvery === 0) ? burstSize : steadyPerTick;
+        for (let i = 0; i < count; ++i) {
+            logOne(msg++);
+        }
+        sample();
+        tick++;
+
+        if (Date.now() < endTime) {
+            setImmediate(logTick);
+        }
+        else {
+            const loop = stopLoopMonitor();
+
+            //give the async writers a moment to drain before reading the totals
+            setTimeout(() => {
+                const usage = logpp.getMemoryUsage();
+                process.send({
+                    config: name,
+                    flushMode: config.flushMode,
+                    flushTarget: config.flushTarget,
+                    calls: totalCalls,
+                    callsPerSecond: totalCalls / seconds,
+                    callMicros: percentiles(calls, callCount),
+                    loopDelayMs: loop,
+                    memory: { maxRss: maxRss, maxNative: maxNative, maxBlockBytes: maxBlockBytes, bytesPerMsg: usage.queuedMessages !== 0 ? usage.queuedBytes / usage.queuedMessages : 0 }
+                }, () => {
+                    process.exit(0);
+                });
+            }, 250);
+        }
+    };
+
+    setImmediate(logTick);
+}
+
+function fmt(stats, digits) {
+    return `p50 ${stats.p50.toFixed(digits)}, p99 ${stats.p99.toFixed(digits)}, p99.9 ${stats.p999.toFixed(digits)}, max ${stats.max.toFixed(digits)}`;
+}
+
+function report(result) {
+    console.log(`${result.config} (${result.flushMode} ${result.flushTarget}): ${result.calls} calls (${(result.callsPerSecond / 1000).toFixed(0)}K/s)`);
+    console.log(`  call us     ${fmt(result.callMicros, 2)}`);
+    console.log(`  loop ms     ${fmt(result.loopDelayMs, 2)}`);
+    console.log(`  memory      max native ${(result.memory.maxNative / 1048576).toFixed(2)}MB, max blocks ${(result.memory.maxBlockBytes / 1048576).toFixed(2)}MB, max rss ${(result.memory.maxRss / 1048576).toFixed(2)}MB, ${result.memory.bytesPerMsg.toFixed(1)} bytes/msg`);
+}
+
+function runAll(names, seconds, jsonFile) {
+    const results = [];
+
+    const next = (index) => {
+        if (index === names.length) {
+            if (jsonFile !== undefined) {
+                const output = { node: process.version, platform: process.platform, arch: process.arch, cpus: os.cpus().length, date: new Date().toISOString(), seconds: seconds, results: results };
+                fs.writeFileSync(jsonFile, JSON.stringify(output, undefined, 2));
+                console.log(`Results written to ${jsonFile}`);
+            }
+            return;
+        }
+
+        //log output goes nowhere for the console configurations and results come back over IPC
+        const child = childProcess.fork(__filename, ["--child", names[index], "--seconds", seconds.toString()], { stdio: ["ignore", "ignore", "inherit", "ipc"] });
+        let result = undefined;
+        child.on("message", (msg) => {
+            result = msg;
+        });
+        child.on("exit", (code) => {
+            if (result !== undefined) {
+                results.push(result);
+                report(result);
+            }
+            else {
+                console.log(`${names[index]}: failed (exit code ${code})`);
+            }
+            next(index + 1);
+        });
+    };
+
+    console.log("----");
+    console.log(`Running latency bench for ${seconds}s per configuration (${steadyPerTick} msgs per tick with ${burstSize} msg bursts every ${burstEvery} ticks)`);
+    next(0);
+}
+
+const args = process.argv.slice(2);
+let seconds = 5;
+let jsonFile = undefined;
+let child = undefined;
+const names = [];
+for (let i = 0; i < args.length; ++i) {
+    if (args[i] === "--seconds") {
+        seconds = Number.parseFloat(args[++i]);
+    }
+    else if (args[i] === "--json") {
+        jsonFile = args[++i];
+    }
+    else if (args[i] === "--child") {
+        child = args[++i];
+    }
+    else if (configs[args[i]] !== undefined) {
+        names.push(args[i]);
+    }
+    else {
+        console.log(`Unknown configuration ${args[i]} -- expected one of ${Object.keys(configs).join(", ")}`);
+        process.exit(1);
+    }
+}
+
+if (child !== undefined) {
+    runConfig(child, seconds);
+}
+else {
+    runAll(names.length !== 0 ? names : Object.keys(configs), seconds, jsonFile);
+}
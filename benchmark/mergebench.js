@@ -0,0 +1,71 @@
+"use strict";
+
+//
+//Throughput of merging the logs from several processes by time with mergeLogFiles (files are written to the tmp dir and read back from the page cache)
+//  node benchmark/mergebench.js [FILE_COUNT] [MB_PER_FILE]
+//
+
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+const fileCount = Number.parseInt(process.argv[2] || "8");
+const mbPerFile = Number.parseInt(process.argv[3] || "64");
+const runs = 5;
+
+const tmpbase = path.join(os.tmpdir(), "logpp_mergebench_" + process.pid);
+const outfile = tmpbase + "_out.txt";
+
+function writeInput(file, id) {
+    const fd = fs.openSync(file, "w");
+
+    let time = Date.parse("2018-03-01T10:00:00.000Z") + id;
+    let written = 0;
+    let ctr = 0;
+    while (written < mbPerFile * 1048576) {
+        const lines = [];
+        for (let i = 0; i < 1000; ++i) {
+            time += (ctr % 3);
+            lines.push(`INFO#default @ ${new Date(time).toISOString()} from host::worker${id} | request ${ctr++} completed for "/api/items/${ctr % 97}" in ${ctr % 13}ms`);
+        }
+
+        const chunk = lines.join("\n") + "\n";
+        fs.writeSync(fd, chunk);
+        written += chunk.length;
+    }
+
+    fs.closeSync(fd);
+}
+
+function median(values) {
+    const sorted = values.slice().sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+const logpp = require("../src/logger")("mergebench", { flushMode: "NOP" });
+
+const files = [];
+for (let i = 0; i < fileCount; ++i) {
+    files.push(tmpbase + "_" + i + ".txt");
+    writeInput(files[i], i);
+}
+
+const times = [];
+let res = undefined;
+for (let i = 0; i < runs; ++i) {
+    const start = process.hrtime();
+    res = logpp.mergeLogFiles(files, outfile);
+    const elapsed = process.hrtime(start);
+
+    if (res === false) {
+        throw new Error("Merge failed");
+    }
+    times.push(elapsed[0] + elapsed[1] / 1000000000);
+}
+
+const seconds = median(times);
+console.log(`Merged ${fileCount} files (${(res.bytes / 1048576).toFixed(0)}MB, ${res.lines} lines) in ${(seconds * 1000).toFixed(0)}ms (median of ${runs}):`);
+console.log(`    ${(res.bytes / seconds / 1073741824).toFixed(2)} GB/s`);
+
+files.forEach((file) => fs.unlinkSync(file));
+fs.unlinkSync(outfile);
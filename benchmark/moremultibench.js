@@ -15,6 +15,7 @@ var plog = require("pino")(dest);
 
 var logpp = require("../src/logger")("basic", { flushTarget: "stream", stream: dest, prefix: false });
 logpp.addFormat("hello3", "#host #wallclock #timestamp hello at #wallclock from #logger with %j %n -- %s");
+require("./blockmemory")(logpp, "moremulti");
 
 process.env.DEBUG = "dlog";
 var debug = require("debug");
@@ -15,6 +15,7 @@ var plog = require("pino")(dest);
 
 var logpp = require("../src/logger")("basic", { flushTarget: "stream", stream: dest, prefix: false });
 logpp.addFormat("hello2", "#host #wallclock #timestamp hello %s %j %n");
+require("./blockmemory")(logpp, "multi");
 
 process.env.DEBUG = "dlog";
 var debug = require("debug");
@@ -0,0 +1,102 @@
+"use strict";
+
+//
+//Time from logging an ERROR (under a heavy INFO load) until it is in the output file -- with the priority path (fsync'd) or with the normal batches
+//  node benchmark/prioritybench.js [PRIORITY|BATCHED]
+//
+
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+const mode = process.argv[2] || "PRIORITY";
+
+const outfile = path.join(os.tmpdir(), "logpp_prioritybench_" + process.pid + ".txt");
+const outfd = fs.openSync(outfile, "w");
+const readfd = fs.openSync(outfile, "r");
+
+const options = { flushTarget: "stream", stream: fs.createWriteStream(null, { fd: outfd }), flushMode: "ASYNC" };
+if (mode === "PRIORITY") {
+    options.priorityLevel = "ERROR";
+    options.prioritySync = true;
+}
+
+const logpp = require("../src/logger")("prioritybench", options);
+logpp.addFormat("Msg", "#wallclock %s iteration %n with payload %j");
+logpp.addFormat("Urgent", "urgent-%n");
+
+const payload = { name: "priority", values: [1, 2, 3, 4, 5], nested: { ok: true, text: "some more text to make the messages bigger" } };
+
+const rounds = 200;
+const perRound = 2000;
+const errorEvery = 4;
+
+const latencies = [];
+let round = 0;
+let readPos = 0;
+let readTail = "";
+
+//True if "urgent-<id>" has made it into the output file (only reads what was added since the last check)
+function written(id) {
+    const size = fs.fstatSync(readfd).size;
+    if (size > readPos) {
+        const buff = Buffer.alloc(size - readPos);
+        fs.readSync(readfd, buff, 0, buff.length, readPos);
+        readPos = size;
+        readTail = (readTail + buff.toString()).slice(-4096);
+    }
+
+    return readTail.indexOf("urgent-" + id + "\n") !== -1;
+}
+
+function waitForWrite(id, start, cb) {
+    if (written(id)) {
+        latencies.push(Number(process.hrtime.bigint() - start) / 1000000);
+        cb();
+    }
+    else {
+        setTimeout(() => waitForWrite(id, start, cb), 1);
+    }
+}
+
+function percentile(sorted, p) {
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+function report() {
+    const sorted = latencies.slice().sort((a, b) => a - b);
+    console.log(`Mode ${mode}: ${sorted.length} errors under ${rounds * perRound} info msgs`);
+    console.log(`  time to written p50 ${percentile(sorted, 0.5).toFixed(3)}ms, p99 ${percentile(sorted, 0.99).toFixed(3)}ms, max ${sorted[sorted.length - 1].toFixed(3)}ms`);
+
+    fs.closeSync(readfd);
+    fs.unlinkSync(outfile);
+}
+
+function logRound() {
+    for (let i = 0; i < perRound; ++i) {
+        logpp.info(logpp.$Msg, "bench", i, payload);
+    }
+
+    const next = () => {
+        if (++round < rounds) {
+            setImmediate(logRound);
+        }
+        else {
+            report();
+        }
+    };
+
+    if (round % errorEvery === 0) {
+        const start = process.hrtime.bigint();
+        logpp.error(logpp.$Urgent, round);
+        waitForWrite(round, start, next);
+    }
+    else {
+        next();
+    }
+}
+
+console.log("----");
+console.log(`Running priority latency bench (${rounds * perRound} msgs) in mode ${mode}`);
+
+setImmediate(logRound);
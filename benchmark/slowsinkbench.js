@@ -0,0 +1,69 @@
+"use strict";
+
+//
+//Log much faster than a (deliberately) slow stream can write and check that native memory stays within the budget for each policy
+//  node benchmark/slowsinkbench.js [FLUSH|DROP_LEVELS|DROP_OLDEST|NONE]
+//
+
+const stream = require("stream");
+
+const policy = process.argv[2] || "FLUSH";
+const budget = 4 * 1024 * 1024;
+
+//accepts 64KB every 10ms (~6.4MB/s)
+let written = 0;
+const dest = new stream.Writable({
+    highWaterMark: 65536,
+    write: function (chunk, encoding, cb) {
+        written += chunk.length;
+        setTimeout(cb, 10);
+    }
+});
+
+const options = { flushTarget: "stream", stream: dest, flushMode: "ASYNC", bufferTimeLimit: 0 };
+if (policy !== "NONE") {
+    options.memoryBudget = budget;
+    options.memoryPolicy = policy;
+}
+
+const logpp = require("../src/logger")("slowsink", options);
+logpp.addFormat("Msg", "#wallclock #timestamp %s iteration %n with payload %j");
+
+const payload = { name: "slow sink", values: [1, 2, 3, 4, 5], nested: { ok: true, text: "some more text to make the messages bigger" } };
+
+const rounds = 200;
+const perRound = 2000;
+
+let maxRss = 0;
+let maxNative = 0;
+let round = 0;
+
+function sample() {
+    maxRss = Math.max(maxRss, process.memoryUsage().rss);
+    maxNative = Math.max(maxNative, logpp.getMemoryUsage().used);
+}
+
+function logRound() {
+    for (let i = 0; i < perRound; ++i) {
+        logpp.info(logpp.$Msg, "bench", i, payload);
+        if (i % 100 === 0) {
+            logpp.debug(logpp.$Msg, "debug", i, payload);
+        }
+    }
+    sample();
+
+    if (++round < rounds) {
+        setImmediate(logRound);
+    }
+    else {
+        const usage = logpp.getMemoryUsage();
+        console.log(`Policy ${policy}: budget ${policy !== "NONE" ? (budget / (1024 * 1024)).toFixed(1) + "MB" : "none"}`);
+        console.log(`  max native ${(maxNative / (1024 * 1024)).toFixed(2)}MB, max rss ${(maxRss / (1024 * 1024)).toFixed(2)}MB`);
+        console.log(`  written ${(written / (1024 * 1024)).toFixed(2)}MB, dropped ${usage.droppedMessages} msgs (${usage.droppedBlocks} blocks)`);
+    }
+}
+
+console.log("----");
+console.log(`Running slow sink stress (${rounds * perRound} msgs) with memoryPolicy ${policy}`);
+
+setImmediate(logRound);
@@ -3,6 +3,7 @@
         "target_name": "nlogger",
         "include_dirs": ["<!@(node -p \"require('node-addon-api').include\")"],
         "dependencies": ["<!(node -p \"require('node-addon-api').gyp\")"],
+        "defines": [ "NAPI_VERSION=4" ],
         "cflags!": [ "-fno-exceptions" ],
         "cflags_cc!": [ "-fno-exceptions" ],
         "xcode_settings": {
@@ -15,11 +16,29 @@
         },
         "sources": [ 
             "./nsrc/common.h",
+            "./nsrc/mpscqueue.h",
+            "./nsrc/output.h",
+            "./nsrc/tracer.h",
+            "./nsrc/registry.h",
+            "./nsrc/prefixcache.h",
+            "./nsrc/memorybudget.h",
+            "./nsrc/flushscheduler.h",
             "./nsrc/environment.h",
             "./nsrc/format.h",
             "./nsrc/formatter.h",
+            "./nsrc/signalsafewriter.h",
             "./nsrc/processingblock.h",
+            "./nsrc/query.h",
+            "./nsrc/metrics.h",
+            "./nsrc/flightrecorder.h",
             "./nsrc/formatworker.h",
+            "./nsrc/crashflush.h",
+            "./nsrc/formatcatalog.h",
+            "./nsrc/backgroundwriter.h",
+            "./nsrc/aggregator.h",
+            "./nsrc/columnar.h",
+            "./nsrc/logmerge.h",
+            "./nsrc/sinks.h",
             "./nsrc/nlogger.cc" 
             ]
     }]
@@ -0,0 +1,167 @@
+#pragma once
+
+//Merges the processed blocks from all the logging environments (main thread + worker_threads) into a single output file.
+//Each environment pushes its blocks into a lock-free queue and a single native writer thread merges them by wallclock time and formats them.
+class LogAggregator
+{
+private:
+    struct AggregateBlock
+    {
+        int64_t producerId;
+        bool stdPrefix;
+        std::shared_ptr<LogProcessingBlock> block;
+
+        AggregateBlock() :
+            producerId(-1), stdPrefix(false), block(nullptr)
+        {
+            ;
+        }
+
+        AggregateBlock(int64_t producerId, bool stdPrefix, std::shared_ptr<LogProcessingBlock> block) :
+            producerId(producerId), stdPrefix(stdPrefix), block(block)
+        {
+            ;
+        }
+    };
+
+    LoggingRegistry* m_registry;
+
+    //Blocks waiting to be merged (in order) for each producer -- only touched by the writer thread
+    std::map<int64_t, std::deque<AggregateBlock>> m_pending;
+    std::unique_ptr<LoggingEnvironment> m_lenv;
+    Formatter m_formatter;
+
+    std::string m_path;
+    int m_fd;
+    int64_t m_window;
+    std::atomic<int64_t> m_producerCtr;
+
+    //Producers push without taking any locks -- only the writer thread pops
+    BackgroundWriter<AggregateBlock> m_writer;
+
+    static int64_t GetCurrentWallTime()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    //On the writer thread
+    void AddPending(AggregateBlock& ablock)
+    {
+        ablock.block->resetFormatPosition();
+        this->m_pending[ablock.producerId].push_back(std::move(ablock));
+    }
+
+    //Emit messages (oldest first over all producers) until we reach the first message newer than the watermark
+    void MergePending(Formatter* formatter, int64_t watermark)
+    {
+        while (true)
+        {
+            AggregateBlock* next = nullptr;
+            int64_t nextTime = INT64_MAX;
+
+            for (auto iter = this->m_pending.begin(); iter != this->m_pending.end(); iter++)
+            {
+                std::deque<AggregateBlock>& blocks = iter->second;
+                while (!blocks.empty() && !blocks.front().block->hasMoreFormatEntries())
+                {
+                    blocks.pop_front();
+                }
+
+                if (!blocks.empty())
+                {
+                    const int64_t msgTime = static_cast<int64_t>(blocks.front().block->getFormatEntryWallTime());
+                    if (msgTime < nextTime)
+                    {
+                        next = &blocks.front();
+                        nextTime = msgTime;
+                    }
+                }
+            }
+
+            if (next == nullptr || nextTime > watermark)
+            {
+                return;
+            }
+
+            next->block->emitFormatEntry(formatter, this->m_lenv.get(), next->stdPrefix);
+        }
+    }
+
+    //On the writer thread
+    void WritePending(bool flushing, bool stopping)
+    {
+        //when flushing or shutting down everything we have gets written -- otherwise hold back recent messages so late threads can merge in order
+        const int64_t watermark = (flushing || stopping) ? INT64_MAX : GetCurrentWallTime() - this->m_window;
+        this->MergePending(&this->m_formatter, watermark);
+
+        if (this->m_formatter.getOutputBufferSize() != 0)
+        {
+            WriteOutputFully(this->m_fd, this->m_formatter.getOutputBuffer(), this->m_formatter.getOutputBufferSize());
+            this->m_formatter.reset();
+        }
+    }
+
+public:
+    LogAggregator(LoggingRegistry* registry) :
+        m_registry(registry), m_pending(), m_lenv(nullptr), m_formatter(),
+        m_path(), m_fd(-1), m_window(DEFAULT_AGGREGATE_WINDOW), m_producerCtr(0),
+        m_writer("logpp-aggregate", [this](AggregateBlock& ablock) { this->AddPending(ablock); }, [this](bool flushing, bool stopping) { this->WritePending(flushing, stopping); })
+    {
+        ;
+    }
+
+    ~LogAggregator()
+    {
+        this->Stop();
+    }
+
+    //Start the writer (or join the running one if it is writing to the same file) and get a producer id -- returns -1 on failure
+    int64_t Start(const std::string& path, int64_t window, const std::string& hostName, const std::string& appName)
+    {
+        const bool started = this->m_writer.Start([&](bool running) {
+            if (running)
+            {
+                return this->m_path == path;
+            }
+
+            this->m_fd = OpenOutputFile(path);
+            if (this->m_fd < 0)
+            {
+                return false;
+            }
+
+            this->m_path = path;
+            this->m_window = window;
+            this->m_lenv.reset(new LoggingEnvironment(this->m_registry, LoggingLevel::LLALL, hostName, appName));
+            return true;
+        });
+
+        return started ? this->m_producerCtr++ : -1;
+    }
+
+    bool IsRunning()
+    {
+        return this->m_writer.IsRunning();
+    }
+
+    //Safe to call from any thread without blocking
+    void Submit(int64_t producerId, bool stdPrefix, std::shared_ptr<LogProcessingBlock> block)
+    {
+        this->m_writer.Submit(AggregateBlock(producerId, stdPrefix, block));
+    }
+
+    //Block until everything submitted (by any thread) before this call has been written
+    void Flush()
+    {
+        this->m_writer.Flush();
+    }
+
+    void Stop()
+    {
+        if (this->m_writer.Stop())
+        {
+            CloseOutputFile(this->m_fd);
+            this->m_fd = -1;
+        }
+    }
+};
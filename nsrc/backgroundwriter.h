@@ -0,0 +1,143 @@
+#pragma once
+
+//The native writer thread shared by the aggregator, the columnar writer, and the sinks.
+//Producers push items into a lock-free queue and the writer thread hands each one to the write callback, then calls the drained callback once the queue is empty.
+//The drained callback is told if a flush was requested (everything submitted so far must be written before it returns) or if the writer is stopping.
+template <typename T>
+class BackgroundWriter
+{
+public:
+    typedef std::function<void(T&)> WriteCallback;
+    typedef std::function<void(bool flushing, bool stopping)> DrainedCallback;
+
+private:
+    const char* m_threadName;
+    WriteCallback m_write;
+    DrainedCallback m_drained;
+
+    MPSCQueue<T> m_queue;
+
+    //Protects the start/stop state and the flush handshake (never taken by the push path)
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_flushed;
+    uint64_t m_flushRequest;
+    uint64_t m_flushComplete;
+    bool m_stopping;
+    std::thread m_writer;
+
+    void WriterLoop()
+    {
+        TraceRecorder::SetCurrentThreadName(this->m_threadName);
+
+        bool stopping = false;
+        while (!stopping)
+        {
+            uint64_t flushTicket = 0;
+            {
+                std::unique_lock<std::mutex> lock(this->m_lock);
+                this->m_wake.wait_for(lock, std::chrono::milliseconds(AGGREGATE_POLL_INTERVAL), [this]() { return this->m_stopping || this->m_flushRequest != this->m_flushComplete; });
+
+                flushTicket = this->m_flushRequest;
+                stopping = this->m_stopping;
+            }
+
+            //only the writer thread writes m_flushComplete so it can be read without the lock here
+            const bool flushing = flushTicket != this->m_flushComplete;
+
+            T item;
+            while (this->m_queue.Pop(item))
+            {
+                this->m_write(item);
+            }
+            item = T(); //don't hold on to the last item until the next wakeup
+
+            this->m_drained(flushing, stopping);
+
+            if (flushing)
+            {
+                std::lock_guard<std::mutex> lock(this->m_lock);
+                this->m_flushComplete = flushTicket;
+                this->m_flushed.notify_all();
+            }
+        }
+    }
+
+public:
+    BackgroundWriter(const char* threadName, WriteCallback write, DrainedCallback drained) :
+        m_threadName(threadName), m_write(write), m_drained(drained), m_queue(),
+        m_lock(), m_wake(), m_flushed(), m_flushRequest(0), m_flushComplete(0), m_stopping(false), m_writer()
+    {
+        ;
+    }
+
+    ~BackgroundWriter()
+    {
+        this->Stop();
+    }
+
+    //Start the writer thread if it is not running -- configure is called (under the start/stop lock) with true if it is already running and the writer is only started if it returns true.
+    //Returns the result of configure.
+    bool Start(const std::function<bool(bool running)>& configure)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        const bool running = this->m_writer.joinable();
+        if (!configure(running))
+        {
+            return false;
+        }
+
+        if (!running)
+        {
+            this->m_stopping = false;
+            this->m_writer = std::thread(&BackgroundWriter::WriterLoop, this);
+        }
+
+        return true;
+    }
+
+    bool IsRunning()
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        return this->m_writer.joinable();
+    }
+
+    //Safe to call from any thread without blocking
+    void Submit(T&& item)
+    {
+        this->m_queue.Push(std::forward<T>(item));
+    }
+
+    //Block until everything submitted (by any thread) before this call has been written
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock(this->m_lock);
+        if (!this->m_writer.joinable())
+        {
+            return;
+        }
+
+        const uint64_t flushTicket = ++this->m_flushRequest;
+        this->m_wake.notify_one();
+        this->m_flushed.wait(lock, [this, flushTicket]() { return this->m_flushComplete >= flushTicket; });
+    }
+
+    //Write everything that is queued and join the writer thread -- returns false if it was not running
+    bool Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_lock);
+            if (!this->m_writer.joinable())
+            {
+                return false;
+            }
+
+            this->m_stopping = true;
+            this->m_wake.notify_one();
+        }
+
+        this->m_writer.join();
+        return true;
+    }
+};
@@ -0,0 +1,487 @@
+#pragma once
+
+//Output mode that stores messages as rows of a table per format (the format entries give a fixed schema) and writes them as columnar segment files.
+//A segment file is a header -- magic, version, format id, format name, format string, row count, column count -- then the schema (name + type of each column)
+//and then each column -- a validity byte per row (0 for a missing/mismatched value) followed by the values:
+//  TimeDelta  -- i64 base time then u32 byte count + zigzag varint deltas from the previous row
+//  Float64    -- f64 per row
+//  UInt8      -- u8 per row
+//  UInt32     -- u32 per row
+//  DictString/DictJson -- u32 dictionary size + the strings then u32 dictionary index per row
+//All values are in the native byte order (like the format catalog).
+enum class ColumnType : uint8_t
+{
+    TimeDelta = 0x1,
+    Float64 = 0x2,
+    UInt8 = 0x3,
+    UInt32 = 0x4,
+    DictString = 0x5,
+    DictJson = 0x6
+};
+
+class ColumnBuffer
+{
+private:
+    std::string m_name;
+    ColumnType m_type;
+
+    std::vector<uint8_t> m_valid;
+
+    std::vector<double> m_doubles;
+    std::vector<uint8_t> m_bytes; //UInt8 values or the TimeDelta varints
+    std::vector<uint32_t> m_ints; //UInt32 values or dictionary indices
+
+    std::unordered_map<std::string, uint32_t> m_dictIds;
+    std::vector<const std::string*> m_dict; //points at the keys in m_dictIds (which never move)
+
+    int64_t m_timeBase;
+    int64_t m_timeLast;
+
+    void AddDictString(const std::string& str)
+    {
+        auto iter = this->m_dictIds.find(str);
+        if (iter == this->m_dictIds.end())
+        {
+            iter = this->m_dictIds.emplace(str, static_cast<uint32_t>(this->m_dict.size())).first;
+            this->m_dict.push_back(&iter->first);
+        }
+
+        this->m_ints.push_back(iter->second);
+    }
+
+public:
+    ColumnBuffer(std::string&& name, ColumnType type) :
+        m_name(std::forward<std::string>(name)), m_type(type), m_valid(), m_doubles(), m_bytes(), m_ints(), m_dictIds(), m_dict(), m_timeBase(0), m_timeLast(0)
+    {
+        ;
+    }
+
+    ColumnType GetType() const { return this->m_type; }
+    size_t GetRowCount() const { return this->m_valid.size(); }
+
+    void AddNull()
+    {
+        this->m_valid.push_back(0);
+        switch (this->m_type)
+        {
+        case ColumnType::TimeDelta:
+            AppendZigZagVarInt(this->m_bytes, 0);
+            break;
+        case ColumnType::Float64:
+            this->m_doubles.push_back(0.0);
+            break;
+        case ColumnType::UInt8:
+            this->m_bytes.push_back(0);
+            break;
+        default:
+            this->m_ints.push_back(0);
+            break;
+        }
+    }
+
+    void AddTime(int64_t time)
+    {
+        if (this->m_valid.empty())
+        {
+            this->m_timeBase = time;
+            this->m_timeLast = time;
+        }
+
+        this->m_valid.push_back(1);
+        AppendZigZagVarInt(this->m_bytes, time - this->m_timeLast);
+        this->m_timeLast = time;
+    }
+
+    void AddUInt32(uint32_t value)
+    {
+        this->m_valid.push_back(1);
+        this->m_ints.push_back(value);
+    }
+
+    void AddString(const std::string* str)
+    {
+        if (str == nullptr)
+        {
+            this->AddNull();
+        }
+        else
+        {
+            this->m_valid.push_back(1);
+            this->AddDictString(*str);
+        }
+    }
+
+    void AddValue(LogEntryTag tag, double value, const std::string* str)
+    {
+        if (this->m_type == ColumnType::Float64 && (tag == LogEntryTag::JsVarValue_Number || tag == LogEntryTag::JsVarValue_Date))
+        {
+            this->m_valid.push_back(1);
+            this->m_doubles.push_back(value);
+        }
+        else if (this->m_type == ColumnType::UInt8 && tag == LogEntryTag::JsVarValue_Bool)
+        {
+            this->m_valid.push_back(1);
+            this->m_bytes.push_back(value != 0.0 ? 1 : 0);
+        }
+        else if ((this->m_type == ColumnType::DictString || this->m_type == ColumnType::DictJson) && str != nullptr)
+        {
+            this->m_valid.push_back(1);
+            this->AddDictString(*str);
+        }
+        else
+        {
+            this->AddNull();
+        }
+    }
+
+    void WriteSchema(BinaryWriter& writer) const
+    {
+        writer.WriteString(this->m_name);
+        writer.WriteU8(static_cast<uint8_t>(this->m_type));
+    }
+
+    void WriteData(BinaryWriter& writer) const
+    {
+        writer.WriteArray(this->m_valid);
+
+        switch (this->m_type)
+        {
+        case ColumnType::TimeDelta:
+            writer.WriteI64(this->m_timeBase);
+            writer.WriteU32(static_cast<uint32_t>(this->m_bytes.size()));
+            writer.WriteArray(this->m_bytes);
+            break;
+        case ColumnType::Float64:
+            writer.WriteArray(this->m_doubles);
+            break;
+        case ColumnType::UInt8:
+            writer.WriteArray(this->m_bytes);
+            break;
+        case ColumnType::UInt32:
+            writer.WriteArray(this->m_ints);
+            break;
+        default:
+            writer.WriteU32(static_cast<uint32_t>(this->m_dict.size()));
+            for (size_t i = 0; i < this->m_dict.size(); ++i)
+            {
+                writer.WriteString(*this->m_dict[i]);
+            }
+            writer.WriteArray(this->m_ints);
+            break;
+        }
+    }
+
+    void Clear()
+    {
+        this->m_valid.clear();
+        this->m_doubles.clear();
+        this->m_bytes.clear();
+        this->m_ints.clear();
+        this->m_dict.clear();
+        this->m_dictIds.clear();
+    }
+};
+
+//The rows for one format -- used as the visitor for LogProcessingBlock::visitFormatEntryRow
+class ColumnarTable
+{
+private:
+    const MsgFormat* m_fmt;
+
+    //time, level, category, logger, child info, and then a column for each argument entry in the format
+    std::vector<ColumnBuffer> m_columns;
+    size_t m_nextColumn;
+    size_t m_rows;
+
+    static const size_t ArgColumnStart = 5;
+
+    static ColumnType GetColumnType(const FormatEntry& fentry)
+    {
+        if (fentry.fkind == FormatStringEntryKind::Compound)
+        {
+            return ColumnType::DictJson;
+        }
+
+        switch (fentry.fenum)
+        {
+        case FormatStringEnum::LOGGER:
+        case FormatStringEnum::SOURCE:
+        case FormatStringEnum::STRING:
+            return ColumnType::DictString;
+        case FormatStringEnum::BOOL:
+            return ColumnType::UInt8;
+        default:
+            return ColumnType::Float64;
+        }
+    }
+
+    static std::string GetExpandoName(FormatStringEnum fenum)
+    {
+        switch (fenum)
+        {
+        case FormatStringEnum::LOGGER:
+            return "logger";
+        case FormatStringEnum::SOURCE:
+            return "source";
+        case FormatStringEnum::WALLCLOCK:
+            return "wallclock";
+        case FormatStringEnum::TIMESTAMP:
+            return "timestamp";
+        case FormatStringEnum::CALLBACK:
+            return "callback";
+        default:
+            return "request";
+        }
+    }
+
+public:
+    ColumnarTable(const MsgFormat* fmt) :
+        m_fmt(fmt), m_columns(), m_nextColumn(0), m_rows(0)
+    {
+        this->m_columns.emplace_back("$time", ColumnType::TimeDelta);
+        this->m_columns.emplace_back("$level", ColumnType::UInt32);
+        this->m_columns.emplace_back("$category", ColumnType::UInt32);
+        this->m_columns.emplace_back("$logger", ColumnType::DictString);
+        this->m_columns.emplace_back("$child", ColumnType::DictString);
+
+        size_t argPosition = 0;
+        const std::string* preceding = &fmt->GetInitialFormatStringSegment();
+        const std::vector<FormatEntry>& entries = fmt->GetEntries();
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const FormatEntry& fentry = entries[i];
+            if (fentry.fkind != FormatStringEntryKind::Literal && !(fentry.fkind == FormatStringEntryKind::Expando && (fentry.fenum == FormatStringEnum::HOST || fentry.fenum == FormatStringEnum::APP)))
+            {
+                std::string name = MsgFormat::GetPropertyName(*preceding);
+                if (name.empty())
+                {
+                    name = (fentry.fkind == FormatStringEntryKind::Expando) ? GetExpandoName(fentry.fenum) : ("arg" + std::to_string(argPosition));
+                }
+
+                if (fentry.fkind != FormatStringEntryKind::Expando)
+                {
+                    argPosition++;
+                }
+
+                this->m_columns.emplace_back(std::move(name), GetColumnType(fentry));
+            }
+
+            preceding = &fentry.ffollow;
+        }
+    }
+
+    const MsgFormat* GetFormat() const { return this->m_fmt; }
+    size_t GetRowCount() const { return this->m_rows; }
+
+    void Header(LoggingLevel level, int64_t category, int64_t walltime, const std::string* logger, const std::string* childInfo)
+    {
+        this->m_columns[0].AddTime(walltime);
+        this->m_columns[1].AddUInt32(static_cast<uint32_t>(level));
+        this->m_columns[2].AddUInt32(static_cast<uint32_t>(category));
+        this->m_columns[3].AddString(logger);
+        this->m_columns[4].AddString(childInfo);
+
+        this->m_nextColumn = ArgColumnStart;
+    }
+
+    void Value(LogEntryTag tag, double value, const std::string* str)
+    {
+        if (this->m_nextColumn < this->m_columns.size())
+        {
+            this->m_columns[this->m_nextColumn++].AddValue(tag, value, str);
+        }
+    }
+
+    //Pad out any columns a short (e.g., truncated) message did not fill
+    void EndRow()
+    {
+        while (this->m_nextColumn < this->m_columns.size())
+        {
+            this->m_columns[this->m_nextColumn++].AddNull();
+        }
+
+        this->m_rows++;
+    }
+
+    bool WriteSegment(const std::string& path) const
+    {
+        BinaryWriter writer;
+        writer.WriteU32(COLUMNAR_SEGMENT_MAGIC);
+        writer.WriteU32(COLUMNAR_SEGMENT_VERSION);
+        writer.WriteU32(static_cast<uint32_t>(this->m_fmt->GetFormatId()));
+        writer.WriteString(this->m_fmt->GetFormatName());
+        writer.WriteString(this->m_fmt->GetOriginalFormatString());
+        writer.WriteU32(static_cast<uint32_t>(this->m_rows));
+        writer.WriteU32(static_cast<uint32_t>(this->m_columns.size()));
+
+        for (size_t i = 0; i < this->m_columns.size(); ++i)
+        {
+            this->m_columns[i].WriteSchema(writer);
+        }
+
+        for (size_t i = 0; i < this->m_columns.size(); ++i)
+        {
+            this->m_columns[i].WriteData(writer);
+        }
+
+        return writer.WriteToFile(path);
+    }
+
+    void Clear()
+    {
+        for (size_t i = 0; i < this->m_columns.size(); ++i)
+        {
+            this->m_columns[i].Clear();
+        }
+
+        this->m_rows = 0;
+    }
+};
+
+//Like the aggregator -- every environment pushes its processed blocks to a single native writer thread which turns them into rows.
+//A segment file is written when a format has segmentRows rows buffered and for every format with rows on a flush.
+//A segment that cannot be written is counted as a failure and its rows dropped (like the sinks do).
+class ColumnarWriter
+{
+private:
+    LoggingRegistry* m_registry;
+
+    //Only touched by the writer thread
+    std::map<int64_t, std::unique_ptr<ColumnarTable>> m_tables;
+    std::unique_ptr<LoggingEnvironment> m_lenv;
+    Formatter m_scratch;
+    uint64_t m_segmentCtr;
+
+    std::string m_dir;
+    size_t m_segmentRows;
+
+    //Read by the JS thread for the stats
+    std::atomic<uint64_t> m_segments;
+    std::atomic<uint64_t> m_rows;
+    std::atomic<uint64_t> m_failures;
+
+    BackgroundWriter<std::shared_ptr<LogProcessingBlock>> m_writer;
+
+    void WriteSegment(ColumnarTable* table)
+    {
+        std::string path = this->m_dir + "/logpp-" + std::to_string(GetProcessId()) + "-f" + std::to_string(table->GetFormat()->GetFormatId()) + "-" + std::to_string(this->m_segmentCtr++) + ".lpcol";
+
+        if (table->WriteSegment(path))
+        {
+            this->m_segments.fetch_add(1, std::memory_order_relaxed);
+            this->m_rows.fetch_add(table->GetRowCount(), std::memory_order_relaxed);
+        }
+        else
+        {
+            this->m_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        table->Clear();
+    }
+
+    static int64_t GetProcessId()
+    {
+#ifdef _WIN32
+        return static_cast<int64_t>(_getpid());
+#else
+        return static_cast<int64_t>(getpid());
+#endif
+    }
+
+    //On the writer thread
+    void AddRows(std::shared_ptr<LogProcessingBlock>& block)
+    {
+        block->resetFormatPosition();
+        while (block->hasMoreFormatEntries())
+        {
+            const int64_t fmtId = block->getFormatEntryFormatId();
+            const MsgFormat* fmt = this->m_lenv->TryGetFormat(fmtId);
+            if (fmt == nullptr)
+            {
+                //an unknown format id has no table so the message is dropped
+                block->skipFormatEntry();
+                continue;
+            }
+
+            std::unique_ptr<ColumnarTable>& table = this->m_tables[fmtId];
+            if (table == nullptr)
+            {
+                table.reset(new ColumnarTable(fmt));
+            }
+
+            block->visitFormatEntryRow(this->m_lenv.get(), &this->m_scratch, *table);
+            table->EndRow();
+
+            if (table->GetRowCount() >= this->m_segmentRows)
+            {
+                this->WriteSegment(table.get());
+            }
+        }
+    }
+
+    //On the writer thread
+    void WritePartialSegments(bool flushing, bool stopping)
+    {
+        if (flushing || stopping)
+        {
+            for (auto iter = this->m_tables.begin(); iter != this->m_tables.end(); iter++)
+            {
+                if (iter->second->GetRowCount() != 0)
+                {
+                    this->WriteSegment(iter->second.get());
+                }
+            }
+        }
+    }
+
+public:
+    ColumnarWriter(LoggingRegistry* registry) :
+        m_registry(registry), m_tables(), m_lenv(nullptr), m_scratch(), m_segmentCtr(0),
+        m_dir(), m_segmentRows(DEFAULT_COLUMNAR_SEGMENT_ROWS), m_segments(0), m_rows(0), m_failures(0),
+        m_writer("logpp-columnar", [this](std::shared_ptr<LogProcessingBlock>& block) { this->AddRows(block); }, [this](bool flushing, bool stopping) { this->WritePartialSegments(flushing, stopping); })
+    {
+        ;
+    }
+
+    ~ColumnarWriter()
+    {
+        this->Stop();
+    }
+
+    //Start the writer (or join the running one if it is writing to the same directory) -- returns false if it is already writing somewhere else
+    bool Start(const std::string& dir, size_t segmentRows, const std::string& hostName, const std::string& appName)
+    {
+        return this->m_writer.Start([&](bool running) {
+            if (running)
+            {
+                return this->m_dir == dir;
+            }
+
+            this->m_dir = dir;
+            this->m_segmentRows = std::max<size_t>(segmentRows, 1);
+            this->m_lenv.reset(new LoggingEnvironment(this->m_registry, LoggingLevel::LLALL, hostName, appName));
+            return true;
+        });
+    }
+
+    uint64_t GetSegmentCount() const { return this->m_segments.load(std::memory_order_relaxed); }
+    uint64_t GetRowCount() const { return this->m_rows.load(std::memory_order_relaxed); }
+    uint64_t GetFailureCount() const { return this->m_failures.load(std::memory_order_relaxed); }
+
+    //Safe to call from any thread without blocking
+    void Submit(std::shared_ptr<LogProcessingBlock> block)
+    {
+        this->m_writer.Submit(std::move(block));
+    }
+
+    //Block until everything submitted (by any thread) before this call has been written to segment files
+    void Flush()
+    {
+        this->m_writer.Flush();
+    }
+
+    void Stop()
+    {
+        this->m_writer.Stop();
+    }
+};
@@ -3,6 +3,7 @@
 #include "napi.h"
 
 #include <cstdint>
+#include <cstring>
 
 #include <time.h>
 #include <cmath>
@@ -12,11 +13,38 @@
 #include <iomanip>
 
 #include <algorithm>
+#include <functional>
+#include <stdexcept>
 
 #include <memory>
 #include <vector>
 #include <stack>
+#include <deque>
+#include <queue>
 #include <map>
+#include <unordered_map>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <cerrno>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#endif
 
 enum class FormatStringEntryKind : uint8_t
 {
@@ -63,6 +91,8 @@ enum class LogEntryTag : uint8_t
     RParen = 0x9,
     LBrack = 0xA,
     RBrack = 0xB,
+    LShape = 0xC, //an object with a registered shape (the data is the shape id) -- the values follow in shape order and it is closed by RParen
+    MsgLoggerId = 0xD, //the id of the (sub)logger that logged the message -- only in the JS blocks (for the level masks) and only if it is not the root logger
 
     JsVarValue_Undefined = 0x11,
     JsVarValue_Null = 0x12,
@@ -96,8 +126,124 @@ enum class LoggingLevel :uint32_t
 };
 #define LOG_LEVEL_ENABLED(level, enabledLevel) ((static_cast<uint32_t>(level) & static_cast<uint32_t>(enabledLevel)) == static_cast<uint32_t>(level))
 
+//Written over the level of a message the priority path has already written -- not a valid level mask so it is never enabled
+#define PRIORITY_WRITTEN_LEVEL 0x100
+
+//The levels are contiguous bit masks so the number of set bits gives a dense index (OFF = 0 ... ALL = 8)
+#define LOGGING_LEVEL_COUNT 9
+inline size_t LoggingLevelIndex(LoggingLevel level)
+{
+    size_t index = 0;
+    for (uint32_t bits = static_cast<uint32_t>(level); bits != 0; bits >>= 1)
+    {
+        index += (bits & 0x1);
+    }
+
+    return index;
+}
+
+//Thread safe version of std::localtime (the dates are formatted on the JS thread and the native writer threads at the same time)
+inline bool LocalTime(std::time_t tval, std::tm& into)
+{
+#ifdef _WIN32
+    return localtime_s(&into, &tval) == 0;
+#else
+    return localtime_r(&tval, &into) != nullptr;
+#endif
+}
+
+//Rough size of a std::map node holding a string (used for memory accounting)
+#define STRING_MAP_NODE_OVERHEAD 64
+
+//In the encoded processing blocks a tag byte with this bit set is followed by a raw 8 byte double (instead of a zigzag varint) -- the tags are all < 0x80
+#define ENTRY_RAW_DOUBLE_FLAG 0x80
+
+//Values with a magnitude below this (that are whole numbers) are stored as varints in the processing blocks
+#define ENTRY_VARINT_LIMIT 9.0e15
+
+//Limit on the number of distinct logger names we keep pre-rendered prefixes for
+#define PREFIX_CACHE_MAX_LOGGERS 1024
+
+//The fatal signal handler writes through a 64KB buffer (on its own 64KB stack) for at most 64 environments
+#define CRASH_FLUSH_BUFFER_SIZE ((size_t)65536)
+#define CRASH_FLUSH_ALTSTACK_SIZE 65536
+#define CRASH_FLUSH_MAX_ENVIRONMENTS 64
+#define CRASH_FLUSH_SIGNAL_COUNT 5
+
+//Compiled format catalog files start with "LPPC" + the version (bump the version if the layout or any of the format enum values change)
+#define FORMAT_CATALOG_MAGIC 0x4350504C
+#define FORMAT_CATALOG_VERSION 1
+
+//Columnar segment files start with "LPCS" + the version and are written every 4096 rows (per format) by default
+#define COLUMNAR_SEGMENT_MAGIC 0x5343504C
+#define COLUMNAR_SEGMENT_VERSION 1
+#define DEFAULT_COLUMNAR_SEGMENT_ROWS 4096
+
+//The log file merge reads each input (and buffers the output) in 1MB chunks
+#define MERGE_IO_BUFFER_SIZE ((size_t)1048576)
+
 //Defaults for block flushing are over 0.5s or more than 4096 entries used
 #define DEFAULT_LOG_TIMELIMIT 500
 #define DEFAULT_LOG_SLOTSUSED 4096
 
+//Without adaptive flushing JS checks for expired messages every 500ms (250ms if the last flush left messages behind)
+#define DEFAULT_FLUSH_DELAY 500
+#define DEFAULT_FLUSH_RETRY_DELAY 250
+
+//Adaptive flushing defaults to a 500ms latency target and 1MB of in memory (JS) messages -- each slot is a tag byte + a double
+#define DEFAULT_FLUSH_LATENCY_TARGET 500
+#define DEFAULT_FLUSH_MEMORY_TARGET 1048576
+#define IN_MEMORY_SLOT_BYTES 9
+
+//Bounds for the adaptive limits and the weight given to each new rate/cost sample (rates are sampled over at least 10ms)
+#define ADAPTIVE_FLUSH_MIN_TIMELIMIT 5
+#define ADAPTIVE_FLUSH_MIN_SLOTS 256
+#define ADAPTIVE_FLUSH_MIN_SAMPLE_TIME 10
+#define ADAPTIVE_FLUSH_EWMA_WEIGHT 0.25
+
 #define INIT_LOG_BLOCK_SIZE 64
+
+//Slots in the control record (a Float64Array) JS shares with processMsgChain -- keep in sync with ProcessControl in logger.js
+//Inputs are the current time and the force all/full detail flags, outputs are the number of fully processed blocks at the head of the chain, the new spos of the head block (-1 if every block was processed), the memory pressure flag, the effective logging level
+//and the delays (from the flush scheduler) JS should use for its next idle check and for a retry when messages were left behind
+#define PROCESS_CONTROL_NOW 0
+#define PROCESS_CONTROL_FORCEALL 1
+#define PROCESS_CONTROL_FULLDETAIL 2
+#define PROCESS_CONTROL_CONSUMED_BLOCKS 3
+#define PROCESS_CONTROL_HEAD_SPOS 4
+#define PROCESS_CONTROL_MEMORY_PRESSURE 5
+#define PROCESS_CONTROL_EFFECTIVE_LEVEL 6
+#define PROCESS_CONTROL_FLUSH_DELAY 7
+#define PROCESS_CONTROL_RETRY_DELAY 8
+#define PROCESS_CONTROL_SIZE 10
+
+//The format thread waits for JS to take its output once there is more than 16MB waiting
+#define FORMAT_OUTPUT_BACKPRESSURE_LIMIT 16777216
+
+//Formatted output is handed on in chunks of (about) 1MB so flushing a big backlog never builds one giant buffer
+#define FORMAT_STREAM_CHUNK_SIZE 1048576
+
+//Output buffers JS is done with are kept (up to 4 of them and up to 4MB each) for the formatters to reuse
+#define FORMAT_BUFFER_POOL_COUNT 4
+#define FORMAT_BUFFER_POOL_MAX_SIZE 4194304
+
+//Defaults for the cross thread aggregation writer -- poll for new blocks every 50ms and hold messages back 1s so late threads can be merged in order
+#define AGGREGATE_POLL_INTERVAL 50
+#define DEFAULT_AGGREGATE_WINDOW 1000
+
+//Each fan-out sink buffers up to 64KB of output before writing (and always writes what it has once the queued blocks are drained)
+#define SINK_BUFFER_FLUSH_SIZE 65536
+
+//Socket sinks send datagram frames of at most 8KB, keep up to 1MB of unsent frames, retry a lost connection every 100ms and wait up to 250ms for unsent frames on a flush
+#define SINK_SOCKET_DATAGRAM_SIZE 8192
+#define SINK_SOCKET_RETRY_LIMIT 1048576
+#define SINK_SOCKET_RECONNECT_INTERVAL 100
+#define SINK_SOCKET_FLUSH_WAIT 250
+
+//Quantile sketches for the log metrics are accurate to 1% (relative) with at most 2048 buckets and values smaller than 1e-9 in magnitude count as 0
+#define METRICS_SKETCH_ACCURACY 0.01
+#define METRICS_SKETCH_MAX_BUCKETS 2048
+#define METRICS_SKETCH_MIN_VALUE 1.0e-9
+
+//Trace events are written to the trace file in 64KB chunks
+#define TRACE_BUFFER_FLUSH_SIZE 65536
@@ -0,0 +1,193 @@
+#pragma once
+
+//Opt-in handler for fatal signals (SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT) that writes out everything already in native memory before the process dies.
+//This includes output the format thread has finished but JS has not written yet and the processed blocks that have not been formatted.
+//The handler only uses async-signal-safe operations -- everything it needs (output buffer, alternate stack) is allocated when it is enabled.
+//Messages that are still in the JS in-memory blocks are not reachable from the handler and are lost.
+class CrashFlush
+{
+private:
+    //The environments (one per JS thread) that have enabled the handler -- an empty slot is nullptr
+    std::atomic<LoggingEnvironment*> m_environments[CRASH_FLUSH_MAX_ENVIRONMENTS];
+
+    SignalSafeWriter m_writer;
+    std::atomic<bool> m_flushed;
+
+    std::mutex m_lock;
+    bool m_installed;
+
+#ifndef _WIN32
+    struct sigaction m_previous[CRASH_FLUSH_SIGNAL_COUNT];
+
+    static int GetSignal(size_t idx)
+    {
+        static const int s_signals[CRASH_FLUSH_SIGNAL_COUNT] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+        return s_signals[idx];
+    }
+
+    static std::atomic<CrashFlush*>& GetActive()
+    {
+        static std::atomic<CrashFlush*> s_active(nullptr);
+        return s_active;
+    }
+
+    static bool IsSignalPending(int sig)
+    {
+        sigset_t pending;
+        sigemptyset(&pending);
+        return sigpending(&pending) == 0 && sigismember(&pending, sig) == 1;
+    }
+
+    //Each thread that enables the handler gets an alternate signal stack so we can still run after a stack overflow
+    static void EnsureAlternateStack()
+    {
+        stack_t current;
+        if (sigaltstack(nullptr, &current) == 0 && (current.ss_flags & SS_DISABLE) == 0)
+        {
+            return;
+        }
+
+        stack_t altstack;
+        altstack.ss_size = CRASH_FLUSH_ALTSTACK_SIZE;
+        altstack.ss_sp = new char[CRASH_FLUSH_ALTSTACK_SIZE]; //lives as long as the thread (we can't know when a signal might arrive)
+        altstack.ss_flags = 0;
+        sigaltstack(&altstack, nullptr);
+    }
+
+    void WriteEverything()
+    {
+        for (size_t i = 0; i < CRASH_FLUSH_MAX_ENVIRONMENTS; ++i)
+        {
+            const LoggingEnvironment* lenv = this->m_environments[i].load(std::memory_order_acquire);
+            if (lenv == nullptr)
+            {
+                continue;
+            }
+
+            //output that was formatted first comes before the blocks still waiting
+            const FormatThread* fthread = lenv->GetFormatThread();
+            if (fthread != nullptr)
+            {
+                this->m_writer.emitLiteralString(fthread->GetUndeliveredOutputUnsafe());
+            }
+
+            lenv->VisitPendingBlocksUnsafe([this, lenv](const std::shared_ptr<LogProcessingBlock>& block, bool resumed) {
+                block->emitAllFormatEntriesSignalSafe(&this->m_writer, lenv, resumed);
+            });
+        }
+
+        this->m_writer.flush();
+    }
+
+    static void HandleFatalSignal(int sig, siginfo_t* info, void* context)
+    {
+        CrashFlush* crashFlush = GetActive().load();
+
+        size_t idx = 0;
+        while (idx < CRASH_FLUSH_SIGNAL_COUNT && GetSignal(idx) != sig)
+        {
+            idx++;
+        }
+
+        //give any handler that was installed before us (e.g., node's WebAssembly trap handler) the first chance to deal with the signal
+        const struct sigaction& previous = crashFlush->m_previous[idx];
+        if ((previous.sa_flags & SA_SIGINFO) != 0 && previous.sa_sigaction != nullptr)
+        {
+            previous.sa_sigaction(sig, info, context);
+        }
+        else if ((previous.sa_flags & SA_SIGINFO) == 0 && previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+        {
+            previous.sa_handler(sig);
+        }
+        else
+        {
+            struct sigaction dflt;
+            memset(&dflt, 0, sizeof(dflt));
+            dflt.sa_handler = SIG_DFL;
+            sigemptyset(&dflt.sa_mask);
+            sigaction(sig, &dflt, nullptr);
+
+            //blocked while we are in the handler so this is delivered (and kills the process) when we return
+            raise(sig);
+        }
+
+        //if the previous handler recovered then the signal is not pending and we are not going to die
+        if (!IsSignalPending(sig))
+        {
+            return;
+        }
+
+        if (!crashFlush->m_flushed.exchange(true))
+        {
+            crashFlush->WriteEverything();
+        }
+    }
+#endif
+
+public:
+    CrashFlush() :
+        m_writer(), m_flushed(false), m_lock(), m_installed(false)
+    {
+        for (size_t i = 0; i < CRASH_FLUSH_MAX_ENVIRONMENTS; ++i)
+        {
+            this->m_environments[i].store(nullptr);
+        }
+    }
+
+    //Install the handler (if needed) writing to the given fd and add the environment -- returns false if this is not supported or all the slots are in use
+    bool Enable(int fd, LoggingEnvironment* lenv)
+    {
+#ifdef _WIN32
+        return false;
+#else
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        bool added = false;
+        for (size_t i = 0; i < CRASH_FLUSH_MAX_ENVIRONMENTS && !added; ++i)
+        {
+            LoggingEnvironment* expected = nullptr;
+            added = (this->m_environments[i].load() == lenv) || this->m_environments[i].compare_exchange_strong(expected, lenv);
+        }
+
+        if (!added)
+        {
+            return false;
+        }
+
+        this->m_writer.setOutput(fd);
+        EnsureAlternateStack();
+
+        if (!this->m_installed)
+        {
+            GetActive().store(this);
+
+            for (size_t i = 0; i < CRASH_FLUSH_SIGNAL_COUNT; ++i)
+            {
+                struct sigaction action;
+                memset(&action, 0, sizeof(action));
+                action.sa_sigaction = &CrashFlush::HandleFatalSignal;
+                action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+                sigemptyset(&action.sa_mask);
+
+                sigaction(GetSignal(i), &action, &this->m_previous[i]);
+            }
+
+            this->m_installed = true;
+        }
+
+        return true;
+#endif
+    }
+
+    //Remove the environment (when its thread is shutting down) -- the handler stays installed for the others
+    void Disable(LoggingEnvironment* lenv)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        for (size_t i = 0; i < CRASH_FLUSH_MAX_ENVIRONMENTS; ++i)
+        {
+            LoggingEnvironment* expected = lenv;
+            this->m_environments[i].compare_exchange_strong(expected, nullptr);
+        }
+    }
+};
@@ -3,17 +3,49 @@
 //forward decls
 class MsgFormat;
 class LogProcessingBlock;
-class FormatWorker;
+class FormatThread;
+
+//References to the JS blocks that were handed off and that we are done reading -- any thread can push but only the JS thread that owns them pops (to give them back to JS)
+typedef MPSCQueue<napi_ref> JsBlockReleaseQueue;
+
+//A processed block waiting to be formatted along with its accounting info
+struct PendingBlock
+{
+    std::shared_ptr<LogProcessingBlock> block;
+    int64_t bytes;
+    int64_t msgCount;
+    uint64_t traceId; //the "queued" trace span (0 if we were not tracing)
+
+    PendingBlock() :
+        block(nullptr), bytes(0), msgCount(0), traceId(0)
+    {
+        ;
+    }
+
+    PendingBlock(std::shared_ptr<LogProcessingBlock>&& block, int64_t bytes, int64_t msgCount, uint64_t traceId) :
+        block(std::move(block)), bytes(bytes), msgCount(msgCount), traceId(traceId)
+    {
+        ;
+    }
+};
 
 class LoggingEnvironment
 {
 private:
     //Keep track of which logging level is enabled
     LoggingLevel m_enabledLoggingLevel;
-    std::map<LoggingLevel, std::string> m_loggingLevelToNames;
+    std::string m_loggingLevelNames[LOGGING_LEVEL_COUNT];
+
+    //The levels each category and logger (by id) is allowed to emit -- LLALL (no restriction) for any id not set
+    std::vector<LoggingLevel> m_categoryLevels;
+    std::vector<LoggingLevel> m_loggerLevels;
+
+    //Only used by the thread formatting for this environment (JS or the format thread -- never both at once)
+    mutable PrefixCache m_prefixCache;
+    mutable PrefixCache m_priorityPrefixCache; //only used by the priority path (on the JS thread) so it never races the format thread
 
-    //Keep track of which category names
-    std::map<int64_t, std::string> m_categoryNames;
+    //The formats and category names (shared with all the other environments in the process)
+    LoggingRegistry* m_registry;
 
     std::string m_hostName;
     std::string m_appName;
@@ -21,34 +53,64 @@ private:
     int64_t m_msgTimeLimit;
     size_t m_msgCountLimit;
 
-    std::vector<std::shared_ptr<MsgFormat>> m_formats;
+    //The block JS is currently processing messages into
+    std::shared_ptr<LogProcessingBlock> m_activeBlock;
 
-    std::vector<std::shared_ptr<LogProcessingBlock>> m_processing;
+    //Completed blocks waiting to be formatted -- JS pushes and either the format thread or JS pops (the consumer lock keeps a single consumer when JS drops blocks)
+    MPSCQueue<PendingBlock> m_processing;
+    std::atomic<size_t> m_processingCount;
+    std::mutex m_consumerLock;
+
+    //A partly formatted block put back by the consumer (e.g., the JS write callback threw) -- popped before the queue and formatting continues where it stopped
+    PendingBlock m_resumeBlock;
+
+    MemoryBudget m_memory;
+    FlushScheduler m_flushScheduler;
     char m_processingMode = 'n';
 
-    FormatWorker* m_formatWorker;
+    FormatThread* m_formatThread;
+
+    //Set if formatted output goes to JS as external Buffers rather than strings
+    bool m_outputBuffers;
+
+    //Set if whole JS blocks can be handed off to be read in place (only when this environment formats its own blocks)
+    bool m_blockHandoff;
+    std::shared_ptr<JsBlockReleaseQueue> m_releaseQueue;
+
+    //The id this environment uses when sending blocks to the shared aggregator (-1 if not aggregating)
+    int64_t m_aggregateProducerId;
+
+    static void SetMaskLevel(std::vector<LoggingLevel>& levels, size_t id, LoggingLevel level)
+    {
+        if (id >= levels.size())
+        {
+            levels.resize(id + 1, LoggingLevel::LLALL);
+        }
+        levels[id] = level;
+    }
+
+    static LoggingLevel GetMaskLevel(const std::vector<LoggingLevel>& levels, int64_t id)
+    {
+        return (id >= 0 && static_cast<size_t>(id) < levels.size()) ? levels[static_cast<size_t>(id)] : LoggingLevel::LLALL;
+    }
 
 public:
-    LoggingEnvironment(const LoggingLevel level, const std::string& hostName, const std::string& appName) :
-        m_enabledLoggingLevel(level), m_loggingLevelToNames(), m_categoryNames(),
+    LoggingEnvironment(LoggingRegistry* registry, const LoggingLevel level, const std::string& hostName, const std::string& appName) :
+        m_enabledLoggingLevel(level), m_loggingLevelNames(), m_categoryLevels(), m_loggerLevels(), m_prefixCache(), m_priorityPrefixCache(), m_registry(registry),
         m_hostName(hostName), m_appName(appName),
         m_msgTimeLimit(DEFAULT_LOG_TIMELIMIT), m_msgCountLimit(DEFAULT_LOG_SLOTSUSED),
-		m_formats(),
-        m_processing(), m_processingMode('n'),
-        m_formatWorker(nullptr)
+        m_activeBlock(nullptr), m_processing(), m_processingCount(0), m_consumerLock(), m_resumeBlock(), m_memory(), m_flushScheduler(), m_processingMode('n'),
+        m_formatThread(nullptr), m_outputBuffers(false), m_blockHandoff(false), m_releaseQueue(std::make_shared<JsBlockReleaseQueue>()), m_aggregateProducerId(-1)
     {
-        this->m_categoryNames[1] = "$default"; //$default is defined by default
-        this->m_categoryNames[2] = "$explicit"; //$explicit is defined by default
-
-        this->m_loggingLevelToNames[LoggingLevel::LLOFF] = std::string("OFF");
-        this->m_loggingLevelToNames[LoggingLevel::LLFATAL] = std::string("FATAL");
-        this->m_loggingLevelToNames[LoggingLevel::LLERROR] = std::string("ERROR");
-        this->m_loggingLevelToNames[LoggingLevel::LLWARN] = std::string("WARN");
-        this->m_loggingLevelToNames[LoggingLevel::LLINFO] = std::string("INFO");
-        this->m_loggingLevelToNames[LoggingLevel::LLDETAIL] = std::string("DETAIL");
-        this->m_loggingLevelToNames[LoggingLevel::LLDEBUG] = std::string("DEBUG");
-        this->m_loggingLevelToNames[LoggingLevel::LLTRACE] = std::string("TRACE");
-        this->m_loggingLevelToNames[LoggingLevel::LLOFF] = std::string("OFF");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLOFF)] = std::string("OFF");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLFATAL)] = std::string("FATAL");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLERROR)] = std::string("ERROR");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLWARN)] = std::string("WARN");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLINFO)] = std::string("INFO");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLDETAIL)] = std::string("DETAIL");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLDEBUG)] = std::string("DEBUG");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLTRACE)] = std::string("TRACE");
+        this->m_loggingLevelNames[LoggingLevelIndex(LoggingLevel::LLALL)] = std::string("ALL");
     }
 
     void InitializeEnvironmentData(const LoggingLevel level, const std::string& hostName, const std::string& appName)
@@ -56,80 +118,220 @@ public:
         this->m_enabledLoggingLevel = level;
         this->m_hostName = hostName;
         this->m_appName = appName;
-    }
 
-    void AddFormat(int64_t fmtId, std::shared_ptr<MsgFormat> fmt)
-    {
-        if (fmtId == static_cast<int64_t>(this->m_formats.size()))
-        {
-            this->m_formats.push_back(fmt);
-        }
-        else
-        {
-            //a previous format add failed so replace the index with the new one
-            this->m_formats[fmtId] = fmt;
-        }
+        //the host name is baked into the cached prefixes
+        this->m_prefixCache.Clear();
+        this->m_priorityPrefixCache.Clear();
     }
 
-    std::shared_ptr<MsgFormat> GetFormat(int64_t idx) const
-    {
-        return this->m_formats[idx];
-    }
+    LoggingRegistry* GetRegistry() const { return this->m_registry; }
+
+    //nullptr for an unknown id (this is used on the format and writer threads so it never throws)
+    const MsgFormat* TryGetFormat(int64_t idx) const { return this->m_registry->TryGetFormat(idx); }
 
     const std::string& GetHostName() const { return this->m_hostName; }
     const std::string& GetAppName() const { return this->m_appName; }
 
     void SetMsgTimeLimit(int64_t limit) { this->m_msgTimeLimit = limit; }
-    int64_t GetMsgTimeLimit() const { return this->m_msgTimeLimit; }
+    //The configured limits unless the flush scheduler is adapting them
+    int64_t GetMsgTimeLimit() const { return this->m_flushScheduler.IsAdaptive() ? this->m_flushScheduler.GetTimeLimit() : this->m_msgTimeLimit; }
 
     void SetMsgSlotsLimit(size_t limit) { this->m_msgCountLimit = limit; }
-    size_t GetMsgSlotsLimit() const { return this->m_msgCountLimit; }
+    size_t GetMsgSlotsLimit() const { return this->m_flushScheduler.IsAdaptive() ? static_cast<size_t>(this->m_flushScheduler.GetSlotLimit()) : this->m_msgCountLimit; }
+
+    //The limits set by JS (which adaptive flushing starts from)
+    int64_t GetConfiguredMsgTimeLimit() const { return this->m_msgTimeLimit; }
+    size_t GetConfiguredMsgSlotsLimit() const { return this->m_msgCountLimit; }
 
-    void AddCategory(int64_t categoryId, const std::string& name) { this->m_categoryNames[categoryId] = name; }
-    const std::string& GetCategoryName(int64_t categoryId) const { return this->m_categoryNames.at(categoryId); }
+    const std::string& GetCategoryName(int64_t categoryId) const { return this->m_registry->GetCategoryName(categoryId); }
 
     void SetEnabledLoggingLevel(LoggingLevel level) { this->m_enabledLoggingLevel = level; }
     LoggingLevel GetEnabledLoggingLevel() const { return this->m_enabledLoggingLevel; }
-    const std::string& GetLogLevelName(LoggingLevel level) const { return this->m_loggingLevelToNames.at(level); }
 
-    void AddProcessingBlock(std::shared_ptr<LogProcessingBlock> block) { this->m_processing.push_back(block); }
-    std::shared_ptr<LogProcessingBlock> GetActiveProcessingBlock() { return this->m_processing.back(); }
+    void SetCategoryLevel(size_t categoryId, LoggingLevel level) { SetMaskLevel(this->m_categoryLevels, categoryId, level); }
+    void SetLoggerLevel(size_t loggerId, LoggingLevel level) { SetMaskLevel(this->m_loggerLevels, loggerId, level); }
+
+    //The levels a message from this category and logger can be emitted at (checked against the buffered messages when they are processed)
+    LoggingLevel GetMsgLevelMask(int64_t categoryId, int64_t loggerId) const
+    {
+        const uint32_t categoryLevel = static_cast<uint32_t>(GetMaskLevel(this->m_categoryLevels, categoryId));
+        const uint32_t loggerLevel = static_cast<uint32_t>(GetMaskLevel(this->m_loggerLevels, loggerId));
+        return static_cast<LoggingLevel>(categoryLevel & loggerLevel);
+    }
+
+    //The enabled level after any levels dropped due to memory pressure
+    LoggingLevel GetEffectiveLoggingLevel() const { return this->m_memory.CapLevel(this->m_enabledLoggingLevel); }
+    const std::string& GetLogLevelName(LoggingLevel level) const { return this->m_loggingLevelNames[LoggingLevelIndex(level)]; }
+
+    //The cache for formatting on the JS thread while the format thread may be using the main one
+    PrefixCache* GetPriorityPrefixCache() const { return &this->m_priorityPrefixCache; }
+
+    //The "LEVEL#category @ " part of the standard prefix (from the given cache or the main one)
+    const std::string& GetPrefixHead(LoggingLevel level, int64_t categoryId, PrefixCache* cache = nullptr) const
+    {
+        PrefixCache& pcache = (cache != nullptr) ? *cache : this->m_prefixCache;
+        const size_t levelIndex = LoggingLevelIndex(level);
+
+        const std::string* head = pcache.TryGetHead(levelIndex, categoryId);
+        if (head != nullptr)
+        {
+            return *head;
+        }
+
+        return pcache.AddHead(levelIndex, categoryId, this->m_loggingLevelNames[levelIndex], this->GetCategoryName(categoryId));
+    }
+
+    //The " from host::logger | " part of the standard prefix
+    const std::string& GetPrefixTail(const std::string& logger, PrefixCache* cache = nullptr) const
+    {
+        PrefixCache& pcache = (cache != nullptr) ? *cache : this->m_prefixCache;
+        return pcache.GetTail(this->m_hostName, logger);
+    }
+
+    void AddProcessingBlock(std::shared_ptr<LogProcessingBlock> block) { this->m_activeBlock = block; }
+    std::shared_ptr<LogProcessingBlock> GetActiveProcessingBlock() { return this->m_activeBlock; }
 
     void SetProcessingMode(char c) { this->m_processingMode = c; }
     char GetProcessingMode() const { return this->m_processingMode; }
 
-    void DiscardProcesingBlock(std::shared_ptr<LogProcessingBlock> pb)
+    //Done processing into the active block so queue it for formatting (unless nothing was saved into it)
+    void CompleteActiveProcessingBlock(bool isEmpty, int64_t bytes, int64_t msgCount)
     {
-        //should always be the last block
-        this->m_processing.pop_back();
+        if (!isEmpty)
+        {
+            this->AddPendingBlock(std::move(this->m_activeBlock), bytes, msgCount);
+        }
+
+        this->m_activeBlock = nullptr;
     }
 
-    void AddBlockFromFormatterAbort(std::shared_ptr<LogProcessingBlock> pb)
+    //Queue a block of processed messages for formatting
+    void AddPendingBlock(std::shared_ptr<LogProcessingBlock>&& block, int64_t bytes, int64_t msgCount)
     {
-        this->m_processing.insert(this->m_processing.begin(), pb);
+        this->m_memory.AddBlockBytes(bytes);
+        this->m_memory.CountQueuedBlock(bytes, msgCount);
+
+        const uint64_t traceId = GetTraceRecorder().IsEnabled() ? GetTraceRecorder().AsyncBegin("queued", "messages", static_cast<double>(msgCount), "bytes", static_cast<double>(bytes)) : 0;
+        this->m_processing.Push(PendingBlock(std::move(block), bytes, msgCount, traceId));
+        this->m_processingCount.fetch_add(1, std::memory_order_release);
     }
 
-    std::shared_ptr<LogProcessingBlock> GetNextFormatBlock()
+    //The next block to format -- resumed is set if it is a requeued block (so formatting continues from its current format position)
+    std::shared_ptr<LogProcessingBlock> GetNextFormatBlock(bool* resumed = nullptr)
     {
-        if (this->m_processing.empty())
+        PendingBlock pb;
+        bool isResume = false;
         {
-            return nullptr;
+            std::lock_guard<std::mutex> lock(this->m_consumerLock);
+            if (this->m_resumeBlock.block != nullptr)
+            {
+                pb = std::move(this->m_resumeBlock);
+                this->m_resumeBlock = PendingBlock();
+                isResume = true;
+            }
+            else if (!this->m_processing.Pop(pb))
+            {
+                return nullptr;
+            }
         }
-        else
+
+        this->m_processingCount.fetch_sub(1, std::memory_order_relaxed);
+        this->m_memory.RemoveBlockBytes(pb.bytes);
+        GetTraceRecorder().AsyncEnd("queued", pb.traceId);
+
+        if (resumed != nullptr)
         {
-            std::shared_ptr<LogProcessingBlock> pb = this->m_processing.front();
-            this->m_processing.erase(this->m_processing.begin());
+            *resumed = isResume;
+        }
+
+        return pb.block;
+    }
+
+    //Put a partly formatted block back so the next GetNextFormatBlock continues with the rest of its messages (there is only one since blocks are formatted one at a time)
+    void RequeueFormatBlock(std::shared_ptr<LogProcessingBlock>&& block, int64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(this->m_consumerLock);
 
-            return pb;
+        this->m_memory.AddBlockBytes(bytes);
+        this->m_resumeBlock = PendingBlock(std::move(block), bytes, 0, 0);
+        this->m_processingCount.fetch_add(1, std::memory_order_release);
+    }
+
+    //With the DropOldest policy throw away pending blocks (oldest first) until we are under budget -- gives up if a consumer is busy popping
+    void DropOldestPendingBlocks()
+    {
+        std::unique_lock<std::mutex> lock(this->m_consumerLock, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return;
         }
+
+        PendingBlock pb;
+        while (this->m_memory.IsOverBudget() && this->m_processing.Pop(pb))
+        {
+            this->m_processingCount.fetch_sub(1, std::memory_order_relaxed);
+            this->m_memory.RemoveBlockBytes(pb.bytes);
+
+            this->m_memory.CountDroppedBlock();
+            this->m_memory.CountDroppedMessages(pb.msgCount);
+            GetTraceRecorder().AsyncEnd("queued", pb.traceId);
+        }
+    }
+
+    MemoryBudget& GetMemoryBudget() { return this->m_memory; }
+    const MemoryBudget& GetMemoryBudget() const { return this->m_memory; }
+
+    FlushScheduler& GetFlushScheduler() { return this->m_flushScheduler; }
+    const FlushScheduler& GetFlushScheduler() const { return this->m_flushScheduler; }
+
+    size_t GetPendingBlockCount() const { return this->m_processingCount.load(std::memory_order_relaxed); }
+
+    void SetFormatThread(FormatThread* formatThread) { this->m_formatThread = formatThread; }
+    FormatThread* GetFormatThread() { return this->m_formatThread; }
+    const FormatThread* GetFormatThread() const { return this->m_formatThread; }
+    void ClearFormatThread() { this->m_formatThread = nullptr; }
+
+    void SetOutputBuffers(bool outputBuffers) { this->m_outputBuffers = outputBuffers; }
+    bool GetOutputBuffers() const { return this->m_outputBuffers; }
+
+    void SetBlockHandoff(bool blockHandoff) { this->m_blockHandoff = blockHandoff; }
+    bool GetBlockHandoff() const { return this->m_blockHandoff; }
+
+    //Shared with the handed off blocks (which may outlive us on another thread)
+    const std::shared_ptr<JsBlockReleaseQueue>& GetReleaseQueue() const { return this->m_releaseQueue; }
+
+    //Only for the fatal signal handler -- see MPSCQueue::VisitUnsafe and VisitPendingBlocks
+    template <typename TVisitor>
+    void VisitPendingBlocksUnsafe(TVisitor visitor) const
+    {
+        if (this->m_resumeBlock.block != nullptr)
+        {
+            visitor(this->m_resumeBlock.block, true);
+        }
+
+        this->m_processing.VisitUnsafe([&visitor](const PendingBlock& pb) { visitor(pb.block, false); });
     }
 
-    void SetAsyncFormatWorker(FormatWorker* formatWorker) { this->m_formatWorker = formatWorker; }
-    FormatWorker* GetAsyncFormatWorker() { return this->m_formatWorker; }
-    void ClearAsyncFormatWorker() { this->m_formatWorker = nullptr; }
+    //Walk the pending blocks (oldest first) without removing them -- holds the consumer lock so the blocks cannot be popped while we look at them.
+    //The visitor also gets if the block is the requeued (partly written) one -- its messages before the format position were already written.
+    template <typename TVisitor>
+    void VisitPendingBlocks(TVisitor visitor)
+    {
+        std::lock_guard<std::mutex> lock(this->m_consumerLock);
+        if (this->m_resumeBlock.block != nullptr)
+        {
+            visitor(this->m_resumeBlock.block, true);
+        }
 
+        this->m_processing.VisitUnsafe([&visitor](const PendingBlock& pb) { visitor(pb.block, false); });
+    }
+
+    //Safe to call while the format thread is popping blocks
     bool HasWorkPending() const
     {
-        return !this->m_processing.empty();
+        return this->m_processingCount.load(std::memory_order_acquire) != 0;
     }
+
+    void SetAggregateProducerId(int64_t producerId) { this->m_aggregateProducerId = producerId; }
+    int64_t GetAggregateProducerId() const { return this->m_aggregateProducerId; }
 };
@@ -0,0 +1,238 @@
+#pragma once
+
+//Keeps the most recent messages that processing discarded for being below the emit level so the context around an error can be written after the fact.
+//Messages are copied (in processed form) into a fixed size byte ring -- the oldest whole messages are evicted to make room or once they are older than the age limit.
+//When a message at (or above) the dump level is saved the recorded messages are replayed into the output just ahead of it. Only used from the JS thread that owns the environment.
+class FlightRecorder
+{
+private:
+    //Where a recorded message lives in the ring
+    struct RecordedMsg
+    {
+        size_t offset;
+        size_t size;
+        double walltime;
+    };
+
+    std::vector<uint8_t> m_ring;
+    size_t m_tail; //where the next message is written
+    std::deque<RecordedMsg> m_msgs; //oldest first
+
+    int64_t m_maxAge;
+    LoggingLevel m_dumpLevel;
+
+    //The message being recorded (it can be split over blocks so we collect it here until we see the end)
+    std::vector<uint8_t> m_current;
+    double m_currentTime;
+    bool m_recording;
+
+    uint64_t m_recorded;
+    uint64_t m_evicted;
+    uint64_t m_dumped;
+
+    void EvictOlderThan(double walltime)
+    {
+        while (!this->m_msgs.empty() && this->m_msgs.front().walltime < walltime)
+        {
+            this->m_msgs.pop_front();
+            this->m_evicted++;
+        }
+    }
+
+    //Copy the current message into the ring (evicting the oldest messages it overlaps)
+    void Commit()
+    {
+        const size_t size = this->m_current.size();
+        if (size == 0 || size > this->m_ring.size())
+        {
+            //too big to ever fit
+            this->m_evicted++;
+            return;
+        }
+
+        size_t offset = this->m_tail;
+        if (offset + size > this->m_ring.size())
+        {
+            //wrap -- the messages between the tail and the end of the ring are the oldest so they go first
+            while (!this->m_msgs.empty() && this->m_msgs.front().offset >= offset)
+            {
+                this->m_msgs.pop_front();
+                this->m_evicted++;
+            }
+            offset = 0;
+        }
+
+        while (!this->m_msgs.empty() && this->m_msgs.front().offset < offset + size && this->m_msgs.front().offset + this->m_msgs.front().size > offset)
+        {
+            this->m_msgs.pop_front();
+            this->m_evicted++;
+        }
+
+        memcpy(this->m_ring.data() + offset, this->m_current.data(), size);
+        this->m_msgs.push_back({ offset, size, this->m_currentTime });
+        this->m_tail = offset + size;
+        this->m_recorded++;
+
+        this->EvictOlderThan(this->m_currentTime - static_cast<double>(this->m_maxAge));
+    }
+
+    template <typename T>
+    void AppendValue(T value)
+    {
+        const size_t pos = this->m_current.size();
+        this->m_current.resize(pos + sizeof(T));
+        memcpy(this->m_current.data() + pos, &value, sizeof(T));
+    }
+
+    template <typename T>
+    static T ReadValue(const uint8_t* pos)
+    {
+        T value;
+        memcpy(&value, pos, sizeof(T));
+        return value;
+    }
+
+    static bool IsStringTag(LogEntryTag tag)
+    {
+        return (tag == LogEntryTag::JsVarValue_StringIdx) | (tag == LogEntryTag::PropertyRecord) | (tag == LogEntryTag::MSGLogger) | (tag == LogEntryTag::MSGChildInfo);
+    }
+
+public:
+    FlightRecorder() :
+        m_ring(), m_tail(0), m_msgs(), m_maxAge(0), m_dumpLevel(LoggingLevel::LLOFF),
+        m_current(), m_currentTime(0.0), m_recording(false),
+        m_recorded(0), m_evicted(0), m_dumped(0)
+    {
+        ;
+    }
+
+    bool IsEnabled() const { return !this->m_ring.empty(); }
+    bool IsRecording() const { return this->m_recording; }
+
+    //Keep up to maxBytes of discarded messages that are at most maxAge ms older than the newest one (0 bytes turns recording off and drops them)
+    void Configure(size_t maxBytes, int64_t maxAge, LoggingLevel dumpLevel)
+    {
+        this->m_ring.clear();
+        this->m_ring.shrink_to_fit();
+        this->m_ring.resize(maxBytes);
+        this->m_tail = 0;
+        this->m_msgs.clear();
+
+        this->m_maxAge = maxAge;
+        this->m_dumpLevel = dumpLevel;
+
+        this->m_current.clear();
+        this->m_recording = false;
+    }
+
+    //True if saving a message at this level should dump the recorded messages ahead of it
+    bool ShouldDump(LoggingLevel level) const
+    {
+        return !this->m_msgs.empty() && LOG_LEVEL_ENABLED(level, this->m_dumpLevel);
+    }
+
+    //Start recording a discarded message (that starts at cpos)
+    void BeginMessage(size_t cpos, const double* data)
+    {
+        this->m_current.clear();
+        this->m_currentTime = data[cpos + 3];
+        this->m_recording = true;
+    }
+
+    //Record the entries in [spos, epos) of the message being recorded -- complete is true if the end sentinal was included
+    void RecordEntries(size_t spos, size_t epos, const uint8_t* tags, const double* data, const Napi::Array& stringData, bool complete)
+    {
+        for (size_t pos = spos; pos < epos; ++pos)
+        {
+            const LogEntryTag tag = static_cast<LogEntryTag>(tags[pos]);
+            if (tag == LogEntryTag::MsgEndSentinal)
+            {
+                break;
+            }
+
+            if (tag == LogEntryTag::MsgLoggerId)
+            {
+                continue;
+            }
+
+            this->m_current.push_back(tags[pos]);
+            if (IsStringTag(tag))
+            {
+                Napi::Value sval = stringData[static_cast<size_t>(data[pos])];
+                const std::string str = sval.As<Napi::String>().Utf8Value();
+
+                this->AppendValue<uint32_t>(static_cast<uint32_t>(str.size()));
+                this->m_current.insert(this->m_current.end(), str.cbegin(), str.cend());
+            }
+            else
+            {
+                this->AppendValue<double>(data[pos]);
+            }
+        }
+
+        if (complete)
+        {
+            this->m_recording = false;
+            this->Commit();
+        }
+    }
+
+    //Move the recorded messages (dropping any older than maxAge before now) into the block in the order they were logged -- returns the # of messages
+    int64_t Dump(LogProcessingBlock* into, double now)
+    {
+        this->EvictOlderThan(now - static_cast<double>(this->m_maxAge));
+
+        int64_t count = 0;
+        for (auto iter = this->m_msgs.cbegin(); iter != this->m_msgs.cend(); ++iter)
+        {
+            const uint8_t* pos = this->m_ring.data() + iter->offset;
+            const uint8_t* end = pos + iter->size;
+            while (pos < end)
+            {
+                const LogEntryTag tag = static_cast<LogEntryTag>(*pos);
+                pos++;
+
+                if (IsStringTag(tag))
+                {
+                    const uint32_t length = ReadValue<uint32_t>(pos);
+                    pos += sizeof(uint32_t);
+
+                    into->AddLocalStringDataEntry(tag, std::string(reinterpret_cast<const char*>(pos), length));
+                    pos += length;
+                }
+                else
+                {
+                    into->AddDataEntry(tag, ReadValue<double>(pos));
+                    pos += sizeof(double);
+                }
+            }
+            into->AddDataEntry(LogEntryTag::MsgEndSentinal, 0.0);
+
+            count++;
+        }
+
+        this->m_msgs.clear();
+        this->m_tail = 0;
+        this->m_dumped += static_cast<uint64_t>(count);
+
+        return count;
+    }
+
+    size_t GetCapacity() const { return this->m_ring.size(); }
+    size_t GetMessageCount() const { return this->m_msgs.size(); }
+
+    //Bytes in the ring used by the recorded messages
+    size_t GetUsedBytes() const
+    {
+        size_t bytes = 0;
+        for (auto iter = this->m_msgs.cbegin(); iter != this->m_msgs.cend(); ++iter)
+        {
+            bytes += iter->size;
+        }
+        return bytes;
+    }
+
+    uint64_t GetRecordedCount() const { return this->m_recorded; }
+    uint64_t GetEvictedCount() const { return this->m_evicted; }
+    uint64_t GetDumpedCount() const { return this->m_dumped; }
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+//Which constraint set the current adaptive limits
+enum class FlushLimitReason : uint8_t
+{
+    Fixed = 0x0, //adaptive flushing is off so we use the configured limits
+    Latency = 0x1, //the time limit fits the latency target (after format and sink time)
+    Memory = 0x2, //the slot limit is capped by the memory target
+    Floor = 0x3 //format and sink time alone use up the latency target so we are at the minimum time limit
+};
+
+//Picks the message time/slot limits and the JS flush timer delays for an environment.
+//With adaptive flushing on we keep moving averages of the logging rate (from processing), the format cost per message (from the format thread or sync formatting)
+//and the sink latency (reported by JS) and size the limits so a message is written within the latency target without buffering more than the memory target.
+//The limits are read (atomically) for every message we process -- the estimates are updated under a lock since that only happens once per flush/format/write.
+class FlushScheduler
+{
+private:
+    std::atomic<bool> m_adaptive;
+    std::atomic<int64_t> m_timeLimit;
+    std::atomic<int64_t> m_slotLimit;
+    std::atomic<int64_t> m_flushDelay;
+    std::atomic<int64_t> m_retryDelay;
+
+    mutable std::mutex m_lock;
+
+    int64_t m_latencyTarget;
+    int64_t m_memoryTarget;
+
+    //slots/saved messages seen since the last rate sample was taken
+    int64_t m_sampleStart;
+    int64_t m_slotsLeft;
+    int64_t m_arrivedSlots;
+    int64_t m_savedMsgs;
+
+    //moving averages (and how many samples went into each one)
+    double m_slotRate; //slots per ms
+    double m_msgRate; //saved messages per ms
+    double m_formatCost; //ms per message
+    double m_sinkLatency; //ms per write
+    int64_t m_rateSamples;
+    int64_t m_formatSamples;
+    int64_t m_sinkSamples;
+
+    int64_t m_adjustments;
+    FlushLimitReason m_reason;
+
+    static void Blend(double& estimate, int64_t& samples, double sample)
+    {
+        estimate = (samples == 0) ? sample : estimate + ADAPTIVE_FLUSH_EWMA_WEIGHT * (sample - estimate);
+        samples++;
+    }
+
+    //Must hold m_lock
+    void Recompute()
+    {
+        //a message waits up to the time limit (+ up to half of it for the next timer check) and then for its share of the format and sink work
+        const double workPerMs = this->m_msgRate * this->m_formatCost;
+        const double available = static_cast<double>(this->m_latencyTarget) - this->m_sinkLatency;
+
+        double timeLimit = available / (1.5 + workPerMs);
+        FlushLimitReason reason = FlushLimitReason::Latency;
+        if (timeLimit < ADAPTIVE_FLUSH_MIN_TIMELIMIT)
+        {
+            timeLimit = ADAPTIVE_FLUSH_MIN_TIMELIMIT;
+            reason = FlushLimitReason::Floor;
+        }
+
+        //leave room for the rate to double before the slot limit (rather than the time limit) starts the processing
+        const double memorySlots = std::max<double>(static_cast<double>(this->m_memoryTarget / IN_MEMORY_SLOT_BYTES), ADAPTIVE_FLUSH_MIN_SLOTS);
+        double slotLimit = std::max<double>(2.0 * this->m_slotRate * timeLimit, ADAPTIVE_FLUSH_MIN_SLOTS);
+        if (slotLimit > memorySlots)
+        {
+            slotLimit = memorySlots;
+            reason = FlushLimitReason::Memory;
+        }
+
+        const int64_t ntime = static_cast<int64_t>(timeLimit);
+        const int64_t nslots = static_cast<int64_t>(slotLimit);
+        if (ntime != this->m_timeLimit.load(std::memory_order_relaxed) || nslots != this->m_slotLimit.load(std::memory_order_relaxed))
+        {
+            this->m_adjustments++;
+        }
+
+        this->m_timeLimit.store(ntime, std::memory_order_relaxed);
+        this->m_slotLimit.store(nslots, std::memory_order_relaxed);
+        this->m_flushDelay.store(std::max<int64_t>(ntime / 2, 1), std::memory_order_relaxed);
+        this->m_retryDelay.store(std::max<int64_t>(ntime / 4, 1), std::memory_order_relaxed);
+        this->m_reason = reason;
+    }
+
+public:
+    FlushScheduler() :
+        m_adaptive(false), m_timeLimit(DEFAULT_LOG_TIMELIMIT), m_slotLimit(DEFAULT_LOG_SLOTSUSED), m_flushDelay(DEFAULT_FLUSH_DELAY), m_retryDelay(DEFAULT_FLUSH_RETRY_DELAY),
+        m_lock(), m_latencyTarget(DEFAULT_FLUSH_LATENCY_TARGET), m_memoryTarget(DEFAULT_FLUSH_MEMORY_TARGET),
+        m_sampleStart(0), m_slotsLeft(0), m_arrivedSlots(0), m_savedMsgs(0),
+        m_slotRate(0.0), m_msgRate(0.0), m_formatCost(0.0), m_sinkLatency(0.0), m_rateSamples(0), m_formatSamples(0), m_sinkSamples(0),
+        m_adjustments(0), m_reason(FlushLimitReason::Fixed)
+    {
+        ;
+    }
+
+    //Turn adaptive flushing on (starting from the given limits) or off (going back to the fixed delays)
+    void Configure(bool adaptive, int64_t latencyTarget, int64_t memoryTarget, int64_t timeLimit, int64_t slotLimit)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        this->m_latencyTarget = latencyTarget;
+        this->m_memoryTarget = memoryTarget;
+
+        this->m_sampleStart = 0;
+        this->m_arrivedSlots = 0;
+        this->m_savedMsgs = 0;
+        this->m_rateSamples = 0;
+        this->m_formatSamples = 0;
+        this->m_sinkSamples = 0;
+        this->m_adjustments = 0;
+
+        this->m_timeLimit.store(std::min<int64_t>(timeLimit, latencyTarget), std::memory_order_relaxed);
+        this->m_slotLimit.store(slotLimit, std::memory_order_relaxed);
+        this->m_flushDelay.store(adaptive ? std::max<int64_t>(std::min<int64_t>(timeLimit, latencyTarget) / 2, 1) : DEFAULT_FLUSH_DELAY, std::memory_order_relaxed);
+        this->m_retryDelay.store(adaptive ? std::max<int64_t>(std::min<int64_t>(timeLimit, latencyTarget) / 4, 1) : DEFAULT_FLUSH_RETRY_DELAY, std::memory_order_relaxed);
+        this->m_reason = adaptive ? FlushLimitReason::Latency : FlushLimitReason::Fixed;
+
+        this->m_adaptive.store(adaptive, std::memory_order_relaxed);
+    }
+
+    bool IsAdaptive() const { return this->m_adaptive.load(std::memory_order_relaxed); }
+
+    int64_t GetTimeLimit() const { return this->m_timeLimit.load(std::memory_order_relaxed); }
+    int64_t GetSlotLimit() const { return this->m_slotLimit.load(std::memory_order_relaxed); }
+    int64_t GetFlushDelay() const { return this->m_flushDelay.load(std::memory_order_relaxed); }
+    int64_t GetRetryDelay() const { return this->m_retryDelay.load(std::memory_order_relaxed); }
+
+    //After processing at time now -- pendingSlots were in the JS log when we started, slotsLeft are still there and savedMsgs were kept for formatting
+    void ObserveProcess(int64_t now, int64_t pendingSlots, int64_t slotsLeft, int64_t savedMsgs)
+    {
+        if (!this->IsAdaptive())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        //anything more than was left behind last time is new (unless JS reset the log in the meantime)
+        this->m_arrivedSlots += std::max<int64_t>(pendingSlots - this->m_slotsLeft, 0);
+        this->m_savedMsgs += savedMsgs;
+        this->m_slotsLeft = slotsLeft;
+
+        if (this->m_sampleStart == 0)
+        {
+            this->m_sampleStart = now;
+            this->m_arrivedSlots = 0;
+            this->m_savedMsgs = 0;
+            return;
+        }
+
+        const int64_t elapsed = now - this->m_sampleStart;
+        if (elapsed < ADAPTIVE_FLUSH_MIN_SAMPLE_TIME)
+        {
+            return;
+        }
+
+        int64_t msgSamples = this->m_rateSamples;
+        Blend(this->m_slotRate, this->m_rateSamples, static_cast<double>(this->m_arrivedSlots) / static_cast<double>(elapsed));
+        Blend(this->m_msgRate, msgSamples, static_cast<double>(this->m_savedMsgs) / static_cast<double>(elapsed));
+
+        this->m_sampleStart = now;
+        this->m_arrivedSlots = 0;
+        this->m_savedMsgs = 0;
+
+        this->Recompute();
+    }
+
+    //Formatting msgCount messages took ms (from the format thread or a sync format)
+    void ObserveFormat(int64_t msgCount, double ms)
+    {
+        if (!this->IsAdaptive() || msgCount == 0)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        Blend(this->m_formatCost, this->m_formatSamples, ms / static_cast<double>(msgCount));
+        this->Recompute();
+    }
+
+    //Writing a batch of formatted output took ms (reported by JS when the write completes)
+    void ObserveSink(double ms)
+    {
+        if (!this->IsAdaptive())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        Blend(this->m_sinkLatency, this->m_sinkSamples, ms);
+        this->Recompute();
+    }
+
+    int64_t GetLatencyTarget() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_latencyTarget; }
+    int64_t GetMemoryTarget() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_memoryTarget; }
+    double GetSlotRate() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_slotRate; }
+    double GetMsgRate() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_msgRate; }
+    double GetFormatCost() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_formatCost; }
+    double GetSinkLatency() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_sinkLatency; }
+    int64_t GetAdjustments() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_adjustments; }
+    FlushLimitReason GetReason() const { std::lock_guard<std::mutex> lock(this->m_lock); return this->m_reason; }
+};
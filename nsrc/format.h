@@ -5,22 +5,24 @@ class FormatEntry
 public:
     const FormatStringEntryKind fkind;
     const FormatStringEnum fenum;
+    const int32_t fdepth; //the max depth and length to expand a compound argument (-1 otherwise)
+    const int32_t flength;
     std::string ffollow; //the string to put into the log after this content
 
     FormatEntry() :
-        fkind(FormatStringEntryKind::Clear), fenum(FormatStringEnum::Clear), ffollow()
+        fkind(FormatStringEntryKind::Clear), fenum(FormatStringEnum::Clear), fdepth(-1), flength(-1), ffollow()
     {
         ;
     }
 
-    FormatEntry(FormatStringEntryKind fkind, FormatStringEnum fenum, std::string&& ffollow) :
-        fkind(fkind), fenum(fenum), ffollow(std::forward<std::string>(ffollow))
+    FormatEntry(FormatStringEntryKind fkind, FormatStringEnum fenum, int32_t fdepth, int32_t flength, std::string&& ffollow) :
+        fkind(fkind), fenum(fenum), fdepth(fdepth), flength(flength), ffollow(std::forward<std::string>(ffollow))
     {
         ;
     }
 
     FormatEntry(FormatEntry&& other) :
-        fkind(other.fkind), fenum(other.fenum), ffollow(std::forward<std::string>(other.ffollow))
+        fkind(other.fkind), fenum(other.fenum), fdepth(other.fdepth), flength(other.flength), ffollow(std::forward<std::string>(other.ffollow))
     {
         ;
     }
@@ -30,19 +32,20 @@ class MsgFormat
 {
 private:
     const int64_t m_formatId; //a unique identifier for the format
+    std::string m_formatName;
     std::vector<FormatEntry> m_fentries; //the array of FormatEntry objects
     std::string m_initialFormatStringSegment;
     std::string m_originalFormatString; //the origial raw format string
 
 public:
     MsgFormat() :
-        m_formatId(0), m_fentries(), m_initialFormatStringSegment(), m_originalFormatString()
+        m_formatId(0), m_formatName(), m_fentries(), m_initialFormatStringSegment(), m_originalFormatString()
     {
         ;
     }
 
-    MsgFormat(int64_t formatId, size_t entryCount, std::string&& initialFormatStringSegment, std::string&& originalFormatString) :
-        m_formatId(formatId), m_fentries(),
+    MsgFormat(int64_t formatId, std::string&& formatName, size_t entryCount, std::string&& initialFormatStringSegment, std::string&& originalFormatString) :
+        m_formatId(formatId), m_formatName(std::forward<std::string>(formatName)), m_fentries(),
         m_initialFormatStringSegment(std::forward<std::string>(initialFormatStringSegment)),
         m_originalFormatString(std::forward<std::string>(originalFormatString))
     {
@@ -54,6 +57,56 @@ public:
         this->m_fentries.emplace_back(std::forward<FormatEntry>(entry));
     }
 
+    int64_t GetFormatId() const { return this->m_formatId; }
+    const std::string& GetFormatName() const { return this->m_formatName; }
+    const std::string& GetOriginalFormatString() const { return this->m_originalFormatString; }
+
     const std::vector<FormatEntry>& GetEntries() const { return this->m_fentries; }
     const std::string& GetInitialFormatStringSegment() const { return this->m_initialFormatStringSegment; }
+
+    //For JSON style formats the property name an argument is the value of given the format text before it (e.g., the "time" in { "time": #wallclock })
+    static std::string GetPropertyName(const std::string& preceding)
+    {
+        size_t end = preceding.find_last_not_of(' ');
+        if (end == std::string::npos || preceding[end] != ':')
+        {
+            return std::string();
+        }
+
+        end = preceding.find_last_not_of(' ', end - 1);
+        if (end == std::string::npos || preceding[end] != '"' || end == 0)
+        {
+            return std::string();
+        }
+
+        const size_t start = preceding.rfind('"', end - 1);
+        return (start == std::string::npos) ? std::string() : preceding.substr(start + 1, end - start - 1);
+    }
+};
+
+//A sequence of property names that many logged objects share -- registered once so each object only needs the shape id + its values.
+//The keys are stored pre-escaped as the "key": fragments the formatter writes.
+class ObjectShape
+{
+private:
+    int64_t m_shapeId;
+    std::vector<std::string> m_keyFragments;
+
+public:
+    ObjectShape() :
+        m_shapeId(0), m_keyFragments()
+    {
+        ;
+    }
+
+    ObjectShape(int64_t shapeId, std::vector<std::string>&& keyFragments) :
+        m_shapeId(shapeId), m_keyFragments(std::move(keyFragments))
+    {
+        ;
+    }
+
+    int64_t GetShapeId() const { return this->m_shapeId; }
+
+    size_t GetKeyCount() const { return this->m_keyFragments.size(); }
+    const std::string& GetKeyFragment(size_t idx) const { return this->m_keyFragments[idx]; }
 };
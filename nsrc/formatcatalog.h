@@ -0,0 +1,337 @@
+#pragma once
+
+//Save/load the compiled formats in the registry so short lived processes can skip parsing (in JS) and registering formats one at a time.
+//The file is a header (magic, version, format count) followed by each format:
+//  name, format string, initial segment, entry count, then for each entry -- kind (u8), enum (u8), depth (i32), length (i32), follow string
+//Strings are a u32 byte length followed by the utf8 bytes and all values are in the native byte order.
+
+//A read only view of the whole catalog file (memory mapped where we can)
+class CatalogFile
+{
+private:
+    const char* m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    std::vector<char> m_contents;
+#else
+    void* m_mapping;
+#endif
+
+public:
+    CatalogFile() :
+#ifdef _WIN32
+        m_data(nullptr), m_size(0), m_contents()
+#else
+        m_data(nullptr), m_size(0), m_mapping(MAP_FAILED)
+#endif
+    {
+        ;
+    }
+
+    ~CatalogFile()
+    {
+#ifndef _WIN32
+        if (this->m_mapping != MAP_FAILED)
+        {
+            munmap(this->m_mapping, this->m_size);
+        }
+#endif
+    }
+
+    CatalogFile(const CatalogFile&) = delete;
+    CatalogFile& operator=(const CatalogFile&) = delete;
+
+    bool Open(const std::string& path)
+    {
+#ifdef _WIN32
+        int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        char buff[4096];
+        int bytes = 0;
+        while ((bytes = _read(fd, buff, sizeof(buff))) > 0)
+        {
+            this->m_contents.insert(this->m_contents.end(), buff, buff + bytes);
+        }
+        _close(fd);
+
+        this->m_data = this->m_contents.data();
+        this->m_size = this->m_contents.size();
+        return bytes == 0;
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        this->m_size = static_cast<size_t>(info.st_size);
+        this->m_mapping = mmap(nullptr, this->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (this->m_mapping == MAP_FAILED)
+        {
+            return false;
+        }
+
+        this->m_data = static_cast<const char*>(this->m_mapping);
+        return true;
+#endif
+    }
+
+    const char* GetData() const { return this->m_data; }
+    size_t GetSize() const { return this->m_size; }
+};
+
+//Bounds checked reads from binary file contents -- throws if the file is truncated or corrupt
+class BinaryReader
+{
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos;
+
+    void Check(size_t bytes) const
+    {
+        if (bytes > this->m_size - this->m_pos)
+        {
+            throw std::runtime_error("Truncated file");
+        }
+    }
+
+    template <typename T>
+    T Read()
+    {
+        this->Check(sizeof(T));
+
+        T value;
+        memcpy(&value, this->m_data + this->m_pos, sizeof(T));
+        this->m_pos += sizeof(T);
+
+        return value;
+    }
+
+public:
+    BinaryReader(const char* data, size_t size) :
+        m_data(data), m_size(size), m_pos(0)
+    {
+        ;
+    }
+
+    uint8_t ReadU8() { return this->Read<uint8_t>(); }
+    uint32_t ReadU32() { return this->Read<uint32_t>(); }
+    int32_t ReadI32() { return this->Read<int32_t>(); }
+
+    std::string ReadString()
+    {
+        const uint32_t length = this->ReadU32();
+        this->Check(length);
+
+        std::string value(this->m_data + this->m_pos, length);
+        this->m_pos += length;
+
+        return value;
+    }
+
+    bool AtEnd() const { return this->m_pos == this->m_size; }
+};
+
+//Builds the contents of a binary file (catalogs and columnar segments) in memory
+class BinaryWriter
+{
+private:
+    std::string m_buff;
+
+    template <typename T>
+    void Write(T value)
+    {
+        this->m_buff.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+public:
+    BinaryWriter() :
+        m_buff()
+    {
+        ;
+    }
+
+    void WriteU8(uint8_t value) { this->Write<uint8_t>(value); }
+    void WriteU32(uint32_t value) { this->Write<uint32_t>(value); }
+    void WriteI32(int32_t value) { this->Write<int32_t>(value); }
+    void WriteI64(int64_t value) { this->Write<int64_t>(value); }
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& values)
+    {
+        if (!values.empty())
+        {
+            this->m_buff.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+    }
+
+    void WriteString(const std::string& value)
+    {
+        this->WriteU32(static_cast<uint32_t>(value.size()));
+        this->m_buff.append(value);
+    }
+
+    const std::string& GetContents() const { return this->m_buff; }
+
+    //Write the contents to path (replacing any existing file) -- returns false if the write failed
+    bool WriteToFile(const std::string& path) const
+    {
+        int fd = CreateOutputFile(path);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        const bool ok = WriteOutputFully(fd, this->m_buff.c_str(), this->m_buff.size());
+        CloseOutputFile(fd);
+
+        return ok;
+    }
+};
+
+//Write every format in the registry to the catalog at path (replacing any existing file) -- returns false if the write failed
+static bool WriteFormatCatalog(const std::string& path, const LoggingRegistry* registry)
+{
+    const size_t formatCount = registry->GetFormatCount();
+
+    BinaryWriter writer;
+    writer.WriteU32(FORMAT_CATALOG_MAGIC);
+    writer.WriteU32(FORMAT_CATALOG_VERSION);
+    writer.WriteU32(static_cast<uint32_t>(formatCount));
+
+    for (size_t i = 0; i < formatCount; ++i)
+    {
+        const MsgFormat* fmt = registry->TryGetFormat(static_cast<int64_t>(i));
+
+        writer.WriteString(fmt->GetFormatName());
+        writer.WriteString(fmt->GetOriginalFormatString());
+        writer.WriteString(fmt->GetInitialFormatStringSegment());
+
+        const std::vector<FormatEntry>& entries = fmt->GetEntries();
+        writer.WriteU32(static_cast<uint32_t>(entries.size()));
+        for (size_t j = 0; j < entries.size(); ++j)
+        {
+            writer.WriteU8(static_cast<uint8_t>(entries[j].fkind));
+            writer.WriteU8(static_cast<uint8_t>(entries[j].fenum));
+            writer.WriteI32(entries[j].fdepth);
+            writer.WriteI32(entries[j].flength);
+            writer.WriteString(entries[j].ffollow);
+        }
+    }
+
+    return writer.WriteToFile(path);
+}
+
+//True if the kind/enum bytes of a catalog entry are a pairing the format parser can produce (so the formatters never see an unknown kind or enum)
+static bool IsValidCatalogEntry(uint8_t kind, uint8_t fenum)
+{
+    switch (static_cast<FormatStringEntryKind>(kind))
+    {
+    case FormatStringEntryKind::Literal:
+        return fenum == static_cast<uint8_t>(FormatStringEnum::HASH) || fenum == static_cast<uint8_t>(FormatStringEnum::PERCENT);
+    case FormatStringEntryKind::Expando:
+        return fenum >= static_cast<uint8_t>(FormatStringEnum::HOST) && fenum <= static_cast<uint8_t>(FormatStringEnum::REQUEST);
+    case FormatStringEntryKind::Basic:
+        return fenum >= static_cast<uint8_t>(FormatStringEnum::BOOL) && fenum <= static_cast<uint8_t>(FormatStringEnum::DATELOCAL);
+    case FormatStringEntryKind::Compound:
+        return fenum == static_cast<uint8_t>(FormatStringEnum::GENERAL);
+    default:
+        return false;
+    }
+}
+
+//One format as read from a catalog (before it is registered)
+struct CatalogFormat
+{
+    std::string fmtName;
+    std::string fmtString;
+    std::string initialFormatSegment;
+    std::vector<FormatEntry> entries;
+};
+
+//Register every format in the catalog at path (formats we already have keep their ids) and return the id of each one in file order.
+//The whole catalog is read and checked before any format is registered so a bad catalog adds nothing.
+static std::vector<int64_t> ReadFormatCatalog(const std::string& path, LoggingRegistry* registry)
+{
+    CatalogFile file;
+    if (!file.Open(path))
+    {
+        throw std::runtime_error("Could not open format catalog");
+    }
+
+    BinaryReader reader(file.GetData(), file.GetSize());
+    if (reader.ReadU32() != FORMAT_CATALOG_MAGIC || reader.ReadU32() != FORMAT_CATALOG_VERSION)
+    {
+        throw std::runtime_error("Not a format catalog (or from an incompatible version)");
+    }
+
+    const uint32_t formatCount = reader.ReadU32();
+
+    std::vector<CatalogFormat> formats;
+    for (uint32_t i = 0; i < formatCount; ++i)
+    {
+        CatalogFormat format;
+        format.fmtName = reader.ReadString();
+        format.fmtString = reader.ReadString();
+        format.initialFormatSegment = reader.ReadString();
+
+        const uint32_t entryCount = reader.ReadU32();
+        for (uint32_t j = 0; j < entryCount; ++j)
+        {
+            const uint8_t kind = reader.ReadU8();
+            const uint8_t fenum = reader.ReadU8();
+            if (!IsValidCatalogEntry(kind, fenum))
+            {
+                throw std::runtime_error("Bad format entry in format catalog");
+            }
+
+            const int32_t fdepth = reader.ReadI32();
+            const int32_t flength = reader.ReadI32();
+
+            format.entries.emplace_back(static_cast<FormatStringEntryKind>(kind), static_cast<FormatStringEnum>(fenum), fdepth, flength, reader.ReadString());
+        }
+
+        formats.push_back(std::move(format));
+    }
+
+    if (!reader.AtEnd())
+    {
+        throw std::runtime_error("Trailing data in format catalog");
+    }
+
+    std::vector<int64_t> fmtIds;
+    fmtIds.reserve(formats.size());
+    for (size_t i = 0; i < formats.size(); ++i)
+    {
+        CatalogFormat& format = formats[i];
+
+        const std::string memoKey = format.fmtName + format.fmtString;
+        fmtIds.push_back(registry->AddFormat(memoKey, [&](int64_t newId) {
+            std::shared_ptr<MsgFormat> msgf = std::make_shared<MsgFormat>(newId, std::move(format.fmtName), format.entries.size(), std::move(format.initialFormatSegment), std::move(format.fmtString));
+
+            for (size_t j = 0; j < format.entries.size(); ++j)
+            {
+                msgf->AddFormat(std::move(format.entries[j]));
+            }
+
+            return msgf;
+        }));
+    }
+
+    return fmtIds;
+}
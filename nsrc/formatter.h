@@ -2,6 +2,299 @@
 
 #define INITIAL_FORMAT_BUFFER_SIZE 1024
 
+//Formatter buffers that were handed to JS as external Buffers come back here when the Buffer is collected so the next output can reuse them.
+//The finalizers run on whichever JS thread owned the Buffer so the pool is shared by the process (under a lock).
+class FormatBufferPool
+{
+private:
+    std::mutex m_lock;
+    std::vector<std::pair<char*, size_t>> m_buffers;
+
+public:
+    FormatBufferPool() :
+        m_lock(), m_buffers()
+    {
+        ;
+    }
+
+    //A buffer (and its capacity) from the pool or a new one if the pool is empty
+    char* Take(size_t& capacity)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_lock);
+            if (!this->m_buffers.empty())
+            {
+                char* buff = this->m_buffers.back().first;
+                capacity = this->m_buffers.back().second;
+                this->m_buffers.pop_back();
+                return buff;
+            }
+        }
+
+        capacity = INITIAL_FORMAT_BUFFER_SIZE;
+        return (char*)malloc(INITIAL_FORMAT_BUFFER_SIZE);
+    }
+
+    void Give(char* buff, size_t capacity)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_lock);
+            if (this->m_buffers.size() < FORMAT_BUFFER_POOL_COUNT && capacity <= FORMAT_BUFFER_POOL_MAX_SIZE)
+            {
+                this->m_buffers.push_back(std::make_pair(buff, capacity));
+                return;
+            }
+        }
+
+        free(buff);
+    }
+};
+
+//Never destroyed since Buffers can be finalized as the process is torn down
+static FormatBufferPool& GetFormatBufferPool()
+{
+    static FormatBufferPool* s_pool = new FormatBufferPool();
+    return *s_pool;
+}
+
+//The conversions shared by the Formatter and the SignalSafeWriter (so the crash flush output matches the normal output).
+//They only write into the given buffer -- no allocation, locale, or C library formatting -- so they are safe in a fatal signal handler.
+
+//Large enough for any number, int, date, or escaped character written below
+#define FORMAT_CONVERSION_MAX_CHARS 48
+
+//Decimal digits of value zero padded to minDigits -- returns the # of chars written
+static size_t WriteDigits(uint64_t value, size_t minDigits, char* into)
+{
+    char digits[24];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + (value % 10));
+        value /= 10;
+    } while (value != 0 && count < sizeof(digits));
+
+    while (count < minDigits && count < sizeof(digits))
+    {
+        digits[count++] = '0';
+    }
+
+    size_t written = 0;
+    while (count != 0)
+    {
+        into[written++] = digits[--count];
+    }
+
+    return written;
+}
+
+static size_t WriteJsInt(int64_t ival, char* into)
+{
+    if (ival < 0)
+    {
+        into[0] = '-';
+        return 1 + WriteDigits(static_cast<uint64_t>(-(ival + 1)) + 1, 1, into + 1);
+    }
+
+    return WriteDigits(static_cast<uint64_t>(ival), 1, into);
+}
+
+//Integers in the int64 range are exact, everything else gets (up to) 6 fractional digits, values past the int64 range are only approximate (digits + exponent), and NaN/Infinity are null (like JSON.stringify)
+static size_t WriteJsNumber(double val, char* into)
+{
+    if (std::isnan(val) || std::isinf(val))
+    {
+        memcpy(into, "null", 4);
+        return 4;
+    }
+
+    if (std::floor(val) == val && val >= -9223372036854775808.0 && val < 9223372036854775808.0)
+    {
+        return WriteJsInt(static_cast<int64_t>(val), into);
+    }
+
+    size_t pos = 0;
+    if (val < 0)
+    {
+        into[pos++] = '-';
+        val = -val;
+    }
+
+    int32_t exponent = 0;
+    while (val >= 1.0e18)
+    {
+        val /= 10.0;
+        exponent++;
+    }
+
+    uint64_t ipart = static_cast<uint64_t>(val);
+    uint64_t fpart = static_cast<uint64_t>((val - static_cast<double>(ipart)) * 1000000.0 + 0.5);
+    if (fpart >= 1000000)
+    {
+        ipart++;
+        fpart -= 1000000;
+    }
+
+    pos += WriteDigits(ipart, 1, into + pos);
+    if (fpart != 0 && exponent == 0)
+    {
+        size_t digits = 6;
+        while (fpart % 10 == 0)
+        {
+            fpart /= 10;
+            digits--;
+        }
+
+        into[pos++] = '.';
+        pos += WriteDigits(fpart, digits, into + pos);
+    }
+
+    if (exponent != 0)
+    {
+        into[pos++] = 'e';
+        into[pos++] = '+';
+        pos += WriteDigits(static_cast<uint64_t>(exponent), 1, into + pos);
+    }
+
+    return pos;
+}
+
+//ISO format "YYYY-MM-DDTHH:MM:SS.mmmZ" (in UTC) for ms since the epoch
+static size_t WriteIsoDate(int64_t dval, char* into)
+{
+    int64_t days = dval / 86400000;
+    int64_t msInDay = dval % 86400000;
+    if (msInDay < 0)
+    {
+        msInDay += 86400000;
+        days--;
+    }
+
+    //civil date from days since the epoch (proleptic Gregorian)
+    const int64_t z = days + 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    const int64_t day = doy - (153 * mp + 2) / 5 + 1;
+    const int64_t month = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+
+    size_t pos = WriteJsInt(year, into);
+    into[pos++] = '-';
+    pos += WriteDigits(static_cast<uint64_t>(month), 2, into + pos);
+    into[pos++] = '-';
+    pos += WriteDigits(static_cast<uint64_t>(day), 2, into + pos);
+    into[pos++] = 'T';
+    pos += WriteDigits(static_cast<uint64_t>(msInDay / 3600000), 2, into + pos);
+    into[pos++] = ':';
+    pos += WriteDigits(static_cast<uint64_t>((msInDay / 60000) % 60), 2, into + pos);
+    into[pos++] = ':';
+    pos += WriteDigits(static_cast<uint64_t>((msInDay / 1000) % 60), 2, into + pos);
+    into[pos++] = '.';
+    pos += WriteDigits(static_cast<uint64_t>(msInDay % 1000), 3, into + pos);
+    into[pos++] = 'Z';
+
+    return pos;
+}
+
+//The JSON string form of the character at c -- non-ascii characters are written as \uxxxx (c is left on the last byte of the utf8 sequence) -- returns the # of chars written
+static size_t WriteJsStringChar(std::string::const_iterator& c, std::string::const_iterator end, char* into)
+{
+    static const char* hex = "0123456789abcdef";
+
+    uint32_t cvalue = 0;
+    switch (*c)
+    {
+    case '"':
+    case '\\':
+        into[0] = '\\';
+        into[1] = *c;
+        return 2;
+    case '\b':
+        into[0] = '\\';
+        into[1] = 'b';
+        return 2;
+    case '\f':
+        into[0] = '\\';
+        into[1] = 'f';
+        return 2;
+    case '\n':
+        into[0] = '\\';
+        into[1] = 'n';
+        return 2;
+    case '\r':
+        into[0] = '\\';
+        into[1] = 'r';
+        return 2;
+    case '\t':
+        into[0] = '\\';
+        into[1] = 't';
+        return 2;
+    default:
+        if ((*c & 0x80) == 0)
+        {
+            if (static_cast<unsigned char>(*c) >= 0x20)
+            {
+                into[0] = *c;
+                return 1;
+            }
+
+            cvalue = static_cast<uint32_t>(*c);
+        }
+        else if ((*c & 0xE0) == 0xC0 && end - c > 1)
+        {
+            cvalue = ((*c & 0x1F) << 6) | (*(c + 1) & 0x3F);
+            c += 1; //last increment happens in the caller's loop
+        }
+        else if ((*c & 0xF0) == 0xE0 && end - c > 2)
+        {
+            cvalue = ((*c & 0xF) << 12) | ((*(c + 1) & 0x3F) << 6) | (*(c + 2) & 0x3F);
+            c += 2; //last increment happens in the caller's loop
+        }
+        else
+        {
+            cvalue = 0xFFFD;
+            while (c + 1 != end && (*(c + 1) & 0xC0) == 0x80)
+            {
+                c++;
+            }
+        }
+        break;
+    }
+
+    into[0] = '\\';
+    into[1] = 'u';
+    into[2] = hex[(cvalue >> 12) & 0xF];
+    into[3] = hex[(cvalue >> 8) & 0xF];
+    into[4] = hex[(cvalue >> 4) & 0xF];
+    into[5] = hex[cvalue & 0xF];
+    return 6;
+}
+
+//The text written for the special (non-value) tags
+static const char* GetSpecialTagText(LogEntryTag tag)
+{
+    switch (tag)
+    {
+    case LogEntryTag::JsBadFormatVar:
+        return "\"<BadFormat>\"";
+    case LogEntryTag::DepthBoundObject:
+        return "\"{...}\"";
+    case LogEntryTag::LengthBoundObject:
+        return "\"$rest$\": \"...\"";
+    case LogEntryTag::DepthBoundArray:
+        return "\"[...]\"";
+    case LogEntryTag::LengthBoundArray:
+        return "\"...\"";
+    case LogEntryTag::CycleValue:
+        return "\"<Cycle>\"";
+    default:
+        return "\"<OpaqueValue>\"";
+    }
+}
+
 //This class controls the formatting
 class Formatter
 {
@@ -13,18 +306,17 @@ private:
     template<size_t N>
     void ensure_fixed()
     {
-        if (this->m_curr + N >= this->m_max)
-        {
-            this->m_max *= 2;
-            this->m_buff = (char*)realloc(this->m_buff, this->m_max);
-        }
+        this->ensure(N);
     }
 
     void ensure(size_t extra)
     {
         if (this->m_curr + extra >= this->m_max)
         {
-            this->m_max *= 2;
+            while (this->m_curr + extra >= this->m_max)
+            {
+                this->m_max *= 2;
+            }
             this->m_buff = (char*)realloc(this->m_buff, this->m_max);
         }
     }
@@ -36,16 +328,36 @@ public:
         ;
     }
 
+    ~Formatter()
+    {
+        free(this->m_buff);
+    }
+
+    Formatter(const Formatter&) = delete;
+    Formatter& operator=(const Formatter&) = delete;
+
     size_t getOutputBufferSize() const { return this->m_curr; }
     char* getOutputBuffer() const { return this->m_buff; }
+    size_t getBufferCapacity() const { return this->m_max; }
 
+    //Clear the output but keep the buffer around for reuse
     void reset()
     {
-        this->m_buff = (char*)malloc(INITIAL_FORMAT_BUFFER_SIZE);
-        this->m_max = INITIAL_FORMAT_BUFFER_SIZE;
         this->m_curr = 0;
     }
 
+    //Hand the output buffer (and its capacity) over to the caller -- who gives it back to the pool when done -- and carry on with a buffer from the pool
+    char* detachOutputBuffer(size_t& capacity)
+    {
+        char* buff = this->m_buff;
+        capacity = this->m_max;
+
+        this->m_buff = GetFormatBufferPool().Take(this->m_max);
+        this->m_curr = 0;
+
+        return buff;
+    }
+
     void emitLiteralChar(char c)
     {
         this->ensure(1);
@@ -61,80 +373,27 @@ public:
         this->m_curr += N - 1;
     }
 
-    void emitLiteralString(const std::string& str)
+    void emitLiteralString(const char* str, size_t length)
     {
-        this->ensure(str.length());
-        memcpy(this->m_buff + this->m_curr, str.c_str(), str.length());
+        this->ensure(length);
+        memcpy(this->m_buff + this->m_curr, str, length);
 
-        this->m_curr += str.length();
+        this->m_curr += length;
+    }
+
+    void emitLiteralString(const std::string& str)
+    {
+        this->emitLiteralString(str.c_str(), str.length());
     }
 
     void emitJsString(const std::string& str)
     {
         this->emitLiteralChar('"');
 
-        for (auto c = str.cbegin(); c != str.cend(); c++) {
-            this->ensure_fixed<8>(); //extra in case we do \uxxxx\0
-
-            switch (*c) {
-            case '"':
-                this->m_buff[this->m_curr] ='\\';
-                this->m_buff[this->m_curr++] = '"';
-                break;
-            case '\\':
-                this->m_buff[this->m_curr++] = '\\';
-                this->m_buff[this->m_curr++] = '\\';
-                break;
-            case '\b':
-                this->m_buff[this->m_curr++] = '\\';
-                this->m_buff[this->m_curr++] = 'b';
-                break;
-            case '\f':
-                this->m_buff[this->m_curr++] = '\\';
-                this->m_buff[this->m_curr++] = 'f';
-                break;
-            case '\n':
-                this->m_buff[this->m_curr++] = '\\';
-                this->m_buff[this->m_curr++] = 'n';
-                break;
-            case '\r':
-                this->m_buff[this->m_curr++] = '\\';
-                this->m_buff[this->m_curr++] = 'r';
-                break;
-            case '\t':
-                this->m_buff[this->m_curr++] = '\\';
-                this->m_buff[this->m_curr++] = 't';
-                break;
-            default:
-				if ((*c & 0x80) == 0)
-				{
-					this->m_buff[this->m_curr++] = *c;
-				}
-				else
-				{
-					uint32_t cvalue = 0;
-					if ((*c & 0xE0) == 0xC0)
-					{
-						cvalue = ((*c & 0x1F) << 6) | (*(c + 1) & 0x3F);
-						c += 1; //last increment happens in loop
-					}
-					else if((*c & 0xF0) == 0xE0)
-					{
-						cvalue = ((*c & 0xF) << 12) | ((*(c + 1) & 0x3F) << 6) | (*(c + 2) & 0x3F);
-						c += 2; //last increment happens in loop
-					}
-					else
-					{
-						cvalue = 0xFFFD;
-						while ((*c & 0x80) != 0 && (c + 1 != str.cend()))
-						{
-							c++;
-						}
-					}
-					
-					this->m_curr += snprintf(this->m_buff + this->m_curr, 8, "\\u%04x", cvalue);
-				}
-            }
+        for (auto c = str.cbegin(); c != str.cend(); c++)
+        {
+            this->ensure_fixed<8>();
+            this->m_curr += WriteJsStringChar(c, str.cend(), this->m_buff + this->m_curr);
         }
 
         this->emitLiteralChar('"');
@@ -142,38 +401,14 @@ public:
 
     void emitJsInt(int64_t val)
     {
-        this->ensure(32);
-        this->m_curr += snprintf(this->m_buff + this->m_curr, 32, "%lli", static_cast<long long int>(val));
+        this->ensure(FORMAT_CONVERSION_MAX_CHARS);
+        this->m_curr += WriteJsInt(val, this->m_buff + this->m_curr);
     }
 
     void emitJsNumber(double val)
     {
-        if (std::isnan(val))
-        {
-            this->emitLiteralString("null");
-        }
-        else if (val == std::numeric_limits<double>::infinity())
-        {
-            this->emitLiteralString("null");
-        }
-        else if (val == -std::numeric_limits<double>::infinity())
-        {
-            this->emitLiteralString("null");
-        }
-        else if (floor(val) == val)
-        {
-            this->ensure(32);
-            this->m_curr += snprintf(this->m_buff + this->m_curr, 32, "%lli", static_cast<long long int>(val));
-        }
-        else
-        {
-            this->ensure(32);
-            this->m_curr += snprintf(this->m_buff + this->m_curr, 32, "%f", val);
-            while (this->m_buff[this->m_curr - 1] == '0')
-            {
-                this->m_curr--;
-            }
-        }
+        this->ensure(FORMAT_CONVERSION_MAX_CHARS);
+        this->m_curr += WriteJsNumber(val, this->m_buff + this->m_curr);
     }
 
     void emitJsDate(std::time_t dval, FormatStringEnum fmt, bool quotes)
@@ -183,21 +418,16 @@ public:
             this->emitLiteralChar('"');
         }
 
-        std::time_t tval = dval / 1000;
-        uint32_t msval = dval % 1000;
-
         this->ensure(128);
         if (fmt == FormatStringEnum::DATELOCAL)
         {
-            auto localtime = std::localtime(&tval);
-            this->m_curr += strftime(this->m_buff + this->m_curr, 128, "%a %b %d %Y %H:%M:%S GMT%z (%Z)", localtime);
+            std::tm tm = {};
+            LocalTime(dval / 1000, tm);
+            this->m_curr += strftime(this->m_buff + this->m_curr, 128, "%a %b %d %Y %H:%M:%S GMT%z (%Z)", &tm);
         }
         else
         {
-            //ISO
-            auto utctime = std::gmtime(&tval);
-            this->m_curr += strftime(this->m_buff + this->m_curr, 96, "%Y-%m-%dT%H:%M:%S", utctime);
-            this->m_curr += snprintf(this->m_buff + this->m_curr, 32, ".%03dZ", msval);
+            this->m_curr += WriteIsoDate(static_cast<int64_t>(dval), this->m_buff + this->m_curr);
         }
 
         if (quotes)
@@ -213,29 +443,52 @@ public:
 
     void emitSpecialTag(LogEntryTag tag)
     {
-        switch (tag)
-        {
-        case LogEntryTag::JsBadFormatVar:
-            this->emitLiteralString("\"<BadFormat>\"");
-            break;
-        case LogEntryTag::DepthBoundObject:
-            this->emitLiteralString("\"{...}\"");
-            break;
-        case LogEntryTag::LengthBoundObject:
-            this->emitLiteralString("\"$rest$\": \"...\"");
-            break;
-        case LogEntryTag::DepthBoundArray:
-            this->emitLiteralString("\"[...]\"");
-            break;
-        case LogEntryTag::LengthBoundArray:
-            this->emitLiteralString("\"...\"");
-            break;
-        case LogEntryTag::CycleValue:
-            this->emitLiteralString("\"<Cycle>\"");
-            break;
-        default:
-            this->emitLiteralString("\"<OpaqueValue>\"");
-            break;
-        }
+        const char* text = GetSpecialTagText(tag);
+        this->emitLiteralString(text, strlen(text));
     }
 };
+
+//Formatted output for JS -- as a string (copied and transcoded into the V8 heap) or, if asBuffer, as an external Buffer over the formatter's bytes (no copy).
+//The formatter is left empty either way.
+static Napi::Value CreateFormattedOutput(Napi::Env env, Formatter& formatter, bool asBuffer)
+{
+    if (!asBuffer)
+    {
+        Napi::String output = Napi::String::New(env, formatter.getOutputBuffer(), formatter.getOutputBufferSize());
+        formatter.reset();
+        return output;
+    }
+
+    if (formatter.getOutputBufferSize() == 0)
+    {
+        return Napi::Buffer<char>::New(env, 0);
+    }
+
+    const size_t size = formatter.getOutputBufferSize();
+    size_t* capacity = new size_t(0);
+    char* buff = formatter.detachOutputBuffer(*capacity);
+
+    return Napi::Buffer<char>::New(env, buff, size, [](Napi::Env env, char* data, size_t* capacity) {
+        GetFormatBufferPool().Give(data, *capacity);
+        delete capacity;
+    }, capacity);
+}
+
+//As above for output that was collected in a string (the Buffer takes over the string's storage)
+static Napi::Value CreateFormattedOutput(Napi::Env env, std::string&& output, bool asBuffer)
+{
+    if (!asBuffer)
+    {
+        return Napi::String::New(env, output.c_str(), output.size());
+    }
+
+    if (output.empty())
+    {
+        return Napi::Buffer<char>::New(env, 0);
+    }
+
+    std::string* owned = new std::string(std::move(output));
+    return Napi::Buffer<char>::New(env, &(*owned)[0], owned->size(), [](Napi::Env env, char* data, std::string* owned) {
+        delete owned;
+    }, owned);
+}
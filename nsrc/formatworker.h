@@ -1,51 +1,293 @@
 #pragma once
 
-class FormatWorker : public Napi::AsyncWorker
+//A long lived native thread that formats the processed blocks for an environment as they are added.
+//JS is only called back (via a threadsafe function) to deliver output or signal that all the pending work is done.
+class FormatThread
 {
 private:
-    std::shared_ptr<Formatter> m_formatter;
-    std::shared_ptr<LogProcessingBlock> m_block;
     LoggingEnvironment* m_lenv;
-    const bool m_stdPrefix;
+    Formatter m_formatter;
+
+    Napi::ThreadSafeFunction m_deliver;
+    std::thread m_thread;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake; //formatter waits here for work
+    std::condition_variable m_idle; //JS waits here for the formatter to finish its current block
+    std::condition_variable m_backpressure; //formatter waits here if JS is not taking the output
+
+    bool m_workRequested;
+    bool m_stdPrefix;
+    bool m_busy;
+    bool m_paused;
+    bool m_stopping;
+
+    //Formatted output that has not been handed to JS yet
+    std::string m_completed;
+    bool m_deliveryScheduled;
+
+    //Must hold m_lock
+    void ScheduleDelivery()
+    {
+        if (!this->m_deliveryScheduled)
+        {
+            this->m_deliveryScheduled = true;
+            this->m_deliver.NonBlockingCall([this](Napi::Env env, Napi::Function callback) {
+                //a null env means the function is being torn down
+                if (env != nullptr)
+                {
+                    this->Deliver(env, callback);
+                }
+            });
+        }
+    }
+
+    //Runs on the JS thread
+    void Deliver(Napi::Env env, Napi::Function callback)
+    {
+        TraceSpan span("deliver");
+
+        std::string output;
+        bool pending = false;
+        {
+            std::lock_guard<std::mutex> lock(this->m_lock);
+
+            output.swap(this->m_completed);
+            this->m_lenv->GetMemoryBudget().SetFormatterBytes(static_cast<int64_t>(this->m_formatter.getBufferCapacity()));
+            this->m_deliveryScheduled = false;
+            pending = this->m_busy || (this->m_workRequested && !this->m_paused);
+
+            this->m_backpressure.notify_all();
+        }
+
+        //nothing to write and still working so no need to bother JS
+        if (output.empty() && pending)
+        {
+            return;
+        }
+
+        span.SetArgs("bytes", static_cast<double>(output.size()));
+
+        Napi::HandleScope scope(env);
+        callback.Call({ env.Undefined(), CreateFormattedOutput(env, std::move(output), this->m_lenv->GetOutputBuffers()), Napi::Boolean::New(env, pending) });
+    }
+
+    void FormatLoop()
+    {
+        TraceRecorder::SetCurrentThreadName("logpp-format");
+
+        std::unique_lock<std::mutex> lock(this->m_lock);
+        while (true)
+        {
+            this->m_wake.wait(lock, [this]() { return this->m_stopping || (this->m_workRequested && !this->m_paused); });
+            if (this->m_stopping)
+            {
+                break;
+            }
+
+            this->m_workRequested = false;
+            this->m_busy = true;
+            const bool stdPrefix = this->m_stdPrefix;
+            lock.unlock();
+
+            bool resumed = false;
+            std::shared_ptr<LogProcessingBlock> block = this->m_lenv->GetNextFormatBlock(&resumed);
+            while (block != nullptr)
+            {
+                //a block (e.g., from a full flush) can be huge so it is formatted and handed to JS a chunk at a time
+                if (!resumed)
+                {
+                    block->resetFormatPosition();
+                }
+
+                while (block->hasMoreFormatEntries())
+                {
+                    this->m_formatter.reset();
+
+                    FlushScheduler& scheduler = this->m_lenv->GetFlushScheduler();
+                    const bool timed = scheduler.IsAdaptive();
+                    const auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+                    int64_t msgCount = 0;
+                    {
+                        TraceSpan span("formatBlock");
+                        msgCount = block->emitFormatEntriesUpTo(&this->m_formatter, this->m_lenv, stdPrefix, FORMAT_STREAM_CHUNK_SIZE);
+                        span.SetArgs("messages", static_cast<double>(msgCount), "bytes", static_cast<double>(this->m_formatter.getOutputBufferSize()));
+                    }
+
+                    if (timed)
+                    {
+                        scheduler.ObserveFormat(msgCount, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                    }
+
+                    lock.lock();
+                    auto outputTaken = [this]() { return this->m_stopping || this->m_paused || this->m_completed.size() < FORMAT_OUTPUT_BACKPRESSURE_LIMIT; };
+                    if (!outputTaken())
+                    {
+                        TraceSpan span("backpressure");
+                        span.SetArgs("pending", static_cast<double>(this->m_completed.size()));
+                        this->m_backpressure.wait(lock, outputTaken);
+                    }
+
+                    this->m_completed.append(this->m_formatter.getOutputBuffer(), this->m_formatter.getOutputBufferSize());
+                    this->m_lenv->GetMemoryBudget().SetFormatterBytes(static_cast<int64_t>(this->m_formatter.getBufferCapacity() + this->m_completed.capacity()));
+                    this->ScheduleDelivery();
+                    lock.unlock();
+                }
+
+                //leave the rest of the blocks for the sync formatter if we are paused
+                lock.lock();
+                const bool stop = this->m_paused || this->m_stopping;
+                lock.unlock();
+
+                block = stop ? nullptr : this->m_lenv->GetNextFormatBlock(&resumed);
+            }
+
+            lock.lock();
+            this->m_busy = false;
+            this->ScheduleDelivery();
+            this->m_idle.notify_all();
+        }
+    }
+
+    static void CleanupHook(void* arg)
+    {
+        FormatThread* fthread = static_cast<FormatThread*>(arg);
+        fthread->m_lenv->ClearFormatThread();
+
+        fthread->Stop();
+        delete fthread;
+    }
 
 public:
+    FormatThread(Napi::Env env, Napi::Function callback, LoggingEnvironment* lenv) :
+        m_lenv(lenv), m_formatter(), m_deliver(), m_thread(),
+        m_lock(), m_wake(), m_idle(), m_backpressure(),
+        m_workRequested(false), m_stdPrefix(false), m_busy(false), m_paused(false), m_stopping(false),
+        m_completed(), m_deliveryScheduled(false)
+    {
+        this->m_deliver = Napi::ThreadSafeFunction::New(env, callback, "logpp-format", 0, 1);
 
-    FormatWorker(Napi::Function& callback, std::shared_ptr<LogProcessingBlock> block, LoggingEnvironment* lenv, bool stdPrefix) :
-        Napi::AsyncWorker(callback), m_formatter(nullptr), m_block(block), m_lenv(lenv), m_stdPrefix(stdPrefix)
+        //an idle formatter should not keep the process alive -- anything undelivered at exit is picked up by the termination flush
+        this->m_deliver.Unref(env);
+
+        napi_add_env_cleanup_hook(env, &FormatThread::CleanupHook, this);
+
+        this->m_thread = std::thread(&FormatThread::FormatLoop, this);
+    }
+
+    ~FormatThread()
     {
-        ;
+        this->Stop();
     }
 
-    virtual ~FormatWorker()
+    //Wake the formatter to process any pending blocks (and resume if we were paused)
+    void RequestFormat(bool stdPrefix)
     {
-        ;
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        this->m_stdPrefix = stdPrefix;
+        this->m_workRequested = true;
+        this->m_paused = false;
+
+        this->m_wake.notify_one();
     }
 
-    std::shared_ptr<LogProcessingBlock> GetProcessingBlock() { return this->m_block; }
+    //Stop formatting (after the current block) until the next request and take any output JS has not been given yet
+    std::string Pause()
+    {
+        std::unique_lock<std::mutex> lock(this->m_lock);
+
+        this->m_paused = true;
+        this->m_backpressure.notify_all();
+        this->m_idle.wait(lock, [this]() { return !this->m_busy; });
+
+        std::string output;
+        output.swap(this->m_completed);
+        return output;
+    }
+
+    //Hold the formatter (after its current block) so JS can use the environment's format state directly (e.g., for a query) -- returns true if it was already paused
+    bool Suspend()
+    {
+        std::unique_lock<std::mutex> lock(this->m_lock);
+
+        const bool wasPaused = this->m_paused;
+        this->m_paused = true;
+        this->m_backpressure.notify_all();
+        this->m_idle.wait(lock, [this]() { return !this->m_busy; });
 
-    virtual void Execute() override
+        return wasPaused;
+    }
+
+    //Undo a Suspend and pick up any blocks that were added in the meantime
+    void Resume(bool wasPaused)
     {
-        if (this->m_formatter == nullptr)
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (wasPaused)
         {
-            this->m_formatter = std::make_shared<Formatter>();
+            return;
         }
 
-        this->m_block->emitAllFormatEntries(this->m_formatter.get(), this->m_lenv, this->m_stdPrefix);
+        this->m_paused = false;
+        if (this->m_lenv->HasWorkPending())
+        {
+            this->m_workRequested = true;
+            this->m_wake.notify_one();
+        }
     }
 
-    virtual void OnOK() override
+    //Only for the fatal signal handler -- reads the output without taking the lock
+    const std::string& GetUndeliveredOutputUnsafe() const
     {
-        Napi::HandleScope scope(Env());
-        this->m_lenv->ClearAsyncFormatWorker();
+        return this->m_completed;
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_lock);
+            if (this->m_stopping)
+            {
+                return;
+            }
+
+            this->m_stopping = true;
+            this->m_wake.notify_one();
+            this->m_backpressure.notify_all();
+        }
+
+        if (this->m_thread.joinable())
+        {
+            this->m_thread.join();
+        }
 
-        Callback().Call({ Env().Undefined(), Napi::String::New(Env(), this->m_formatter->getOutputBuffer(), this->m_formatter->getOutputBufferSize()) });
+        this->m_deliver.Release();
     }
+};
 
-    virtual void OnError(const Napi::Error& e) override
+//Suspends the format thread (if there is one) for the enclosing scope -- resumes it even if the scope is left by an exception
+class FormatThreadSuspension
+{
+private:
+    FormatThread* m_thread;
+    bool m_wasPaused;
+
+public:
+    FormatThreadSuspension(FormatThread* fthread) :
+        m_thread(fthread), m_wasPaused((fthread != nullptr) ? fthread->Suspend() : true)
     {
-        Napi::HandleScope scope(Env());
-        this->m_lenv->ClearAsyncFormatWorker();
+        ;
+    }
 
-        Callback().Call({ e.Value(), Env().Undefined() });
+    ~FormatThreadSuspension()
+    {
+        if (this->m_thread != nullptr)
+        {
+            this->m_thread->Resume(this->m_wasPaused);
+        }
     }
-};
\ No newline at end of file
+
+    FormatThreadSuspension(const FormatThreadSuspension&) = delete;
+    FormatThreadSuspension& operator=(const FormatThreadSuspension&) = delete;
+};
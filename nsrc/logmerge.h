@@ -0,0 +1,301 @@
+#pragma once
+
+//Merge the text output (with the standard prefix) of several processes into a single file ordered by wallclock time.
+//Each input is streamed through a fixed size buffer and a min heap picks the input with the earliest next message so memory use is bounded by the number of inputs (not their size).
+//Lines without a standard prefix (e.g. output with the prefix disabled) stay attached to the message before them in the same input.
+
+//Parse the "YYYY-MM-DDTHH:MM:SS.mmmZ" form written by Formatter::emitJsDate into ms since the epoch -- returns false if the text is not in that form
+static bool ParseIsoTime(const char* str, size_t length, int64_t& time)
+{
+    static const char* s_layout = "dddd-dd-ddTdd:dd:dd.dddZ";
+    const size_t layoutLength = 24;
+
+    if (length < layoutLength)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < layoutLength; ++i)
+    {
+        if (s_layout[i] == 'd' ? (str[i] < '0' || str[i] > '9') : (str[i] != s_layout[i]))
+        {
+            return false;
+        }
+    }
+
+    auto digits = [str](size_t pos, size_t count) {
+        int64_t value = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            value = value * 10 + (str[pos + i] - '0');
+        }
+        return value;
+    };
+
+    //days from the civil date (proleptic Gregorian) -- see http://howardhinnant.github.io/date_algorithms.html
+    const int64_t month = digits(5, 2);
+    const int64_t year = digits(0, 4) - (month <= 2 ? 1 : 0);
+    const int64_t era = year / 400;
+    const int64_t yoe = year - era * 400;
+    const int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + digits(8, 2) - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    const int64_t days = era * 146097 + doe - 719468;
+
+    const int64_t seconds = days * 86400 + digits(11, 2) * 3600 + digits(14, 2) * 60 + digits(17, 2);
+    time = seconds * 1000 + digits(20, 3);
+
+    return true;
+}
+
+//The time of a message line "LEVEL#category @ <time> from host::logger | ..." -- returns false if the line does not start with a standard prefix
+static bool ParseLogLineTime(const char* line, size_t length, int64_t& time)
+{
+    //the level and category part of the prefix is short so don't scan the whole message looking for the separator
+    const size_t searchLength = std::min<size_t>(length, 128);
+    for (size_t i = 0; i + 3 <= searchLength; ++i)
+    {
+        if (line[i] == ' ' && line[i + 1] == '@' && line[i + 2] == ' ')
+        {
+            return ParseIsoTime(line + i + 3, length - (i + 3), time);
+        }
+    }
+
+    return false;
+}
+
+//Reads an input file one line at a time through a buffer (grown only if a single line does not fit)
+class MergeInput
+{
+private:
+    int m_fd;
+    std::vector<char> m_buff;
+    size_t m_start;
+    size_t m_end;
+    bool m_eof;
+
+    //The current line (valid until the next call to Advance)
+    const char* m_line;
+    size_t m_lineLength;
+    int64_t m_time;
+    bool m_continuation;
+
+    void Fill()
+    {
+        if (this->m_start != 0)
+        {
+            memmove(this->m_buff.data(), this->m_buff.data() + this->m_start, this->m_end - this->m_start);
+            this->m_end -= this->m_start;
+            this->m_start = 0;
+        }
+
+        if (this->m_end == this->m_buff.size())
+        {
+            this->m_buff.resize(this->m_buff.size() * 2);
+        }
+
+        while (true)
+        {
+#ifdef _WIN32
+            int bytes = _read(this->m_fd, this->m_buff.data() + this->m_end, static_cast<unsigned int>(this->m_buff.size() - this->m_end));
+#else
+            ssize_t bytes = read(this->m_fd, this->m_buff.data() + this->m_end, this->m_buff.size() - this->m_end);
+            if (bytes < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+
+            if (bytes < 0)
+            {
+                throw std::runtime_error("Failed reading merge input");
+            }
+
+            this->m_eof = (bytes == 0);
+            this->m_end += static_cast<size_t>(bytes);
+            return;
+        }
+    }
+
+    bool NextLine()
+    {
+        while (true)
+        {
+            const char* start = this->m_buff.data() + this->m_start;
+            const size_t available = this->m_end - this->m_start;
+
+            const char* newline = static_cast<const char*>(memchr(start, '\n', available));
+            if (newline != nullptr || (this->m_eof && available != 0))
+            {
+                this->m_line = start;
+                this->m_lineLength = (newline != nullptr) ? static_cast<size_t>(newline - start) : available;
+                this->m_start += (newline != nullptr) ? this->m_lineLength + 1 : available;
+                return true;
+            }
+
+            if (this->m_eof)
+            {
+                return false;
+            }
+
+            this->Fill();
+        }
+    }
+
+public:
+    MergeInput() :
+        m_fd(-1), m_buff(MERGE_IO_BUFFER_SIZE), m_start(0), m_end(0), m_eof(false), m_line(nullptr), m_lineLength(0), m_time(INT64_MIN), m_continuation(false)
+    {
+        ;
+    }
+
+    ~MergeInput()
+    {
+        if (this->m_fd >= 0)
+        {
+            CloseOutputFile(this->m_fd);
+        }
+    }
+
+    MergeInput(const MergeInput&) = delete;
+    MergeInput& operator=(const MergeInput&) = delete;
+
+    bool Open(const std::string& path)
+    {
+#ifdef _WIN32
+        this->m_fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        this->m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (this->m_fd >= 0)
+        {
+            posix_fadvise(this->m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+#endif
+
+        return this->m_fd >= 0;
+    }
+
+    //Move to the next line -- lines without a prefix keep the time of the line before them
+    bool Advance()
+    {
+        if (!this->NextLine())
+        {
+            return false;
+        }
+
+        int64_t time = 0;
+        this->m_continuation = !ParseLogLineTime(this->m_line, this->m_lineLength, time);
+        if (!this->m_continuation)
+        {
+            this->m_time = time;
+        }
+
+        return true;
+    }
+
+    //True if the current line does not start a new message (so it must be written right after the message before it)
+    bool IsContinuation() const { return this->m_continuation; }
+
+    const char* GetLine() const { return this->m_line; }
+    size_t GetLineLength() const { return this->m_lineLength; }
+    int64_t GetTime() const { return this->m_time; }
+};
+
+struct MergeStats
+{
+    uint64_t lines;
+    uint64_t bytes;
+};
+
+//Merge the inputs into output (replacing any existing file) -- throws if any file cannot be read/written
+static MergeStats MergeLogFiles(const std::vector<std::string>& inputs, const std::string& output)
+{
+    std::vector<std::unique_ptr<MergeInput>> readers;
+    readers.reserve(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        readers.emplace_back(new MergeInput());
+        if (!readers.back()->Open(inputs[i]))
+        {
+            throw std::runtime_error("Could not open merge input " + inputs[i]);
+        }
+    }
+
+    int fd = CreateOutputFile(output);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open merge output " + output);
+    }
+
+    //(time, input index) so equal times come out in input order and messages from a single input stay in order
+    typedef std::pair<int64_t, size_t> HeapEntry;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+
+    MergeStats stats = { 0, 0 };
+    std::string buff;
+    buff.reserve(MERGE_IO_BUFFER_SIZE + 4096);
+
+    bool ok = true;
+    try
+    {
+        for (size_t i = 0; i < readers.size(); ++i)
+        {
+            if (readers[i]->Advance())
+            {
+                heap.push(HeapEntry(readers[i]->GetTime(), i));
+            }
+        }
+
+        while (ok && !heap.empty())
+        {
+            const size_t current = heap.top().second;
+            heap.pop();
+
+            MergeInput* reader = readers[current].get();
+
+            //write the message and any lines that continue it
+            bool more = true;
+            do
+            {
+                buff.append(reader->GetLine(), reader->GetLineLength());
+                buff.push_back('\n');
+                stats.lines++;
+
+                if (buff.size() >= MERGE_IO_BUFFER_SIZE)
+                {
+                    ok = WriteOutputFully(fd, buff.c_str(), buff.size());
+                    stats.bytes += buff.size();
+                    buff.clear();
+                }
+
+                more = reader->Advance();
+            } while (ok && more && reader->IsContinuation());
+
+            if (more)
+            {
+                heap.push(HeapEntry(reader->GetTime(), current));
+            }
+        }
+
+        if (ok && !buff.empty())
+        {
+            ok = WriteOutputFully(fd, buff.c_str(), buff.size());
+            stats.bytes += buff.size();
+        }
+    }
+    catch (...)
+    {
+        CloseOutputFile(fd);
+        throw;
+    }
+
+    CloseOutputFile(fd);
+
+    if (!ok)
+    {
+        throw std::runtime_error("Failed writing merge output " + output);
+    }
+
+    return stats;
+}
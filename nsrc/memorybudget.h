@@ -0,0 +1,104 @@
+#pragma once
+
+//What to do when the native memory used for processed (but not yet written) messages goes over the budget
+enum class MemoryPolicy : uint8_t
+{
+    Flush = 0x1, //ask JS to format and write everything synchronously
+    DropLevels = 0x2, //stop saving the least important levels first (FATAL is always kept)
+    DropOldest = 0x3 //throw away the oldest pending blocks
+};
+
+//Byte accounting for the pending blocks and format buffers of an environment.
+//Updated by JS (adding blocks) and the format thread (removing blocks and buffer sizes) so all the counters are atomic.
+class MemoryBudget
+{
+private:
+    int64_t m_budget; //0 is unlimited
+    MemoryPolicy m_policy;
+
+    std::atomic<int64_t> m_blockBytes;
+    std::atomic<int64_t> m_formatterBytes;
+    std::atomic<int64_t> m_syncFormatterBytes;
+
+    std::atomic<int64_t> m_droppedMessages;
+    std::atomic<int64_t> m_droppedBlocks;
+
+    //totals over every block ever queued (for the bytes per message of the encoded blocks)
+    std::atomic<int64_t> m_queuedBytes;
+    std::atomic<int64_t> m_queuedMessages;
+
+    //JS blocks that were read in place (blockHandoff) and the ones given back to JS for reuse
+    std::atomic<int64_t> m_handoffBlocks;
+    std::atomic<int64_t> m_reclaimedBlocks;
+
+public:
+    MemoryBudget() :
+        m_budget(0), m_policy(MemoryPolicy::Flush),
+        m_blockBytes(0), m_formatterBytes(0), m_syncFormatterBytes(0), m_droppedMessages(0), m_droppedBlocks(0), m_queuedBytes(0), m_queuedMessages(0), m_handoffBlocks(0), m_reclaimedBlocks(0)
+    {
+        ;
+    }
+
+    void SetBudget(int64_t budget, MemoryPolicy policy)
+    {
+        this->m_budget = budget;
+        this->m_policy = policy;
+    }
+
+    int64_t GetBudget() const { return this->m_budget; }
+    MemoryPolicy GetPolicy() const { return this->m_policy; }
+
+    void AddBlockBytes(int64_t bytes) { this->m_blockBytes.fetch_add(bytes, std::memory_order_relaxed); }
+    void RemoveBlockBytes(int64_t bytes) { this->m_blockBytes.fetch_sub(bytes, std::memory_order_relaxed); }
+    int64_t GetBlockBytes() const { return this->m_blockBytes.load(std::memory_order_relaxed); }
+
+    //The format thread publishes the current size of its (reused) buffers
+    void SetFormatterBytes(int64_t bytes) { this->m_formatterBytes.store(bytes, std::memory_order_relaxed); }
+
+    //The JS thread publishes the size of the (reused) sync formatter buffer after each sync format
+    void SetSyncFormatterBytes(int64_t bytes) { this->m_syncFormatterBytes.store(bytes, std::memory_order_relaxed); }
+
+    int64_t GetFormatterBytes() const { return this->m_formatterBytes.load(std::memory_order_relaxed) + this->m_syncFormatterBytes.load(std::memory_order_relaxed); }
+
+    int64_t GetUsed() const { return this->GetBlockBytes() + this->GetFormatterBytes(); }
+
+    bool IsOverBudget() const
+    {
+        return this->m_budget != 0 && this->GetUsed() > this->m_budget;
+    }
+
+    void CountDroppedMessages(int64_t count) { this->m_droppedMessages.fetch_add(count, std::memory_order_relaxed); }
+    int64_t GetDroppedMessages() const { return this->m_droppedMessages.load(std::memory_order_relaxed); }
+
+    void CountDroppedBlock() { this->m_droppedBlocks.fetch_add(1, std::memory_order_relaxed); }
+    int64_t GetDroppedBlocks() const { return this->m_droppedBlocks.load(std::memory_order_relaxed); }
+
+    void CountQueuedBlock(int64_t bytes, int64_t msgCount)
+    {
+        this->m_queuedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        this->m_queuedMessages.fetch_add(msgCount, std::memory_order_relaxed);
+    }
+
+    int64_t GetQueuedBytes() const { return this->m_queuedBytes.load(std::memory_order_relaxed); }
+    int64_t GetQueuedMessages() const { return this->m_queuedMessages.load(std::memory_order_relaxed); }
+
+    void CountHandoffBlock() { this->m_handoffBlocks.fetch_add(1, std::memory_order_relaxed); }
+    int64_t GetHandoffBlocks() const { return this->m_handoffBlocks.load(std::memory_order_relaxed); }
+
+    void CountReclaimedBlocks(int64_t count) { this->m_reclaimedBlocks.fetch_add(count, std::memory_order_relaxed); }
+    int64_t GetReclaimedBlocks() const { return this->m_reclaimedBlocks.load(std::memory_order_relaxed); }
+
+    //With the DropLevels policy each 25% over the budget removes one more level (starting from the least important enabled level)
+    LoggingLevel CapLevel(LoggingLevel level) const
+    {
+        if (this->m_policy != MemoryPolicy::DropLevels || !this->IsOverBudget())
+        {
+            return level;
+        }
+
+        const int64_t steps = 1 + ((this->GetUsed() - this->m_budget) * 4) / this->m_budget;
+        const int64_t index = std::max<int64_t>(1, static_cast<int64_t>(LoggingLevelIndex(level)) - steps);
+
+        return static_cast<LoggingLevel>(static_cast<uint32_t>(level) & ((1u << index) - 1));
+    }
+};
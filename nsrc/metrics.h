@@ -0,0 +1,376 @@
+#pragma once
+
+//Mergeable quantile sketch with log spaced buckets (as in DDSketch) -- any quantile is within METRICS_SKETCH_ACCURACY relative error of the true value.
+//Two sketches with the same accuracy merge by adding the counts of the buckets with the same index.
+class QuantileSketch
+{
+private:
+    double m_gamma;
+    double m_logGamma;
+
+    std::map<int32_t, uint64_t> m_positive;
+    std::map<int32_t, uint64_t> m_negative; //by the index of the magnitude
+    uint64_t m_zeros;
+    uint64_t m_count;
+
+    int32_t GetIndex(double magnitude) const
+    {
+        return static_cast<int32_t>(std::ceil(std::log(magnitude) / this->m_logGamma));
+    }
+
+    double GetBucketValue(int32_t index) const
+    {
+        return 2.0 * std::pow(this->m_gamma, static_cast<double>(index)) / (this->m_gamma + 1.0);
+    }
+
+    //Keep the bucket count bounded by folding the buckets for the smallest magnitudes together (so only the accuracy of the smallest values suffers)
+    void Collapse()
+    {
+        while (this->m_positive.size() + this->m_negative.size() > METRICS_SKETCH_MAX_BUCKETS)
+        {
+            std::map<int32_t, uint64_t>& buckets = (this->m_positive.size() >= this->m_negative.size()) ? this->m_positive : this->m_negative;
+
+            auto first = buckets.begin();
+            const uint64_t count = first->second;
+            buckets.erase(first);
+            buckets.begin()->second += count;
+        }
+    }
+
+public:
+    QuantileSketch() :
+        m_gamma((1.0 + METRICS_SKETCH_ACCURACY) / (1.0 - METRICS_SKETCH_ACCURACY)), m_logGamma(std::log((1.0 + METRICS_SKETCH_ACCURACY) / (1.0 - METRICS_SKETCH_ACCURACY))),
+        m_positive(), m_negative(), m_zeros(0), m_count(0)
+    {
+        ;
+    }
+
+    double GetAccuracy() const { return METRICS_SKETCH_ACCURACY; }
+    uint64_t GetZeroCount() const { return this->m_zeros; }
+    const std::map<int32_t, uint64_t>& GetPositiveBuckets() const { return this->m_positive; }
+    const std::map<int32_t, uint64_t>& GetNegativeBuckets() const { return this->m_negative; }
+
+    void Add(double value)
+    {
+        this->m_count++;
+
+        if (std::abs(value) < METRICS_SKETCH_MIN_VALUE)
+        {
+            this->m_zeros++;
+        }
+        else if (value > 0.0)
+        {
+            this->m_positive[this->GetIndex(value)]++;
+        }
+        else
+        {
+            this->m_negative[this->GetIndex(-value)]++;
+        }
+
+        this->Collapse();
+    }
+
+    //q in [0, 1]
+    double GetQuantile(double q) const
+    {
+        if (this->m_count == 0)
+        {
+            return 0.0;
+        }
+
+        const uint64_t rank = static_cast<uint64_t>(std::max<double>(0.0, std::min<double>(q, 1.0)) * static_cast<double>(this->m_count - 1));
+
+        //the most negative values are the largest magnitudes
+        uint64_t seen = 0;
+        for (auto iter = this->m_negative.crbegin(); iter != this->m_negative.crend(); ++iter)
+        {
+            seen += iter->second;
+            if (seen > rank)
+            {
+                return -this->GetBucketValue(iter->first);
+            }
+        }
+
+        seen += this->m_zeros;
+        if (seen > rank)
+        {
+            return 0.0;
+        }
+
+        for (auto iter = this->m_positive.cbegin(); iter != this->m_positive.cend(); ++iter)
+        {
+            seen += iter->second;
+            if (seen > rank)
+            {
+                return this->GetBucketValue(iter->first);
+            }
+        }
+
+        return this->GetBucketValue(this->m_positive.crbegin()->first);
+    }
+};
+
+//The aggregate for one %n argument of a format
+class ArgMetric
+{
+public:
+    const size_t argIndex;
+    const std::string name;
+
+    uint64_t count;
+    double sum;
+    double min;
+    double max;
+    QuantileSketch sketch;
+
+    ArgMetric(size_t argIndex, std::string&& name) :
+        argIndex(argIndex), name(std::move(name)), count(0), sum(0.0), min(0.0), max(0.0), sketch()
+    {
+        ;
+    }
+
+    void Clear()
+    {
+        this->count = 0;
+        this->sum = 0.0;
+        this->min = 0.0;
+        this->max = 0.0;
+        this->sketch = QuantileSketch();
+    }
+
+    void Add(double value)
+    {
+        if (std::isnan(value))
+        {
+            return;
+        }
+
+        this->min = (this->count == 0) ? value : std::min<double>(this->min, value);
+        this->max = (this->count == 0) ? value : std::max<double>(this->max, value);
+        this->count++;
+        this->sum += value;
+        this->sketch.Add(value);
+    }
+};
+
+//The metric slot for each entry of a format (FORMAT_METRIC_NODATA for literals/host/app which have no logged value and FORMAT_METRIC_UNTRACKED for values we don't aggregate)
+#define FORMAT_METRIC_NODATA -2
+#define FORMAT_METRIC_UNTRACKED -1
+
+class FormatMetrics
+{
+public:
+    const MsgFormat* fmt;
+    std::vector<int32_t> slots;
+    std::vector<ArgMetric> metrics;
+
+    FormatMetrics(const MsgFormat* fmt) :
+        fmt(fmt), slots(), metrics()
+    {
+        size_t argPosition = 0;
+        const std::string* preceding = &fmt->GetInitialFormatStringSegment();
+        const std::vector<FormatEntry>& entries = fmt->GetEntries();
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const FormatEntry& fentry = entries[i];
+            if (fentry.fkind == FormatStringEntryKind::Literal || (fentry.fkind == FormatStringEntryKind::Expando && (fentry.fenum == FormatStringEnum::HOST || fentry.fenum == FormatStringEnum::APP)))
+            {
+                this->slots.push_back(FORMAT_METRIC_NODATA);
+            }
+            else if (fentry.fkind == FormatStringEntryKind::Basic && fentry.fenum == FormatStringEnum::NUMBER)
+            {
+                std::string name = MsgFormat::GetPropertyName(*preceding);
+                if (name.empty())
+                {
+                    name = "arg" + std::to_string(argPosition);
+                }
+
+                this->slots.push_back(static_cast<int32_t>(this->metrics.size()));
+                this->metrics.emplace_back(argPosition, std::move(name));
+            }
+            else
+            {
+                this->slots.push_back(FORMAT_METRIC_UNTRACKED);
+            }
+
+            if (fentry.fkind == FormatStringEntryKind::Basic || fentry.fkind == FormatStringEntryKind::Compound)
+            {
+                argPosition++;
+            }
+
+            preceding = &fentry.ffollow;
+        }
+    }
+};
+
+//Aggregates the %n arguments of the enabled formats straight from the JS blocks as they are processed (so messages that are discarded by level still count).
+//The scan is resumable since a message can be split over blocks and processing can stop at any message. Only used from the JS thread that owns the environment.
+class LogMetrics
+{
+private:
+    const LoggingRegistry* m_registry;
+
+    bool m_allFormats;
+    std::unordered_map<int64_t, std::unique_ptr<FormatMetrics>> m_formats;
+
+    //where we are in the message being scanned
+    FormatMetrics* m_current;
+    size_t m_entryIndex;
+    size_t m_depth;
+
+    FormatMetrics* GetFormatMetrics(int64_t fmtId)
+    {
+        auto iter = this->m_formats.find(fmtId);
+        if (iter != this->m_formats.end())
+        {
+            return iter->second.get();
+        }
+
+        if (!this->m_allFormats)
+        {
+            return nullptr;
+        }
+
+        const MsgFormat* fmt = this->m_registry->TryGetFormat(fmtId);
+        if (fmt == nullptr)
+        {
+            return nullptr;
+        }
+
+        FormatMetrics* fmetrics = new FormatMetrics(fmt);
+        this->m_formats[fmtId] = std::unique_ptr<FormatMetrics>(fmetrics);
+        return fmetrics;
+    }
+
+    //Move to the next format entry that has a logged value
+    void NextValueEntry()
+    {
+        while (this->m_entryIndex < this->m_current->slots.size() && this->m_current->slots[this->m_entryIndex] == FORMAT_METRIC_NODATA)
+        {
+            this->m_entryIndex++;
+        }
+    }
+
+public:
+    LogMetrics(const LoggingRegistry* registry) :
+        m_registry(registry), m_allFormats(false), m_formats(), m_current(nullptr), m_entryIndex(0), m_depth(0)
+    {
+        ;
+    }
+
+    bool IsEnabled() const { return this->m_allFormats || !this->m_formats.empty(); }
+
+    //Aggregate the %n arguments of this format (or of all formats if fmtId is -1) -- returns false if there is no such format
+    bool Enable(int64_t fmtId)
+    {
+        if (fmtId == -1)
+        {
+            this->m_allFormats = true;
+            return true;
+        }
+
+        if (this->m_formats.find(fmtId) != this->m_formats.end())
+        {
+            return true;
+        }
+
+        const MsgFormat* fmt = this->m_registry->TryGetFormat(fmtId);
+        if (fmt == nullptr)
+        {
+            return false;
+        }
+
+        this->m_formats[fmtId] = std::unique_ptr<FormatMetrics>(new FormatMetrics(fmt));
+        return true;
+    }
+
+    //Stop aggregating and drop all the values
+    void Disable()
+    {
+        this->m_allFormats = false;
+        this->m_formats.clear();
+        this->m_current = nullptr;
+    }
+
+    //Drop the values collected so far (the enabled formats stay enabled)
+    void Reset()
+    {
+        for (auto iter = this->m_formats.begin(); iter != this->m_formats.end(); ++iter)
+        {
+            FormatMetrics* fmetrics = iter->second.get();
+            for (size_t i = 0; i < fmetrics->metrics.size(); ++i)
+            {
+                fmetrics->metrics[i].Clear();
+            }
+        }
+    }
+
+    const std::unordered_map<int64_t, std::unique_ptr<FormatMetrics>>& GetFormats() const { return this->m_formats; }
+
+    //Scan the entries in [spos, epos) that were just processed (saved or discarded)
+    void Scan(const uint8_t* tags, const double* data, size_t spos, size_t epos)
+    {
+        size_t cpos = spos;
+        while (cpos < epos)
+        {
+            const LogEntryTag tag = static_cast<LogEntryTag>(tags[cpos]);
+            if (tag == LogEntryTag::MsgFormat)
+            {
+                this->m_current = this->GetFormatMetrics(static_cast<int64_t>(data[cpos]));
+                if (this->m_current != nullptr && this->m_current->metrics.empty())
+                {
+                    this->m_current = nullptr;
+                }
+
+                this->m_entryIndex = 0;
+                this->m_depth = 0;
+                if (this->m_current != nullptr)
+                {
+                    this->NextValueEntry();
+                }
+                cpos++;
+                continue;
+            }
+
+            if (this->m_current == nullptr)
+            {
+                //not a message we aggregate so jump to its end
+                const void* end = std::memchr(tags + cpos, static_cast<int>(LogEntryTag::MsgEndSentinal), epos - cpos);
+                cpos = (end != nullptr) ? static_cast<size_t>(static_cast<const uint8_t*>(end) - tags) + 1 : epos;
+                continue;
+            }
+
+            if (tag == LogEntryTag::MsgEndSentinal)
+            {
+                this->m_current = nullptr;
+            }
+            else if (tag == LogEntryTag::MsgLevel || tag == LogEntryTag::MsgCategory || tag == LogEntryTag::MsgWallTime || tag == LogEntryTag::MSGLogger || tag == LogEntryTag::MSGChildInfo || tag == LogEntryTag::MsgLoggerId)
+            {
+                ;
+            }
+            else if (this->m_depth != 0 || IsStructuredStartTag(tag))
+            {
+                //a compound value takes up one format entry however big it is (and it can continue in the next block)
+                if (SkipValueEntries(tags, cpos, epos, this->m_depth))
+                {
+                    this->m_entryIndex++;
+                    this->NextValueEntry();
+                }
+                continue;
+            }
+            else if (this->m_entryIndex < this->m_current->slots.size())
+            {
+                const int32_t slot = this->m_current->slots[this->m_entryIndex];
+                if (slot >= 0 && tag == LogEntryTag::JsVarValue_Number)
+                {
+                    this->m_current->metrics[static_cast<size_t>(slot)].Add(data[cpos]);
+                }
+
+                this->m_entryIndex++;
+                this->NextValueEntry();
+            }
+
+            cpos++;
+        }
+    }
+};
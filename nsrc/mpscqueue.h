@@ -0,0 +1,82 @@
+#pragma once
+
+//A multi-producer single-consumer queue (Vyukov style) -- producers never take a lock and the (single) consumer never blocks them
+template <typename T>
+class MPSCQueue
+{
+private:
+    struct Node
+    {
+        std::atomic<Node*> next;
+        T value;
+
+        Node() : next(nullptr), value() { ; }
+        Node(T&& v) : next(nullptr), value(std::forward<T>(v)) { ; }
+    };
+
+    //producers swing the head to their new node -- the consumer owns the tail (which is always a stub node)
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+
+public:
+    MPSCQueue() :
+        m_head(nullptr), m_tail(new Node())
+    {
+        this->m_head.store(this->m_tail);
+    }
+
+    ~MPSCQueue()
+    {
+        T discard;
+        while (this->Pop(discard))
+        {
+            ;
+        }
+
+        delete this->m_tail;
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    //Safe to call concurrently from any number of threads
+    void Push(T&& value)
+    {
+        Node* node = new Node(std::forward<T>(value));
+
+        Node* prev = this->m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    //Only the consumer thread may call this -- a push that is in progress is not visible until it links in
+    bool Pop(T& value)
+    {
+        Node* tail = this->m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+
+        value = std::move(next->value);
+        this->m_tail = next;
+        delete tail;
+
+        return true;
+    }
+
+    //Only for crash handling -- walk the queued values without removing them (no locks or allocation but racy if the consumer is popping)
+    template <typename TVisitor>
+    void VisitUnsafe(TVisitor visitor) const
+    {
+        for (const Node* node = this->m_tail->next.load(std::memory_order_acquire); node != nullptr; node = node->next.load(std::memory_order_acquire))
+        {
+            visitor(node->value);
+        }
+    }
+
+    bool IsEmpty() const
+    {
+        return this->m_tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+};
@@ -1,51 +1,83 @@
 
 #include "common.h"
 
+#include "mpscqueue.h"
+#include "output.h"
+#include "tracer.h"
+#include "registry.h"
+#include "prefixcache.h"
+#include "memorybudget.h"
+#include "flushscheduler.h"
 #include "environment.h"
 #include "format.h"
 #include "formatter.h"
+#include "signalsafewriter.h"
 #include "processingblock.h"
+#include "query.h"
+#include "metrics.h"
+#include "flightrecorder.h"
 #include "formatworker.h"
-
-static LoggingEnvironment s_environment(LoggingLevel::LLOFF, "[undefined]", "[undefined]");
+#include "crashflush.h"
+#include "formatcatalog.h"
+#include "backgroundwriter.h"
+#include "aggregator.h"
+#include "columnar.h"
+#include "logmerge.h"
+#include "sinks.h"
+
+//Formats and categories are shared by all threads but each JS thread (main or worker_thread) gets its own environment
+static LoggingRegistry s_registry;
+static thread_local LoggingEnvironment s_environment(&s_registry, LoggingLevel::LLOFF, "[undefined]", "[undefined]");
+static thread_local LogMetrics s_metrics(&s_registry);
+static thread_local FlightRecorder s_flightRecorder;
+
+//Used by formatMsgsSync so its buffer is reused across calls (and, with output buffers, replaced from the pool when JS takes it)
+static thread_local Formatter s_syncFormatter;
+
+static LogAggregator s_aggregator(&s_registry);
+static ColumnarWriter s_columnar(&s_registry);
+static SinkFanout s_sinks(&s_registry);
+static CrashFlush s_crashFlush;
 
 Napi::Value RegisterFormat(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() != 6)
+    if (info.Length() != 7)
     {
-        Napi::TypeError::New(env, "Wrong argument count (expected 6)").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Wrong argument count (expected 7)").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    if (!info[0].IsNumber() || !info[1].IsTypedArray() || !info[2].IsTypedArray() || !info[3].IsString() || !info[4].IsArray() || !info[5].IsString())
+    if (!info[0].IsString() || !info[1].IsTypedArray() || !info[2].IsTypedArray() || !info[3].IsTypedArray() || !info[4].IsString() || !info[5].IsArray() || !info[6].IsString())
     {
         Napi::TypeError::New(env, "Wrong argument types").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    //fmtId, kindArray, enumArray, initialFormatSegment, tailingFormatSegmentArray, fmtString
-    int64_t fmtId = info[0].As<Napi::Number>().Int64Value();
-    Napi::String initialFormatSegment = info[3].As<Napi::String>();
-    Napi::String fmtString = info[5].As<Napi::String>();
+    //fmtName, kindArray, enumArray, expandArray, initialFormatSegment, tailingFormatSegmentArray, fmtString
+    std::string fmtName = info[0].As<Napi::String>().Utf8Value();
+    Napi::String initialFormatSegment = info[4].As<Napi::String>();
+    Napi::String fmtString = info[6].As<Napi::String>();
 
     Napi::Uint8Array kindArray = info[1].As<Napi::Uint8Array>();
     Napi::Uint8Array enumArray = info[2].As<Napi::Uint8Array>();
-    Napi::Array tailingFormatSegmentArray = info[4].As<Napi::Array>();
+    Napi::Int32Array expandArray = info[3].As<Napi::Int32Array>();
+    Napi::Array tailingFormatSegmentArray = info[5].As<Napi::Array>();
 
     size_t expectedLength = tailingFormatSegmentArray.Length();
-    if (enumArray.ElementLength() != expectedLength || kindArray.ElementLength() != expectedLength)
+    if (enumArray.ElementLength() != expectedLength || kindArray.ElementLength() != expectedLength || expandArray.ElementLength() != 2 * expectedLength)
     {
         Napi::TypeError::New(env, "Error in format entry lengths").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    std::shared_ptr<MsgFormat> msgf = std::make_shared<MsgFormat>(fmtId, expectedLength, initialFormatSegment.Utf8Value(), fmtString.Utf8Value());
-
     const uint8_t* kindArrayData = kindArray.Data();
     const uint8_t* enumArrayData = enumArray.Data();
+    const int32_t* expandArrayData = expandArray.Data();
 
+    std::vector<std::string> tailingSegments;
+    tailingSegments.reserve(expectedLength);
     for (size_t i = 0; i < expectedLength; ++i)
     {
         Napi::Value argv = tailingFormatSegmentArray[i];
@@ -55,28 +87,154 @@ Napi::Value RegisterFormat(const Napi::CallbackInfo& info)
             return env.Undefined();
         }
 
-        FormatStringEntryKind fkind = static_cast<FormatStringEntryKind>(kindArrayData[i]);
-        FormatStringEnum fenum = static_cast<FormatStringEnum>(enumArrayData[i]);
-        Napi::String tailingSegment = argv.As<Napi::String>();
+        tailingSegments.push_back(argv.As<Napi::String>().Utf8Value());
+    }
+
+    std::string fmtStringValue = fmtString.Utf8Value();
+    std::string memoKey = fmtName + fmtStringValue;
+
+    //The id is assigned by the shared registry so it is the same for every thread that registers this format
+    int64_t fmtId = s_registry.AddFormat(memoKey, [&](int64_t newId) {
+        std::shared_ptr<MsgFormat> msgf = std::make_shared<MsgFormat>(newId, std::move(fmtName), expectedLength, initialFormatSegment.Utf8Value(), std::move(fmtStringValue));
+
+        for (size_t i = 0; i < expectedLength; ++i)
+        {
+            FormatStringEntryKind fkind = static_cast<FormatStringEntryKind>(kindArrayData[i]);
+            FormatStringEnum fenum = static_cast<FormatStringEnum>(enumArrayData[i]);
+
+            msgf->AddFormat(FormatEntry(fkind, fenum, expandArrayData[2 * i], expandArrayData[2 * i + 1], std::move(tailingSegments[i])));
+        }
+
+        return msgf;
+    });
+
+    return Napi::Number::New(env, static_cast<double>(fmtId));
+}
+
+Napi::Value SaveFormatCatalog(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    return Napi::Boolean::New(env, WriteFormatCatalog(path, &s_registry));
+}
 
-        msgf->AddFormat(FormatEntry(fkind, fenum, tailingSegment.Utf8Value()));
+Napi::Value LoadFormatCatalog(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
 
-    s_environment.AddFormat(fmtId, msgf);
+    std::string path = info[0].As<Napi::String>().Utf8Value();
 
-    return env.Undefined();
+    std::vector<int64_t> fmtIds;
+    try
+    {
+        fmtIds = ReadFormatCatalog(path, &s_registry);
+    }
+    catch (const std::exception& ex)
+    {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    //hand back what JS needs to build its format objects -- the names + format strings and a flat layout of [id, entry count, (kind, enum, depth, length)*]
+    size_t layoutLength = 0;
+    for (size_t i = 0; i < fmtIds.size(); ++i)
+    {
+        layoutLength += 2 + 4 * s_registry.GetFormat(fmtIds[i])->GetEntries().size();
+    }
+
+    Napi::Array names = Napi::Array::New(env, fmtIds.size());
+    Napi::Array formatStrings = Napi::Array::New(env, fmtIds.size());
+    Napi::Int32Array layout = Napi::Int32Array::New(env, layoutLength);
+
+    size_t lpos = 0;
+    for (size_t i = 0; i < fmtIds.size(); ++i)
+    {
+        const std::shared_ptr<MsgFormat>& fmt = s_registry.GetFormat(fmtIds[i]);
+        names.Set(static_cast<uint32_t>(i), Napi::String::New(env, fmt->GetFormatName()));
+        formatStrings.Set(static_cast<uint32_t>(i), Napi::String::New(env, fmt->GetOriginalFormatString()));
+
+        const std::vector<FormatEntry>& entries = fmt->GetEntries();
+        layout[lpos++] = static_cast<int32_t>(fmtIds[i]);
+        layout[lpos++] = static_cast<int32_t>(entries.size());
+        for (size_t j = 0; j < entries.size(); ++j)
+        {
+            layout[lpos++] = static_cast<int32_t>(entries[j].fkind);
+            layout[lpos++] = static_cast<int32_t>(entries[j].fenum);
+            layout[lpos++] = entries[j].fdepth;
+            layout[lpos++] = entries[j].flength;
+        }
+    }
+
+    Napi::Object catalog = Napi::Object::New(env);
+    catalog.Set("names", names);
+    catalog.Set("formatStrings", formatStrings);
+    catalog.Set("layout", layout);
+
+    return catalog;
 }
 
 Napi::Value AddCategory(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
-    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsString() || info[0].As<Napi::Number>().Int64Value() < 0)
+    if (info.Length() != 1 || !info[0].IsString())
     {
         return env.Undefined();
     }
 
-    s_environment.AddCategory(info[0].As<Napi::Number>().Int64Value(), info[1].As<Napi::String>().Utf8Value());
-    return env.Undefined();
+    int64_t categoryId = s_registry.AddCategory(info[0].As<Napi::String>().Utf8Value());
+    return Napi::Number::New(env, static_cast<double>(categoryId));
+}
+
+Napi::Value RegisterShape(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsArray())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Array keyArray = info[0].As<Napi::Array>();
+
+    //the key has the length of each name so different splits of the same characters never collide
+    std::vector<std::string> keys;
+    std::string memoKey;
+    for (uint32_t i = 0; i < keyArray.Length(); ++i)
+    {
+        keys.push_back(keyArray.Get(i).As<Napi::String>().Utf8Value());
+
+        memoKey.append(std::to_string(keys.back().size()));
+        memoKey.push_back(':');
+        memoKey.append(keys.back());
+    }
+
+    int64_t shapeId = s_registry.AddShape(memoKey, [&](int64_t newId) {
+        Formatter escaper;
+        std::vector<std::string> keyFragments;
+        keyFragments.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            escaper.reset();
+            escaper.emitJsString(keys[i]);
+            escaper.emitLiteralString(": ");
+            keyFragments.emplace_back(escaper.getOutputBuffer(), escaper.getOutputBufferSize());
+        }
+
+        return std::make_shared<ObjectShape>(newId, std::move(keyFragments));
+    });
+
+    return Napi::Number::New(env, static_cast<double>(shapeId));
 }
 
 Napi::Value GetEmitLevel(const Napi::CallbackInfo& info)
@@ -96,6 +254,32 @@ Napi::Value SetEmitLevel(const Napi::CallbackInfo& info)
     return env.Undefined();
 }
 
+//Set the levels a category (by id) can be emitted at -- applied to the messages that are already buffered too
+Napi::Value SetCategoryLevel(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber() || info[0].As<Napi::Number>().Int64Value() < 0 || info[1].As<Napi::Number>().Int32Value() < 0)
+    {
+        return env.Undefined();
+    }
+
+    s_environment.SetCategoryLevel(static_cast<size_t>(info[0].As<Napi::Number>().Int64Value()), static_cast<LoggingLevel>(info[1].As<Napi::Number>().Int32Value()));
+    return env.Undefined();
+}
+
+//Set the levels a (sub)logger (by id) can be emitted at -- applied to the messages that are already buffered too
+Napi::Value SetLoggerLevel(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber() || info[0].As<Napi::Number>().Int64Value() < 0 || info[1].As<Napi::Number>().Int32Value() < 0)
+    {
+        return env.Undefined();
+    }
+
+    s_environment.SetLoggerLevel(static_cast<size_t>(info[0].As<Napi::Number>().Int64Value()), static_cast<LoggingLevel>(info[1].As<Napi::Number>().Int32Value()));
+    return env.Undefined();
+}
+
 Napi::Value GetMsgTimeLimit(const Napi::CallbackInfo& info)
 {
     return Napi::Number::New(info.Env(), static_cast<double>(s_environment.GetMsgTimeLimit()));
@@ -130,84 +314,101 @@ Napi::Value SetMsgSlotLimit(const Napi::CallbackInfo& info)
     return env.Undefined();
 }
 
-Napi::Value ProcessMsgsReserveBlock(const Napi::CallbackInfo& info)
+//What processing does with a message that starts at cpos
+enum class MsgDisposition : uint8_t
 {
-    Napi::Env env = info.Env();
-    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber())
-    {
-        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
-        return env.Undefined();
-    }
-
-    const int32_t spos = info[0].As<Napi::Number>().Int32Value();
-    const int32_t epos = info[1].As<Napi::Number>().Int32Value();
-    size_t sizehint = std::max((epos - spos) + 16, INIT_LOG_BLOCK_SIZE);
-    s_environment.AddProcessingBlock(std::make_shared<LogProcessingBlock>(sizehint));
-
-    return env.Undefined();
-}
+    Wait = 0x1, //not old enough (and we are under the slot limit) so stop processing here
+    Discard = 0x2,
+    Save = 0x3
+};
 
-Napi::Value ProcessMsgs(const Napi::CallbackInfo& info)
+//The keep/drop decision for the message starting at cpos (used by ProcessMsgSegment and by IsWholeBlockSaved so a handed off block is exactly what the copy would save) -- msgMask is set to the level mask of the message
+static MsgDisposition GetMsgDisposition(LoggingEnvironment* lenv, size_t cpos, size_t epos, const uint8_t* tags, const double* data, int64_t msgCount, std::time_t now, bool forceall, bool fulldetail, LoggingLevel& msgMask)
 {
-    Napi::Env env = info.Env();
-    if (info.Length() != 5 || !info[0].IsObject() || !info[1].IsNumber() || !info[2].IsNumber() || !info[3].IsBoolean() || !info[4].IsBoolean())
-    {
-        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
-        return env.Undefined();
-    }
-
-    int32_t msgCount = info[1].As<Napi::Number>().Int32Value();
-    std::time_t now = info[2].As<Napi::Number>().Int64Value();
-    bool forceall = info[3].As<Napi::Boolean>().Value();
-    bool fulldetail = info[4].As<Napi::Boolean>().Value();
-
-    Napi::Object inmemblock = info[0].As<Napi::Object>();
-    const size_t epos = inmemblock.Get("epos").As<Napi::Number>().Int64Value(); 
-    size_t cpos = inmemblock.Get("spos").As<Napi::Number>().Int64Value();
-
-    Napi::Uint8Array tagArray = inmemblock.Get("tags").As<Napi::Uint8Array>();
-    Napi::Float64Array dataArray = inmemblock.Get("data").As<Napi::Float64Array>();
-    if (tagArray.ElementLength() < epos || dataArray.ElementLength() < epos || epos < cpos)
+    //check time and # of slots in use (only at the start of a message -- a message split over blocks is always finished)
+    if (!forceall && !(LogProcessingBlock::MsgTimeExpired(cpos, data, lenv, now) || LogProcessingBlock::MsgOverSizeLimit(msgCount, lenv)))
     {
-        Napi::TypeError::New(env, "Bad lengths for block segment").ThrowAsJavaScriptException();
-        return env.Undefined();
+        return MsgDisposition::Wait;
     }
 
-    const uint8_t* tags = tagArray.Data();
-    const double* data = dataArray.Data();
-
-    const Napi::Array stringData = inmemblock.Get("stringData").As<Napi::Array>();
-
-    if (cpos == epos)
+    msgMask = LogProcessingBlock::GetMsgLevelMask(cpos, epos, tags, data, lenv);
+    const LoggingLevel msgLevel = static_cast<LoggingLevel>(static_cast<uint32_t>(lenv->GetEffectiveLoggingLevel()) & static_cast<uint32_t>(msgMask));
+    if (LogProcessingBlock::IsPriorityWritten(cpos, data) || (!fulldetail && LogProcessingBlock::ShouldDiscard(cpos, data, msgLevel)))
     {
-        return Napi::Boolean::New(env, true);
+        return MsgDisposition::Discard;
     }
 
-    std::shared_ptr<LogProcessingBlock> into = s_environment.GetActiveProcessingBlock();
+    return MsgDisposition::Save;
+}
 
-    LoggingEnvironment* lenv = &s_environment;
+//Move the messages in tags/data from cpos (up to epos) into the active processing block (or drop them) -- returns false if we stopped because the time/slot limits were not hit
+static bool ProcessMsgSegment(LoggingEnvironment* lenv, LogProcessingBlock* into, size_t& cpos, size_t epos, const uint8_t* tags, const double* data, const Napi::Array& stringData, int64_t& msgCount, std::time_t now, bool forceall, bool fulldetail)
+{
     while (cpos < epos)
     {
-        //check time and # of slots in use
-        if (!forceall && !(LogProcessingBlock::MsgTimeExpired(cpos, data, lenv, now) || LogProcessingBlock::MsgOverSizeLimit(msgCount, lenv)))
+        //the rest of a message split over blocks keeps the disposition it started with
+        const bool msgstart = lenv->GetProcessingMode() == 'n';
+        LoggingLevel msgMask = LoggingLevel::LLALL;
+        const MsgDisposition disposition = msgstart ? GetMsgDisposition(lenv, cpos, epos, tags, data, msgCount, now, forceall, fulldetail, msgMask) : (lenv->GetProcessingMode() == 'd' ? MsgDisposition::Discard : MsgDisposition::Save);
+        if (disposition == MsgDisposition::Wait)
         {
-            inmemblock.Set("spos", Napi::Number::New(env, static_cast<double>(cpos)));
-            return Napi::Boolean::New(env, true);
+            return false;
         }
 
         size_t oldcpos = cpos;
         bool msgcomplete = true;
-        if ((lenv->GetProcessingMode() == 'n' && !fulldetail && LogProcessingBlock::ShouldDiscard(cpos, data, lenv)) || lenv->GetProcessingMode() == 'd')
+        if (disposition == MsgDisposition::Discard)
         {
+            if (msgstart && LogProcessingBlock::IsPressureDiscard(cpos, data, lenv, msgMask))
+            {
+                lenv->GetMemoryBudget().CountDroppedMessages(1);
+            }
+
+            if (msgstart && s_flightRecorder.IsEnabled())
+            {
+                if (LogProcessingBlock::IsPriorityWritten(cpos, data))
+                {
+                    //already written on the priority path so the context we have goes out after it
+                    if (s_flightRecorder.GetMessageCount() != 0)
+                    {
+                        s_flightRecorder.Dump(into, data[cpos + 3]);
+                    }
+                }
+                else if (LogProcessingBlock::IsLevelMasked(cpos, data, msgMask))
+                {
+                    //the category or logger is turned off for this level so it is never wanted (even as context)
+                    ;
+                }
+                else
+                {
+                    s_flightRecorder.BeginMessage(cpos, data);
+                }
+            }
+
             lenv->SetProcessingMode('d');
             msgcomplete = LogProcessingBlock::ProcessDiscardEntry(cpos, epos, tags);
+
+            if (s_flightRecorder.IsRecording())
+            {
+                s_flightRecorder.RecordEntries(oldcpos, cpos, tags, data, stringData, msgcomplete);
+            }
         }
         else
         {
+            if (msgstart && s_flightRecorder.ShouldDump(static_cast<LoggingLevel>(static_cast<uint32_t>(data[cpos + 1]))))
+            {
+                s_flightRecorder.Dump(into, data[cpos + 3]);
+            }
+
             lenv->SetProcessingMode('s');
             msgcomplete = into->ProcessSaveEntry(cpos, epos, tags, data, stringData);
         }
-        msgCount -= static_cast<int32_t>(cpos - oldcpos);
+        msgCount -= static_cast<int64_t>(cpos - oldcpos);
+
+        if (s_metrics.IsEnabled())
+        {
+            s_metrics.Scan(tags, data, oldcpos, cpos);
+        }
 
         if (msgcomplete)
         {
@@ -215,111 +416,1243 @@ Napi::Value ProcessMsgs(const Napi::CallbackInfo& info)
         }
     }
 
-    inmemblock.Set("spos", Napi::Number::New(env, static_cast<double>(cpos)));
-    return Napi::Boolean::New(env, false);
+    return true;
 }
 
-Napi::Value ProcessMsgsComplete(const Napi::CallbackInfo& info)
+//True if ProcessMsgSegment would save every message in [cpos, epos) so the block can be handed off as is -- msgCount is as in ProcessMsgSegment and blockMsgs is set to the # of messages
+static bool IsWholeBlockSaved(LoggingEnvironment* lenv, size_t cpos, size_t epos, const uint8_t* tags, const double* data, int64_t msgCount, std::time_t now, bool forceall, bool fulldetail, int64_t& blockMsgs)
 {
-    Napi::Env env = info.Env();
+    //it has to start and end on a message boundary and saving a message could dump the flight recorder ahead of it
+    if (lenv->GetProcessingMode() != 'n' || cpos == epos || tags[epos - 1] != static_cast<uint8_t>(LogEntryTag::MsgEndSentinal) || s_flightRecorder.GetMessageCount() != 0)
+    {
+        return false;
+    }
 
-    std::shared_ptr<LogProcessingBlock> into = s_environment.GetActiveProcessingBlock();
-    if (into->IsEmptyBlock())
+    blockMsgs = 0;
+    while (cpos < epos)
     {
-        s_environment.DiscardProcesingBlock(into);
+        LoggingLevel msgMask = LoggingLevel::LLALL;
+        if (GetMsgDisposition(lenv, cpos, epos, tags, data, msgCount, now, forceall, fulldetail, msgMask) != MsgDisposition::Save)
+        {
+            return false;
+        }
+
+        const void* end = std::memchr(tags + cpos, static_cast<int>(LogEntryTag::MsgEndSentinal), epos - cpos);
+        const size_t next = static_cast<size_t>(static_cast<const uint8_t*>(end) - tags) + 1;
+
+        msgCount -= static_cast<int64_t>(next - cpos);
+        cpos = next;
+        blockMsgs++;
     }
 
-    return env.Undefined();
+    return true;
 }
 
-Napi::Value AbortAsyncWork(const Napi::CallbackInfo& info)
+//Give the JS blocks that were handed off (and that we are done reading) back to JS so it can reuse them -- undefined if there are none
+static Napi::Value ReclaimHandoffBlocks(Napi::Env env, LoggingEnvironment* lenv)
+{
+    JsBlockReleaseQueue& queue = *lenv->GetReleaseQueue();
+
+    napi_ref ref = nullptr;
+    if (!queue.Pop(ref))
+    {
+        return env.Undefined();
+    }
+
+    Napi::Array blocks = Napi::Array::New(env);
+    uint32_t count = 0;
+    do
+    {
+        napi_value value = nullptr;
+        if (napi_get_reference_value(env, ref, &value) == napi_ok && value != nullptr)
+        {
+            blocks.Set(count++, Napi::Value(env, value));
+        }
+        napi_delete_reference(env, ref);
+    } while (queue.Pop(ref));
+
+    lenv->GetMemoryBudget().CountReclaimedBlocks(count);
+    return blocks;
+}
+
+//Process the whole chain of in memory blocks (following next from the head) in one call -- the only block property we write is reported through the control record.
+//We still read a few properties per block (next/spos/epos to find the chain and tags/data/stringData for each block we process) so the cost grows with the # of blocks
+//but there is no JS to native transition or property write per block.
+Napi::Value ProcessMsgChain(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsObject() || !info[1].IsTypedArray() || info[1].As<Napi::TypedArray>().TypedArrayType() != napi_float64_array || info[1].As<Napi::Float64Array>().ElementLength() < PROCESS_CONTROL_SIZE)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    double* control = info[1].As<Napi::Float64Array>().Data();
+    const std::time_t now = static_cast<std::time_t>(control[PROCESS_CONTROL_NOW]);
+    const bool forceall = control[PROCESS_CONTROL_FORCEALL] != 0.0;
+    const bool fulldetail = control[PROCESS_CONTROL_FULLDETAIL] != 0.0;
+
+    LoggingEnvironment* lenv = &s_environment;
 
-    if (s_environment.GetAsyncFormatWorker() != nullptr)
+    //one pass to find the blocks and the total # of slots in use
+    std::vector<std::pair<Napi::Object, std::pair<size_t, size_t>>> chain;
+    int64_t msgCount = 0;
+    for (Napi::Value cval = info[0]; cval.IsObject(); cval = cval.As<Napi::Object>().Get("next"))
     {
-        s_environment.AddBlockFromFormatterAbort(s_environment.GetAsyncFormatWorker()->GetProcessingBlock());
-        try
+        Napi::Object cblock = cval.As<Napi::Object>();
+        const size_t spos = static_cast<size_t>(cblock.Get("spos").As<Napi::Number>().Int64Value());
+        const size_t epos = static_cast<size_t>(cblock.Get("epos").As<Napi::Number>().Int64Value());
+        if (epos < spos)
         {
-            s_environment.GetAsyncFormatWorker()->Cancel();
+            Napi::TypeError::New(env, "Bad lengths for block segment").ThrowAsJavaScriptException();
+            return env.Undefined();
         }
-        catch (...)
+
+        chain.push_back(std::make_pair(cblock, std::make_pair(spos, epos)));
+        msgCount += static_cast<int64_t>(epos - spos);
+    }
+
+    control[PROCESS_CONTROL_CONSUMED_BLOCKS] = 0.0;
+    control[PROCESS_CONTROL_HEAD_SPOS] = static_cast<double>(chain[0].second.first);
+    control[PROCESS_CONTROL_EFFECTIVE_LEVEL] = static_cast<double>(static_cast<uint32_t>(lenv->GetEffectiveLoggingLevel()));
+
+    FlushScheduler& scheduler = lenv->GetFlushScheduler();
+    const int64_t pendingSlots = msgCount;
+
+    if (msgCount == 0)
+    {
+        scheduler.ObserveProcess(static_cast<int64_t>(now), 0, 0, 0);
+
+        control[PROCESS_CONTROL_MEMORY_PRESSURE] = 0.0;
+        control[PROCESS_CONTROL_FLUSH_DELAY] = static_cast<double>(scheduler.GetFlushDelay());
+        control[PROCESS_CONTROL_RETRY_DELAY] = static_cast<double>(scheduler.GetRetryDelay());
+        return ReclaimHandoffBlocks(env, lenv);
+    }
+
+    TraceSpan chainSpan("processMsgChain");
+
+    const size_t sizehint = std::max<size_t>((chain[0].second.second - chain[0].second.first) + 16, INIT_LOG_BLOCK_SIZE);
+    lenv->AddProcessingBlock(std::make_shared<LogProcessingBlock>(sizehint));
+    std::shared_ptr<LogProcessingBlock> into = lenv->GetActiveProcessingBlock();
+
+    int64_t savedMsgs = 0;
+    size_t consumed = 0;
+    size_t cpos = chain[0].second.first;
+    while (consumed < chain.size())
+    {
+        const Napi::Object& cblock = chain[consumed].first;
+        const size_t epos = chain[consumed].second.second;
+        cpos = chain[consumed].second.first;
+
+        if (cpos != epos)
         {
-            ;
+            TraceSpan blockSpan("processBlock");
+            blockSpan.SetArgs("slots", static_cast<double>(epos - cpos));
+
+            Napi::Uint8Array tagArray = cblock.Get("tags").As<Napi::Uint8Array>();
+            Napi::Float64Array dataArray = cblock.Get("data").As<Napi::Float64Array>();
+            if (tagArray.ElementLength() < epos || dataArray.ElementLength() < epos)
+            {
+                Napi::TypeError::New(env, "Bad lengths for block segment").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+
+            const Napi::Array stringData = cblock.Get("stringData").As<Napi::Array>();
+
+            //a JS block that is mostly full and completely saved is read in place rather than copied (JS never writes to a processed block again)
+            int64_t blockMsgs = 0;
+            napi_ref blockRef = nullptr;
+            if (lenv->GetBlockHandoff() && (epos - cpos) * 2 >= tagArray.ElementLength() && IsWholeBlockSaved(lenv, cpos, epos, tagArray.Data(), dataArray.Data(), msgCount, now, forceall, fulldetail, blockMsgs) && napi_create_reference(env, cblock, 1, &blockRef) == napi_ok)
+            {
+                //queue what we have saved so far first so the messages stay in order
+                savedMsgs += into->GetMessageCount();
+                lenv->CompleteActiveProcessingBlock(into->IsEmptyBlock(), into->GetMemoryFootprint(), into->GetMessageCount());
+
+                const size_t blockBytes = tagArray.ByteLength() + dataArray.ByteLength();
+                std::shared_ptr<LogProcessingBlock> handoff = std::make_shared<LogProcessingBlock>(tagArray.Data(), dataArray.Data(), cpos, epos, blockBytes, blockMsgs, blockRef, lenv->GetReleaseQueue());
+                handoff->AddJsBlockStrings(stringData);
+
+                savedMsgs += blockMsgs;
+                lenv->GetMemoryBudget().CountHandoffBlock();
+                const int64_t handoffBytes = handoff->GetMemoryFootprint();
+                lenv->AddPendingBlock(std::move(handoff), handoffBytes, blockMsgs);
+
+                if (s_metrics.IsEnabled())
+                {
+                    s_metrics.Scan(tagArray.Data(), dataArray.Data(), cpos, epos);
+                }
+
+                msgCount -= static_cast<int64_t>(epos - cpos);
+                cpos = epos;
+
+                lenv->AddProcessingBlock(std::make_shared<LogProcessingBlock>(sizehint));
+                into = lenv->GetActiveProcessingBlock();
+
+                consumed++;
+                continue;
+            }
+
+            if (!ProcessMsgSegment(lenv, into.get(), cpos, epos, tagArray.Data(), dataArray.Data(), stringData, msgCount, now, forceall, fulldetail))
+            {
+                break;
+            }
         }
-        s_environment.ClearAsyncFormatWorker();
+
+        consumed++;
     }
 
-    return env.Undefined();
+    control[PROCESS_CONTROL_CONSUMED_BLOCKS] = static_cast<double>(consumed);
+    control[PROCESS_CONTROL_HEAD_SPOS] = (consumed < chain.size()) ? static_cast<double>(cpos) : -1.0;
+
+    savedMsgs += into->GetMessageCount();
+    lenv->CompleteActiveProcessingBlock(into->IsEmptyBlock(), into->GetMemoryFootprint(), into->GetMessageCount());
+    chainSpan.SetArgs("blocks", static_cast<double>(consumed), "messages", static_cast<double>(savedMsgs));
+
+    scheduler.ObserveProcess(static_cast<int64_t>(now), pendingSlots, msgCount, savedMsgs);
+
+    MemoryBudget& budget = lenv->GetMemoryBudget();
+    if (budget.IsOverBudget() && budget.GetPolicy() == MemoryPolicy::DropOldest)
+    {
+        lenv->DropOldestPendingBlocks();
+    }
+
+    //let JS know if it needs to do a blocking flush to get back under the memory budget
+    control[PROCESS_CONTROL_MEMORY_PRESSURE] = (budget.IsOverBudget() && budget.GetPolicy() == MemoryPolicy::Flush) ? 1.0 : 0.0;
+    control[PROCESS_CONTROL_EFFECTIVE_LEVEL] = static_cast<double>(static_cast<uint32_t>(lenv->GetEffectiveLoggingLevel()));
+    control[PROCESS_CONTROL_FLUSH_DELAY] = static_cast<double>(scheduler.GetFlushDelay());
+    control[PROCESS_CONTROL_RETRY_DELAY] = static_cast<double>(scheduler.GetRetryDelay());
+
+    return ReclaimHandoffBlocks(env, lenv);
 }
 
-Napi::Value FormatMsgsSync(const Napi::CallbackInfo& info)
+//Process and format a single message (just logged at a priority level) straight from the JS blocks and write it to fd -- optionally with an fsync so it is durable when we return.
+//The level of a written message is replaced with PRIORITY_WRITTEN_LEVEL so the batched processing drops it.
+//Returns null if the message is not enabled for emit (or its header is split over blocks), the output if fd is -1 (so JS writes it), and otherwise if the write succeeded (a failed write leaves the message for the batched path).
+Napi::Value WritePriorityMsg(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
-    if (info.Length() != 1 || !info[0].IsBoolean())
+    if (info.Length() != 5 || !info[0].IsObject() || !info[1].IsNumber() || !info[2].IsNumber() || !info[3].IsBoolean() || !info[4].IsBoolean())
     {
         Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    bool emitstdprefix = info[0].As<Napi::Boolean>().Value();
+    Napi::Object startBlock = info[0].As<Napi::Object>();
+    const size_t spos = static_cast<size_t>(info[1].As<Napi::Number>().Int64Value());
+    const int fd = info[2].As<Napi::Number>().Int32Value();
+    const bool dosync = info[3].As<Napi::Boolean>().Value();
+    const bool emitstdprefix = info[4].As<Napi::Boolean>().Value();
+
+    LoggingEnvironment* lenv = &s_environment;
+
+    Napi::Float64Array startData = startBlock.Get("data").As<Napi::Float64Array>();
+    const size_t startEpos = static_cast<size_t>(startBlock.Get("epos").As<Napi::Number>().Int64Value());
+    if (spos + 4 > startEpos || startData.ElementLength() < startEpos)
+    {
+        return env.Null();
+    }
+
+    Napi::Uint8Array startTags = startBlock.Get("tags").As<Napi::Uint8Array>();
+    if (startTags.ElementLength() < startEpos)
+    {
+        return env.Null();
+    }
+
+    const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(startData[spos + 1]));
+    const LoggingLevel msgMask = LogProcessingBlock::GetMsgLevelMask(spos, startEpos, startTags.Data(), startData.Data(), lenv);
+    if (!LOG_LEVEL_ENABLED(level, static_cast<uint32_t>(lenv->GetEnabledLoggingLevel()) & static_cast<uint32_t>(msgMask)))
+    {
+        return env.Null();
+    }
+
+    //the message is complete (it was just logged) but may continue into the following blocks
+    LogProcessingBlock pblock(INIT_LOG_BLOCK_SIZE);
+    bool complete = false;
+    for (Napi::Value cval = startBlock; !complete && cval.IsObject(); cval = cval.As<Napi::Object>().Get("next"))
+    {
+        Napi::Object cblock = cval.As<Napi::Object>();
+        size_t cpos = (cblock == startBlock) ? spos : static_cast<size_t>(cblock.Get("spos").As<Napi::Number>().Int64Value());
+
+        const size_t epos = static_cast<size_t>(cblock.Get("epos").As<Napi::Number>().Int64Value());
+        Napi::Uint8Array tagArray = cblock.Get("tags").As<Napi::Uint8Array>();
+        Napi::Float64Array dataArray = cblock.Get("data").As<Napi::Float64Array>();
+        if (epos < cpos || tagArray.ElementLength() < epos || dataArray.ElementLength() < epos)
+        {
+            Napi::TypeError::New(env, "Bad lengths for block segment").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+
+        complete = pblock.ProcessSaveEntry(cpos, epos, tagArray.Data(), dataArray.Data(), cblock.Get("stringData").As<Napi::Array>());
+    }
+
+    if (!complete)
+    {
+        return env.Null();
+    }
+
+    TraceSpan span("priorityWrite");
 
     Formatter formatter;
-    std::shared_ptr<LogProcessingBlock> block = s_environment.GetNextFormatBlock();
-    while (block != nullptr)
+    pblock.emitAllFormatEntries(&formatter, lenv, emitstdprefix, lenv->GetPriorityPrefixCache());
+    span.SetArgs("bytes", static_cast<double>(formatter.getOutputBufferSize()));
+
+    if (fd < 0)
     {
-        block->emitAllFormatEntries(&formatter, &s_environment, emitstdprefix);
-        block = s_environment.GetNextFormatBlock();
+        startData[spos + 1] = static_cast<double>(PRIORITY_WRITTEN_LEVEL);
+        return Napi::String::New(env, formatter.getOutputBuffer(), formatter.getOutputBufferSize());
     }
 
-    return Napi::String::New(env, formatter.getOutputBuffer(), formatter.getOutputBufferSize());
+    bool ok = WriteOutputFully(fd, formatter.getOutputBuffer(), formatter.getOutputBufferSize());
+    if (ok && dosync)
+    {
+        ok = SyncOutputFile(fd);
+    }
+
+    if (ok)
+    {
+        startData[spos + 1] = static_cast<double>(PRIORITY_WRITTEN_LEVEL);
+    }
+
+    return Napi::Boolean::New(env, ok);
 }
 
-Napi::Value FormatMsgsAsync(const Napi::CallbackInfo& info)
+Napi::Value AbortAsyncWork(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    //pause the formatter so the remaining blocks can be formatted sync and hand back anything it finished that JS has not seen yet
+    std::string undelivered;
+    if (s_environment.GetFormatThread() != nullptr)
+    {
+        undelivered = s_environment.GetFormatThread()->Pause();
+    }
+
+    return CreateFormattedOutput(env, std::move(undelivered), s_environment.GetOutputBuffers());
+}
+
+//formatMsgsSync(prefix) returns all the output -- formatMsgsSync(prefix, write) streams it to write(chunk) in FORMAT_STREAM_CHUNK_SIZE pieces instead
+Napi::Value FormatMsgsSync(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
-    if (info.Length() != 2 || !info[0].IsFunction() || !info[1].IsBoolean())
+    if ((info.Length() != 1 && info.Length() != 2) || !info[0].IsBoolean() || (info.Length() == 2 && !info[1].IsFunction()))
     {
         Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    Napi::Function callback = info[0].As<Napi::Function>();
-    bool stdPrefix = info[1].As<Napi::Boolean>().Value();
+    bool emitstdprefix = info[0].As<Napi::Boolean>().Value();
+    const bool streaming = (info.Length() == 2);
+    const size_t limit = streaming ? FORMAT_STREAM_CHUNK_SIZE : std::numeric_limits<size_t>::max();
 
-    std::shared_ptr<LogProcessingBlock> block = s_environment.GetNextFormatBlock();
-    if (block == nullptr)
+    FlushScheduler& scheduler = s_environment.GetFlushScheduler();
+    const bool timed = scheduler.IsAdaptive();
+
+    Formatter& formatter = s_syncFormatter;
+    formatter.reset();
+
+    bool resumed = false;
+    std::shared_ptr<LogProcessingBlock> block = s_environment.GetNextFormatBlock(&resumed);
+    while (block != nullptr)
+    {
+        if (!resumed)
+        {
+            block->resetFormatPosition();
+        }
+
+        while (block->hasMoreFormatEntries())
+        {
+            const auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+            int64_t msgCount = 0;
+            {
+                const size_t startSize = formatter.getOutputBufferSize();
+
+                TraceSpan span("formatBlock");
+                msgCount = block->emitFormatEntriesUpTo(&formatter, &s_environment, emitstdprefix, limit);
+                span.SetArgs("messages", static_cast<double>(msgCount), "bytes", static_cast<double>(formatter.getOutputBufferSize() - startSize));
+            }
+
+            if (timed)
+            {
+                scheduler.ObserveFormat(msgCount, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            if (streaming && formatter.getOutputBufferSize() >= limit)
+            {
+                try
+                {
+                    Napi::HandleScope scope(env);
+                    info[1].As<Napi::Function>().Call({ CreateFormattedOutput(env, formatter, s_environment.GetOutputBuffers()) });
+                }
+                catch (const Napi::Error&)
+                {
+                    //the chunk went to write but the rest of this block (and the queued blocks) stay pending for the next call
+                    if (block->hasMoreFormatEntries())
+                    {
+                        const int64_t bytes = block->GetMemoryFootprint();
+                        s_environment.RequeueFormatBlock(std::move(block), bytes);
+                    }
+                    throw;
+                }
+            }
+        }
+
+        block = s_environment.GetNextFormatBlock(&resumed);
+    }
+
+    if (streaming)
     {
-        callback.Call({ env.Undefined(), Napi::String::New(env, "") });
+        if (formatter.getOutputBufferSize() != 0)
+        {
+            Napi::HandleScope scope(env);
+            info[1].As<Napi::Function>().Call({ CreateFormattedOutput(env, formatter, s_environment.GetOutputBuffers()) });
+        }
+        s_environment.GetMemoryBudget().SetSyncFormatterBytes(static_cast<int64_t>(formatter.getBufferCapacity()));
+        return env.Undefined();
     }
-    else
+
+    Napi::Value output = CreateFormattedOutput(env, formatter, s_environment.GetOutputBuffers());
+    s_environment.GetMemoryBudget().SetSyncFormatterBytes(static_cast<int64_t>(formatter.getBufferCapacity()));
+    return output;
+}
+
+Napi::Value SetOutputBuffers(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsBoolean())
     {
-        s_environment.SetAsyncFormatWorker(new FormatWorker(callback, block, &s_environment, stdPrefix));
-        s_environment.GetAsyncFormatWorker()->Queue();
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
 
+    s_environment.SetOutputBuffers(info[0].As<Napi::Boolean>().Value());
     return env.Undefined();
 }
 
-Napi::Value HasWorkPending(const Napi::CallbackInfo& info)
+Napi::Value SetBlockHandoff(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
-    return Napi::Boolean::New(env, s_environment.HasWorkPending());
+    if (info.Length() != 1 || !info[0].IsBoolean())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    s_environment.SetBlockHandoff(info[0].As<Napi::Boolean>().Value());
+    return env.Undefined();
 }
 
-Napi::Value InitializeLogger(const Napi::CallbackInfo& info)
+Napi::Value StartFormatThread(const Napi::CallbackInfo& info)
 {
     Napi::Env env = info.Env();
-    if (info.Length() != 3 || !info[0].IsNumber() || !info[1].IsString() || !info[2].IsString())
+    if (info.Length() != 1 || !info[0].IsFunction())
     {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
-    LoggingLevel level = static_cast<LoggingLevel>(info[0].As<Napi::Number>().Int32Value());
-    std::string host = info[1].As<Napi::String>().Utf8Value();
-    std::string app = info[2].As<Napi::String>().Utf8Value();
-
-    s_environment.InitializeEnvironmentData(level, host, app);
+    //the thread (and its callback) live until the environment is torn down
+    if (s_environment.GetFormatThread() == nullptr)
+    {
+        s_environment.SetFormatThread(new FormatThread(env, info[0].As<Napi::Function>(), &s_environment));
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value FormatMsgsAsync(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsBoolean())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (s_environment.GetFormatThread() == nullptr)
+    {
+        Napi::Error::New(env, "Format thread was not started").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    bool stdPrefix = info[0].As<Napi::Boolean>().Value();
+    s_environment.GetFormatThread()->RequestFormat(stdPrefix);
+
+    return env.Undefined();
+}
+
+Napi::Value StartAggregation(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsString() || !info[1].IsNumber() || info[1].As<Napi::Number>().Int64Value() < 0)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    int64_t window = info[1].As<Napi::Number>().Int64Value();
+
+    int64_t producerId = s_aggregator.Start(path, window, s_environment.GetHostName(), s_environment.GetAppName());
+    s_environment.SetAggregateProducerId(producerId);
+
+    return Napi::Boolean::New(env, producerId != -1);
+}
+
+Napi::Value AggregateMsgs(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsBoolean())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    int64_t producerId = s_environment.GetAggregateProducerId();
+    if (producerId == -1)
+    {
+        Napi::Error::New(env, "Aggregation was not started").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    bool stdPrefix = info[0].As<Napi::Boolean>().Value();
+
+    std::shared_ptr<LogProcessingBlock> block = s_environment.GetNextFormatBlock();
+    while (block != nullptr)
+    {
+        s_aggregator.Submit(producerId, stdPrefix, block);
+        block = s_environment.GetNextFormatBlock();
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value FlushAggregation(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    s_aggregator.Flush();
+    return env.Undefined();
+}
+
+Napi::Value StartColumnar(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsString() || !info[1].IsNumber() || info[1].As<Napi::Number>().Int64Value() <= 0)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string dir = info[0].As<Napi::String>().Utf8Value();
+    size_t segmentRows = static_cast<size_t>(info[1].As<Napi::Number>().Int64Value());
+
+    return Napi::Boolean::New(env, s_columnar.Start(dir, segmentRows, s_environment.GetHostName(), s_environment.GetAppName()));
+}
+
+Napi::Value ColumnarMsgs(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    std::shared_ptr<LogProcessingBlock> block = s_environment.GetNextFormatBlock();
+    while (block != nullptr)
+    {
+        s_columnar.Submit(block);
+        block = s_environment.GetNextFormatBlock();
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value FlushColumnar(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    s_columnar.Flush();
+    return env.Undefined();
+}
+
+Napi::Value GetColumnarStats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("segments", Napi::Number::New(env, static_cast<double>(s_columnar.GetSegmentCount())));
+    stats.Set("rows", Napi::Number::New(env, static_cast<double>(s_columnar.GetRowCount())));
+    stats.Set("failures", Napi::Number::New(env, static_cast<double>(s_columnar.GetFailureCount())));
+
+    return stats;
+}
+
+Napi::Value StartSinks(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsArray() || info[0].As<Napi::Array>().Length() == 0)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::vector<std::unique_ptr<LogSink>> sinks;
+    Napi::Array configs = info[0].As<Napi::Array>();
+    for (uint32_t i = 0; i < configs.Length(); ++i)
+    {
+        Napi::Value cval = configs.Get(i);
+        if (!cval.IsObject())
+        {
+            Napi::TypeError::New(env, "Bad sink").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+
+        Napi::Object config = cval.As<Napi::Object>();
+        Napi::Value output = config.Get("output");
+        Napi::Value mode = config.Get("mode");
+        Napi::Value level = config.Get("level");
+        Napi::Value categories = config.Get("categories");
+        if (!output.IsString() || !mode.IsString() || !level.IsNumber() || !categories.IsArray())
+        {
+            Napi::TypeError::New(env, "Bad sink").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+
+        const std::string outputName = output.As<Napi::String>().Utf8Value();
+        const std::string modeName = mode.As<Napi::String>().Utf8Value();
+
+        std::string path;
+        SinkOutput soutput = SinkOutput::Stdout;
+        if (outputName == "stderr")
+        {
+            soutput = SinkOutput::Stderr;
+        }
+        else if (outputName == "file" || outputName == "socket")
+        {
+            Napi::Value pval = config.Get("path");
+            if (!pval.IsString())
+            {
+                Napi::TypeError::New(env, "Bad sink").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+
+            if (outputName == "file")
+            {
+                soutput = SinkOutput::File;
+            }
+            else
+            {
+                Napi::Value tval = config.Get("socketType");
+                soutput = (tval.IsString() && tval.As<Napi::String>().Utf8Value() == "datagram") ? SinkOutput::Datagram : SinkOutput::Socket;
+            }
+            path = pval.As<Napi::String>().Utf8Value();
+        }
+
+        SinkMode smode = SinkMode::Text;
+        if (modeName == "plain")
+        {
+            smode = SinkMode::Plain;
+        }
+        else if (modeName == "ndjson")
+        {
+            smode = SinkMode::NDJson;
+        }
+
+        std::vector<std::string> categoryNames;
+        Napi::Array carray = categories.As<Napi::Array>();
+        for (uint32_t j = 0; j < carray.Length(); ++j)
+        {
+            categoryNames.push_back(carray.Get(j).ToString().Utf8Value());
+        }
+
+        const LoggingLevel slevel = static_cast<LoggingLevel>(level.As<Napi::Number>().Uint32Value());
+        sinks.push_back(std::unique_ptr<LogSink>(new LogSink(soutput, smode, slevel, std::move(path), std::move(categoryNames))));
+    }
+
+    return Napi::Boolean::New(env, s_sinks.Start(std::move(sinks), s_environment.GetHostName(), s_environment.GetAppName()));
+}
+
+Napi::Value SinkMsgs(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    std::shared_ptr<LogProcessingBlock> block = s_environment.GetNextFormatBlock();
+    while (block != nullptr)
+    {
+        s_sinks.Submit(block);
+        block = s_environment.GetNextFormatBlock();
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value FlushSinks(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    s_sinks.Flush();
+    return env.Undefined();
+}
+
+Napi::Value GetSinkStats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Array res = Napi::Array::New(env);
+    if (!s_sinks.IsStarted())
+    {
+        return res;
+    }
+
+    const char* outputNames[] = { "", "stdout", "stderr", "file", "socket", "socket" };
+    const char* modeNames[] = { "", "text", "plain", "ndjson" };
+
+    const std::vector<std::unique_ptr<LogSink>>& sinks = s_sinks.GetSinks();
+    for (size_t i = 0; i < sinks.size(); ++i)
+    {
+        Napi::Object stats = Napi::Object::New(env);
+        stats.Set("output", Napi::String::New(env, outputNames[static_cast<uint8_t>(sinks[i]->GetOutput())]));
+        stats.Set("path", Napi::String::New(env, sinks[i]->GetPath()));
+        stats.Set("mode", Napi::String::New(env, modeNames[static_cast<uint8_t>(sinks[i]->GetMode())]));
+        stats.Set("level", Napi::Number::New(env, static_cast<double>(sinks[i]->GetLevel())));
+        stats.Set("messages", Napi::Number::New(env, static_cast<double>(sinks[i]->GetMessageCount())));
+        stats.Set("bytes", Napi::Number::New(env, static_cast<double>(sinks[i]->GetByteCount())));
+        stats.Set("failures", Napi::Number::New(env, static_cast<double>(sinks[i]->GetFailureCount())));
+
+        const SinkSocket* socket = sinks[i]->GetSocket();
+        if (socket != nullptr)
+        {
+            stats.Set("socketType", Napi::String::New(env, socket->IsDatagram() ? "datagram" : "stream"));
+            stats.Set("connects", Napi::Number::New(env, static_cast<double>(socket->GetConnects())));
+            stats.Set("pendingBytes", Napi::Number::New(env, static_cast<double>(socket->GetPendingBytes())));
+        }
+
+        res.Set(static_cast<uint32_t>(i), stats);
+    }
+
+    return res;
+}
+
+Napi::Value MergeLogs(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsArray() || !info[1].IsString())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Array inputArray = info[0].As<Napi::Array>();
+    std::vector<std::string> inputs;
+    for (uint32_t i = 0; i < inputArray.Length(); ++i)
+    {
+        Napi::Value input = inputArray.Get(i);
+        if (!input.IsString())
+        {
+            Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        inputs.push_back(input.As<Napi::String>().Utf8Value());
+    }
+
+    std::string output = info[1].As<Napi::String>().Utf8Value();
+
+    MergeStats stats;
+    try
+    {
+        stats = MergeLogFiles(inputs, output);
+    }
+    catch (const std::exception& ex)
+    {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Object res = Napi::Object::New(env);
+    res.Set("lines", Napi::Number::New(env, static_cast<double>(stats.lines)));
+    res.Set("bytes", Napi::Number::New(env, static_cast<double>(stats.bytes)));
+
+    return res;
+}
+
+Napi::Value SetMemoryBudget(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber() || info[0].As<Napi::Number>().Int64Value() < 0)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    int64_t budget = info[0].As<Napi::Number>().Int64Value();
+    MemoryPolicy policy = static_cast<MemoryPolicy>(info[1].As<Napi::Number>().Int32Value());
+
+    s_environment.GetMemoryBudget().SetBudget(budget, policy);
+
+    return env.Undefined();
+}
+
+Napi::Value GetMemoryUsage(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    const MemoryBudget& budget = s_environment.GetMemoryBudget();
+
+    Napi::Object usage = Napi::Object::New(env);
+    usage.Set("budget", Napi::Number::New(env, static_cast<double>(budget.GetBudget())));
+    usage.Set("used", Napi::Number::New(env, static_cast<double>(budget.GetUsed())));
+    usage.Set("blockBytes", Napi::Number::New(env, static_cast<double>(budget.GetBlockBytes())));
+    usage.Set("formatterBytes", Napi::Number::New(env, static_cast<double>(budget.GetFormatterBytes())));
+    usage.Set("pendingBlocks", Napi::Number::New(env, static_cast<double>(s_environment.GetPendingBlockCount())));
+    usage.Set("droppedMessages", Napi::Number::New(env, static_cast<double>(budget.GetDroppedMessages())));
+    usage.Set("droppedBlocks", Napi::Number::New(env, static_cast<double>(budget.GetDroppedBlocks())));
+    usage.Set("queuedBytes", Napi::Number::New(env, static_cast<double>(budget.GetQueuedBytes())));
+    usage.Set("queuedMessages", Napi::Number::New(env, static_cast<double>(budget.GetQueuedMessages())));
+    usage.Set("handoffBlocks", Napi::Number::New(env, static_cast<double>(budget.GetHandoffBlocks())));
+    usage.Set("reclaimedBlocks", Napi::Number::New(env, static_cast<double>(budget.GetReclaimedBlocks())));
+
+    return usage;
+}
+
+Napi::Value SetAdaptiveFlush(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 3 || !info[0].IsBoolean() || !info[1].IsNumber() || !info[2].IsNumber() || info[1].As<Napi::Number>().Int64Value() <= 0 || info[2].As<Napi::Number>().Int64Value() <= 0)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    const bool adaptive = info[0].As<Napi::Boolean>().Value();
+    const int64_t latencyTarget = info[1].As<Napi::Number>().Int64Value();
+    const int64_t memoryTarget = info[2].As<Napi::Number>().Int64Value();
+
+    s_environment.GetFlushScheduler().Configure(adaptive, latencyTarget, memoryTarget, s_environment.GetConfiguredMsgTimeLimit(), static_cast<int64_t>(s_environment.GetConfiguredMsgSlotsLimit()));
+    return env.Undefined();
+}
+
+Napi::Value ReportSinkLatency(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsNumber() || info[0].As<Napi::Number>().DoubleValue() < 0.0)
+    {
+        return env.Undefined();
+    }
+
+    s_environment.GetFlushScheduler().ObserveSink(info[0].As<Napi::Number>().DoubleValue());
+    return env.Undefined();
+}
+
+Napi::Value GetFlushStats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    const FlushScheduler& scheduler = s_environment.GetFlushScheduler();
+
+    const char* limitedBy = "fixed";
+    switch (scheduler.GetReason())
+    {
+    case FlushLimitReason::Latency:
+        limitedBy = "latency";
+        break;
+    case FlushLimitReason::Memory:
+        limitedBy = "memory";
+        break;
+    case FlushLimitReason::Floor:
+        limitedBy = "floor";
+        break;
+    default:
+        break;
+    }
+
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("adaptive", Napi::Boolean::New(env, scheduler.IsAdaptive()));
+    stats.Set("latencyTarget", Napi::Number::New(env, static_cast<double>(scheduler.GetLatencyTarget())));
+    stats.Set("memoryTarget", Napi::Number::New(env, static_cast<double>(scheduler.GetMemoryTarget())));
+    stats.Set("timeLimit", Napi::Number::New(env, static_cast<double>(s_environment.GetMsgTimeLimit())));
+    stats.Set("slotLimit", Napi::Number::New(env, static_cast<double>(s_environment.GetMsgSlotsLimit())));
+    stats.Set("flushDelay", Napi::Number::New(env, static_cast<double>(scheduler.GetFlushDelay())));
+    stats.Set("retryDelay", Napi::Number::New(env, static_cast<double>(scheduler.GetRetryDelay())));
+    stats.Set("slotsPerSecond", Napi::Number::New(env, scheduler.GetSlotRate() * 1000.0));
+    stats.Set("messagesPerSecond", Napi::Number::New(env, scheduler.GetMsgRate() * 1000.0));
+    stats.Set("formatMicrosPerMessage", Napi::Number::New(env, scheduler.GetFormatCost() * 1000.0));
+    stats.Set("sinkLatency", Napi::Number::New(env, scheduler.GetSinkLatency()));
+    stats.Set("adjustments", Napi::Number::New(env, static_cast<double>(scheduler.GetAdjustments())));
+    stats.Set("limitedBy", Napi::String::New(env, limitedBy));
+
+    return stats;
+}
+
+static void DisableCrashFlushHook(void* arg)
+{
+    s_crashFlush.Disable(static_cast<LoggingEnvironment*>(arg));
+}
+
+Napi::Value EnableCrashFlush(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsNumber() || info[0].As<Napi::Number>().Int32Value() < 0)
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    int fd = info[0].As<Napi::Number>().Int32Value();
+
+    bool enabled = s_crashFlush.Enable(fd, &s_environment);
+    if (enabled)
+    {
+        //the environment goes away with its thread so make sure the handler stops looking at it
+        napi_add_env_cleanup_hook(env, &DisableCrashFlushHook, &s_environment);
+    }
+
+    return Napi::Boolean::New(env, enabled);
+}
+
+Napi::Value QueryMsgs(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 3 || !info[0].IsArray() || !info[1].IsObject() || !info[2].IsBoolean())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    const Napi::Array inmemblocks = info[0].As<Napi::Array>();
+    const Napi::Object qobj = info[1].As<Napi::Object>();
+    bool emitstdprefix = info[2].As<Napi::Boolean>().Value();
+
+    LogQuery query;
+    if (qobj.Get("formatId").IsNumber())
+    {
+        query.SetFormat(qobj.Get("formatId").As<Napi::Number>().Int64Value());
+    }
+    if (qobj.Get("level").IsNumber())
+    {
+        query.SetLevel(static_cast<LoggingLevel>(qobj.Get("level").As<Napi::Number>().Uint32Value()));
+    }
+    if (qobj.Get("categoryId").IsNumber())
+    {
+        query.SetCategory(qobj.Get("categoryId").As<Napi::Number>().Int64Value());
+    }
+    if (qobj.Get("timeStart").IsNumber())
+    {
+        query.SetTimeStart(qobj.Get("timeStart").As<Napi::Number>().Int64Value());
+    }
+    if (qobj.Get("timeEnd").IsNumber())
+    {
+        query.SetTimeEnd(qobj.Get("timeEnd").As<Napi::Number>().Int64Value());
+    }
+    if (qobj.Get("requestId").IsNumber())
+    {
+        query.SetRequestId(qobj.Get("requestId").As<Napi::Number>().DoubleValue());
+    }
+    if (qobj.Get("callbackId").IsNumber())
+    {
+        query.SetCallbackId(qobj.Get("callbackId").As<Napi::Number>().DoubleValue());
+    }
+
+    const LoggingRegistry* registry = &s_registry;
+
+    //the format thread shares the prefix cache (and would pop the pending blocks) so hold it while we run
+    FormatThreadSuspension suspension(s_environment.GetFormatThread());
+
+    Formatter formatter;
+
+    //pending native blocks are older than anything still in the JS blocks
+    s_environment.VisitPendingBlocks([&](const std::shared_ptr<LogProcessingBlock>& block, bool resumed) {
+        block->emitMatchingFormatEntries(&formatter, &s_environment, emitstdprefix, resumed, [&query, registry](const LogEntryTag* tags, const double* data, size_t spos, size_t epos) {
+            return query.Matches(tags, data, spos, epos, registry);
+        });
+    });
+
+    //copy the messages whose header matches out of the JS blocks (a message may span blocks) and then check the ids on the copies
+    LogProcessingBlock matches(INIT_LOG_BLOCK_SIZE);
+    char mode = 'n';
+    for (uint32_t i = 0; i < inmemblocks.Length(); ++i)
+    {
+        const Napi::Object inmemblock = inmemblocks.Get(i).As<Napi::Object>();
+        const size_t epos = inmemblock.Get("epos").As<Napi::Number>().Int64Value();
+        size_t cpos = inmemblock.Get("spos").As<Napi::Number>().Int64Value();
+
+        Napi::Uint8Array tagArray = inmemblock.Get("tags").As<Napi::Uint8Array>();
+        Napi::Float64Array dataArray = inmemblock.Get("data").As<Napi::Float64Array>();
+        if (tagArray.ElementLength() < epos || dataArray.ElementLength() < epos || epos < cpos)
+        {
+            continue;
+        }
+
+        const uint8_t* tags = tagArray.Data();
+        const double* data = dataArray.Data();
+        const Napi::Array stringData = inmemblock.Get("stringData").As<Napi::Array>();
+
+        while (cpos < epos)
+        {
+            if (mode == 'n')
+            {
+                mode = query.MatchesHeader(data, cpos) ? 's' : 'd';
+            }
+
+            const bool msgcomplete = (mode == 'd') ? LogProcessingBlock::ProcessDiscardEntry(cpos, epos, tags) : matches.ProcessSaveEntry(cpos, epos, tags, data, stringData);
+            if (msgcomplete)
+            {
+                mode = 'n';
+            }
+        }
+    }
+    matches.emitMatchingFormatEntries(&formatter, &s_environment, emitstdprefix, false, [&query, registry](const LogEntryTag* tags, const double* data, size_t spos, size_t epos) {
+        return query.MatchesIds(tags, data, spos, epos, registry);
+    });
+
+    return Napi::String::New(env, formatter.getOutputBuffer(), formatter.getOutputBufferSize());
+}
+
+Napi::Value EnableMetrics(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return Napi::Boolean::New(env, s_metrics.Enable(info[0].As<Napi::Number>().Int64Value()));
+}
+
+Napi::Value DisableMetrics(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    s_metrics.Disable();
+    return env.Undefined();
+}
+
+Napi::Value ResetMetrics(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    s_metrics.Reset();
+    return env.Undefined();
+}
+
+static Napi::Array ExportSketchBuckets(Napi::Env env, const std::map<int32_t, uint64_t>& buckets)
+{
+    Napi::Array res = Napi::Array::New(env);
+
+    uint32_t pos = 0;
+    for (auto iter = buckets.cbegin(); iter != buckets.cend(); ++iter)
+    {
+        Napi::Array bucket = Napi::Array::New(env);
+        bucket.Set(static_cast<uint32_t>(0), Napi::Number::New(env, static_cast<double>(iter->first)));
+        bucket.Set(static_cast<uint32_t>(1), Napi::Number::New(env, static_cast<double>(iter->second)));
+        res.Set(pos++, bucket);
+    }
+
+    return res;
+}
+
+//Export the aggregates for every %n argument of the enabled formats that has seen a value -- quantiles is an array of the q values (in [0, 1]) to estimate
+Napi::Value GetMetrics(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsArray())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::vector<double> quantiles;
+    Napi::Array qarray = info[0].As<Napi::Array>();
+    for (uint32_t i = 0; i < qarray.Length(); ++i)
+    {
+        quantiles.push_back(qarray.Get(i).ToNumber().DoubleValue());
+    }
+
+    //in format id order so the export is stable
+    std::vector<const FormatMetrics*> formats;
+    const std::unordered_map<int64_t, std::unique_ptr<FormatMetrics>>& fmap = s_metrics.GetFormats();
+    for (auto iter = fmap.cbegin(); iter != fmap.cend(); ++iter)
+    {
+        formats.push_back(iter->second.get());
+    }
+    std::sort(formats.begin(), formats.end(), [](const FormatMetrics* a, const FormatMetrics* b) { return a->fmt->GetFormatId() < b->fmt->GetFormatId(); });
+
+    Napi::Array res = Napi::Array::New(env);
+    uint32_t pos = 0;
+    for (size_t i = 0; i < formats.size(); ++i)
+    {
+        for (size_t j = 0; j < formats[i]->metrics.size(); ++j)
+        {
+            const ArgMetric& metric = formats[i]->metrics[j];
+            if (metric.count == 0)
+            {
+                continue;
+            }
+
+            Napi::Object entry = Napi::Object::New(env);
+            entry.Set("format", Napi::String::New(env, formats[i]->fmt->GetFormatName()));
+            entry.Set("formatId", Napi::Number::New(env, static_cast<double>(formats[i]->fmt->GetFormatId())));
+            entry.Set("arg", Napi::Number::New(env, static_cast<double>(metric.argIndex)));
+            entry.Set("name", Napi::String::New(env, metric.name));
+            entry.Set("count", Napi::Number::New(env, static_cast<double>(metric.count)));
+            entry.Set("sum", Napi::Number::New(env, metric.sum));
+            entry.Set("min", Napi::Number::New(env, metric.min));
+            entry.Set("max", Napi::Number::New(env, metric.max));
+            entry.Set("mean", Napi::Number::New(env, metric.sum / static_cast<double>(metric.count)));
+
+            Napi::Object qvals = Napi::Object::New(env);
+            for (size_t k = 0; k < quantiles.size(); ++k)
+            {
+                //the sketch value is within the accuracy but can fall outside the (exact) range we saw
+                double qval = std::max<double>(metric.min, std::min<double>(metric.max, metric.sketch.GetQuantile(quantiles[k])));
+                if (quantiles[k] <= 0.0 || quantiles[k] >= 1.0)
+                {
+                    qval = (quantiles[k] <= 0.0) ? metric.min : metric.max;
+                }
+                qvals.Set(Napi::Number::New(env, quantiles[k]).ToString(), Napi::Number::New(env, qval));
+            }
+            entry.Set("quantiles", qvals);
+
+            Napi::Object sketch = Napi::Object::New(env);
+            sketch.Set("accuracy", Napi::Number::New(env, metric.sketch.GetAccuracy()));
+            sketch.Set("zeros", Napi::Number::New(env, static_cast<double>(metric.sketch.GetZeroCount())));
+            sketch.Set("positive", ExportSketchBuckets(env, metric.sketch.GetPositiveBuckets()));
+            sketch.Set("negative", ExportSketchBuckets(env, metric.sketch.GetNegativeBuckets()));
+            entry.Set("sketch", sketch);
+
+            res.Set(pos++, entry);
+        }
+    }
+
+    return res;
+}
+
+//Start writing a timeline of the flush pipeline to the file (replacing any trace in progress) -- returns false if the file cannot be created
+Napi::Value StartTrace(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return Napi::Boolean::New(env, GetTraceRecorder().Start(info[0].As<Napi::String>().Utf8Value()));
+}
+
+Napi::Value StopTrace(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    GetTraceRecorder().Stop();
+    return env.Undefined();
+}
+
+Napi::Value TraceNow(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    return Napi::Number::New(env, GetTraceRecorder().Now());
+}
+
+//JS timed a write of the output from startUs until now (in the write callback so it shows the time until the stream was done with it)
+Napi::Value TraceWrite(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    TraceRecorder& recorder = GetTraceRecorder();
+    recorder.AsyncSpan("sinkWrite", info[0].As<Napi::Number>().DoubleValue(), recorder.Now(), "bytes", info[1].As<Napi::Number>().DoubleValue());
+    return env.Undefined();
+}
+
+//JS timed a flush callback (processing, format hand off, and the writes it started) from startUs until now
+Napi::Value TraceFlush(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    TraceRecorder& recorder = GetTraceRecorder();
+    recorder.Span("flush", info[0].As<Napi::Number>().DoubleValue(), recorder.Now());
+    return env.Undefined();
+}
+
+Napi::Value SetFlightRecorder(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber())
+    {
+        Napi::TypeError::New(env, "Wrong arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    const size_t maxBytes = static_cast<size_t>(std::max<int64_t>(info[0].As<Napi::Number>().Int64Value(), 0));
+    const int64_t maxAge = info[1].As<Napi::Number>().Int64Value();
+    const LoggingLevel dumpLevel = static_cast<LoggingLevel>(info[2].As<Napi::Number>().Uint32Value());
+
+    s_flightRecorder.Configure(maxBytes, maxAge, dumpLevel);
+    return env.Undefined();
+}
+
+//Queue the recorded messages for formatting (with the next flush) -- returns the # of messages
+Napi::Value DumpFlightRecorder(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (!s_flightRecorder.IsEnabled() || s_flightRecorder.GetMessageCount() == 0)
+    {
+        return Napi::Number::New(env, 0.0);
+    }
+
+    const double now = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+    std::shared_ptr<LogProcessingBlock> block = std::make_shared<LogProcessingBlock>(INIT_LOG_BLOCK_SIZE);
+    const int64_t count = s_flightRecorder.Dump(block.get(), now);
+    if (count != 0)
+    {
+        const int64_t bytes = block->GetMemoryFootprint();
+        s_environment.AddPendingBlock(std::move(block), bytes, count);
+    }
+
+    return Napi::Number::New(env, static_cast<double>(count));
+}
+
+Napi::Value GetFlightRecorderStats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    Napi::Object res = Napi::Object::New(env);
+    res.Set("capacity", Napi::Number::New(env, static_cast<double>(s_flightRecorder.GetCapacity())));
+    res.Set("messages", Napi::Number::New(env, static_cast<double>(s_flightRecorder.GetMessageCount())));
+    res.Set("bytes", Napi::Number::New(env, static_cast<double>(s_flightRecorder.GetUsedBytes())));
+    res.Set("recorded", Napi::Number::New(env, static_cast<double>(s_flightRecorder.GetRecordedCount())));
+    res.Set("evicted", Napi::Number::New(env, static_cast<double>(s_flightRecorder.GetEvictedCount())));
+    res.Set("dumped", Napi::Number::New(env, static_cast<double>(s_flightRecorder.GetDumpedCount())));
+
+    return res;
+}
+
+Napi::Value HasWorkPending(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    return Napi::Boolean::New(env, s_environment.HasWorkPending());
+}
+
+Napi::Value InitializeLogger(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 3 || !info[0].IsNumber() || !info[1].IsString() || !info[2].IsString())
+    {
+        return env.Undefined();
+    }
+
+    LoggingLevel level = static_cast<LoggingLevel>(info[0].As<Napi::Number>().Int32Value());
+    std::string host = info[1].As<Napi::String>().Utf8Value();
+    std::string app = info[2].As<Napi::String>().Utf8Value();
+
+    s_environment.InitializeEnvironmentData(level, host, app);
 
     return env.Undefined();
 }
@@ -328,10 +1661,15 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "initializeLogger"), Napi::Function::New(env, InitializeLogger));
 
     exports.Set(Napi::String::New(env, "registerFormat"), Napi::Function::New(env, RegisterFormat));
+    exports.Set(Napi::String::New(env, "saveFormatCatalog"), Napi::Function::New(env, SaveFormatCatalog));
+    exports.Set(Napi::String::New(env, "loadFormatCatalog"), Napi::Function::New(env, LoadFormatCatalog));
     exports.Set(Napi::String::New(env, "addCategory"), Napi::Function::New(env, AddCategory));
+    exports.Set(Napi::String::New(env, "registerShape"), Napi::Function::New(env, RegisterShape));
 
     exports.Set(Napi::String::New(env, "getEmitLevel"), Napi::Function::New(env, GetEmitLevel));
     exports.Set(Napi::String::New(env, "setEmitLevel"), Napi::Function::New(env, SetEmitLevel));
+    exports.Set(Napi::String::New(env, "setCategoryLevel"), Napi::Function::New(env, SetCategoryLevel));
+    exports.Set(Napi::String::New(env, "setLoggerLevel"), Napi::Function::New(env, SetLoggerLevel));
 
     exports.Set(Napi::String::New(env, "getMsgTimeLimit"), Napi::Function::New(env, GetMsgTimeLimit));
     exports.Set(Napi::String::New(env, "setMsgTimeLimit"), Napi::Function::New(env, SetMsgTimeLimit));
@@ -339,14 +1677,57 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "getMsgSlotLimit"), Napi::Function::New(env, GetMsgSlotLimit));
     exports.Set(Napi::String::New(env, "setMsgSlotLimit"), Napi::Function::New(env, SetMsgSlotLimit));
 
-    exports.Set(Napi::String::New(env, "processMsgsReserveBlock"), Napi::Function::New(env, ProcessMsgsReserveBlock));
-    exports.Set(Napi::String::New(env, "processMsgsForEmit"), Napi::Function::New(env, ProcessMsgs));
-    exports.Set(Napi::String::New(env, "processMsgsComplete"), Napi::Function::New(env, ProcessMsgsComplete));
+    exports.Set(Napi::String::New(env, "processMsgChain"), Napi::Function::New(env, ProcessMsgChain));
 
     exports.Set(Napi::String::New(env, "abortAsyncWork"), Napi::Function::New(env, AbortAsyncWork));
+    exports.Set(Napi::String::New(env, "writePriorityMsg"), Napi::Function::New(env, WritePriorityMsg));
     exports.Set(Napi::String::New(env, "formatMsgsSync"), Napi::Function::New(env, FormatMsgsSync));
+    exports.Set(Napi::String::New(env, "setOutputBuffers"), Napi::Function::New(env, SetOutputBuffers));
+    exports.Set(Napi::String::New(env, "setBlockHandoff"), Napi::Function::New(env, SetBlockHandoff));
+    exports.Set(Napi::String::New(env, "startFormatThread"), Napi::Function::New(env, StartFormatThread));
     exports.Set(Napi::String::New(env, "formatMsgsAsync"), Napi::Function::New(env, FormatMsgsAsync));
 
+    exports.Set(Napi::String::New(env, "startAggregation"), Napi::Function::New(env, StartAggregation));
+    exports.Set(Napi::String::New(env, "aggregateMsgs"), Napi::Function::New(env, AggregateMsgs));
+    exports.Set(Napi::String::New(env, "flushAggregation"), Napi::Function::New(env, FlushAggregation));
+
+    exports.Set(Napi::String::New(env, "startColumnar"), Napi::Function::New(env, StartColumnar));
+    exports.Set(Napi::String::New(env, "columnarMsgs"), Napi::Function::New(env, ColumnarMsgs));
+    exports.Set(Napi::String::New(env, "flushColumnar"), Napi::Function::New(env, FlushColumnar));
+    exports.Set(Napi::String::New(env, "getColumnarStats"), Napi::Function::New(env, GetColumnarStats));
+    exports.Set(Napi::String::New(env, "mergeLogs"), Napi::Function::New(env, MergeLogs));
+
+    exports.Set(Napi::String::New(env, "startSinks"), Napi::Function::New(env, StartSinks));
+    exports.Set(Napi::String::New(env, "sinkMsgs"), Napi::Function::New(env, SinkMsgs));
+    exports.Set(Napi::String::New(env, "flushSinks"), Napi::Function::New(env, FlushSinks));
+    exports.Set(Napi::String::New(env, "getSinkStats"), Napi::Function::New(env, GetSinkStats));
+
+    exports.Set(Napi::String::New(env, "setMemoryBudget"), Napi::Function::New(env, SetMemoryBudget));
+    exports.Set(Napi::String::New(env, "getMemoryUsage"), Napi::Function::New(env, GetMemoryUsage));
+
+    exports.Set(Napi::String::New(env, "setAdaptiveFlush"), Napi::Function::New(env, SetAdaptiveFlush));
+    exports.Set(Napi::String::New(env, "reportSinkLatency"), Napi::Function::New(env, ReportSinkLatency));
+    exports.Set(Napi::String::New(env, "getFlushStats"), Napi::Function::New(env, GetFlushStats));
+
+    exports.Set(Napi::String::New(env, "enableMetrics"), Napi::Function::New(env, EnableMetrics));
+    exports.Set(Napi::String::New(env, "disableMetrics"), Napi::Function::New(env, DisableMetrics));
+    exports.Set(Napi::String::New(env, "resetMetrics"), Napi::Function::New(env, ResetMetrics));
+    exports.Set(Napi::String::New(env, "getMetrics"), Napi::Function::New(env, GetMetrics));
+
+    exports.Set(Napi::String::New(env, "setFlightRecorder"), Napi::Function::New(env, SetFlightRecorder));
+    exports.Set(Napi::String::New(env, "dumpFlightRecorder"), Napi::Function::New(env, DumpFlightRecorder));
+    exports.Set(Napi::String::New(env, "getFlightRecorderStats"), Napi::Function::New(env, GetFlightRecorderStats));
+
+    exports.Set(Napi::String::New(env, "startTrace"), Napi::Function::New(env, StartTrace));
+    exports.Set(Napi::String::New(env, "stopTrace"), Napi::Function::New(env, StopTrace));
+    exports.Set(Napi::String::New(env, "traceNow"), Napi::Function::New(env, TraceNow));
+    exports.Set(Napi::String::New(env, "traceWrite"), Napi::Function::New(env, TraceWrite));
+    exports.Set(Napi::String::New(env, "traceFlush"), Napi::Function::New(env, TraceFlush));
+
+    exports.Set(Napi::String::New(env, "enableCrashFlush"), Napi::Function::New(env, EnableCrashFlush));
+
+    exports.Set(Napi::String::New(env, "queryMsgs"), Napi::Function::New(env, QueryMsgs));
+
     exports.Set(Napi::String::New(env, "hasWorkPending"), Napi::Function::New(env, HasWorkPending));
 
     return exports;
@@ -0,0 +1,161 @@
+#pragma once
+
+//Helpers for writing formatted output directly to files from native code (i.e., without going through a JS stream)
+
+static int OpenOutputFile(const std::string& path)
+{
+#ifdef _WIN32
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+}
+
+//Like OpenOutputFile but replaces any existing contents
+static int CreateOutputFile(const std::string& path)
+{
+#ifdef _WIN32
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+static void CloseOutputFile(int fd)
+{
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+//Push anything written to fd to the device -- fds that can't be synced (ttys, pipes) are not an error
+static bool SyncOutputFile(int fd)
+{
+#ifdef _WIN32
+    return _commit(fd) == 0 || errno == EBADF;
+#else
+    return fsync(fd) == 0 || errno == EINVAL || errno == EROFS;
+#endif
+}
+
+//Write all the bytes (retrying on partial writes and interrupts) -- returns false if the write failed
+static bool WriteOutputFully(int fd, const char* buff, size_t size)
+{
+    while (size != 0)
+    {
+#ifdef _WIN32
+        int written = _write(fd, buff, static_cast<unsigned int>(std::min<size_t>(size, INT32_MAX)));
+#else
+        ssize_t written = write(fd, buff, size);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+#endif
+
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        buff += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+//Connect a non-blocking Unix-domain stream or datagram socket to the listener at path -- returns -1 if there is no listener (or no AF_UNIX support)
+static int ConnectOutputSocket(const std::string& path, bool datagram)
+{
+#ifdef _WIN32
+    return -1;
+#else
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, datagram ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    //Unix-domain connects complete (or fail) right away -- a full listen backlog is EAGAIN and we just try again later
+    int res = -1;
+    do
+    {
+        res = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+#endif
+}
+
+//Send as much of buff as the socket takes without blocking -- returns the bytes sent, 0 if it would block, -1 if the connection is broken, or -2 if buff is too big to ever send as a datagram
+static int64_t SendOutputSocket(int fd, const char* buff, size_t size)
+{
+#ifdef _WIN32
+    return -1;
+#else
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+
+    ssize_t sent = -1;
+    do
+    {
+        sent = send(fd, buff, size, flags);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent >= 0)
+    {
+        return static_cast<int64_t>(sent);
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+    {
+        return 0;
+    }
+
+    return (errno == EMSGSIZE) ? -2 : -1;
+#endif
+}
+
+//Wait up to ms for the socket to take more output -- returns false on a timeout or error
+static bool WaitOutputSocket(int fd, int ms)
+{
+#ifdef _WIN32
+    return false;
+#else
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, ms) > 0 && (pfd.revents & POLLOUT) != 0;
+#endif
+}
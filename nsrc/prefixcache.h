@@ -0,0 +1,82 @@
+#pragma once
+
+//Pre-rendered pieces of the standard message prefix "LEVEL#category @ <date> from host::logger | ".
+//The (level, category) head is kept in a dense array indexed by level and category id and the " from host::logger | " tail is keyed by logger name -- so the prefix is two copies plus the timestamp.
+//Each cache is only used by the thread currently formatting for its environment.
+class PrefixCache
+{
+private:
+    //Indexed by (categoryId * LOGGING_LEVEL_COUNT + level index) -- an empty entry has not been rendered yet
+    std::vector<std::string> m_heads;
+
+    std::unordered_map<std::string, std::string> m_tails;
+
+    //Almost every message in a block comes from the same logger so remember the last hit
+    std::string m_lastLogger;
+    const std::string* m_lastTail;
+
+public:
+    PrefixCache() :
+        m_heads(), m_tails(), m_lastLogger(), m_lastTail(nullptr)
+    {
+        ;
+    }
+
+    //Drop everything (e.g., when the host name is changed)
+    void Clear()
+    {
+        this->m_heads.clear();
+        this->m_tails.clear();
+        this->m_lastLogger.clear();
+        this->m_lastTail = nullptr;
+    }
+
+    //Returns nullptr if the head has not been rendered yet
+    const std::string* TryGetHead(size_t levelIndex, int64_t categoryId) const
+    {
+        const size_t pos = static_cast<size_t>(categoryId) * LOGGING_LEVEL_COUNT + levelIndex;
+        if (pos >= this->m_heads.size() || this->m_heads[pos].empty())
+        {
+            return nullptr;
+        }
+
+        return &this->m_heads[pos];
+    }
+
+    //Categories are only ever added (and names never change) so a new category just grows the array
+    const std::string& AddHead(size_t levelIndex, int64_t categoryId, const std::string& levelName, const std::string& categoryName)
+    {
+        const size_t pos = static_cast<size_t>(categoryId) * LOGGING_LEVEL_COUNT + levelIndex;
+        if (pos >= this->m_heads.size())
+        {
+            this->m_heads.resize((static_cast<size_t>(categoryId) + 1) * LOGGING_LEVEL_COUNT);
+        }
+
+        this->m_heads[pos] = levelName + "#" + categoryName + " @ ";
+        return this->m_heads[pos];
+    }
+
+    const std::string& GetTail(const std::string& hostName, const std::string& logger)
+    {
+        if (this->m_lastTail != nullptr && this->m_lastLogger == logger)
+        {
+            return *this->m_lastTail;
+        }
+
+        auto iter = this->m_tails.find(logger);
+        if (iter == this->m_tails.end())
+        {
+            //logger names are few but don't let an unusual app grow this without bound
+            if (this->m_tails.size() >= PREFIX_CACHE_MAX_LOGGERS)
+            {
+                this->m_tails.clear();
+            }
+
+            iter = this->m_tails.emplace(logger, " from " + hostName + "::" + logger + " | ").first;
+        }
+
+        this->m_lastLogger = logger;
+        this->m_lastTail = &iter->second;
+        return iter->second;
+    }
+};
@@ -1,153 +1,652 @@
 #pragma once
 
+//Blocks store their entries encoded as a tag byte and then the data -- nothing for the tags that carry no data (brackets, sentinals, undefined, ...),
+//a zigzag varint for whole numbers (ids, levels, string keys, bools, most numbers and dates) with the walltimes as the delta from the previous one,
+//and a raw double (flagged with ENTRY_RAW_DOUBLE_FLAG on the tag byte) for everything else. They are only ever decoded front to back.
+static void AppendZigZagVarInt(std::vector<uint8_t>& into, int64_t value)
+{
+    uint64_t zz = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (zz >= 0x80)
+    {
+        into.push_back(static_cast<uint8_t>(zz | 0x80));
+        zz >>= 7;
+    }
+    into.push_back(static_cast<uint8_t>(zz));
+}
+
+//Read a value written by AppendZigZagVarInt at pos (and move pos past it) -- a truncated value reads as whatever bits are there
+static int64_t ReadZigZagVarInt(const uint8_t* bytes, size_t size, size_t& pos)
+{
+    uint64_t zz = 0;
+    uint32_t shift = 0;
+    while (pos < size)
+    {
+        const uint8_t b = bytes[pos++];
+        if (shift < 64)
+        {
+            zz |= static_cast<uint64_t>(b & 0x7F) << shift;
+        }
+        shift += 7;
+
+        if ((b & 0x80) == 0)
+        {
+            break;
+        }
+    }
+
+    return static_cast<int64_t>(zz >> 1) ^ -static_cast<int64_t>(zz & 0x1);
+}
+
+static bool IsDataLessTag(LogEntryTag tag)
+{
+    switch (tag)
+    {
+    case LogEntryTag::MsgEndSentinal:
+    case LogEntryTag::LParen:
+    case LogEntryTag::RParen:
+    case LogEntryTag::LBrack:
+    case LogEntryTag::RBrack:
+    case LogEntryTag::JsVarValue_Undefined:
+    case LogEntryTag::JsVarValue_Null:
+    case LogEntryTag::JsBadFormatVar:
+    case LogEntryTag::CycleValue:
+    case LogEntryTag::OpaqueValue:
+    case LogEntryTag::DepthBoundObject:
+    case LogEntryTag::LengthBoundObject:
+    case LogEntryTag::DepthBoundArray:
+    case LogEntryTag::LengthBoundArray:
+        return true;
+    default:
+        return false;
+    }
+}
+
+//True for the tags that open a structured value (closed by RParen or RBrack)
+static bool IsStructuredStartTag(LogEntryTag tag)
+{
+    return tag == LogEntryTag::LParen || tag == LogEntryTag::LBrack || tag == LogEntryTag::LShape;
+}
+
+//Move pos past the (rest of the) value starting at pos -- depth is how deep in a structured value we already are (0 at the start of a value) and is kept
+//so a value that is split over blocks can be continued with the next block. Returns true if we reached the end of the value (false if we hit end first).
+template <typename TTag>
+static bool SkipValueEntries(const TTag* tags, size_t& pos, size_t end, size_t& depth)
+{
+    do
+    {
+        const LogEntryTag tag = static_cast<LogEntryTag>(tags[pos]);
+        if (IsStructuredStartTag(tag))
+        {
+            depth++;
+        }
+        else if ((tag == LogEntryTag::RParen || tag == LogEntryTag::RBrack) && depth != 0)
+        {
+            depth--;
+        }
+        pos++;
+    } while (depth != 0 && pos < end);
+
+    return depth == 0;
+}
+
+//Whole numbers that round trip through a varint (not -0 or NaN)
+static bool IsVarIntValue(double value)
+{
+    return std::abs(value) < ENTRY_VARINT_LIMIT && std::floor(value) == value && !(value == 0.0 && std::signbit(value));
+}
+
+//Forward decoder for the entries of a block -- it is just a few words so lookahead is done on a copy (and the signal handler can use one without allocating)
+//It also reads the tags/data of a JS block in place for the blocks that were handed off without being encoded.
+class BlockEntryReader
+{
+private:
+    const uint8_t* m_bytes;
+    size_t m_size;
+    size_t m_next; //start of the entry after the current one
+    double m_walltime; //the last walltime (they are stored as deltas)
+
+    //set if we are reading a JS block (m_next and m_size are then slot indices)
+    const uint8_t* m_jsTags;
+    const double* m_jsData;
+
+    bool m_valid;
+    LogEntryTag m_tag;
+    double m_data;
+
+public:
+    BlockEntryReader(const uint8_t* bytes, size_t size) :
+        m_bytes(bytes), m_size(size), m_next(0), m_walltime(0.0), m_jsTags(nullptr), m_jsData(nullptr), m_valid(false), m_tag(LogEntryTag::MsgEndSentinal), m_data(0.0)
+    {
+        this->Advance();
+    }
+
+    //The slots [spos, epos) of a JS block
+    BlockEntryReader(const uint8_t* tags, const double* data, size_t spos, size_t epos) :
+        m_bytes(nullptr), m_size(epos), m_next(spos), m_walltime(0.0), m_jsTags(tags), m_jsData(data), m_valid(false), m_tag(LogEntryTag::MsgEndSentinal), m_data(0.0)
+    {
+        this->Advance();
+    }
+
+    //False once we are past the last entry (the tag then reads as MsgEndSentinal so scans for the end of a message always stop)
+    bool IsValid() const { return this->m_valid; }
+
+    LogEntryTag GetTag() const { return this->m_tag; }
+    double GetData() const { return this->m_data; }
+
+    void Advance()
+    {
+        if (this->m_jsTags != nullptr)
+        {
+            //the logger ids are only there for the level masks
+            while (this->m_next < this->m_size && this->m_jsTags[this->m_next] == static_cast<uint8_t>(LogEntryTag::MsgLoggerId))
+            {
+                this->m_next++;
+            }
+        }
+
+        if (this->m_next >= this->m_size)
+        {
+            this->m_valid = false;
+            this->m_tag = LogEntryTag::MsgEndSentinal;
+            this->m_data = 0.0;
+            return;
+        }
+
+        if (this->m_jsTags != nullptr)
+        {
+            //the slots of the tag only entries are not written so there can be anything in the data
+            this->m_valid = true;
+            this->m_tag = static_cast<LogEntryTag>(this->m_jsTags[this->m_next]);
+            this->m_data = IsDataLessTag(this->m_tag) ? 0.0 : this->m_jsData[this->m_next];
+            this->m_next++;
+            return;
+        }
+
+        const uint8_t tbyte = this->m_bytes[this->m_next++];
+        const bool raw = (tbyte & ENTRY_RAW_DOUBLE_FLAG) != 0;
+
+        this->m_valid = true;
+        this->m_tag = static_cast<LogEntryTag>(tbyte & ~ENTRY_RAW_DOUBLE_FLAG);
+
+        if (raw)
+        {
+            this->m_data = 0.0;
+            if (this->m_next + sizeof(double) <= this->m_size)
+            {
+                memcpy(&this->m_data, this->m_bytes + this->m_next, sizeof(double));
+            }
+            this->m_next = std::min<size_t>(this->m_next + sizeof(double), this->m_size);
+        }
+        else if (IsDataLessTag(this->m_tag))
+        {
+            this->m_data = 0.0;
+        }
+        else
+        {
+            this->m_data = static_cast<double>(ReadZigZagVarInt(this->m_bytes, this->m_size, this->m_next));
+        }
+
+        if (this->m_tag == LogEntryTag::MsgWallTime)
+        {
+            //raw walltimes are absolute
+            this->m_walltime = raw ? this->m_data : this->m_walltime + this->m_data;
+            this->m_data = this->m_walltime;
+        }
+    }
+};
+
 //We load the JS data into this for later processing
 class LogProcessingBlock
 {
 private:
-    std::vector<LogEntryTag> m_tags;
-    std::vector<double> m_data;
+    std::vector<uint8_t> m_bytes;
     std::map<int32_t, std::string> m_stringData;
+    int32_t m_nextLocalStringKey; //strings that did not come from a JS block get negative keys so they never collide with the JS string ids
 
-    std::vector<LogEntryTag>::const_iterator m_cposTag;
-    std::vector<double>::const_iterator m_cposData;
+    double m_lastWallTime; //walltimes are encoded as the delta from this
+    int64_t m_msgCount;
 
-    LogEntryTag getCurrentTag() const { return *this->m_cposTag; }
+    //Set if the messages were handed off in a whole JS block which we read in place (JS never writes to it again and the reference keeps it alive)
+    const uint8_t* m_jsTags;
+    const double* m_jsData;
+    size_t m_jsSpos;
+    size_t m_jsEpos;
+    size_t m_jsBlockBytes;
+    napi_ref m_jsBlockRef;
+    std::shared_ptr<JsBlockReleaseQueue> m_releaseQueue;
 
-    bool getCurrentDataAsBool() const { return static_cast<bool>(*this->m_cposData); }
-    int64_t getCurrentDataAsInt() const { return static_cast<int64_t>(*this->m_cposData); }
-    double getCurrentDataAsFloat() const { return *this->m_cposData; }
+    BlockEntryReader m_cpos;
 
-    LoggingLevel getCurrentDataAsLoggingLevel() const { return static_cast<LoggingLevel>(static_cast<uint32_t>(*this->m_cposData)); }
-    time_t getCurrentDataAsTime() const { return static_cast<time_t>(*this->m_cposData); }
+    BlockEntryReader makeReader() const
+    {
+        if (this->m_jsTags != nullptr)
+        {
+            return BlockEntryReader(this->m_jsTags, this->m_jsData, this->m_jsSpos, this->m_jsEpos);
+        }
+        else
+        {
+            return BlockEntryReader(this->m_bytes.data(), this->m_bytes.size());
+        }
+    }
+
+    LogEntryTag getCurrentTag() const { return this->m_cpos.GetTag(); }
+
+    bool getCurrentDataAsBool() const { return static_cast<bool>(this->m_cpos.GetData()); }
+    int64_t getCurrentDataAsInt() const { return static_cast<int64_t>(this->m_cpos.GetData()); }
+    double getCurrentDataAsFloat() const { return this->m_cpos.GetData(); }
+
+    LoggingLevel getCurrentDataAsLoggingLevel() const { return static_cast<LoggingLevel>(static_cast<uint32_t>(this->m_cpos.GetData())); }
+    time_t getCurrentDataAsTime() const { return static_cast<time_t>(this->m_cpos.GetData()); }
 
     const std::string& getCurrentDataAsString() const
     {
-        int32_t sidx = static_cast<int32_t>(*this->m_cposData);
+        int32_t sidx = static_cast<int32_t>(this->m_cpos.GetData());
         return this->m_stringData.at(sidx);
     }
 
     void advancePos()
     {
-        this->m_cposTag++;
-        this->m_cposData++;
+        this->m_cpos.Advance();
     }
 
     bool hasMoreEntries() const
     {
-        return this->m_cposTag != this->m_tags.end();
+        return this->m_cpos.IsValid();
+    }
+
+    //A copy of the format position moved ahead by count entries (for reading the header of the current message)
+    BlockEntryReader peekEntry(size_t count) const
+    {
+        BlockEntryReader reader = this->m_cpos;
+        for (size_t i = 0; i < count; ++i)
+        {
+            reader.Advance();
+        }
+        return reader;
+    }
+
+    void appendTag(LogEntryTag tag, bool raw)
+    {
+        this->m_bytes.push_back(static_cast<uint8_t>(tag) | (raw ? ENTRY_RAW_DOUBLE_FLAG : 0x0));
+    }
+
+    void appendRawDouble(double value)
+    {
+        const size_t pos = this->m_bytes.size();
+        this->m_bytes.resize(pos + sizeof(double));
+        memcpy(this->m_bytes.data() + pos, &value, sizeof(double));
     }
 
-    void emitVarTagEntry(Formatter* formatter, LogEntryTag tag)
+    //The message writers below are templated on the writer -- a Formatter or (from the fatal signal handler) a SignalSafeWriter -- so they only read the block through
+    //the given reader and never allocate or throw (e.g., a missing string is written as "<Missing>").
+
+    template <typename TWriter>
+    void emitStringEntry(TWriter* writer, double key, bool quotes) const
     {
-        switch (tag)
+        auto iter = this->m_stringData.find(static_cast<int32_t>(key));
+        if (iter == this->m_stringData.end())
+        {
+            writer->emitLiteralString("\"<Missing>\"");
+        }
+        else if (quotes)
+        {
+            writer->emitJsString(iter->second);
+        }
+        else
+        {
+            writer->emitLiteralString(iter->second);
+        }
+    }
+
+    //Write the (non-structured) value at the reader -- the caller advances the reader
+    template <typename TWriter>
+    void emitVarTagEntry(TWriter* writer, const BlockEntryReader& reader) const
+    {
+        switch (reader.GetTag())
         {
         case LogEntryTag::JsVarValue_Undefined:
-            formatter->emitLiteralString("undefined");
+            writer->emitLiteralString("undefined");
             break;
         case LogEntryTag::JsVarValue_Null:
-            formatter->emitLiteralString("null");
+            writer->emitLiteralString("null");
             break;
         case LogEntryTag::JsVarValue_Bool:
-            if (this->getCurrentDataAsBool())
+            if (reader.GetData() != 0.0)
             {
-                formatter->emitLiteralString("true");
+                writer->emitLiteralString("true");
             }
             else
             {
-                formatter->emitLiteralString("false");
+                writer->emitLiteralString("false");
             }
             break;
         case LogEntryTag::JsVarValue_Number:
-            formatter->emitJsNumber(this->getCurrentDataAsFloat());
+            writer->emitJsNumber(reader.GetData());
             break;
         case LogEntryTag::JsVarValue_StringIdx:
-            formatter->emitJsString(this->getCurrentDataAsString());
+            this->emitStringEntry(writer, reader.GetData(), true);
             break;
         case LogEntryTag::JsVarValue_Date:
-            formatter->emitJsDate(this->getCurrentDataAsTime(), FormatStringEnum::DATEISO, true);
+            writer->emitJsDate(static_cast<std::time_t>(reader.GetData()), FormatStringEnum::DATEISO, true);
             break;
         default:
-            formatter->emitSpecialTag(tag);
+            writer->emitSpecialTag(reader.GetTag());
             break;
         }
     }
 
-    void emitStructuredEntry(Formatter* formatter)
+    //Write the structured value at the reader and move the reader past it (a truncated value stops at the end sentinal).
+    //Objects with a registered shape (LShape) get their "key": fragments from the shape instead of PropertyRecord entries.
+    template <typename TWriter>
+    void emitStructuredEntry(TWriter* writer, BlockEntryReader& reader, const LoggingRegistry* registry) const
     {
-        std::stack<std::pair<char, bool>> processingStack;
-        processingStack.push(std::make_pair<char, bool>(this->getCurrentTag() == LogEntryTag::LParen ? '{' : '[', true));
+        const LogEntryTag openTag = reader.GetTag();
+        const ObjectShape* shape = (openTag == LogEntryTag::LShape) ? registry->TryGetShape(static_cast<int64_t>(reader.GetData())) : nullptr;
+        size_t keyIndex = 0;
+        bool first = true;
 
-        formatter->emitLiteralChar(processingStack.top().first);
-        this->advancePos();
+        writer->emitLiteralChar(openTag == LogEntryTag::LBrack ? '[' : '{');
+        reader.Advance();
 
-        while (!processingStack.empty())
+        while (true)
         {
-            std::pair<char, bool>& cs = processingStack.top();
-            LogEntryTag tag = this->getCurrentTag();
+            const LogEntryTag tag = reader.GetTag();
 
-            if (cs.second)
+            if (tag == LogEntryTag::MsgEndSentinal)
             {
-                cs.second = false;
+                return;
             }
-            else
+
+            if (tag == LogEntryTag::RParen || tag == LogEntryTag::RBrack)
             {
-                if (tag != LogEntryTag::RParen && tag != LogEntryTag::RBrack)
-                {
-                    formatter->emitLiteralString(", ");
-                }
+                writer->emitLiteralChar(tag == LogEntryTag::RParen ? '}' : ']');
+                reader.Advance();
+                return;
             }
 
+            if (!first)
+            {
+                writer->emitLiteralString(", ");
+            }
+            first = false;
+
             if (tag == LogEntryTag::PropertyRecord)
             {
-                formatter->emitJsString(this->getCurrentDataAsString());
-                formatter->emitLiteralString(": ");
-                this->advancePos();
+                this->emitStringEntry(writer, reader.GetData(), true);
+                writer->emitLiteralString(": ");
+                reader.Advance();
 
-                cs.second = true;
+                first = true;
+                continue;
             }
-            else if (tag == LogEntryTag::LParen || tag == LogEntryTag::LBrack)
+
+            if (shape != nullptr && keyIndex < shape->GetKeyCount())
             {
-                this->emitStructuredEntry(formatter);
-                //pos advanced in call
+                writer->emitLiteralString(shape->GetKeyFragment(keyIndex++));
             }
-            else if (tag == LogEntryTag::RParen || tag == LogEntryTag::RBrack)
+
+            if (IsStructuredStartTag(tag))
             {
-                formatter->emitLiteralChar(tag == LogEntryTag::RParen ? '}' : ']');
-                this->advancePos();
-                processingStack.pop();
+                this->emitStructuredEntry(writer, reader, registry);
+                //reader advanced in call
             }
             else
             {
-                this->emitVarTagEntry(formatter, tag);
-                this->advancePos();
+                this->emitVarTagEntry(writer, reader);
+                reader.Advance();
+            }
+        }
+    }
+
+    //Write the message at the reader after its prefix (the reader is at the child info or the first argument) -- the child info, the format text, and the newline.
+    //The reader is moved past the end sentinal. An unknown format (nullptr) is written as "<BadFormat>".
+    template <typename TWriter>
+    void emitMsgText(TWriter* writer, BlockEntryReader& reader, const MsgFormat* fmt, const LoggingEnvironment* lenv) const
+    {
+        if (reader.GetTag() == LogEntryTag::MSGChildInfo)
+        {
+            this->emitStringEntry(writer, reader.GetData(), false);
+            reader.Advance();
+
+            writer->emitLiteralString(" -- ");
+        }
+
+        if (fmt == nullptr)
+        {
+            writer->emitSpecialTag(LogEntryTag::JsBadFormatVar);
+        }
+        else
+        {
+            writer->emitLiteralString(fmt->GetInitialFormatStringSegment());
+
+            const std::vector<FormatEntry>& formatArray = fmt->GetEntries();
+            for (size_t formatIndex = 0; formatIndex < formatArray.size(); formatIndex++)
+            {
+                const FormatEntry& fentry = formatArray[formatIndex];
+                const LogEntryTag tag = reader.GetTag();
+
+                if (fentry.fkind == FormatStringEntryKind::Literal)
+                {
+                    writer->emitLiteralChar(fentry.fenum == FormatStringEnum::HASH ? '#' : '%');
+                }
+                else if (fentry.fkind == FormatStringEntryKind::Expando && fentry.fenum == FormatStringEnum::HOST)
+                {
+                    writer->emitJsString(lenv->GetHostName());
+                }
+                else if (fentry.fkind == FormatStringEntryKind::Expando && fentry.fenum == FormatStringEnum::APP)
+                {
+                    writer->emitJsString(lenv->GetAppName());
+                }
+                else if (tag == LogEntryTag::MsgEndSentinal || tag == LogEntryTag::JsBadFormatVar)
+                {
+                    //a truncated message is missing the rest of its arguments so we stay on the sentinal
+                    writer->emitSpecialTag(LogEntryTag::JsBadFormatVar);
+                    if (tag != LogEntryTag::MsgEndSentinal)
+                    {
+                        reader.Advance();
+                    }
+                }
+                else if (fentry.fkind == FormatStringEntryKind::Expando)
+                {
+                    switch (fentry.fenum)
+                    {
+                    case FormatStringEnum::LOGGER:
+                        this->emitStringEntry(writer, reader.GetData(), true);
+                        break;
+                    case FormatStringEnum::SOURCE:
+                    {
+                        auto iter = this->m_stringData.find(static_cast<int32_t>(reader.GetData()));
+                        if (iter != this->m_stringData.end())
+                        {
+                            writer->emitCallStack(iter->second);
+                        }
+                        else
+                        {
+                            writer->emitLiteralString("\"<Missing>\"");
+                        }
+                        break;
+                    }
+                    case FormatStringEnum::WALLCLOCK:
+                        writer->emitJsDate(static_cast<std::time_t>(reader.GetData()), FormatStringEnum::DATEISO, true);
+                        break;
+                    case FormatStringEnum::TIMESTAMP:
+                    case FormatStringEnum::CALLBACK:
+                    case FormatStringEnum::REQUEST:
+                        writer->emitJsInt(static_cast<int64_t>(reader.GetData()));
+                        break;
+                    default:
+                        writer->emitSpecialTag(LogEntryTag::JsBadFormatVar);
+                        break;
+                    }
+
+                    reader.Advance();
+                }
+                else if (IsStructuredStartTag(tag))
+                {
+                    this->emitStructuredEntry(writer, reader, lenv->GetRegistry());
+                    //reader advanced in call
+                }
+                else
+                {
+                    switch (fentry.fenum)
+                    {
+                    case FormatStringEnum::BOOL:
+                        if (reader.GetData() != 0.0)
+                        {
+                            writer->emitLiteralString("true");
+                        }
+                        else
+                        {
+                            writer->emitLiteralString("false");
+                        }
+                        break;
+                    case FormatStringEnum::NUMBER:
+                        writer->emitJsNumber(reader.GetData());
+                        break;
+                    case FormatStringEnum::STRING:
+                        this->emitStringEntry(writer, reader.GetData(), true);
+                        break;
+                    case FormatStringEnum::DATEISO:
+                    case FormatStringEnum::DATELOCAL:
+                        writer->emitJsDate(static_cast<std::time_t>(reader.GetData()), fentry.fenum, true);
+                        break;
+                    default:
+                        this->emitVarTagEntry(writer, reader);
+                        break;
+                    }
+
+                    reader.Advance();
+                }
+
+                writer->emitLiteralString(fentry.ffollow);
             }
         }
+        writer->emitLiteralChar('\n');
+
+        //skip anything left over (e.g., if the format was unknown) and the end sentinal
+        while (reader.GetTag() != LogEntryTag::MsgEndSentinal)
+        {
+            reader.Advance();
+        }
+        reader.Advance();
     }
 
 public:
+    //sizehint is in entries (most entries take 1-3 bytes)
     LogProcessingBlock(size_t sizehint) :
-        m_tags(), m_data(), m_stringData()
+        m_bytes(), m_stringData(), m_nextLocalStringKey(-1), m_lastWallTime(0.0), m_msgCount(0),
+        m_jsTags(nullptr), m_jsData(nullptr), m_jsSpos(0), m_jsEpos(0), m_jsBlockBytes(0), m_jsBlockRef(nullptr), m_releaseQueue(nullptr),
+        m_cpos(nullptr, 0)
+    {
+        this->m_bytes.reserve(sizehint * 2);
+    }
+
+    //Take the complete messages in [spos, epos) of a JS block as they are -- jsBlockRef goes on the release queue when the block is destroyed (on whatever thread that is)
+    LogProcessingBlock(const uint8_t* tags, const double* data, size_t spos, size_t epos, size_t blockBytes, int64_t msgCount, napi_ref jsBlockRef, std::shared_ptr<JsBlockReleaseQueue> releaseQueue) :
+        m_bytes(), m_stringData(), m_nextLocalStringKey(-1), m_lastWallTime(0.0), m_msgCount(msgCount),
+        m_jsTags(tags), m_jsData(data), m_jsSpos(spos), m_jsEpos(epos), m_jsBlockBytes(blockBytes), m_jsBlockRef(jsBlockRef), m_releaseQueue(std::move(releaseQueue)),
+        m_cpos(nullptr, 0)
+    {
+        ;
+    }
+
+    ~LogProcessingBlock()
     {
-        this->m_tags.reserve(sizehint);
-        this->m_data.reserve(sizehint);
+        if (this->m_jsBlockRef != nullptr)
+        {
+            napi_ref ref = this->m_jsBlockRef;
+            this->m_releaseQueue->Push(std::move(ref));
+        }
     }
 
+    LogProcessingBlock(const LogProcessingBlock&) = delete;
+    LogProcessingBlock& operator=(const LogProcessingBlock&) = delete;
+
     bool IsEmptyBlock() const
     {
-        return this->m_tags.empty();
+        return this->m_bytes.empty() && this->m_jsTags == nullptr;
+    }
+
+    //Copy the strings of a handed off JS block (once each however many entries use them) -- must be on the JS thread
+    void AddJsBlockStrings(const Napi::Array& stringData)
+    {
+        for (size_t pos = this->m_jsSpos; pos < this->m_jsEpos; ++pos)
+        {
+            const LogEntryTag tag = static_cast<LogEntryTag>(this->m_jsTags[pos]);
+            if ((tag == LogEntryTag::JsVarValue_StringIdx) | (tag == LogEntryTag::PropertyRecord) | (tag == LogEntryTag::MSGLogger) | (tag == LogEntryTag::MSGChildInfo))
+            {
+                const int32_t key = static_cast<int32_t>(this->m_jsData[pos]);
+                auto iter = this->m_stringData.lower_bound(key);
+                if (iter == this->m_stringData.end() || iter->first != key)
+                {
+                    Napi::Value sval = stringData[static_cast<size_t>(key)];
+                    this->m_stringData.emplace_hint(iter, key, sval.As<Napi::String>().Utf8Value());
+                }
+            }
+        }
     }
 
+    //Approximate bytes held by the block (the encoded entries or the JS block we hold + the strings and their map nodes)
+    int64_t GetMemoryFootprint() const
+    {
+        size_t bytes = sizeof(LogProcessingBlock) + this->m_bytes.capacity() + this->m_jsBlockBytes;
+        for (auto iter = this->m_stringData.cbegin(); iter != this->m_stringData.cend(); iter++)
+        {
+            bytes += STRING_MAP_NODE_OVERHEAD + iter->second.capacity();
+        }
+
+        return static_cast<int64_t>(bytes);
+    }
+
+    int64_t GetMessageCount() const
+    {
+        return this->m_msgCount;
+    }
 
     void AddDataEntry(LogEntryTag tag, double data)
     {
-        this->m_tags.push_back(tag);
-        this->m_data.push_back(data);
+        if (IsDataLessTag(tag))
+        {
+            this->appendTag(tag, false);
+            if (tag == LogEntryTag::MsgEndSentinal)
+            {
+                this->m_msgCount++;
+            }
+            return;
+        }
+
+        double value = data;
+        if (tag == LogEntryTag::MsgWallTime)
+        {
+            //a delta only if both ends are whole (so adding it back up is exact) -- otherwise the absolute time is stored raw
+            const double last = this->m_lastWallTime;
+            this->m_lastWallTime = data;
+
+            if (!IsVarIntValue(data) || !IsVarIntValue(last))
+            {
+                this->appendTag(tag, true);
+                this->appendRawDouble(data);
+                return;
+            }
+
+            value = data - last;
+        }
+
+        if (IsVarIntValue(value))
+        {
+            this->appendTag(tag, false);
+            AppendZigZagVarInt(this->m_bytes, static_cast<int64_t>(value));
+        }
+        else
+        {
+            this->appendTag(tag, true);
+            this->appendRawDouble(data);
+        }
     }
 
     void AddStringDataEntry(LogEntryTag tag, double data, Napi::String string)
     {
-        this->m_tags.push_back(tag);
-        this->m_data.push_back(data);
+        this->AddDataEntry(tag, data);
 
         int32_t key = static_cast<int32_t>(data);
         auto iter = this->m_stringData.lower_bound(key);
@@ -158,161 +657,309 @@ public:
         }
     }
 
-    void emitFormatEntry(Formatter* formatter, const LoggingEnvironment* lenv, bool emitstdprefix)
+    //A string entry that was copied out of the JS blocks earlier (e.g., by the flight recorder)
+    void AddLocalStringDataEntry(LogEntryTag tag, std::string&& string)
     {
-        const std::shared_ptr<MsgFormat> fmt = lenv->GetFormat(this->getCurrentDataAsInt());
-        this->advancePos();
+        const int32_t key = this->m_nextLocalStringKey--;
+
+        this->AddDataEntry(tag, static_cast<double>(key));
+        this->m_stringData.emplace(key, std::move(string));
+    }
+
+    //Format the message at reader and move reader past it -- returns false (and skips the message) if it has an unknown format id since we run on the writer threads and a bad block must not throw
+    bool emitFormatEntryAt(Formatter* formatter, BlockEntryReader& reader, const LoggingEnvironment* lenv, bool emitstdprefix, PrefixCache* prefixCache) const
+    {
+        const MsgFormat* fmt = lenv->TryGetFormat(static_cast<int64_t>(reader.GetData()));
+        if (fmt == nullptr)
+        {
+            while (reader.GetTag() != LogEntryTag::MsgEndSentinal)
+            {
+                reader.Advance();
+            }
+            reader.Advance();
+            return false;
+        }
+        reader.Advance();
 
-        bool dosep = false;
         if (!emitstdprefix)
         {
-            this->advancePos();
-            this->advancePos();
-            this->advancePos();
+            reader.Advance();
+            reader.Advance();
+            reader.Advance();
+
+            if (reader.GetTag() == LogEntryTag::MSGLogger)
+            {
+                reader.Advance();
+            }
         }
         else
         {
-            dosep = true;
-            formatter->emitLiteralString(lenv->GetLogLevelName(this->getCurrentDataAsLoggingLevel()));
-            this->advancePos();
-            formatter->emitLiteralChar('#');
+            const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(reader.GetData()));
+            reader.Advance();
 
-            formatter->emitLiteralString(lenv->GetCategoryName(this->getCurrentDataAsInt()));
-            this->advancePos();
+            formatter->emitLiteralString(lenv->GetPrefixHead(level, static_cast<int64_t>(reader.GetData()), prefixCache));
+            reader.Advance();
 
-            formatter->emitLiteralString(" @ ");
-            formatter->emitJsDate(this->getCurrentDataAsTime(), FormatStringEnum::DATEISO, false);
-            this->advancePos();
+            formatter->emitJsDate(static_cast<time_t>(reader.GetData()), FormatStringEnum::DATEISO, false);
+            reader.Advance();
 
-            formatter->emitLiteralString(" from ");
-            formatter->emitLiteralString(lenv->GetHostName());
-            formatter->emitLiteralString("::");
-            formatter->emitLiteralString(this->getCurrentDataAsString());
-            this->advancePos();
+            //includes the " | " separator
+            formatter->emitLiteralString(lenv->GetPrefixTail(this->m_stringData.at(static_cast<int32_t>(reader.GetData())), prefixCache));
+            reader.Advance();
         }
 
-        if (dosep)
+        this->emitMsgText(formatter, reader, fmt, lenv);
+        return true;
+    }
+
+    //Format the message at the current format position -- returns false if it was skipped (see emitFormatEntryAt)
+    bool emitFormatEntry(Formatter* formatter, const LoggingEnvironment* lenv, bool emitstdprefix, PrefixCache* prefixCache = nullptr)
+    {
+        return this->emitFormatEntryAt(formatter, this->m_cpos, lenv, emitstdprefix, prefixCache);
+    }
+
+    //Walk the message at the current format position as a row instead of formatting it.
+    //The visitor gets Header(level, category, walltime, logger, childInfo) (the strings are nullptr if not present) and then Value(tag, value, str) for each argument --
+    //str is the string for string values, the JSON text (rendered with scratch) for %j and structured values, and nullptr otherwise.
+    //Returns false (and skips the message without calling the visitor) if it has an unknown format id.
+    template <typename TRowVisitor>
+    bool visitFormatEntryRow(const LoggingEnvironment* lenv, Formatter* scratch, TRowVisitor& visitor)
+    {
+        const MsgFormat* fmt = lenv->TryGetFormat(this->getCurrentDataAsInt());
+        if (fmt == nullptr)
         {
-            formatter->emitLiteralString(" | ");
+            this->skipFormatEntry();
+            return false;
         }
+        this->advancePos();
 
-        if (this->getCurrentTag() == LogEntryTag::MSGChildInfo)
+        const LoggingLevel level = this->getCurrentDataAsLoggingLevel();
+        this->advancePos();
+
+        const int64_t category = this->getCurrentDataAsInt();
+        this->advancePos();
+
+        const int64_t walltime = this->getCurrentDataAsInt();
+        this->advancePos();
+
+        const std::string* logger = nullptr;
+        if (this->getCurrentTag() == LogEntryTag::MSGLogger)
         {
-            formatter->emitLiteralString(this->getCurrentDataAsString());
+            logger = &this->getCurrentDataAsString();
             this->advancePos();
+        }
 
-            formatter->emitLiteralString(" -- ");
+        const std::string* childInfo = nullptr;
+        if (this->getCurrentTag() == LogEntryTag::MSGChildInfo)
+        {
+            childInfo = &this->getCurrentDataAsString();
+            this->advancePos();
         }
 
-        formatter->emitLiteralString(fmt->GetInitialFormatStringSegment());
+        visitor.Header(level, category, walltime, logger, childInfo);
 
+        std::string json;
         const std::vector<FormatEntry>& formatArray = fmt->GetEntries();
-        for (size_t formatIndex = 0; formatIndex < formatArray.size(); formatIndex++)
+        for (size_t formatIndex = 0; formatIndex < formatArray.size() && this->getCurrentTag() != LogEntryTag::MsgEndSentinal; formatIndex++)
         {
             const FormatEntry& fentry = formatArray[formatIndex];
-
-            if (fentry.fkind == FormatStringEntryKind::Literal)
+            if (fentry.fkind == FormatStringEntryKind::Literal || (fentry.fkind == FormatStringEntryKind::Expando && (fentry.fenum == FormatStringEnum::HOST || fentry.fenum == FormatStringEnum::APP)))
             {
-                formatter->emitLiteralChar(fentry.fenum == FormatStringEnum::HASH ? '#' : '%');
+                continue;
             }
-            else if (fentry.fkind == FormatStringEntryKind::Expando) {
-                bool advanceData = true;
 
-                switch (fentry.fenum)
+            const LogEntryTag tag = this->getCurrentTag();
+            if (fentry.fkind == FormatStringEntryKind::Compound || IsStructuredStartTag(tag))
+            {
+                scratch->reset();
+                if (IsStructuredStartTag(tag))
                 {
-                case FormatStringEnum::HOST:
-                    advanceData = false;
-                    formatter->emitJsString(lenv->GetHostName());
-                    break;
-                case FormatStringEnum::APP:
-                    advanceData = false;
-                    formatter->emitJsString(lenv->GetAppName());
-                    break;
-                case FormatStringEnum::LOGGER:
-                    formatter->emitJsString(this->getCurrentDataAsString());
-                    break;
-                case FormatStringEnum::SOURCE:
-                    formatter->emitCallStack(this->getCurrentDataAsString());
-                    break;
-                case FormatStringEnum::WALLCLOCK:
-                    formatter->emitJsDate(this->getCurrentDataAsTime(), FormatStringEnum::DATEISO, true);
-                    break;
-                case FormatStringEnum::TIMESTAMP:
-                case FormatStringEnum::CALLBACK:
-                case FormatStringEnum::REQUEST:
-                    formatter->emitJsInt(this->getCurrentDataAsInt());
-                    break;
-                default:
-                    formatter->emitSpecialTag(LogEntryTag::JsBadFormatVar);
-                    break;
+                    this->emitStructuredEntry(scratch, this->m_cpos, lenv->GetRegistry());
+                    //position is advanced in call
                 }
-
-                if (advanceData)
+                else
                 {
+                    this->emitVarTagEntry(scratch, this->m_cpos);
                     this->advancePos();
                 }
+
+                json.assign(scratch->getOutputBuffer(), scratch->getOutputBufferSize());
+                visitor.Value(tag, 0.0, &json);
             }
             else
             {
-                const LogEntryTag tag = this->getCurrentTag();
+                visitor.Value(tag, this->getCurrentDataAsFloat(), (tag == LogEntryTag::JsVarValue_StringIdx) ? &this->getCurrentDataAsString() : nullptr);
+                this->advancePos();
+            }
+        }
 
-                if (tag == LogEntryTag::JsBadFormatVar)
-                {
-                    formatter->emitSpecialTag(tag);
-                    this->advancePos();
-                }
-                else if (tag == LogEntryTag::LParen || tag == LogEntryTag::LBrack)
-                {
-                    this->emitStructuredEntry(formatter);
-                    //position is advanced in call
-                }
-                else
-                {
-                    switch (fentry.fenum) {
-                    case FormatStringEnum::BOOL:
-                        if (this->getCurrentDataAsBool())
-                        {
-                            formatter->emitLiteralString("true");
-                        }
-                        else
-                        {
-                            formatter->emitLiteralString("false");
-                        }
-                        break;
-                    case FormatStringEnum::NUMBER:
-                        formatter->emitJsNumber(this->getCurrentDataAsFloat());
-                        break;
-                    case FormatStringEnum::STRING:
-                        formatter->emitJsString(this->getCurrentDataAsString());
-                        break;
-                    case FormatStringEnum::DATEISO:
-                    case FormatStringEnum::DATELOCAL:
-                        formatter->emitJsDate(this->getCurrentDataAsTime(), fentry.fenum, true);
-                        break;
-                    default:
-                        this->emitVarTagEntry(formatter, tag);
-                        break;
-                    }
+        //skip anything left over and the end sentinal
+        while (this->getCurrentTag() != LogEntryTag::MsgEndSentinal)
+        {
+            this->advancePos();
+        }
+        this->advancePos();
 
-                    this->advancePos();
-                }
-            }
+        return true;
+    }
+
+    void resetFormatPosition()
+    {
+        this->m_cpos = this->makeReader();
+    }
+
+    bool hasMoreFormatEntries() const
+    {
+        return this->hasMoreEntries();
+    }
+
+    //Format id of the message at the current format position
+    int64_t getFormatEntryFormatId() const
+    {
+        return this->getCurrentDataAsInt();
+    }
 
-            formatter->emitLiteralString(fentry.ffollow);
+    //Wallclock time of the message at the current format position -- entries are MsgFormat, MsgLevel, MsgCategory, MsgWallTime, ...
+    time_t getFormatEntryWallTime() const
+    {
+        return static_cast<time_t>(this->peekEntry(3).GetData());
+    }
+
+    //Level of the message at the current format position
+    LoggingLevel getFormatEntryLevel() const
+    {
+        return static_cast<LoggingLevel>(static_cast<uint32_t>(this->peekEntry(1).GetData()));
+    }
+
+    //Category of the message at the current format position
+    int64_t getFormatEntryCategory() const
+    {
+        return static_cast<int64_t>(this->peekEntry(2).GetData());
+    }
+
+    //Logger name of the message at the current format position (nullptr if it was logged without the prefix info)
+    const std::string* getFormatEntryLogger() const
+    {
+        const BlockEntryReader logger = this->peekEntry(4);
+        if (logger.GetTag() != LogEntryTag::MSGLogger)
+        {
+            return nullptr;
         }
-        formatter->emitLiteralChar('\n');
 
+        return &this->m_stringData.at(static_cast<int32_t>(logger.GetData()));
+    }
+
+    //Move past the message at the current format position without formatting it
+    void skipFormatEntry()
+    {
+        while (this->getCurrentTag() != LogEntryTag::MsgEndSentinal)
+        {
+            this->advancePos();
+        }
         this->advancePos();
     }
 
-    void emitAllFormatEntries(Formatter* formatter, const LoggingEnvironment* lenv, bool emitstdprefix)
+    //Format messages from the current format position until the formatter holds at least limit bytes (or the block is done) -- returns the # of messages formatted
+    int64_t emitFormatEntriesUpTo(Formatter* formatter, const LoggingEnvironment* lenv, bool emitstdprefix, size_t limit)
+    {
+        int64_t count = 0;
+        while (this->hasMoreEntries() && formatter->getOutputBufferSize() < limit)
+        {
+            if (this->emitFormatEntry(formatter, lenv, emitstdprefix))
+            {
+                count++;
+            }
+        }
+
+        return count;
+    }
+
+    void emitAllFormatEntries(Formatter* formatter, const LoggingEnvironment* lenv, bool emitstdprefix, PrefixCache* prefixCache = nullptr)
     {
-        this->m_cposTag = this->m_tags.cbegin();
-        this->m_cposData = this->m_data.cbegin();
+        this->resetFormatPosition();
 
         while (this->hasMoreEntries())
         {
-            this->emitFormatEntry(formatter, lenv, emitstdprefix);
+            this->emitFormatEntry(formatter, lenv, emitstdprefix, prefixCache);
+        }
+    }
+
+    //Only emit the messages the predicate accepts -- it is called with the (decoded) tags, data, and [start, end) range of each message (end is the position of the sentinal).
+    //Does not touch the format position -- we start from it if fromFormatPosition (a partly written block) and from the start of the block otherwise.
+    template <typename TPred>
+    void emitMatchingFormatEntries(Formatter* formatter, const LoggingEnvironment* lenv, bool emitstdprefix, bool fromFormatPosition, TPred pred) const
+    {
+        std::vector<LogEntryTag> msgTags;
+        std::vector<double> msgData;
+
+        BlockEntryReader reader = fromFormatPosition ? this->m_cpos : this->makeReader();
+        while (reader.IsValid())
+        {
+            msgTags.clear();
+            msgData.clear();
+
+            BlockEntryReader scan = reader;
+            while (scan.IsValid() && scan.GetTag() != LogEntryTag::MsgEndSentinal)
+            {
+                msgTags.push_back(scan.GetTag());
+                msgData.push_back(scan.GetData());
+                scan.Advance();
+            }
+
+            if (pred(msgTags.data(), msgData.data(), 0, msgTags.size()))
+            {
+                this->emitFormatEntryAt(formatter, reader, lenv, emitstdprefix, nullptr);
+            }
+            else
+            {
+                scan.Advance();
+                reader = scan;
+            }
+        }
+    }
+
+    //Write every message in the block without allocating, throwing, or touching the format position (used by the fatal signal handler).
+    //Messages always get the standard prefix -- built by hand since the prefix cache allocates. A partly written block (fromFormatPosition) starts at the format position.
+    void emitAllFormatEntriesSignalSafe(SignalSafeWriter* writer, const LoggingEnvironment* lenv, bool fromFormatPosition) const
+    {
+        const LoggingRegistry* registry = lenv->GetRegistry();
+
+        BlockEntryReader reader = fromFormatPosition ? this->m_cpos : this->makeReader();
+        while (reader.IsValid())
+        {
+            const MsgFormat* fmt = registry->TryGetFormat(static_cast<int64_t>(reader.GetData()));
+            reader.Advance();
+
+            const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(reader.GetData()));
+            reader.Advance();
+            if (LoggingLevelIndex(level) < LOGGING_LEVEL_COUNT)
+            {
+                writer->emitLiteralString(lenv->GetLogLevelName(level));
+            }
+            writer->emitLiteralChar('#');
+
+            const std::string* category = registry->TryGetCategoryName(static_cast<int64_t>(reader.GetData()));
+            reader.Advance();
+            if (category != nullptr)
+            {
+                writer->emitLiteralString(*category);
+            }
+
+            writer->emitLiteralString(" @ ");
+            writer->emitJsDate(static_cast<std::time_t>(reader.GetData()), FormatStringEnum::DATEISO, false);
+            reader.Advance();
+
+            if (reader.GetTag() == LogEntryTag::MSGLogger)
+            {
+                writer->emitLiteralString(" from ");
+                writer->emitLiteralString(lenv->GetHostName());
+                writer->emitLiteralString("::");
+                this->emitStringEntry(writer, reader.GetData(), false);
+                reader.Advance();
+            }
+            writer->emitLiteralString(" | ");
+
+            this->emitMsgText(writer, reader, fmt, lenv);
         }
     }
 
@@ -326,10 +973,38 @@ public:
         return msgCount > lenv->GetMsgSlotsLimit();
     }
 
-    static bool ShouldDiscard(size_t cpos, const double* data, const LoggingEnvironment* lenv)
+    //The levels the category and logger of the message at cpos may be emitted at (the logger id follows the walltime in the header if it is not the root logger)
+    static LoggingLevel GetMsgLevelMask(size_t cpos, size_t epos, const uint8_t* tags, const double* data, const LoggingEnvironment* lenv)
+    {
+        const int64_t categoryId = static_cast<int64_t>(data[cpos + 2]);
+        const int64_t loggerId = (cpos + 4 < epos && tags[cpos + 4] == static_cast<uint8_t>(LogEntryTag::MsgLoggerId)) ? static_cast<int64_t>(data[cpos + 4]) : 0;
+        return lenv->GetMsgLevelMask(categoryId, loggerId);
+    }
+
+    static bool ShouldDiscard(size_t cpos, const double* data, LoggingLevel effectiveLevel)
+    {
+        const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(data[cpos + 1]));
+        return !LOG_LEVEL_ENABLED(level, effectiveLevel);
+    }
+
+    //Below the level its category or logger is allowed at (rather than just below the emit level)
+    static bool IsLevelMasked(size_t cpos, const double* data, LoggingLevel msgMask)
+    {
+        const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(data[cpos + 1]));
+        return !LOG_LEVEL_ENABLED(level, msgMask);
+    }
+
+    //Already written by the priority path (so the batched processing always drops it)
+    static bool IsPriorityWritten(size_t cpos, const double* data)
+    {
+        return static_cast<uint32_t>(data[cpos + 1]) == PRIORITY_WRITTEN_LEVEL;
+    }
+
+    //Discarded only because the level was dropped for memory pressure (msgMask is the level mask for the category and logger of the message)
+    static bool IsPressureDiscard(size_t cpos, const double* data, const LoggingEnvironment* lenv, LoggingLevel msgMask)
     {
         const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(data[cpos + 1]));
-        return !LOG_LEVEL_ENABLED(level, lenv->GetEnabledLoggingLevel());
+        return LOG_LEVEL_ENABLED(level, static_cast<uint32_t>(lenv->GetEnabledLoggingLevel()) & static_cast<uint32_t>(msgMask));
     }
 
     static bool ProcessDiscardEntry(size_t& cpos, size_t epos, const uint8_t* tags)
@@ -356,6 +1031,13 @@ public:
         while (cpos < epos && tags[cpos] != static_cast<uint8_t>(LogEntryTag::MsgEndSentinal))
         {
             const LogEntryTag ttag = static_cast<LogEntryTag>(tags[cpos]);
+            if (ttag == LogEntryTag::MsgLoggerId)
+            {
+                //only used to pick the level mask so it is not kept
+                cpos++;
+                continue;
+            }
+
             bool isSimpleValueTag = !((ttag == LogEntryTag::JsVarValue_StringIdx) | (ttag == LogEntryTag::PropertyRecord) | (ttag == LogEntryTag::MSGLogger) | (ttag == LogEntryTag::MSGChildInfo));
 
             if (isSimpleValueTag)
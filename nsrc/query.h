@@ -0,0 +1,112 @@
+#pragma once
+
+//Filter for picking out the messages in the retained log that are relevant to a diagnostic dump.
+//The header checks (format, level, category, time) only look at the first 4 entries of a message so they are cheap -- the request/callback id checks walk the arguments.
+class LogQuery
+{
+private:
+    int64_t m_fmtId; //-1 matches any format
+    LoggingLevel m_level; //messages with a level enabled at this level match
+    int64_t m_category; //-1 matches any category
+    int64_t m_timeStart;
+    int64_t m_timeEnd;
+
+    bool m_hasRequestId;
+    double m_requestId;
+    bool m_hasCallbackId;
+    double m_callbackId;
+
+public:
+    LogQuery() :
+        m_fmtId(-1), m_level(LoggingLevel::LLALL), m_category(-1), m_timeStart(INT64_MIN), m_timeEnd(INT64_MAX),
+        m_hasRequestId(false), m_requestId(0.0), m_hasCallbackId(false), m_callbackId(0.0)
+    {
+        ;
+    }
+
+    void SetFormat(int64_t fmtId) { this->m_fmtId = fmtId; }
+    void SetLevel(LoggingLevel level) { this->m_level = level; }
+    void SetCategory(int64_t category) { this->m_category = category; }
+    void SetTimeStart(int64_t time) { this->m_timeStart = time; }
+    void SetTimeEnd(int64_t time) { this->m_timeEnd = time; }
+    void SetRequestId(double requestId) { this->m_hasRequestId = true; this->m_requestId = requestId; }
+    void SetCallbackId(double callbackId) { this->m_hasCallbackId = true; this->m_callbackId = callbackId; }
+
+    bool HasIdFilter() const { return this->m_hasRequestId || this->m_hasCallbackId; }
+
+    //Entries are MsgFormat, MsgLevel, MsgCategory, MsgWallTime, ...
+    bool MatchesHeader(const double* data, size_t pos) const
+    {
+        if (this->m_fmtId != -1 && static_cast<int64_t>(data[pos]) != this->m_fmtId)
+        {
+            return false;
+        }
+
+        const LoggingLevel level = static_cast<LoggingLevel>(static_cast<uint32_t>(data[pos + 1]));
+        if (!LOG_LEVEL_ENABLED(level, this->m_level))
+        {
+            return false;
+        }
+
+        if (this->m_category != -1 && static_cast<int64_t>(data[pos + 2]) != this->m_category)
+        {
+            return false;
+        }
+
+        const int64_t walltime = static_cast<int64_t>(data[pos + 3]);
+        return this->m_timeStart <= walltime && walltime <= this->m_timeEnd;
+    }
+
+    //Walk the arguments of the (complete) message starting at pos to check the #request and #callback values
+    bool MatchesIds(const LogEntryTag* tags, const double* data, size_t pos, size_t end, const LoggingRegistry* registry) const
+    {
+        if (!this->HasIdFilter())
+        {
+            return true;
+        }
+
+        const MsgFormat* fmt = registry->TryGetFormat(static_cast<int64_t>(data[pos]));
+        if (fmt == nullptr)
+        {
+            return false;
+        }
+
+        pos += 4;
+        while (pos < end && (tags[pos] == LogEntryTag::MSGLogger || tags[pos] == LogEntryTag::MSGChildInfo))
+        {
+            pos++;
+        }
+
+        bool requestOk = !this->m_hasRequestId;
+        bool callbackOk = !this->m_hasCallbackId;
+
+        const std::vector<FormatEntry>& formatArray = fmt->GetEntries();
+        for (size_t formatIndex = 0; formatIndex < formatArray.size() && pos < end && tags[pos] != LogEntryTag::MsgEndSentinal; formatIndex++)
+        {
+            const FormatEntry& fentry = formatArray[formatIndex];
+            if (fentry.fkind == FormatStringEntryKind::Literal || (fentry.fkind == FormatStringEntryKind::Expando && (fentry.fenum == FormatStringEnum::HOST || fentry.fenum == FormatStringEnum::APP)))
+            {
+                continue;
+            }
+
+            if (fentry.fkind == FormatStringEntryKind::Expando && fentry.fenum == FormatStringEnum::REQUEST)
+            {
+                requestOk |= (data[pos] == this->m_requestId);
+            }
+            else if (fentry.fkind == FormatStringEntryKind::Expando && fentry.fenum == FormatStringEnum::CALLBACK)
+            {
+                callbackOk |= (data[pos] == this->m_callbackId);
+            }
+
+            size_t depth = 0;
+            SkipValueEntries(tags, pos, end, depth);
+        }
+
+        return requestOk && callbackOk;
+    }
+
+    bool Matches(const LogEntryTag* tags, const double* data, size_t pos, size_t end, const LoggingRegistry* registry) const
+    {
+        return this->MatchesHeader(data, pos) && this->MatchesIds(tags, data, pos, end, registry);
+    }
+};
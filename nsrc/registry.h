@@ -0,0 +1,208 @@
+#pragma once
+
+//forward decls
+class MsgFormat;
+class ObjectShape;
+
+//An append only table that readers can index on any thread without taking a lock.
+//Entries are stored in fixed size segments that never move so the writer (holding the registry lock) fills in the next entry and then publishes it by bumping the count -- readers see a consistent snapshot of every entry below the count they load.
+template <typename T>
+class PublishedTable
+{
+private:
+    static const size_t SegmentBits = 8;
+    static const size_t SegmentSize = (1 << SegmentBits);
+    static const size_t SegmentMask = SegmentSize - 1;
+    static const size_t MaxSegments = 4096;
+
+    T* m_segments[MaxSegments];
+    std::atomic<size_t> m_count;
+
+public:
+    PublishedTable() :
+        m_count(0)
+    {
+        std::fill(this->m_segments, this->m_segments + MaxSegments, nullptr);
+    }
+
+    ~PublishedTable()
+    {
+        for (size_t i = 0; i < MaxSegments; ++i)
+        {
+            delete[] this->m_segments[i];
+        }
+    }
+
+    PublishedTable(const PublishedTable&) = delete;
+    PublishedTable& operator=(const PublishedTable&) = delete;
+
+    size_t Count() const { return this->m_count.load(std::memory_order_acquire); }
+
+    bool Contains(size_t idx) const { return idx < this->Count(); }
+
+    //Only valid for idx < Count()
+    const T& Get(size_t idx) const
+    {
+        return this->m_segments[idx >> SegmentBits][idx & SegmentMask];
+    }
+
+    //Writer only (must be serialized by the caller) -- returns the index of the new entry
+    size_t Append(T&& value)
+    {
+        const size_t idx = this->m_count.load(std::memory_order_relaxed);
+        const size_t segment = idx >> SegmentBits;
+        if (segment >= MaxSegments)
+        {
+            throw std::length_error("Too many entries in registry");
+        }
+
+        if (this->m_segments[segment] == nullptr)
+        {
+            this->m_segments[segment] = new T[SegmentSize];
+        }
+        this->m_segments[segment][idx & SegmentMask] = std::move(value);
+
+        this->m_count.store(idx + 1, std::memory_order_release);
+        return idx;
+    }
+};
+
+//The formats and categories are shared by every logging environment in the process (main thread + worker_threads) so ids are global.
+//Lookups by id never take a lock so formatting threads can read while JS registers new formats/categories.
+class LoggingRegistry
+{
+private:
+    //Serializes the writers and protects the dedupe maps (which are never used by readers)
+    std::mutex m_lock;
+
+    PublishedTable<std::shared_ptr<MsgFormat>> m_formats;
+    std::map<std::string, int64_t> m_formatIds;
+
+    //Indexed directly by category id (0 is unused)
+    PublishedTable<std::string> m_categoryNames;
+    std::map<std::string, int64_t> m_categoryIds;
+
+    PublishedTable<std::shared_ptr<ObjectShape>> m_shapes;
+    std::map<std::string, int64_t> m_shapeIds;
+
+public:
+    LoggingRegistry() :
+        m_lock(), m_formats(), m_formatIds(), m_categoryNames(), m_categoryIds(), m_shapes(), m_shapeIds()
+    {
+        this->m_categoryNames.Append(std::string());
+        this->m_categoryNames.Append(std::string("$default")); //$default is defined by default
+        this->m_categoryNames.Append(std::string("$explicit")); //$explicit is defined by default
+    }
+
+    //Get the id for the format with the given (name + format string) key -- building and adding the format if this is the first time we have seen it
+    template <typename TBuilder>
+    int64_t AddFormat(const std::string& memoKey, TBuilder builder)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        auto iter = this->m_formatIds.find(memoKey);
+        if (iter != this->m_formatIds.end())
+        {
+            return iter->second;
+        }
+
+        const int64_t fmtId = static_cast<int64_t>(this->m_formats.Count());
+        this->m_formats.Append(builder(fmtId));
+        this->m_formatIds[memoKey] = fmtId;
+
+        return fmtId;
+    }
+
+    //Formats are registered with consecutive ids starting at 0
+    size_t GetFormatCount() const { return this->m_formats.Count(); }
+
+    //Formats are never removed so the reference is stable
+    const std::shared_ptr<MsgFormat>& GetFormat(int64_t fmtId) const
+    {
+        if (fmtId < 0 || !this->m_formats.Contains(static_cast<size_t>(fmtId)))
+        {
+            throw std::out_of_range("Unknown format id");
+        }
+
+        return this->m_formats.Get(static_cast<size_t>(fmtId));
+    }
+
+    //Never throws or allocates (so it is safe to use from a signal handler) -- returns nullptr for an unknown id
+    const MsgFormat* TryGetFormat(int64_t fmtId) const
+    {
+        if (fmtId < 0 || !this->m_formats.Contains(static_cast<size_t>(fmtId)))
+        {
+            return nullptr;
+        }
+
+        return this->m_formats.Get(static_cast<size_t>(fmtId)).get();
+    }
+
+    int64_t AddCategory(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        auto iter = this->m_categoryIds.find(name);
+        if (iter != this->m_categoryIds.end())
+        {
+            return iter->second;
+        }
+
+        const int64_t categoryId = static_cast<int64_t>(this->m_categoryNames.Append(std::string(name)));
+        this->m_categoryIds[name] = categoryId;
+
+        return categoryId;
+    }
+
+    //Names are never changed once added so the reference is stable
+    const std::string& GetCategoryName(int64_t categoryId) const
+    {
+        if (categoryId <= 0 || !this->m_categoryNames.Contains(static_cast<size_t>(categoryId)))
+        {
+            throw std::out_of_range("Unknown category id");
+        }
+
+        return this->m_categoryNames.Get(static_cast<size_t>(categoryId));
+    }
+
+    //Never throws or allocates (so it is safe to use from a signal handler) -- returns nullptr for an unknown id
+    const std::string* TryGetCategoryName(int64_t categoryId) const
+    {
+        if (categoryId <= 0 || !this->m_categoryNames.Contains(static_cast<size_t>(categoryId)))
+        {
+            return nullptr;
+        }
+
+        return &this->m_categoryNames.Get(static_cast<size_t>(categoryId));
+    }
+
+    //Get the id for the shape with the given key (built from its property names) -- building and adding the shape if this is the first time we have seen it
+    template <typename TBuilder>
+    int64_t AddShape(const std::string& memoKey, TBuilder builder)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        auto iter = this->m_shapeIds.find(memoKey);
+        if (iter != this->m_shapeIds.end())
+        {
+            return iter->second;
+        }
+
+        const int64_t shapeId = static_cast<int64_t>(this->m_shapes.Count());
+        this->m_shapes.Append(builder(shapeId));
+        this->m_shapeIds[memoKey] = shapeId;
+
+        return shapeId;
+    }
+
+    //Never throws or allocates (so it is safe to use from a signal handler) -- returns nullptr for an unknown id
+    const ObjectShape* TryGetShape(int64_t shapeId) const
+    {
+        if (shapeId < 0 || !this->m_shapes.Contains(static_cast<size_t>(shapeId)))
+        {
+            return nullptr;
+        }
+
+        return this->m_shapes.Get(static_cast<size_t>(shapeId)).get();
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+//A writer that only uses async-signal-safe operations (so it can be used from a fatal signal handler).
+//All the storage is inside the object and nothing is allocated. It has the same emit methods as the Formatter (and uses the same conversions) so the
+//LogProcessingBlock message writer works with either -- the only difference is that local dates are written in the ISO (UTC) form since they need the timezone database.
+class SignalSafeWriter
+{
+private:
+    int m_fd;
+    size_t m_curr;
+    char m_buff[CRASH_FLUSH_BUFFER_SIZE];
+
+    void ensure(size_t count)
+    {
+        if (this->m_curr + count > CRASH_FLUSH_BUFFER_SIZE)
+        {
+            this->flush();
+        }
+    }
+
+public:
+    SignalSafeWriter() :
+        m_fd(-1), m_curr(0)
+    {
+        ;
+    }
+
+    void setOutput(int fd) { this->m_fd = fd; }
+    int getOutput() const { return this->m_fd; }
+
+    void flush()
+    {
+        size_t pos = 0;
+        while (this->m_fd >= 0 && pos < this->m_curr)
+        {
+#ifdef _WIN32
+            int written = _write(this->m_fd, this->m_buff + pos, static_cast<unsigned int>(this->m_curr - pos));
+#else
+            ssize_t written = write(this->m_fd, this->m_buff + pos, this->m_curr - pos);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            if (written <= 0)
+            {
+                break;
+            }
+
+            pos += static_cast<size_t>(written);
+        }
+
+        this->m_curr = 0;
+    }
+
+    void emitLiteralChar(char c)
+    {
+        this->ensure(1);
+        this->m_buff[this->m_curr++] = c;
+    }
+
+    void emitLiteralString(const char* str, size_t length)
+    {
+        while (length != 0)
+        {
+            this->ensure(1);
+
+            const size_t count = std::min(length, CRASH_FLUSH_BUFFER_SIZE - this->m_curr);
+            memcpy(this->m_buff + this->m_curr, str, count);
+
+            this->m_curr += count;
+            str += count;
+            length -= count;
+        }
+    }
+
+    template <size_t N>
+    void emitLiteralString(const char(&str)[N])
+    {
+        this->emitLiteralString(str, N - 1);
+    }
+
+    void emitLiteralString(const std::string& str)
+    {
+        this->emitLiteralString(str.c_str(), str.length());
+    }
+
+    void emitJsString(const std::string& str)
+    {
+        char conv[FORMAT_CONVERSION_MAX_CHARS];
+
+        this->emitLiteralChar('"');
+        for (auto c = str.cbegin(); c != str.cend(); c++)
+        {
+            this->emitLiteralString(conv, WriteJsStringChar(c, str.cend(), conv));
+        }
+        this->emitLiteralChar('"');
+    }
+
+    void emitJsInt(int64_t ival)
+    {
+        char conv[FORMAT_CONVERSION_MAX_CHARS];
+        this->emitLiteralString(conv, WriteJsInt(ival, conv));
+    }
+
+    void emitJsNumber(double val)
+    {
+        char conv[FORMAT_CONVERSION_MAX_CHARS];
+        this->emitLiteralString(conv, WriteJsNumber(val, conv));
+    }
+
+    //Always the ISO form (in UTC)
+    void emitJsDate(std::time_t dval, FormatStringEnum fmt, bool quotes)
+    {
+        char conv[FORMAT_CONVERSION_MAX_CHARS];
+
+        if (quotes)
+        {
+            this->emitLiteralChar('"');
+        }
+
+        this->emitLiteralString(conv, WriteIsoDate(static_cast<int64_t>(dval), conv));
+
+        if (quotes)
+        {
+            this->emitLiteralChar('"');
+        }
+    }
+
+    void emitCallStack(const std::string& cstack)
+    {
+        this->emitJsString(cstack);
+    }
+
+    void emitSpecialTag(LogEntryTag tag)
+    {
+        const char* text = GetSpecialTagText(tag);
+        this->emitLiteralString(text, strlen(text));
+    }
+};
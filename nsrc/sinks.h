@@ -0,0 +1,585 @@
+#pragma once
+
+//How a sink renders each message -- each mode is rendered at most once per message no matter how many sinks use it
+enum class SinkMode : uint8_t
+{
+    Text = 0x1, //the standard "LEVEL#category @ <time> from host::logger | " prefix and then the message
+    Plain = 0x2, //just the message
+    NDJson = 0x3 //a JSON object per line with the time, level, category, logger and message text
+};
+
+//Where a sink writes
+enum class SinkOutput : uint8_t
+{
+    Stdout = 0x1,
+    Stderr = 0x2,
+    File = 0x3,
+    Socket = 0x4, //Unix-domain stream socket
+    Datagram = 0x5 //Unix-domain datagram socket
+};
+
+//Non-blocking connection to a local collector -- each flush of a sink is sent as one frame (a 4 byte big-endian length and then the batch of messages).
+//Frames wait in a bounded retry buffer while the socket is full or disconnected (dropping the oldest ones once there are more than SINK_SOCKET_RETRY_LIMIT bytes)
+//and a lost connection is retried at most every SINK_SOCKET_RECONNECT_INTERVAL ms. Only touched by the writer thread except for the counters.
+class SinkSocket
+{
+private:
+    std::string m_path;
+    bool m_datagram;
+    int m_fd;
+
+    std::deque<std::string> m_frames;
+    size_t m_frameOffset; //bytes of the first frame already sent (stream sockets can take part of a frame)
+    size_t m_pendingBytes;
+
+    bool m_connectTried;
+    std::chrono::steady_clock::time_point m_lastConnect;
+
+    std::atomic<uint64_t> m_sentBytes;
+    std::atomic<uint64_t> m_droppedFrames;
+    std::atomic<uint64_t> m_connects;
+    std::atomic<uint64_t> m_pendingBytesShared;
+
+    bool EnsureConnected()
+    {
+        if (this->m_fd >= 0)
+        {
+            return true;
+        }
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (this->m_connectTried && now - this->m_lastConnect < std::chrono::milliseconds(SINK_SOCKET_RECONNECT_INTERVAL))
+        {
+            return false;
+        }
+
+        this->m_connectTried = true;
+        this->m_lastConnect = now;
+
+        this->m_fd = ConnectOutputSocket(this->m_path, this->m_datagram);
+        if (this->m_fd < 0)
+        {
+            return false;
+        }
+
+        //a partly sent frame is incomplete on the old connection so the collector never sees it -- send all of it again
+        this->m_frameOffset = 0;
+        this->m_connects.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Disconnect()
+    {
+        CloseOutputFile(this->m_fd);
+        this->m_fd = -1;
+        this->m_frameOffset = 0;
+    }
+
+    void PopFrame(bool sent)
+    {
+        this->m_pendingBytes -= this->m_frames.front().size();
+        if (sent)
+        {
+            this->m_sentBytes.fetch_add(this->m_frames.front().size(), std::memory_order_relaxed);
+        }
+        else
+        {
+            this->m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        this->m_frames.pop_front();
+        this->m_frameOffset = 0;
+    }
+
+public:
+    SinkSocket(const std::string& path, bool datagram) :
+        m_path(path), m_datagram(datagram), m_fd(-1), m_frames(), m_frameOffset(0), m_pendingBytes(0), m_connectTried(false), m_lastConnect(),
+        m_sentBytes(0), m_droppedFrames(0), m_connects(0), m_pendingBytesShared(0)
+    {
+        ;
+    }
+
+    ~SinkSocket()
+    {
+        if (this->m_fd >= 0)
+        {
+            CloseOutputFile(this->m_fd);
+        }
+    }
+
+    SinkSocket(const SinkSocket&) = delete;
+    SinkSocket& operator=(const SinkSocket&) = delete;
+
+    //The collector does not need to be listening yet (we keep trying) but the path must be usable for a socket
+    bool Open()
+    {
+#ifdef _WIN32
+        return false;
+#else
+        this->EnsureConnected();
+        return this->m_path.size() < sizeof(sockaddr_un::sun_path);
+#endif
+    }
+
+    bool IsDatagram() const { return this->m_datagram; }
+
+    uint64_t GetSentBytes() const { return this->m_sentBytes.load(std::memory_order_relaxed); }
+    uint64_t GetDroppedFrames() const { return this->m_droppedFrames.load(std::memory_order_relaxed); }
+    uint64_t GetConnects() const { return this->m_connects.load(std::memory_order_relaxed); }
+    uint64_t GetPendingBytes() const { return this->m_pendingBytesShared.load(std::memory_order_relaxed); }
+
+    //Queue the batch (if any) as a frame and send whatever the socket will take
+    void Write(const std::string& batch)
+    {
+        if (!batch.empty())
+        {
+            const uint32_t length = static_cast<uint32_t>(batch.size());
+            std::string frame;
+            frame.reserve(batch.size() + 4);
+            frame.push_back(static_cast<char>((length >> 24) & 0xFF));
+            frame.push_back(static_cast<char>((length >> 16) & 0xFF));
+            frame.push_back(static_cast<char>((length >> 8) & 0xFF));
+            frame.push_back(static_cast<char>(length & 0xFF));
+            frame.append(batch);
+
+            this->m_pendingBytes += frame.size();
+            this->m_frames.push_back(std::move(frame));
+
+            //drop the oldest frames that are not partly sent
+            while (this->m_pendingBytes > SINK_SOCKET_RETRY_LIMIT && this->m_frames.size() > 1)
+            {
+                if (this->m_frameOffset == 0)
+                {
+                    this->PopFrame(false);
+                }
+                else
+                {
+                    this->m_pendingBytes -= this->m_frames[1].size();
+                    this->m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+                    this->m_frames.erase(this->m_frames.begin() + 1);
+                }
+            }
+        }
+
+        this->Send();
+    }
+
+    void Send()
+    {
+        while (!this->m_frames.empty() && this->EnsureConnected())
+        {
+            const std::string& frame = this->m_frames.front();
+            const int64_t sent = SendOutputSocket(this->m_fd, frame.c_str() + this->m_frameOffset, frame.size() - this->m_frameOffset);
+            if (sent == 0)
+            {
+                break;
+            }
+            else if (sent == -1)
+            {
+                this->Disconnect();
+            }
+            else if (sent == -2)
+            {
+                this->PopFrame(false);
+            }
+            else
+            {
+                this->m_frameOffset += static_cast<size_t>(sent);
+                if (this->m_frameOffset == frame.size())
+                {
+                    this->PopFrame(true);
+                }
+            }
+        }
+
+        this->m_pendingBytesShared.store(this->m_pendingBytes, std::memory_order_relaxed);
+    }
+
+    //Keep sending until everything is out or the deadline passes (when JS asks for a flush)
+    void SendUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        this->Send();
+        while (!this->m_frames.empty())
+        {
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+            {
+                break;
+            }
+
+            const int waitms = static_cast<int>(std::min<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1, SINK_SOCKET_RECONNECT_INTERVAL));
+            if (this->m_fd < 0 || !WaitOutputSocket(this->m_fd, waitms))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(this->m_fd < 0 ? waitms : 1));
+            }
+
+            this->Send();
+        }
+    }
+};
+
+//One output of the fan-out writer with its own level/category filter and output buffer.
+//Everything but the counters is only touched by the writer thread.
+class LogSink
+{
+private:
+    SinkOutput m_output;
+    SinkMode m_mode;
+    LoggingLevel m_level;
+    std::string m_path;
+    int m_fd;
+    std::unique_ptr<SinkSocket> m_socket;
+
+    //Empty is every category -- otherwise the names of the enabled categories with the decision for each category id cached as we see them (0 unknown, 1 enabled, 2 disabled)
+    std::vector<std::string> m_categories;
+    std::vector<uint8_t> m_categoryCache;
+
+    std::string m_buff;
+
+    std::atomic<uint64_t> m_messages;
+    std::atomic<uint64_t> m_bytes;
+    std::atomic<uint64_t> m_failures;
+
+public:
+    LogSink(SinkOutput output, SinkMode mode, LoggingLevel level, std::string&& path, std::vector<std::string>&& categories) :
+        m_output(output), m_mode(mode), m_level(level), m_path(std::move(path)), m_fd(-1), m_socket(nullptr),
+        m_categories(std::move(categories)), m_categoryCache(), m_buff(), m_messages(0), m_bytes(0), m_failures(0)
+    {
+        ;
+    }
+
+    ~LogSink()
+    {
+        if (this->m_output == SinkOutput::File && this->m_fd >= 0)
+        {
+            CloseOutputFile(this->m_fd);
+        }
+    }
+
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    bool Open()
+    {
+        switch (this->m_output)
+        {
+        case SinkOutput::Stdout:
+            this->m_fd = 1;
+            break;
+        case SinkOutput::Stderr:
+            this->m_fd = 2;
+            break;
+        case SinkOutput::Socket:
+        case SinkOutput::Datagram:
+            this->m_socket.reset(new SinkSocket(this->m_path, this->m_output == SinkOutput::Datagram));
+            return this->m_socket->Open();
+        default:
+            this->m_fd = OpenOutputFile(this->m_path);
+            break;
+        }
+
+        return this->m_fd >= 0;
+    }
+
+    SinkOutput GetOutput() const { return this->m_output; }
+    SinkMode GetMode() const { return this->m_mode; }
+    LoggingLevel GetLevel() const { return this->m_level; }
+    const std::string& GetPath() const { return this->m_path; }
+
+    //nullptr unless this is a socket output
+    const SinkSocket* GetSocket() const { return this->m_socket.get(); }
+
+    uint64_t GetMessageCount() const { return this->m_messages.load(std::memory_order_relaxed); }
+    uint64_t GetByteCount() const { return (this->m_socket != nullptr) ? this->m_socket->GetSentBytes() : this->m_bytes.load(std::memory_order_relaxed); }
+    uint64_t GetFailureCount() const { return (this->m_socket != nullptr) ? this->m_socket->GetDroppedFrames() : this->m_failures.load(std::memory_order_relaxed); }
+
+    bool Accepts(LoggingLevel level, int64_t categoryId, const LoggingEnvironment* lenv)
+    {
+        if (!LOG_LEVEL_ENABLED(level, this->m_level))
+        {
+            return false;
+        }
+
+        if (this->m_categories.empty())
+        {
+            return true;
+        }
+
+        const size_t pos = static_cast<size_t>(categoryId);
+        if (pos >= this->m_categoryCache.size())
+        {
+            this->m_categoryCache.resize(pos + 1, 0);
+        }
+
+        if (this->m_categoryCache[pos] == 0)
+        {
+            const std::string& name = lenv->GetCategoryName(categoryId);
+            const bool enabled = std::find(this->m_categories.cbegin(), this->m_categories.cend(), name) != this->m_categories.cend();
+            this->m_categoryCache[pos] = enabled ? 1 : 2;
+        }
+
+        return this->m_categoryCache[pos] == 1;
+    }
+
+    //Add a rendered message (in one or two pieces so the prefix and message text don't need to be copied together first)
+    void Append(const char* data, size_t length, const char* more = nullptr, size_t moreLength = 0)
+    {
+        //each datagram holds whole messages so send what we have first if this one would not fit
+        const size_t limit = (this->m_output == SinkOutput::Datagram) ? SINK_SOCKET_DATAGRAM_SIZE : SINK_BUFFER_FLUSH_SIZE;
+        if (this->m_output == SinkOutput::Datagram && !this->m_buff.empty() && this->m_buff.size() + length + moreLength > limit)
+        {
+            this->Flush();
+        }
+
+        this->m_buff.append(data, length);
+        if (more != nullptr)
+        {
+            this->m_buff.append(more, moreLength);
+        }
+        this->m_messages.fetch_add(1, std::memory_order_relaxed);
+
+        if (this->m_buff.size() >= limit)
+        {
+            this->Flush();
+        }
+    }
+
+    //Write out whatever is buffered -- a failed write is counted and the output dropped (so one bad sink does not hold up the others)
+    void Flush()
+    {
+        if (this->m_socket != nullptr)
+        {
+            //also retries any frames left from earlier flushes
+            this->m_socket->Write(this->m_buff);
+            this->m_buff.clear();
+            return;
+        }
+
+        if (this->m_buff.empty())
+        {
+            return;
+        }
+
+        TraceSpan span("sinkWrite");
+        span.SetArgs("bytes", static_cast<double>(this->m_buff.size()));
+
+        if (WriteOutputFully(this->m_fd, this->m_buff.c_str(), this->m_buff.size()))
+        {
+            this->m_bytes.fetch_add(this->m_buff.size(), std::memory_order_relaxed);
+        }
+        else
+        {
+            this->m_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        this->m_buff.clear();
+    }
+
+    //Give a socket output until the deadline to send any frames it is holding
+    void FlushUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        this->Flush();
+        if (this->m_socket != nullptr)
+        {
+            this->m_socket->SendUntil(deadline);
+        }
+    }
+};
+
+//Like the columnar writer -- every environment pushes its processed blocks into a lock-free queue and a single native writer thread writes them to all the sinks.
+//Each block is walked once and each message is formatted once (the message text) with the prefix and NDJSON forms built around that text only if a matching sink uses them.
+class SinkFanout
+{
+private:
+    LoggingRegistry* m_registry;
+
+    //Only touched by the writer thread (once started)
+    std::vector<std::unique_ptr<LogSink>> m_sinks;
+    std::unique_ptr<LoggingEnvironment> m_lenv;
+    std::vector<LogSink*> m_matched;
+    Formatter m_body;
+    Formatter m_prefix;
+    Formatter m_json;
+    std::string m_scratch;
+
+    BackgroundWriter<std::shared_ptr<LogProcessingBlock>> m_writer;
+
+    void RenderPrefix(Formatter* prefix, LoggingLevel level, int64_t categoryId, std::time_t walltime, const std::string* logger) const
+    {
+        prefix->reset();
+        prefix->emitLiteralString(this->m_lenv->GetPrefixHead(level, categoryId));
+        prefix->emitJsDate(walltime, FormatStringEnum::DATEISO, false);
+        prefix->emitLiteralString(this->m_lenv->GetPrefixTail(logger != nullptr ? *logger : std::string()));
+    }
+
+    void RenderNDJson(Formatter* json, std::string* scratch, const Formatter* body, LoggingLevel level, int64_t categoryId, std::time_t walltime, const std::string* logger) const
+    {
+        json->reset();
+        json->emitLiteralString("{\"time\": ");
+        json->emitJsDate(walltime, FormatStringEnum::DATEISO, true);
+        json->emitLiteralString(", \"level\": ");
+        json->emitJsString(this->m_lenv->GetLogLevelName(level));
+        json->emitLiteralString(", \"category\": ");
+        json->emitJsString(this->m_lenv->GetCategoryName(categoryId));
+        if (logger != nullptr)
+        {
+            json->emitLiteralString(", \"logger\": ");
+            json->emitJsString(*logger);
+        }
+
+        //the message text without its newline
+        scratch->assign(body->getOutputBuffer(), body->getOutputBufferSize() - 1);
+        json->emitLiteralString(", \"msg\": ");
+        json->emitJsString(*scratch);
+        json->emitLiteralString("}\n");
+    }
+
+    //On the writer thread
+    void WriteBlock(std::shared_ptr<LogProcessingBlock>& block)
+    {
+        const LoggingEnvironment* lenv = this->m_lenv.get();
+        std::vector<LogSink*>& matched = this->m_matched;
+        Formatter* body = &this->m_body;
+
+        block->resetFormatPosition();
+        while (block->hasMoreFormatEntries())
+        {
+            const LoggingLevel level = block->getFormatEntryLevel();
+            const int64_t categoryId = block->getFormatEntryCategory();
+
+            bool needPrefix = false;
+            bool needJson = false;
+            matched.clear();
+            for (size_t i = 0; i < this->m_sinks.size(); ++i)
+            {
+                if (this->m_sinks[i]->Accepts(level, categoryId, lenv))
+                {
+                    matched.push_back(this->m_sinks[i].get());
+                    needPrefix |= (this->m_sinks[i]->GetMode() == SinkMode::Text);
+                    needJson |= (this->m_sinks[i]->GetMode() == SinkMode::NDJson);
+                }
+            }
+
+            if (matched.empty())
+            {
+                block->skipFormatEntry();
+                continue;
+            }
+
+            const std::time_t walltime = block->getFormatEntryWallTime();
+            const std::string* logger = block->getFormatEntryLogger();
+
+            body->reset();
+            if (!block->emitFormatEntry(body, lenv, false))
+            {
+                continue;
+            }
+
+            if (needPrefix)
+            {
+                this->RenderPrefix(&this->m_prefix, level, categoryId, walltime, logger);
+            }
+
+            if (needJson)
+            {
+                this->RenderNDJson(&this->m_json, &this->m_scratch, body, level, categoryId, walltime, logger);
+            }
+
+            for (size_t i = 0; i < matched.size(); ++i)
+            {
+                switch (matched[i]->GetMode())
+                {
+                case SinkMode::Text:
+                    matched[i]->Append(this->m_prefix.getOutputBuffer(), this->m_prefix.getOutputBufferSize(), body->getOutputBuffer(), body->getOutputBufferSize());
+                    break;
+                case SinkMode::Plain:
+                    matched[i]->Append(body->getOutputBuffer(), body->getOutputBufferSize());
+                    break;
+                default:
+                    matched[i]->Append(this->m_json.getOutputBuffer(), this->m_json.getOutputBufferSize());
+                    break;
+                }
+            }
+        }
+    }
+
+    //On the writer thread
+    void FlushSinks(bool flushing)
+    {
+        for (size_t i = 0; i < this->m_sinks.size(); ++i)
+        {
+            this->m_sinks[i]->Flush();
+        }
+
+        if (flushing)
+        {
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SINK_SOCKET_FLUSH_WAIT);
+            for (size_t i = 0; i < this->m_sinks.size(); ++i)
+            {
+                this->m_sinks[i]->FlushUntil(deadline);
+            }
+        }
+    }
+
+public:
+    SinkFanout(LoggingRegistry* registry) :
+        m_registry(registry), m_sinks(), m_lenv(nullptr), m_matched(), m_body(), m_prefix(), m_json(), m_scratch(),
+        m_writer("logpp-sinks", [this](std::shared_ptr<LogProcessingBlock>& block) { this->WriteBlock(block); }, [this](bool flushing, bool stopping) { this->FlushSinks(flushing); })
+    {
+        ;
+    }
+
+    ~SinkFanout()
+    {
+        this->Stop();
+    }
+
+    //Open the sinks and start the writer -- returns false if a sink could not be opened.
+    //If the writer is already running (e.g., started by the main thread) the new sinks are ignored and every environment shares the running ones.
+    bool Start(std::vector<std::unique_ptr<LogSink>>&& sinks, const std::string& hostName, const std::string& appName)
+    {
+        return this->m_writer.Start([&](bool running) {
+            if (running)
+            {
+                return true;
+            }
+
+            for (size_t i = 0; i < sinks.size(); ++i)
+            {
+                if (!sinks[i]->Open())
+                {
+                    return false;
+                }
+            }
+
+            this->m_sinks = std::move(sinks);
+            this->m_lenv.reset(new LoggingEnvironment(this->m_registry, LoggingLevel::LLALL, hostName, appName));
+            return true;
+        });
+    }
+
+    bool IsStarted()
+    {
+        return this->m_writer.IsRunning();
+    }
+
+    //The sinks never change once the writer is started so the JS thread can read their counters
+    const std::vector<std::unique_ptr<LogSink>>& GetSinks() const { return this->m_sinks; }
+
+    //Safe to call from any thread without blocking
+    void Submit(std::shared_ptr<LogProcessingBlock> block)
+    {
+        this->m_writer.Submit(std::move(block));
+    }
+
+    //Block until everything submitted (by any thread) before this call has been written to the sinks
+    void Flush()
+    {
+        this->m_writer.Flush();
+    }
+
+    void Stop()
+    {
+        this->m_writer.Stop();
+    }
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+//Opt-in timeline of the flush pipeline in the Chrome trace-event format (load the file in chrome://tracing or Perfetto).
+//Spans come from the JS threads, the format threads, and the native writers so there is one recorder for the process -- events are
+//buffered under a lock (only when tracing is on) and written out in TRACE_BUFFER_FLUSH_SIZE chunks. The file is a JSON array of
+//events which the viewers accept even if the closing ] is missing (e.g., if the process dies while tracing).
+class TraceRecorder
+{
+private:
+    std::atomic<bool> m_enabled;
+
+    std::mutex m_lock;
+    int m_fd;
+    std::string m_buff;
+    bool m_firstEvent;
+    uint64_t m_generation; //bumped on every start so threads re-announce their names in the new file
+
+    std::atomic<int64_t> m_startTicks; //steady clock ticks (read without the lock by Now)
+    std::atomic<uint64_t> m_nextAsyncId;
+    std::atomic<int32_t> m_nextThreadId;
+
+    static int32_t& CurrentThreadId()
+    {
+        static thread_local int32_t s_tid = 0;
+        return s_tid;
+    }
+
+    static const char*& CurrentThreadName()
+    {
+        static thread_local const char* s_name = "js";
+        return s_name;
+    }
+
+    static uint64_t& CurrentThreadGeneration()
+    {
+        static thread_local uint64_t s_generation = 0;
+        return s_generation;
+    }
+
+    static int32_t GetProcessId()
+    {
+#ifdef _WIN32
+        return static_cast<int32_t>(_getpid());
+#else
+        return static_cast<int32_t>(getpid());
+#endif
+    }
+
+    //Must hold m_lock
+    void AppendEvent(const char* event, int length)
+    {
+        if (length <= 0)
+        {
+            return;
+        }
+
+        if (!this->m_firstEvent)
+        {
+            this->m_buff.append(",\n");
+        }
+        this->m_firstEvent = false;
+        this->m_buff.append(event, static_cast<size_t>(length));
+
+        if (this->m_buff.size() >= TRACE_BUFFER_FLUSH_SIZE)
+        {
+            WriteOutputFully(this->m_fd, this->m_buff.c_str(), this->m_buff.size());
+            this->m_buff.clear();
+        }
+    }
+
+    //Must hold m_lock -- the id for this thread (and its name the first time it shows up in this trace)
+    int32_t GetThreadId()
+    {
+        int32_t& tid = CurrentThreadId();
+        if (tid == 0)
+        {
+            tid = this->m_nextThreadId.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t& generation = CurrentThreadGeneration();
+        if (generation != this->m_generation)
+        {
+            generation = this->m_generation;
+
+            char event[256];
+            const int length = snprintf(event, sizeof(event), "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", GetProcessId(), tid, CurrentThreadName());
+            this->AppendEvent(event, length);
+        }
+
+        return tid;
+    }
+
+    //Must hold m_lock
+    void AppendArgs(char* event, size_t size, int& length, const char* arg1, double v1, const char* arg2, double v2)
+    {
+        if (length < 0 || static_cast<size_t>(length) >= size)
+        {
+            length = -1;
+            return;
+        }
+
+        if (arg1 == nullptr)
+        {
+            length += snprintf(event + length, size - static_cast<size_t>(length), "}");
+        }
+        else if (arg2 == nullptr)
+        {
+            length += snprintf(event + length, size - static_cast<size_t>(length), ", \"args\": {\"%s\": %.0f}}", arg1, v1);
+        }
+        else
+        {
+            length += snprintf(event + length, size - static_cast<size_t>(length), ", \"args\": {\"%s\": %.0f, \"%s\": %.0f}}", arg1, v1, arg2, v2);
+        }
+
+        if (static_cast<size_t>(length) >= size)
+        {
+            length = -1;
+        }
+    }
+
+public:
+    TraceRecorder() :
+        m_enabled(false), m_lock(), m_fd(-1), m_buff(), m_firstEvent(true), m_generation(0),
+        m_startTicks(std::chrono::steady_clock::now().time_since_epoch().count()), m_nextAsyncId(1), m_nextThreadId(1)
+    {
+        ;
+    }
+
+    ~TraceRecorder()
+    {
+        this->Stop();
+    }
+
+    //Name the calling thread in the traces (e.g., "logpp-format") -- cheap so threads can do it whether or not tracing is on
+    static void SetCurrentThreadName(const char* name)
+    {
+        CurrentThreadName() = name;
+    }
+
+    bool IsEnabled() const { return this->m_enabled.load(std::memory_order_relaxed); }
+
+    //Start writing a new trace to path (ending any trace in progress) -- returns false if the file cannot be created
+    bool Start(const std::string& path)
+    {
+        this->Stop();
+
+        std::lock_guard<std::mutex> lock(this->m_lock);
+
+        this->m_fd = CreateOutputFile(path);
+        if (this->m_fd < 0)
+        {
+            return false;
+        }
+
+        this->m_buff.assign("[\n");
+        this->m_firstEvent = true;
+        this->m_generation++;
+        this->m_startTicks.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
+        this->m_enabled.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Stop()
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (this->m_fd < 0)
+        {
+            return;
+        }
+
+        this->m_enabled.store(false, std::memory_order_relaxed);
+
+        this->m_buff.append("\n]\n");
+        WriteOutputFully(this->m_fd, this->m_buff.c_str(), this->m_buff.size());
+        CloseOutputFile(this->m_fd);
+
+        this->m_fd = -1;
+        this->m_buff.clear();
+    }
+
+    //Microseconds since the trace started
+    double Now() const
+    {
+        const std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::duration(this->m_startTicks.load(std::memory_order_relaxed)) };
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    //A complete span on the calling thread
+    void Span(const char* name, double startUs, double endUs, const char* arg1 = nullptr, double v1 = 0.0, const char* arg2 = nullptr, double v2 = 0.0)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (!this->IsEnabled())
+        {
+            return;
+        }
+
+        const int32_t tid = this->GetThreadId();
+
+        char event[512];
+        int length = snprintf(event, sizeof(event), "{\"name\": \"%s\", \"cat\": \"logpp\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d", name, startUs, std::max<double>(endUs - startUs, 0.0), GetProcessId(), tid);
+        this->AppendArgs(event, sizeof(event), length, arg1, v1, arg2, v2);
+        this->AppendEvent(event, length);
+    }
+
+    //Start of a span that can end on another thread (like a block waiting in a queue) -- returns the id to end it with (0 if tracing is off)
+    uint64_t AsyncBegin(const char* name, const char* arg1 = nullptr, double v1 = 0.0, const char* arg2 = nullptr, double v2 = 0.0)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (!this->IsEnabled())
+        {
+            return 0;
+        }
+
+        const uint64_t id = this->m_nextAsyncId.fetch_add(1, std::memory_order_relaxed);
+        const int32_t tid = this->GetThreadId();
+
+        char event[512];
+        int length = snprintf(event, sizeof(event), "{\"name\": \"%s\", \"cat\": \"logpp\", \"ph\": \"b\", \"id\": %llu, \"ts\": %.3f, \"pid\": %d, \"tid\": %d", name, static_cast<unsigned long long>(id), this->Now(), GetProcessId(), tid);
+        this->AppendArgs(event, sizeof(event), length, arg1, v1, arg2, v2);
+        this->AppendEvent(event, length);
+
+        return id;
+    }
+
+    //A whole async span that was timed by JS (so it can overlap the other spans on the thread)
+    void AsyncSpan(const char* name, double startUs, double endUs, const char* arg1 = nullptr, double v1 = 0.0)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (!this->IsEnabled())
+        {
+            return;
+        }
+
+        const uint64_t id = this->m_nextAsyncId.fetch_add(1, std::memory_order_relaxed);
+        const int32_t tid = this->GetThreadId();
+
+        char event[512];
+        int length = snprintf(event, sizeof(event), "{\"name\": \"%s\", \"cat\": \"logpp\", \"ph\": \"b\", \"id\": %llu, \"ts\": %.3f, \"pid\": %d, \"tid\": %d", name, static_cast<unsigned long long>(id), startUs, GetProcessId(), tid);
+        this->AppendArgs(event, sizeof(event), length, arg1, v1, nullptr, 0.0);
+        this->AppendEvent(event, length);
+
+        length = snprintf(event, sizeof(event), "{\"name\": \"%s\", \"cat\": \"logpp\", \"ph\": \"e\", \"id\": %llu, \"ts\": %.3f, \"pid\": %d, \"tid\": %d}", name, static_cast<unsigned long long>(id), std::max<double>(endUs, startUs), GetProcessId(), tid);
+        this->AppendEvent(event, length);
+    }
+
+    void AsyncEnd(const char* name, uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (!this->IsEnabled() || id == 0)
+        {
+            return;
+        }
+
+        const int32_t tid = this->GetThreadId();
+
+        char event[256];
+        const int length = snprintf(event, sizeof(event), "{\"name\": \"%s\", \"cat\": \"logpp\", \"ph\": \"e\", \"id\": %llu, \"ts\": %.3f, \"pid\": %d, \"tid\": %d}", name, static_cast<unsigned long long>(id), this->Now(), GetProcessId(), tid);
+        this->AppendEvent(event, length);
+    }
+};
+
+//The recorder for the process (shared by every environment and native thread) -- never destroyed since the native writer threads can still be tracing while the statics are torn down at exit
+//(an unfinished trace is still readable -- see above)
+static TraceRecorder& GetTraceRecorder()
+{
+    static TraceRecorder* s_recorder = new TraceRecorder();
+    return *s_recorder;
+}
+
+//Records a span for the enclosing scope if tracing was on when it started
+class TraceSpan
+{
+private:
+    const char* m_name;
+    double m_start;
+    bool m_active;
+
+    const char* m_arg1;
+    double m_v1;
+    const char* m_arg2;
+    double m_v2;
+
+public:
+    TraceSpan(const char* name) :
+        m_name(name), m_start(0.0), m_active(GetTraceRecorder().IsEnabled()), m_arg1(nullptr), m_v1(0.0), m_arg2(nullptr), m_v2(0.0)
+    {
+        if (this->m_active)
+        {
+            this->m_start = GetTraceRecorder().Now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (this->m_active)
+        {
+            GetTraceRecorder().Span(this->m_name, this->m_start, GetTraceRecorder().Now(), this->m_arg1, this->m_v1, this->m_arg2, this->m_v2);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    bool IsActive() const { return this->m_active; }
+
+    void SetArgs(const char* arg1, double v1, const char* arg2 = nullptr, double v2 = 0.0)
+    {
+        this->m_arg1 = arg1;
+        this->m_v1 = v1;
+        this->m_arg2 = arg2;
+        this->m_v2 = v2;
+    }
+};
@@ -0,0 +1,173 @@
+"use strict";
+
+const fs = require("fs");
+
+const ColumnarSegmentMagic = 0x5343504C;
+const ColumnarSegmentVersion = 1;
+
+/**
+ * Enum values for the column types in a segment file
+ */
+const ColumnTypes = {
+    TimeDelta: 0x1,
+    Float64: 0x2,
+    UInt8: 0x3,
+    UInt32: 0x4,
+    DictString: 0x5,
+    DictJson: 0x6
+};
+
+/**
+ * Bounds checked reads from a segment file buffer (native byte order -- we assume little endian like the hosts writing them).
+ * @constructor
+ * @param {Buffer} buff the segment file contents
+ */
+function SegmentReader(buff) {
+    this.buff = buff;
+    this.pos = 0;
+}
+
+SegmentReader.prototype.check = function (bytes) {
+    if (this.pos + bytes > this.buff.length) {
+        throw new Error("Truncated columnar segment");
+    }
+};
+
+SegmentReader.prototype.readU8 = function () {
+    this.check(1);
+    return this.buff.readUInt8(this.pos++);
+};
+
+SegmentReader.prototype.readU32 = function () {
+    this.check(4);
+    const value = this.buff.readUInt32LE(this.pos);
+    this.pos += 4;
+    return value;
+};
+
+SegmentReader.prototype.readI64 = function () {
+    this.check(8);
+    const value = this.buff.readInt32LE(this.pos + 4) * 4294967296 + this.buff.readUInt32LE(this.pos);
+    this.pos += 8;
+    return value;
+};
+
+SegmentReader.prototype.readF64 = function () {
+    this.check(8);
+    const value = this.buff.readDoubleLE(this.pos);
+    this.pos += 8;
+    return value;
+};
+
+SegmentReader.prototype.readString = function () {
+    const length = this.readU32();
+    this.check(length);
+    const value = this.buff.toString("utf8", this.pos, this.pos + length);
+    this.pos += length;
+    return value;
+};
+
+SegmentReader.prototype.readZigZagVarInt = function () {
+    let value = 0;
+    let scale = 1;
+    let byte = 0;
+    do {
+        byte = this.readU8();
+        value += (byte & 0x7F) * scale;
+        scale *= 128;
+    } while ((byte & 0x80) !== 0);
+
+    return (value % 2 === 0) ? (value / 2) : -((value + 1) / 2);
+};
+
+function readColumnValues(reader, type, rows) {
+    const values = new Array(rows);
+    if (type === ColumnTypes.TimeDelta) {
+        let time = reader.readI64();
+        const end = reader.readU32() + reader.pos;
+        for (let i = 0; i < rows; ++i) {
+            time += reader.readZigZagVarInt();
+            values[i] = time;
+        }
+        if (reader.pos !== end) {
+            throw new Error("Bad time column in columnar segment");
+        }
+    }
+    else if (type === ColumnTypes.Float64) {
+        for (let i = 0; i < rows; ++i) {
+            values[i] = reader.readF64();
+        }
+    }
+    else if (type === ColumnTypes.UInt8) {
+        for (let i = 0; i < rows; ++i) {
+            values[i] = reader.readU8();
+        }
+    }
+    else if (type === ColumnTypes.UInt32) {
+        for (let i = 0; i < rows; ++i) {
+            values[i] = reader.readU32();
+        }
+    }
+    else if (type === ColumnTypes.DictString || type === ColumnTypes.DictJson) {
+        const dict = new Array(reader.readU32());
+        for (let i = 0; i < dict.length; ++i) {
+            dict[i] = reader.readString();
+        }
+        for (let i = 0; i < rows; ++i) {
+            values[i] = dict[reader.readU32()];
+        }
+    }
+    else {
+        throw new Error("Unknown column type in columnar segment");
+    }
+
+    return values;
+}
+
+/**
+ * Read a columnar segment file (written with the "columnar" flushTarget) into plain arrays.
+ * @function
+ * @param {string} file the segment file to read
+ * @returns {Object} { formatId, formatName, formatString, rows, columns } where columns maps each column name to its array of values (null for missing values)
+ */
+function readColumnarSegment(file) {
+    const reader = new SegmentReader(fs.readFileSync(file));
+    if (reader.readU32() !== ColumnarSegmentMagic || reader.readU32() !== ColumnarSegmentVersion) {
+        throw new Error("Not a columnar segment (or from an incompatible version)");
+    }
+
+    const formatId = reader.readU32();
+    const formatName = reader.readString();
+    const formatString = reader.readString();
+    const rows = reader.readU32();
+
+    const schema = new Array(reader.readU32());
+    for (let i = 0; i < schema.length; ++i) {
+        schema[i] = { name: reader.readString(), type: reader.readU8() };
+    }
+
+    const columns = {};
+    for (let i = 0; i < schema.length; ++i) {
+        reader.check(rows);
+        const valid = reader.buff.slice(reader.pos, reader.pos + rows);
+        reader.pos += rows;
+
+        const values = readColumnValues(reader, schema[i].type, rows);
+        for (let j = 0; j < rows; ++j) {
+            if (valid[j] === 0) {
+                values[j] = null;
+            }
+            else if (schema[i].type === ColumnTypes.UInt8) {
+                values[j] = (values[j] !== 0);
+            }
+        }
+        columns[schema[i].name] = values;
+    }
+
+    return { formatId: formatId, formatName: formatName, formatString: formatString, rows: rows, columns: columns };
+}
+
+module.exports = {
+    ColumnTypes: ColumnTypes,
+    readColumnarSegment: readColumnarSegment
+};
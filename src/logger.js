@@ -81,6 +81,15 @@ function sanitizeLogLevel(level) {
     }
 }
 
+/*
+ * What native processing does when it goes over the memory budget (must match MemoryPolicy in memorybudget.h)
+ */
+const MemoryPolicies = {
+    FLUSH: 0x1,
+    DROP_LEVELS: 0x2,
+    DROP_OLDEST: 0x3
+};
+
 /*
  * Default values we expand objects and arrays
  */
@@ -185,6 +194,8 @@ const LogEntryTags = {
     RParen: 0x9,
     LBrack: 0xA,
     RBrack: 0xB,
+    LShape: 0xC,
+    MsgLoggerId: 0xD,
 
     JsVarValue_Undefined: 0x11,
     JsVarValue_Null: 0x12,
@@ -254,7 +265,19 @@ const s_environment = {
     flushCB: () => { },
 
     //Set if we emit a default prefix (level/category/timestamp) on every log message
-    doPrefix: true
+    doPrefix: true,
+
+    //Messages at (or above) this level are written as soon as they are logged instead of with the next batch -- default none
+    priorityLevel: LoggingLevels.OFF,
+
+    //Set if priority messages are fsync'd before the log call returns
+    prioritySync: false,
+
+    //Set if the native flush scheduler is adapting the flush limits/delays (so we report how long our writes take)
+    adaptiveFlush: false,
+
+    //Set if we are writing a trace of the flush pipeline (so we report our flushes and writes)
+    tracing: false
 };
 
 //This state is common to all loggers and will be shared.
@@ -570,6 +593,7 @@ function extractMsgFormat(fmtName, fmtInfo) {
     const formatArray = [];
     const kindArray = new Uint8Array(fArray.length);
     const enumArray = new Uint8Array(fArray.length);
+    const expandArray = new Int32Array(2 * fArray.length);
 
     const initialFormatSegment = (fArray.length !== 0) ? fmtString.substr(0, fArray[0].formatStart) : fmtString;
     const tailingFormatSegmentArray = [];
@@ -579,6 +603,8 @@ function extractMsgFormat(fmtName, fmtInfo) {
         formatArray.push(fentry.fmt);
         kindArray[i] = fentry.fmt.kind;
         enumArray[i] = fentry.fmt.enum;
+        expandArray[2 * i] = fentry.fmt.expandDepth;
+        expandArray[2 * i + 1] = fentry.fmt.expandLength;
 
         const start = fentry.formatEnd;
         const end = (i + 1 < fArray.length) ? fArray[i + 1].formatStart : fmtString.length;
@@ -586,10 +612,10 @@ function extractMsgFormat(fmtName, fmtInfo) {
         tailingFormatSegmentArray.push(fmtString.substr(start, end - start));
     }
 
-    const fmtId = s_fmtMap.length;
-    nlogger.registerFormat(fmtId, kindArray, enumArray, initialFormatSegment, tailingFormatSegmentArray, fmtString);
+    //format ids are assigned natively so they are the same in every thread (e.g., when aggregating output from worker_threads)
+    const fmtId = nlogger.registerFormat(fmtName, kindArray, enumArray, expandArray, initialFormatSegment, tailingFormatSegmentArray, fmtString);
     const fmtObj = createMsgFormat(fmtName, fmtId, formatArray);
-    s_fmtMap.push(fmtObj);
+    s_fmtMap[fmtId] = fmtObj;
 
     //memoize the result
     s_fmtStringToIdMap.set(fmtMemoString, fmtObj.formatId);
@@ -597,6 +623,44 @@ function extractMsgFormat(fmtName, fmtInfo) {
     return fmtObj.formatId;
 }
 
+/**
+ * Load a compiled format catalog (written by saveFormatCatalog) and build our format objects from it without parsing any format strings.
+ * @function
+ * @param {string} catalogFile the catalog file to load
+ * @returns {Object[]} the format objects for the formats in the catalog
+ */
+function loadFormatCatalog(catalogFile) {
+    const catalog = nlogger.loadFormatCatalog(catalogFile);
+    const layout = catalog.layout;
+
+    const loaded = [];
+    let lpos = 0;
+    for (let i = 0; i < catalog.names.length; ++i) {
+        const fmtId = layout[lpos];
+        const entryCount = layout[lpos + 1];
+        lpos += 2;
+
+        let argPosition = 0;
+        const formatArray = [];
+        for (let j = 0; j < entryCount; ++j) {
+            const kind = layout[lpos];
+            const tag = layout[lpos + 1];
+            const argpos = (tag >= FormatStringEnum.ARGREQUIRED) ? argPosition++ : -1;
+
+            formatArray.push(createMsgFormatEntry(kind, tag, argpos, layout[lpos + 2], layout[lpos + 3]));
+            lpos += 4;
+        }
+
+        if (s_fmtMap[fmtId] === undefined) {
+            s_fmtMap[fmtId] = createMsgFormat(catalog.names[i], fmtId, formatArray);
+            s_fmtStringToIdMap.set(catalog.names[i] + catalog.formatStrings[i], fmtId);
+        }
+        loaded.push(s_fmtMap[fmtId]);
+    }
+
+    return loaded;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 //Define structure for representing the in memory log entries.
 //We want to be able to efficiently copy any data needed to construct the log message into this structure.
@@ -614,6 +678,10 @@ const MemoryMsgBlockLimitSize = 16384;
 
 let s_blockIdCtr = 0;
 
+//Blocks that native processing read in place (and has given back) are kept here by size for reuse -- at most MemoryMsgBlockPoolLimit of each size
+const MemoryMsgBlockPoolLimit = 4;
+const s_memoryMsgBlockPool = new Map();
+
 function sizeUp(sizespec) {
     const nextTry = MemoryMsgBlockSizes.find((size) => sizespec < size);
     return nextTry || MemoryMsgBlockLimitSize;
@@ -642,18 +710,33 @@ function blockSize(utilization, size) {
 function createMemoryMsgBlock(previousBlock, blocksize) {
     diaglog("createMemoryMsgBlock", { blocksize: blocksize, blockId: s_blockIdCtr });
 
-    const nblock = {
-        spos: 0,
-        epos: 0,
-        tags: new Uint8Array(blocksize),
-        data: new Float64Array(blocksize),
-        stringData: [],
-        stringMap: new Map(),
-        next: null,
-        blocksize: blocksize,
-        previous: previousBlock,
-        blockId: s_blockIdCtr++
-    };
+    const pool = s_memoryMsgBlockPool.get(blocksize);
+    let nblock = undefined;
+    if (pool !== undefined && pool.length !== 0) {
+        //the old tags/data can be left as they are since a slot is always written before it is read
+        nblock = pool.pop();
+        nblock.spos = 0;
+        nblock.epos = 0;
+        nblock.stringData = [];
+        nblock.stringMap = new Map();
+        nblock.next = null;
+        nblock.previous = previousBlock;
+        nblock.blockId = s_blockIdCtr++;
+    }
+    else {
+        nblock = {
+            spos: 0,
+            epos: 0,
+            tags: new Uint8Array(blocksize),
+            data: new Float64Array(blocksize),
+            stringData: [],
+            stringMap: new Map(),
+            next: null,
+            blocksize: blocksize,
+            previous: previousBlock,
+            blockId: s_blockIdCtr++
+        };
+    }
 
     if (previousBlock) {
         previousBlock.next = nblock;
@@ -662,6 +745,47 @@ function createMemoryMsgBlock(previousBlock, blocksize) {
     return nblock;
 }
 
+//internal function for taking back the blocks that native processing is done reading
+function recycleMemoryMsgBlocks(blocks) {
+    diaglog("recycleMemoryMsgBlocks", { count: blocks.length });
+
+    for (let i = 0; i < blocks.length; ++i) {
+        const block = blocks[i];
+
+        let pool = s_memoryMsgBlockPool.get(block.blocksize);
+        if (pool === undefined) {
+            pool = [];
+            s_memoryMsgBlockPool.set(block.blocksize, pool);
+        }
+
+        if (pool.length < MemoryMsgBlockPoolLimit) {
+            block.stringData = null;
+            block.stringMap = null;
+            pool.push(block);
+        }
+    }
+}
+
+/**
+ * Slots in the control record shared with nlogger.processMsgChain (keep in sync with PROCESS_CONTROL_* in common.h)
+ */
+const ProcessControl = {
+    Now: 0,
+    ForceAll: 1,
+    FullDetail: 2,
+    ConsumedBlocks: 3,
+    HeadSpos: 4,
+    MemoryPressure: 5,
+    EffectiveLevel: 6,
+    FlushDelay: 7,
+    RetryDelay: 8,
+    Size: 10
+};
+
+//The fixed flush delays -- used until native processing gives us the (possibly adaptive) delays from the flush scheduler
+const DefaultFlushDelay = 500;
+const DefaultFlushRetryDelay = 250;
+
 /**
  * InMemoryLog constructor
  * @constructor
@@ -673,6 +797,14 @@ function InMemoryLog() {
 
     this.stringCtr = 0;
     this.writeCount = 0;
+
+    //set when native processing reports we are over the memory budget (with the FLUSH policy)
+    this.memoryPressure = false;
+
+    //inputs/results for native processing so a flush is a single call no matter how many blocks we have (native code still reads the properties of each block)
+    this.processControl = new Float64Array(ProcessControl.Size);
+    this.processControl[ProcessControl.FlushDelay] = DefaultFlushDelay;
+    this.processControl[ProcessControl.RetryDelay] = DefaultFlushRetryDelay;
 }
 
 /**
@@ -738,8 +870,11 @@ InMemoryLog.prototype.removeHeadBlock = function (utilization) {
         this.reset(blockSize(utilization, this.head.blocksize));
     }
     else {
-        this.head = this.head.next;
+        //native processing may still be reading the old head in place so unlink it (it should not keep the rest of the chain alive)
+        const oldHead = this.head;
+        this.head = oldHead.next;
         this.head.previous = null;
+        oldHead.next = null;
     }
 };
 
@@ -769,6 +904,13 @@ InMemoryLog.prototype.addMsgHeader = function (fmt, level, category, env) {
     block.data[block.epos] = Date.now();
     block.epos++;
 
+    //the native level masks look for the sublogger id right after the walltime (the root logger is 0 and has no entry)
+    if (env.LOGGER_ID !== 0) {
+        block.tags[block.epos] = LogEntryTags.MsgLoggerId;
+        block.data[block.epos] = env.LOGGER_ID;
+        block.epos++;
+    }
+
     if (s_environment.doPrefix) {
         this.addStringEntry(LogEntryTags.MSGLogger, env.LOGGER);
     }
@@ -876,6 +1018,34 @@ InMemoryLog.prototype.addGeneralValue = function (value, depth, length) {
     }
 };
 
+//Object shapes are stored in a trie of property names -- each node is the shape for the names on the path to it and is registered (natively) the first time an object ends there
+const MaxObjectShapeNodes = 16384;
+
+function createObjectShapeNode(parent, key) {
+    return {
+        parent: parent,
+        key: key,
+        shapeId: -1,
+        children: new Map()
+    };
+}
+
+const s_objectShapeRoot = createObjectShapeNode(null, undefined);
+let s_objectShapeNodeCount = 1;
+
+function getObjectShapeId(shape) {
+    if (shape.shapeId === -1) {
+        const keys = [];
+        for (let node = shape; node.parent !== null; node = node.parent) {
+            keys.push(node.key);
+        }
+
+        shape.shapeId = nlogger.registerShape(keys.reverse());
+    }
+
+    return shape.shapeId;
+}
+
 /**
  * Add an expanded object value to the InMemoryLog
  * @method
@@ -896,7 +1066,16 @@ InMemoryLog.prototype.addExpandedObject = function (obj, depth, length) {
     else {
         //Set processing as true for cycle detection
         this.jsonCycleMap.add(obj);
-        this.addTagOnlyEntry(LogEntryTags.LParen);
+
+        //the shape id is filled in once we have seen all the property names
+        const shapeBlock = this.ensureSlot();
+        const shapePos = shapeBlock.epos;
+        shapeBlock.tags[shapePos] = LogEntryTags.LShape;
+        shapeBlock.epos++;
+
+        //if we run out of shape nodes (e.g., objects used as maps with lots of different keys) the rest of the properties get their names stored explicitly
+        let shape = s_objectShapeRoot;
+        let shaped = true;
 
         let allowedLengthRemain = length;
         for (const p in obj) {
@@ -906,12 +1085,32 @@ InMemoryLog.prototype.addExpandedObject = function (obj, depth, length) {
             }
             allowedLengthRemain--;
 
-            this.addStringEntry(LogEntryTags.PropertyRecord, p);
+            if (shaped) {
+                let next = shape.children.get(p);
+                if (next === undefined && s_objectShapeNodeCount < MaxObjectShapeNodes) {
+                    next = createObjectShapeNode(shape, p);
+                    shape.children.set(p, next);
+                    s_objectShapeNodeCount++;
+                }
+
+                if (next !== undefined) {
+                    shape = next;
+                }
+                else {
+                    shaped = false;
+                }
+            }
+
+            if (!shaped) {
+                this.addStringEntry(LogEntryTags.PropertyRecord, p);
+            }
 
             const value = obj[p];
             this.addGeneralValue(value, depth - 1, length);
         }
 
+        shapeBlock.data[shapePos] = getObjectShapeId(shape);
+
         //Set processing as false for cycle detection
         this.jsonCycleMap.delete(obj);
         this.addTagOnlyEntry(LogEntryTags.RParen);
@@ -1074,45 +1273,67 @@ InMemoryLog.prototype.logMessage = function (env, level, category, fmt, argStart
 };
 
 /**
- * Filter out all the msgs that we want to drop when writing to disk and copy them to the pending write list.
- * Returns when we are both (1) under size limit and (2) the size limit -- setting them to Number.MAX_SAFE_INTEGER will effectively disable the check.
+ * Process the whole block chain (in one native call) and drop the blocks that were completely processed.
  * @method
- * @ returns true if there is data that was not processed (but will need to be processed eventually)
+ * @param {boolean} forceall true if we should process everything (otherwise we stop once we are under the time/size limits)
+ * @param {boolean} fulldetail true if we should keep every message (not just the ones enabled for emit)
  */
-InMemoryLog.prototype.processMessagesForWrite = function () {
-    let msgCount = 0;
-    for (let cblock = this.head; cblock !== null; cblock = cblock.next) {
-        msgCount += cblock.epos - cblock.spos;
+InMemoryLog.prototype.processBlockChain = function (forceall, fulldetail) {
+    const control = this.processControl;
+    control[ProcessControl.Now] = Date.now();
+    control[ProcessControl.ForceAll] = forceall ? 1 : 0;
+    control[ProcessControl.FullDetail] = fulldetail ? 1 : 0;
+
+    //any blocks that were handed off earlier (and that native is now done with) come back to be reused
+    const recycled = nlogger.processMsgChain(this.head, control);
+
+    const consumed = control[ProcessControl.ConsumedBlocks];
+    diaglog("InMemoryLog.processBlockChain.complete", { consumed: consumed, headSpos: control[ProcessControl.HeadSpos], effectiveLevel: control[ProcessControl.EffectiveLevel] });
+
+    for (let i = 0; i < consumed; ++i) {
+        diaglog("InMemoryLog.processBlockChain.remove", { blockId: this.head.blockId });
+        this.removeHeadBlock(this.head.epos);
     }
 
-    if (msgCount === 0) {
-        return false;
+    if (control[ProcessControl.HeadSpos] !== -1) {
+        this.head.spos = control[ProcessControl.HeadSpos];
     }
 
-    nlogger.processMsgsReserveBlock(this.head.spos, this.head.epos);
-    let keepProcessing = true;
-    do {
-        msgCount = 0;
-        for (let cblock = this.head; cblock !== null; cblock = cblock.next) {
-            msgCount += cblock.epos - cblock.spos;
-        }
+    if (recycled !== undefined) {
+        recycleMemoryMsgBlocks(recycled);
+    }
 
-        if (msgCount === 0) {
-            break;
-        }
+    return control[ProcessControl.MemoryPressure] !== 0;
+};
 
-        diaglog("InMemoryLog.processMessagesForWrite.processing", { blockId: this.head.blockId, msgCount: msgCount });
-        const opos = this.head.spos;
-        const complete = nlogger.processMsgsForEmit(this.head, msgCount, Date.now(), false, false);
+/**
+ * Get the delay (in ms) before we next check for expired messages when there is nothing else prompting a flush
+ * @method
+ */
+InMemoryLog.prototype.getFlushDelay = function () {
+    return this.processControl[ProcessControl.FlushDelay];
+};
 
-        diaglog("InMemoryLog.processMessagesForWrite.complete", { processed: this.head.spos - opos });
-        if (this.head.spos === this.head.epos) {
-            diaglog("InMemoryLog.processMessagesForWrite.remove", { blockId: this.head.blockId });
-            this.removeHeadBlock(this.head.epos - opos);
-        }
-        keepProcessing = !complete;
-    } while (keepProcessing);
-    nlogger.processMsgsComplete();
+/**
+ * Get the delay (in ms) before we try again when the last flush left messages behind
+ * @method
+ */
+InMemoryLog.prototype.getRetryDelay = function () {
+    return this.processControl[ProcessControl.RetryDelay];
+};
+
+/**
+ * Filter out all the msgs that we want to drop when writing to disk and copy them to the pending write list.
+ * Returns when we are both (1) under size limit and (2) the size limit -- setting them to Number.MAX_SAFE_INTEGER will effectively disable the check.
+ * @method
+ * @ returns true if there is data that was not processed (but will need to be processed eventually)
+ */
+InMemoryLog.prototype.processMessagesForWrite = function () {
+    if (this.head.next === null && this.head.spos === this.head.epos) {
+        return false;
+    }
+
+    this.memoryPressure = this.processBlockChain(false, false);
 
     return (this.head.spos !== this.head.epos) || (this.head.next != null);
 };
@@ -1122,24 +1343,7 @@ InMemoryLog.prototype.processMessagesForWrite = function () {
  * @method
  */
 InMemoryLog.prototype.processMessagesForWrite_FullFlush = function (fulldetail) {
-    //These don't matter since we are going to process everything anyway
-    const msgMax = Number.MAX_SAFE_INTEGER;
-    const timeMax = Number.MAX_SAFE_INTEGER;
-
-    nlogger.processMsgsReserveBlock(this.head.spos, this.head.epos);
-    let keepProcessing = true;
-    do {
-        diaglog("InMemoryLog.processMessagesForWrite_FullFlush.processing", { blockId: this.head.blockId });
-        const opos = this.head.spos;
-        nlogger.processMsgsForEmit(this.head, msgMax, timeMax, true, fulldetail);
-
-        if (this.head.spos === this.head.epos) {
-            diaglog("InMemoryLog.processMessagesForWrite_FullFlush.remove", { blockId: this.head.blockId });
-            this.removeHeadBlock(this.head.epos - opos);
-        }
-        keepProcessing = !(this.head.next === null && this.head.spos === this.head.epos);
-    } while (keepProcessing);
-    nlogger.processMsgsComplete();
+    this.processBlockChain(true, fulldetail);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1156,6 +1360,84 @@ function doMsgLog_NOP(fmtorctgry, ...args) { }
 //Special NOP implementations for disabled levels of logging
 function doMsgLog_COND_NOP(cond, fmt, ...args) { }
 
+//The aggregate, columnar and sinks targets hand processed blocks off to a native writer thread which does the formatting/encoding
+function isNativeWriterTarget() {
+    return s_environment.flushTarget === "aggregate" || s_environment.flushTarget === "columnar" || s_environment.flushTarget === "sinks";
+}
+
+function submitToNativeWriter() {
+    if (s_environment.flushTarget === "aggregate") {
+        nlogger.aggregateMsgs(s_environment.doPrefix);
+    }
+    else if (s_environment.flushTarget === "columnar") {
+        nlogger.columnarMsgs();
+    }
+    else {
+        nlogger.sinkMsgs();
+    }
+}
+
+//Write a message that was just logged at a priority level now (natively and fsync'd if requested) -- the batched processing skips it once it is written
+function writePriorityMessage(block, spos) {
+    //the native writers order their output by time so priority messages just go with the next batch
+    if (isNativeWriterTarget()) {
+        return;
+    }
+
+    let fd = -1;
+    if (s_environment.flushTarget === "console") {
+        fd = process.stdout.fd;
+    }
+    else if (s_environment.flushTarget === "stream" && typeof (s_environment.stream.fd) === "number") {
+        fd = s_environment.stream.fd;
+    }
+
+    const result = nlogger.writePriorityMsg(block, spos, fd, s_environment.prioritySync, s_environment.doPrefix);
+    if (typeof (result) === "string") {
+        diaglog("writePriorityMessage.output", { target: s_environment.flushTarget });
+
+        if (s_environment.flushTarget === "stream") {
+            try {
+                s_environment.stream.write(result);
+            }
+            catch (wex) {
+                diaglog("writePriorityMessage.failedStreamWrite", { ex: wex.toString() });
+                s_environment.flushTarget = "console";
+                process.stdout.write(result);
+            }
+        }
+        else {
+            s_environment.flushCB(null, result);
+        }
+    }
+    else if (result === false) {
+        //This is a "safe" failure -- the message is still in the log for the next batch
+        diaglog("writePriorityMessage.failedWrite", { fd: fd });
+    }
+}
+
+function logMessageAndFlush(lenv, level, category, fmt, argStart, args) {
+    if ((level & s_environment.priorityLevel) !== level) {
+        s_inMemoryLog.logMessage(lenv, level, category, fmt, argStart, args);
+    }
+    else {
+        const block = s_inMemoryLog.tail;
+        const spos = block.epos;
+
+        s_inMemoryLog.logMessage(lenv, level, category, fmt, argStart, args);
+
+        //the header is never split so if the tail was full the message starts in the next block
+        if (block.epos === spos) {
+            writePriorityMessage(block.next, block.next.spos);
+        }
+        else {
+            writePriorityMessage(block, spos);
+        }
+    }
+
+    s_environment.flushAction();
+}
+
 function syncFlushAction() {
     if (s_inMemoryLog.getWriteCount() > s_environment.flushCount) {
         diaglog("syncFlushAction", { writeCount: s_inMemoryLog.getWriteCount(), flushCount: s_environment.flushCount });
@@ -1164,35 +1446,85 @@ function syncFlushAction() {
 
         s_inMemoryLog.processMessagesForWrite();
 
-        diaglog("syncFlushAction.formatMsgsSync");
-        const output = nlogger.formatMsgsSync(s_environment.doPrefix);
+        if (isNativeWriterTarget()) {
+            diaglog("syncFlushAction.submitToNativeWriter", { target: s_environment.flushTarget });
+            submitToNativeWriter();
+            return;
+        }
 
-        diaglog("syncFlushAction.output", { target: s_environment.flushTarget });
-        if (s_environment.flushTarget === "console") {
-            process.stdout.write(output);
+        //the output is written a chunk at a time as it is formatted
+        diaglog("syncFlushAction.formatMsgsSync", { target: s_environment.flushTarget });
+        nlogger.formatMsgsSync(s_environment.doPrefix, (output) => writeTargetOutput(output, "syncFlushAction"));
+    }
+}
+
+//Over the native memory budget so format and write everything now (on the JS thread)
+function memoryBudgetFlush() {
+    diaglog("memoryBudgetFlush", { usage: nlogger.getMemoryUsage() });
+
+    s_inMemoryLog.memoryPressure = false;
+
+    const undelivered = abortAsyncWork();
+    if (undelivered.length !== 0) {
+        writeTargetOutput(undelivered, "memoryBudgetFlush");
+    }
+    nlogger.formatMsgsSync(s_environment.doPrefix, (output) => writeTargetOutput(output, "memoryBudgetFlush"));
+}
+
+//Write formatted output to the console or stream flush target -- returns false if the stream write throws.
+//Unless noConsoleFallback is set we switch to the console (and write the output there) when that happens.
+function writeTargetOutput(output, caller, noConsoleFallback) {
+    if (s_environment.flushTarget === "console") {
+        writeFlushOutput(process.stdout, output);
+    }
+    else if (s_environment.flushTarget === "stream") {
+        try {
+            writeFlushOutput(s_environment.stream, output);
         }
-        else if (s_environment.flushTarget === "stream") {
-            try {
-                s_environment.stream.write(output);
-            }
-            catch (wex) {
-                diaglog("syncFlushAction.failedStreamWrite", { ex: wex.toString() });
+        catch (wex) {
+            diaglog(caller + ".failedStreamWrite", { ex: wex.toString() });
+            if (!noConsoleFallback) {
                 s_environment.flushTarget = "console";
                 process.stdout.write(output);
             }
+            return false;
         }
-        else {
-            //
-            //TODO: should be flushCBSync here
-            //
-        }
     }
+    else {
+        //
+        //TODO: should be flushCBSync here
+        //
+    }
+
+    return true;
+}
+
+//Write formatted output to a stream -- with adaptive flushing (or tracing) on we let the native code know how long the write took to complete
+function writeFlushOutput(stream, output) {
+    if (!s_environment.adaptiveFlush && !s_environment.tracing) {
+        stream.write(output);
+        return;
+    }
+
+    const start = Date.now();
+    const traceStart = s_environment.tracing ? nlogger.traceNow() : 0;
+    stream.write(output, () => {
+        if (s_environment.adaptiveFlush) {
+            nlogger.reportSinkLatency(Date.now() - start);
+        }
+
+        if (s_environment.tracing) {
+            nlogger.traceWrite(traceStart, output.length);
+        }
+    });
 }
 
 let s_flushTimeout = undefined;
 let s_formatPending = false;
+let s_asyncHasMore = false;
 
 function asyncFlushCallback() {
+    const traceStart = s_environment.tracing ? nlogger.traceNow() : 0;
     try {
         diaglog("asyncFlushCallback", { flushtTimeout: s_flushTimeout, formatPending: s_formatPending });
 
@@ -1206,54 +1538,92 @@ function asyncFlushCallback() {
         const hasmore = s_inMemoryLog.processMessagesForWrite();
         diaglog("asyncFlushCallback.process", { hasmore: hasmore });
 
-        nlogger.formatMsgsAsync((err, result) => {
-            diaglog("formatMsgsAsync.callback", { flushTimeout: s_flushTimeout, formatPending: s_formatPending });
+        if (isNativeWriterTarget()) {
+            //the native writer does the formatting so just hand off the blocks
+            submitToNativeWriter();
+            s_formatPending = false;
 
+            if (hasmore) {
+                s_flushTimeout = setTimeout(asyncFlushCallback, s_inMemoryLog.getRetryDelay());
+            }
+            return;
+        }
+
+        if (s_inMemoryLog.memoryPressure) {
+            memoryBudgetFlush();
+
+            if (hasmore) {
+                s_flushTimeout = setTimeout(asyncFlushCallback, s_inMemoryLog.getRetryDelay());
+            }
+            return;
+        }
+
+        //the format thread picks up the blocks we just processed and calls asyncFormatComplete with the output
+        s_asyncHasMore = hasmore;
+        nlogger.formatMsgsAsync(s_environment.doPrefix);
+    }
+    catch (ex) {
+        internalLogFailure("Hard failure in asyncFlushCallback", ex);
+    }
+    finally {
+        if (s_environment.tracing) {
+            nlogger.traceFlush(traceStart);
+        }
+    }
+}
+
+//Called (on the JS thread) by the native format thread when it has output for us or it has finished all the work we gave it
+function asyncFormatComplete(err, result, pending) {
+    try {
+        diaglog("asyncFormatComplete", { flushTimeout: s_flushTimeout, formatPending: s_formatPending, pending: pending });
+
+        //ignore the completion if we aborted the async work since then
+        if (!pending && s_formatPending) {
             s_formatPending = false;
 
             if (nlogger.hasWorkPending()) {
-                diaglog("formatMsgsAsync.callback.pending", { hasWorkPending: "hasWorkPending" });
+                diaglog("asyncFormatComplete.pending", { hasWorkPending: "hasWorkPending" });
                 s_flushTimeout = setTimeout(asyncFlushCallback, 0);
             }
-            else if (hasmore) {
-                diaglog("formatMsgsAsync.callback.ms", { hasmore: hasmore });
-                s_flushTimeout = setTimeout(asyncFlushCallback, 250);
+            else if (s_asyncHasMore) {
+                diaglog("asyncFormatComplete.ms", { hasmore: s_asyncHasMore });
+                s_flushTimeout = setTimeout(asyncFlushCallback, s_inMemoryLog.getRetryDelay());
             }
             else {
-                diaglog("formatMsgsAsync.callback.nop");
+                diaglog("asyncFormatComplete.nop");
             }
+        }
 
-            if (err) {
-                diaglog("formatMsgsAsync.callback.err", { error: err.toString() });
-            }
-            else {
-                diaglog("formatMsgsAsync.callback.ok", { flushTarget: s_environment.flushTarget, resultSize: result.length });
+        if (err) {
+            diaglog("asyncFormatComplete.err", { error: err.toString() });
+        }
+        else if (result.length !== 0) {
+            diaglog("asyncFormatComplete.ok", { flushTarget: s_environment.flushTarget, resultSize: result.length });
 
-                if (s_environment.flushTarget === "console") {
-                    process.stdout.write(result);
+            if (s_environment.flushTarget === "console") {
+                writeFlushOutput(process.stdout, result);
+            }
+            else if (s_environment.flushTarget === "stream") {
+                try {
+                    writeFlushOutput(s_environment.stream, result);
                 }
-                else if (s_environment.flushTarget === "stream") {
-                    try {
-                        s_environment.stream.write(result);
-                    }
-                    catch (wex) {
-                        diaglog("formatMsgsAsync.failedStreamWrite", { ex: wex.toString() });
+                catch (wex) {
+                    diaglog("asyncFormatComplete.failedStreamWrite", { ex: wex.toString() });
 
-                        s_environment.flushTarget = "console";
-                        process.stdout.write(result);
-                    }
-                }
-                else {
-                    //
-                    //TODO: we will need to have a flushCB, a flushCBSync, and a abortFlushCB to handle everything
-                    //
-                    s_environment.flushCB(err, result);
+                    s_environment.flushTarget = "console";
+                    process.stdout.write(result);
                 }
             }
-        }, s_environment.doPrefix);
+            else {
+                //
+                //TODO: we will need to have a flushCB, a flushCBSync, and a abortFlushCB to handle everything
+                //
+                s_environment.flushCB(err, result);
+            }
+        }
     }
     catch (ex) {
-        internalLogFailure("Hard failure in asyncFlushCallback", ex);
+        internalLogFailure("Hard failure in asyncFormatComplete", ex);
     }
 }
 
@@ -1268,6 +1638,12 @@ function asyncFlushAction() {
             if (s_inMemoryLog.count() > nlogger.getMsgSlotLimit() * 4) {
                 diaglog("asyncFlushAction.reducePressureFlush", { currentCount: s_inMemoryLog.count(), targetCount: nlogger.getMsgSlotLimit() });
                 s_inMemoryLog.processMessagesForWrite();
+
+                if (s_inMemoryLog.memoryPressure && !isNativeWriterTarget()) {
+                    //this stops the format thread so we need to kick off the next async flush ourselves
+                    memoryBudgetFlush();
+                    s_flushTimeout = setTimeout(asyncFlushCallback, 0);
+                }
             }
 
             return;
@@ -1288,11 +1664,25 @@ function asyncFlushAction() {
 
         if (s_flushTimeout === undefined) {
             diaglog("asyncFlushAction.setTimeout");
-            s_flushTimeout = setTimeout(asyncFlushCallback, 500);
+            s_flushTimeout = setTimeout(asyncFlushCallback, s_inMemoryLog.getFlushDelay());
         }
     }
 }
 
+//Combine two pieces of formatted output (strings or, with outputBuffers, Buffers) -- without a copy if one of them is empty
+function joinOutput(first, second) {
+    if (first.length === 0) {
+        return second;
+    }
+    else if (second.length === 0) {
+        return first;
+    }
+    else {
+        return Buffer.isBuffer(first) ? Buffer.concat([first, second]) : first + second;
+    }
+}
+
+//Pause the format thread so we can format sync -- returns any output it finished that has not been written yet
 function abortAsyncWork() {
     diaglog("abortAsyncWork", { formatPending: s_formatPending, flushTimeout: s_flushTimeout });
 
@@ -1301,10 +1691,8 @@ function abortAsyncWork() {
         s_flushTimeout = undefined;
     }
 
-    if (s_formatPending) {
-        nlogger.abortAsyncWork();
-        s_formatPending = false;
-    }
+    s_formatPending = false;
+    return nlogger.abortAsyncWork();
 }
 
 function discardFlushAction() {
@@ -1410,6 +1798,7 @@ function Logger(loggerName, options) {
         globalEnv: s_globalenv,
         logger_path: __filename,
         LOGGER: loggerName,
+        LOGGER_ID: 0,
         isChild: false
     };
     this.isChild = false;
@@ -1518,13 +1907,15 @@ function Logger(loggerName, options) {
         try {
             let cid = s_categoryNames.get(name);
             if (cid === undefined) {
-                cid = s_categoryNames.size;
+                cid = nlogger.addCategory(name);
                 s_categoryNames.set(name, cid);
-                nlogger.addCategory(cid, name);
             }
 
             if (this === s_rootLogger) {
                 s_enabledCategories[cid] = (enabled === undefined || enabled === true);
+
+                //so messages already buffered in the category are dropped (or kept) when they are processed
+                nlogger.setCategoryLevel(cid, s_enabledCategories[cid] ? LoggingLevels.ALL : LoggingLevels.OFF);
             }
             else {
                 s_enabledCategories[cid] = s_enabledCategories[cid] || false;
@@ -1589,6 +1980,71 @@ function Logger(loggerName, options) {
         }
     };
 
+    /**
+     * Add all the formats from a compiled format catalog file (see saveFormatCatalog) to this logger
+     * @param {string} catalogFile the catalog file to load
+     * @returns true if the catalog was loaded successfully false otherwise
+     */
+    this.loadFormatCatalog = function (catalogFile) {
+        if (this.isChild || typeof (catalogFile) !== "string") {
+            return false;
+        }
+
+        try {
+            const fmts = loadFormatCatalog(catalogFile);
+            for (let i = 0; i < fmts.length; ++i) {
+                this["$" + fmts[i].formatName] = fmts[i].formatId;
+            }
+            return true;
+        }
+        catch (ex) {
+            //This is a "safe" failure so just warn and continue
+            diaglog("loadFormatCatalog.failure", { catalogFile: catalogFile, ex: ex.toString() });
+            return false;
+        }
+    };
+
+    /**
+     * Save the compiled formats (from every logger in the process) to a catalog file that can be loaded quickly with loadFormatCatalog
+     * @param {string} catalogFile the catalog file to write
+     * @returns true if the catalog was written successfully false otherwise
+     */
+    this.saveFormatCatalog = function (catalogFile) {
+        if (typeof (catalogFile) !== "string") {
+            return false;
+        }
+
+        try {
+            return nlogger.saveFormatCatalog(catalogFile);
+        }
+        catch (ex) {
+            //This is a "safe" failure so just warn and continue
+            diaglog("saveFormatCatalog.failure", { catalogFile: catalogFile, ex: ex.toString() });
+            return false;
+        }
+    };
+
+    /**
+     * Merge the (text with the standard prefix) log files written by several processes into a single file ordered by wallclock time
+     * @param {Array} logFiles the log files to merge
+     * @param {string} outputFile the file to write the merged log to (replacing any existing file)
+     * @returns {Object|boolean} { lines, bytes } written if the merge was successful false otherwise
+     */
+    this.mergeLogFiles = function (logFiles, outputFile) {
+        if (!Array.isArray(logFiles) || typeof (outputFile) !== "string") {
+            return false;
+        }
+
+        try {
+            return nlogger.mergeLogs(logFiles, outputFile);
+        }
+        catch (ex) {
+            //This is a "safe" failure so just warn and continue
+            diaglog("mergeLogFiles.failure", { logFiles: logFiles, outputFile: outputFile, ex: ex.toString() });
+            return false;
+        }
+    };
+
     /**
      * Add formats for this logger from files or JSON
      * @param {string|string[]|JSON|JSON[]} arg JSON object(s) of catetory enabled/disabled or file(s) to load this information from
@@ -1674,8 +2130,7 @@ function Logger(loggerName, options) {
             return;
         }
 
-        s_inMemoryLog.logMessage(lenv, level, 2 /*explicit category*/, fmt, 0, args);
-        s_environment.flushAction();
+        logMessageAndFlush(lenv, level, 2 /*explicit category*/, fmt, 0, args);
     }
 
     function processDefaultCategoryFormat(lenv, fmti, level, args) {
@@ -1685,8 +2140,7 @@ function Logger(loggerName, options) {
             return;
         }
 
-        s_inMemoryLog.logMessage(lenv, level, 1 /*default category*/, fmt, 0, args);
-        s_environment.flushAction();
+        logMessageAndFlush(lenv, level, 1 /*default category*/, fmt, 0, args);
     }
 
     function processExplicitCategoryFormat(lenv, categoryi, level, args) {
@@ -1703,8 +2157,7 @@ function Logger(loggerName, options) {
                 return;
             }
 
-            s_inMemoryLog.logMessage(lenv, level, rcategory, fmt, 1, args);
-            s_environment.flushAction();
+            logMessageAndFlush(lenv, level, rcategory, fmt, 1, args);
         }
     }
 
@@ -1809,7 +2262,7 @@ function Logger(loggerName, options) {
         try {
             if (s_rootLogger === this) {
                 diaglog("emitLogSync", { includeFullDetail: includeFullDetail });
-                abortAsyncWork();
+                const undelivered = abortAsyncWork();
 
                 diaglog("emitLogSync.process");
                 const timingInfo = optTimingInfo || {};
@@ -1824,7 +2277,7 @@ function Logger(loggerName, options) {
 
                 diaglog("emitLogSync.format");
                 timingInfo.fstart = new Date();
-                const result = nlogger.formatMsgsSync(s_environment.doPrefix);
+                const result = joinOutput(undelivered, nlogger.formatMsgsSync(s_environment.doPrefix));
                 timingInfo.fend = new Date();
 
                 return result;
@@ -1835,6 +2288,177 @@ function Logger(loggerName, options) {
         }
     };
 
+    /**
+    * Get the native memory accounting for processed messages (budget, used, blockBytes, formatterBytes, pendingBlocks, droppedMessages, droppedBlocks, queuedBytes, queuedMessages, handoffBlocks, reclaimedBlocks)
+    * @method
+    */
+    this.getMemoryUsage = function () {
+        return nlogger.getMemoryUsage();
+    };
+
+    /**
+    * Get the current flush limits/delays and the measurements behind them (adaptive, latencyTarget, memoryTarget, timeLimit, slotLimit, flushDelay, retryDelay, slotsPerSecond, messagesPerSecond, formatMicrosPerMessage, sinkLatency, adjustments, limitedBy)
+    * @method
+    */
+    this.getFlushStats = function () {
+        return nlogger.getFlushStats();
+    };
+
+    /**
+    * Get the output counters for each sink of the "sinks" flush target (output, path, mode, level, messages, bytes, failures)
+    * @method
+    */
+    this.getSinkStats = function () {
+        return nlogger.getSinkStats();
+    };
+
+    /**
+    * Get the counters for the "columnar" flush target (segments and rows written, and segment writes that failed)
+    * @method
+    */
+    this.getColumnarStats = function () {
+        return nlogger.getColumnarStats();
+    };
+
+    /**
+    * Aggregate the %n arguments of a format (count, sum, min, max, and a quantile sketch) natively as messages are processed -- even if they are not emitted
+    * @method
+    * @param {number|undefined} fmt the $NAME format id to aggregate or undefined for every format
+    * @returns true if the format exists and is now being aggregated false otherwise
+    */
+    this.enableMetrics = function (fmt) {
+        if (fmt !== undefined && typeof (fmt) !== "number") {
+            //This is a "safe" failure so just warn and continue
+            diaglog("enableMetrics.failure", { fmt: fmt });
+            return false;
+        }
+
+        return nlogger.enableMetrics(fmt !== undefined ? fmt : -1);
+    };
+
+    /**
+    * Stop aggregating metrics for all formats and drop the values collected so far
+    * @method
+    */
+    this.disableMetrics = function () {
+        nlogger.disableMetrics();
+    };
+
+    /**
+    * Drop the metric values collected so far (the formats stay enabled)
+    * @method
+    */
+    this.resetMetrics = function () {
+        nlogger.resetMetrics();
+    };
+
+    /**
+    * Write out the messages the flight recorder is holding (with the next flush)
+    * @method
+    * @returns the number of messages that will be written
+    */
+    this.dumpFlightRecorder = function () {
+        const count = nlogger.dumpFlightRecorder();
+        if (count !== 0) {
+            s_environment.flushAction();
+        }
+        return count;
+    };
+
+    /**
+    * Get the flight recorder counters (capacity, messages, bytes, recorded, evicted, dumped)
+    * @method
+    */
+    this.getFlightRecorderStats = function () {
+        return nlogger.getFlightRecorderStats();
+    };
+
+    /**
+    * Start writing a timeline of the flush pipeline (processing, queueing, formatting, and writes) to a file in the Chrome trace event format
+    * @method
+    * @param {string} file the trace file to write (replaces any trace in progress)
+    * @returns true if the trace was started false otherwise
+    */
+    this.startTrace = function (file) {
+        if (typeof (file) !== "string") {
+            //This is a "safe" failure so just warn and continue
+            diaglog("startTrace.failure", { file: file });
+            return false;
+        }
+
+        s_environment.tracing = nlogger.startTrace(file);
+        return s_environment.tracing;
+    };
+
+    /**
+    * Stop the trace in progress and close the trace file
+    * @method
+    */
+    this.stopTrace = function () {
+        s_environment.tracing = false;
+        nlogger.stopTrace();
+    };
+
+    /**
+    * Get the aggregates for each %n argument of the enabled formats (format, formatId, arg, name, count, sum, min, max, mean, quantiles, sketch)
+    * @method
+    * @param {number[]|undefined} quantiles the quantiles (in [0, 1]) to estimate (default [0.5, 0.9, 0.99])
+    */
+    this.getMetrics = function (quantiles) {
+        const qs = (Array.isArray(quantiles) && quantiles.every((q) => typeof (q) === "number" && q >= 0 && q <= 1)) ? quantiles : [0.5, 0.9, 0.99];
+        return nlogger.getMetrics(qs);
+    };
+
+    /**
+    * Format the retained (not yet written) messages that match the query -- nothing is removed from the log
+    * @method
+    * @param {Object} query optional filters -- format (a $NAME format id), level, category (name or $$ value), start/end (Date or ms), request and callback (ids)
+    * @returns {string} the formatted matching messages (oldest first)
+    */
+    this.queryLog = function (query) {
+        try {
+            const q = query || {};
+            diaglog("queryLog", { query: q });
+
+            const nquery = {};
+            if (q.format !== undefined) {
+                nquery.formatId = q.format;
+            }
+            if (q.level !== undefined) {
+                nquery.level = q.level;
+            }
+            if (typeof (q.category) === "string") {
+                const cid = s_categoryNames.get(q.category);
+                nquery.categoryId = (cid !== undefined) ? Math.abs(cid) : 0; //0 is never used so nothing matches an unknown name
+            }
+            else if (typeof (q.category) === "number") {
+                nquery.categoryId = Math.abs(q.category);
+            }
+            if (q.start !== undefined) {
+                nquery.timeStart = (q.start instanceof Date) ? q.start.valueOf() : q.start;
+            }
+            if (q.end !== undefined) {
+                nquery.timeEnd = (q.end instanceof Date) ? q.end.valueOf() : q.end;
+            }
+            if (q.request !== undefined) {
+                nquery.requestId = q.request;
+            }
+            if (q.callback !== undefined) {
+                nquery.callbackId = q.callback;
+            }
+
+            const blocks = [];
+            for (let cblock = s_inMemoryLog.head; cblock !== null; cblock = cblock.next) {
+                blocks.push(cblock);
+            }
+
+            return nlogger.queryMsgs(blocks, nquery, s_environment.doPrefix);
+        }
+        catch (ex) {
+            internalLogFailure("Hard failure in queryLog", ex);
+        }
+    };
+
     /**
     * Explicitly set the named sublogger to the given level (now or later)
     * @method
@@ -1852,6 +2476,7 @@ function Logger(loggerName, options) {
 
                 s_enabledSubLoggerNames.set(subloggerName, level);
                 s_disabledSubLoggerNames.delete(subloggerName);
+                nlogger.setLoggerLevel(getSubLoggerId(subloggerName), sanitizeLogLevel(level));
 
                 if (s_loggerMap.has(subloggerName)) {
                     s_loggerMap.get(subloggerName).setLoggingLevel(level);
@@ -1881,6 +2506,7 @@ function Logger(loggerName, options) {
 
                 s_enabledSubLoggerNames.delete(subloggerName);
                 s_disabledSubLoggerNames.add(subloggerName);
+                nlogger.setLoggerLevel(getSubLoggerId(subloggerName), LoggingLevels.OFF);
 
                 if (s_loggerMap.has(subloggerName)) {
                     s_loggerMap.get(subloggerName).setLoggingLevel(LoggingLevels.OFF);
@@ -1924,6 +2550,20 @@ let s_rootLogger = null;
 const s_disabledSubLoggerNames = new Set();
 const s_enabledSubLoggerNames = new Map();
 
+/**
+ * Ids for the sub-logger names (used in the native level masks) -- 0 is the root logger
+ */
+const s_subLoggerIds = new Map();
+
+function getSubLoggerId(name) {
+    let id = s_subLoggerIds.get(name);
+    if (id === undefined) {
+        id = s_subLoggerIds.size + 1;
+        s_subLoggerIds.set(name, id);
+    }
+    return id;
+}
+
 /**
  * Map of the loggers created for various logger names
  */
@@ -1938,27 +2578,102 @@ function processSimpleOptionTransform(options, realOptions, name, typestr, pred,
     realOptions[name] = transform(opt);
 }
 
+//Normalize the sinks option into {output, path, socketType, level, categories, mode} entries for the native fan-out writer -- bad entries are skipped
+function processSinkOptions(sinks) {
+    if (!Array.isArray(sinks)) {
+        return [];
+    }
+
+    const res = [];
+    sinks.forEach((sink) => {
+        const okOutput = sink !== null && typeof (sink) === "object" && /^(stdout|stderr|file|socket)$/.test(sink.output);
+        const okPath = okOutput && ((sink.output !== "file" && sink.output !== "socket") || (typeof (sink.path) === "string" && sink.path.length !== 0));
+        const okSocketType = okOutput && (sink.socketType === undefined || /^(stream|datagram)$/.test(sink.socketType));
+        const okLevel = okOutput && (sink.level === undefined || LoggingLevels[sink.level] !== undefined);
+        const okMode = okOutput && (sink.mode === undefined || /^(text|plain|ndjson)$/.test(sink.mode));
+        const okCategories = okOutput && (sink.categories === undefined || (Array.isArray(sink.categories) && sink.categories.every((cat) => typeof (cat) === "string")));
+
+        if (!okOutput || !okPath || !okSocketType || !okLevel || !okMode || !okCategories) {
+            //This is a "safe" failure so just warn and continue
+            diaglog("logger.sinks.failure", { sink: sink });
+            return;
+        }
+
+        res.push({
+            output: sink.output,
+            path: sink.path,
+            socketType: sink.socketType || "stream",
+            level: LoggingLevels[sink.level || "INFO"],
+            categories: sink.categories || [],
+            mode: sink.mode || "text"
+        });
+    });
+
+    return res;
+}
+
+function isMainThread() {
+    try {
+        return require("worker_threads").isMainThread;
+    }
+    catch (ex) {
+        //no worker_threads support so we must be the main thread
+        return true;
+    }
+}
+
 function processLogOnTermination(iserror) {
     diaglog("processLogOnTermination", { iserror: iserror });
 
-    const finallog = s_rootLogger.emitLogSync(true, iserror);
+    if (isNativeWriterTarget()) {
+        abortAsyncWork();
+        s_inMemoryLog.processMessagesForWrite_FullFlush(iserror);
+        submitToNativeWriter();
 
-    if (s_environment.flushTarget === "console") {
-        process.stdout.write(finallog);
+        //worker_threads just hand off their blocks -- the main thread makes sure everything is written before the process exits
+        if (isMainThread()) {
+            if (s_environment.flushTarget === "aggregate") {
+                nlogger.flushAggregation();
+            }
+            else if (s_environment.flushTarget === "columnar") {
+                nlogger.flushColumnar();
+            }
+            else {
+                nlogger.flushSinks();
+            }
+        }
+        return;
     }
-    else if (s_environment.flushTarget === "stream") {
+
+    //write the output a chunk at a time as it is formatted (a big backlog never becomes one giant string) -- once the stream fails we stop writing
+    let streamOk = true;
+    const writeFinal = (output) => {
+        if (streamOk) {
+            streamOk = writeTargetOutput(output, "processLogOnTermination", true);
+        }
+    };
+
+    try {
+        const undelivered = abortAsyncWork();
+        if (undelivered.length !== 0) {
+            writeFinal(undelivered);
+        }
+
+        s_inMemoryLog.processMessagesForWrite_FullFlush(iserror);
+        nlogger.formatMsgsSync(s_environment.doPrefix, writeFinal);
+    }
+    catch (ex) {
+        internalLogFailure("Hard failure in emit on processLogOnTermination", ex);
+    }
+
+    if (s_environment.flushTarget === "stream" && streamOk) {
         try {
-            s_environment.stream.end(finallog);
+            s_environment.stream.end();
         }
         catch (wex) {
-            diaglog("formatMsgsAsync.failedStreamWrite", { ex: wex.toString() });
+            diaglog("processLogOnTermination.failedStreamEnd", { ex: wex.toString() });
         }
     }
-    else {
-        //
-        //TODO: should be flushCBSync here
-        //
-    }
 }
 
 /**
@@ -1990,13 +2705,13 @@ module.exports = function (name, options) {
 
     if (debuggerAttached && !options.disableAutoDebugger) {
         processSimpleOption(options, ropts, "flushCount", "number", (optv) => optv >= 0, 0);
-        processSimpleOption(options, ropts, "flushTarget", "string", (optv) => /console|stream|callback/.test(optv), "console");
+        processSimpleOption(options, ropts, "flushTarget", "string", (optv) => /console|stream|callback|aggregate|columnar|sinks/.test(optv), "console");
         processSimpleOption(options, ropts, "flushMode", "string", (optv) => /SYNC|ASYNC|NOP|DISCARD/.test(optv), "SYNC");
         processSimpleOption(options, ropts, "flushCallback", "function", (optv) => true, () => { });
     }
     else {
         processSimpleOption(options, ropts, "flushCount", "number", (optv) => optv >= 0, MemoryMsgBlockInitSize / 4);
-        processSimpleOption(options, ropts, "flushTarget", "string", (optv) => /console|stream|callback/.test(optv), "console");
+        processSimpleOption(options, ropts, "flushTarget", "string", (optv) => /console|stream|callback|aggregate|columnar|sinks/.test(optv), "console");
         processSimpleOption(options, ropts, "flushMode", "string", (optv) => /SYNC|ASYNC|NOP|DISCARD/.test(optv), "ASYNC");
         processSimpleOption(options, ropts, "flushCallback", "function", (optv) => true, () => { });
     }
@@ -2010,11 +2725,76 @@ module.exports = function (name, options) {
         }
     }
 
+    if (ropts.flushTarget === "aggregate") {
+        processSimpleOption(options, ropts, "aggregateFile", "string", (optv) => optv.length !== 0, undefined);
+        processSimpleOption(options, ropts, "aggregateWindow", "number", (optv) => optv >= 0, 1000);
+
+        if (ropts.aggregateFile === undefined) {
+            ropts.flushTarget = "console";
+        }
+    }
+
+    if (ropts.flushTarget === "columnar") {
+        processSimpleOption(options, ropts, "columnarDir", "string", (optv) => optv.length !== 0, undefined);
+        processSimpleOption(options, ropts, "columnarSegmentRows", "number", (optv) => optv > 0, 4096);
+
+        if (ropts.columnarDir === undefined) {
+            ropts.flushTarget = "console";
+        }
+    }
+
+    if (ropts.flushTarget === "sinks") {
+        ropts.sinks = processSinkOptions(options.sinks);
+
+        if (ropts.sinks.length === 0) {
+            ropts.flushTarget = "console";
+        }
+        else {
+            //the sinks decide what is emitted (a message is processed if any sink wants it)
+            const sinkLevel = ropts.sinks.reduce((acc, sink) => Math.max(acc, sink.level), LoggingLevels.OFF);
+            ropts.emitLevel = Math.min(sinkLevel, ropts.memoryLevel);
+        }
+    }
+
     processSimpleOption(options, ropts, "prefix", "boolean", (optv) => true, true);
 
+    //opt-in -- formatted output is handed to streams and the flushCallback as Buffers over the native output (no copy into a JS string)
+    processSimpleOption(options, ropts, "outputBuffers", "boolean", (optv) => true, false);
+
+    //whole blocks that are saved as is are read in place by native processing (instead of being copied) and then reused
+    processSimpleOption(options, ropts, "blockHandoff", "boolean", (optv) => true, true);
+    if (ropts.flushTarget === "sinks") {
+        //text sinks need the logger names even if other sinks don't use the prefix
+        ropts.prefix = true;
+    }
+
+    //bytes of native memory processed messages can use before the memoryPolicy kicks in (0 is unlimited)
+    processSimpleOption(options, ropts, "memoryBudget", "number", (optv) => optv >= 0, 0);
+    processSimpleOption(options, ropts, "memoryPolicy", "string", (optv) => MemoryPolicies[optv] !== undefined, "FLUSH");
+
+    //opt-in -- write whatever native code has on a fatal signal to this fd
+    processSimpleOption(options, ropts, "crashFlushFd", "number", (optv) => optv >= 0, undefined);
+
     processSimpleOption(options, ropts, "bufferSizeLimit", "number", (optv) => optv >= 0, 1024);
     processSimpleOption(options, ropts, "bufferTimeLimit", "number", (optv) => optv >= 0, 500);
 
+    //opt-in -- write messages at (or above) this level immediately (optionally fsync'd) rather than with the next batch
+    processSimpleOptionTransform(options, ropts, "priorityLevel", "string", (optv) => LoggingLevels[optv] !== undefined, "OFF", (optv) => LoggingLevels[optv]);
+    processSimpleOption(options, ropts, "prioritySync", "boolean", (optv) => true, false);
+
+    //opt-in -- let the native flush scheduler tune the buffer limits and flush delays to meet a latency (ms) and in memory log size (bytes) target
+    processSimpleOption(options, ropts, "adaptiveFlush", "boolean", (optv) => true, false);
+    processSimpleOption(options, ropts, "flushLatencyTarget", "number", (optv) => optv > 0, 500);
+    processSimpleOption(options, ropts, "flushMemoryTarget", "number", (optv) => optv > 0, 1048576);
+
+    //opt-in -- keep the last bytes/ms of messages discarded for being below the emit level and write them out ahead of a message at the dump level
+    processSimpleOption(options, ropts, "flightRecorderSize", "number", (optv) => optv >= 0, 0);
+    processSimpleOption(options, ropts, "flightRecorderAge", "number", (optv) => optv > 0, 10000);
+    processSimpleOptionTransform(options, ropts, "flightRecorderDumpLevel", "string", (optv) => LoggingLevels[optv] !== undefined, "ERROR", (optv) => LoggingLevels[optv]);
+
+    //opt-in -- write a Chrome trace event timeline of the flush pipeline to this file
+    processSimpleOption(options, ropts, "traceFile", "string", (optv) => optv.length !== 0, undefined);
+
     processSimpleOption(options, ropts, "formats", "any", (optv) => (typeof (optv) === "string" || typeof (optv) === "object"), undefined);
     processSimpleOption(options, ropts, "categories", "any", (optv) => (typeof (optv) === "string" || typeof (optv) === "object"), undefined);
     processSimpleOption(options, ropts, "subloggers", "any", (optv) => (typeof (optv) === "string" || typeof (optv) === "object"), undefined);
@@ -2091,11 +2871,72 @@ module.exports = function (name, options) {
                 }
 
                 nlogger.initializeLogger(ropts.emitLevel, os.hostname(), lfilename);
+                nlogger.setOutputBuffers(ropts.outputBuffers);
                 nlogger.setMsgSlotLimit(ropts.bufferSizeLimit);
                 nlogger.setMsgTimeLimit(ropts.bufferTimeLimit);
+                nlogger.setAdaptiveFlush(ropts.adaptiveFlush, ropts.flushLatencyTarget, ropts.flushMemoryTarget);
+                s_environment.adaptiveFlush = ropts.adaptiveFlush;
+
+                s_environment.priorityLevel = ropts.priorityLevel;
+                s_environment.prioritySync = ropts.prioritySync;
+                nlogger.setMemoryBudget(ropts.memoryBudget, MemoryPolicies[ropts.memoryPolicy]);
+
+                if (ropts.flightRecorderSize !== 0) {
+                    nlogger.setFlightRecorder(ropts.flightRecorderSize, ropts.flightRecorderAge, ropts.flightRecorderDumpLevel);
+                }
+
+                if (s_environment.flushTarget === "aggregate") {
+                    //shared by the main thread and any worker_threads that aggregate into the same file
+                    if (!nlogger.startAggregation(ropts.aggregateFile, ropts.aggregateWindow)) {
+                        diaglog("logger.create.aggregate.failure", { aggregateFile: ropts.aggregateFile });
+                        s_environment.flushTarget = "console";
+                    }
+                }
+
+                if (s_environment.flushTarget === "columnar") {
+                    //like aggregation the segment writer is shared by the main thread and any worker_threads
+                    if (!nlogger.startColumnar(ropts.columnarDir, ropts.columnarSegmentRows)) {
+                        diaglog("logger.create.columnar.failure", { columnarDir: ropts.columnarDir });
+                        s_environment.flushTarget = "console";
+                    }
+                }
+
+                if (s_environment.flushTarget === "sinks") {
+                    //also shared by the main thread and any worker_threads (the first logger to start it picks the sinks)
+                    if (!nlogger.startSinks(ropts.sinks)) {
+                        diaglog("logger.create.sinks.failure", { sinks: ropts.sinks });
+                        s_environment.flushTarget = "console";
+                    }
+                }
+
+                if (ropts.traceFile !== undefined) {
+                    s_environment.tracing = nlogger.startTrace(ropts.traceFile);
+                    if (!s_environment.tracing) {
+                        diaglog("logger.create.trace.failure", { traceFile: ropts.traceFile });
+                    }
+                }
+
+                if (ropts.crashFlushFd !== undefined) {
+                    if (!nlogger.enableCrashFlush(ropts.crashFlushFd)) {
+                        diaglog("logger.create.crashflush.failure", { crashFlushFd: ropts.crashFlushFd });
+                    }
+                }
+
+                if (ropts.flushMode === "ASYNC" && !isNativeWriterTarget()) {
+                    //one native thread does all the async formatting for this logger and reports back through the callback
+                    nlogger.startFormatThread(asyncFormatComplete);
+                }
+
+                //the native writers are shared by the whole process (and can outlive a worker's JS blocks) so they always get copies
+                nlogger.setBlockHandoff(ropts.blockHandoff && !isNativeWriterTarget());
 
                 process.on("exit", (code) => {
                     processLogOnTermination(code !== 0);
+
+                    if (s_environment.tracing) {
+                        s_environment.tracing = false;
+                        nlogger.stopTrace();
+                    }
                 });
 
                 process.on("uncaughtException", () => {
@@ -2122,6 +2963,10 @@ module.exports = function (name, options) {
                 }
             }
 
+            if (logger !== s_rootLogger) {
+                logger.logger_env.LOGGER_ID = getSubLoggerId(name);
+            }
+
             s_loggerMap.set(name, logger);
         }
     }
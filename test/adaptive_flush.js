@@ -0,0 +1,71 @@
+"use strict";
+
+const runner = require("./runner");
+
+//1000 slots of in memory log
+const logpp = require("../src/logger")("adaptive", {
+    flushMode: "NOP",
+    adaptiveFlush: true,
+    flushLatencyTarget: 100,
+    flushMemoryTarget: 9000
+});
+
+function runSingleTest(test) {
+    return JSON.stringify(test.action());
+}
+
+function statsOk(check) {
+    return (res) => check(JSON.parse(res));
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+function spin(ms) {
+    const start = Date.now();
+    while (Date.now() - start < ms) {
+        ;
+    }
+}
+
+//log a burst between each (sync) flush so the scheduler gets a few rate samples
+function logBursts(count, burst) {
+    for (let i = 0; i < count; ++i) {
+        for (let j = 0; j < burst; ++j) {
+            logpp.info("burst %d", j);
+        }
+        spin(15);
+        logpp.emitLogSync(true, false);
+    }
+
+    return logpp.getFlushStats();
+}
+
+const adaptivetests = [
+    {
+        name: "flush.initial",
+        action: () => logpp.getFlushStats(),
+        oktest: statsOk((res) => res.adaptive && res.latencyTarget === 100 && res.memoryTarget === 9000 && res.timeLimit === 100 && res.flushDelay === 50 && res.retryDelay === 25 && res.limitedBy === "latency")
+    },
+    {
+        name: "flush.burst",
+        action: () => logBursts(4, 500),
+        oktest: statsOk((res) => res.adjustments > 0 && res.slotsPerSecond > 0 && res.messagesPerSecond > 0 && res.formatMicrosPerMessage >= 0 && res.timeLimit < 100 && res.flushDelay === Math.max(Math.floor(res.timeLimit / 2), 1))
+    },
+    {
+        name: "flush.memorycap",
+        action: () => logpp.getFlushStats(),
+        oktest: statsOk((res) => res.limitedBy === "memory" && res.slotLimit === 1000)
+    },
+    {
+        name: "flush.quiet",
+        action: () => logBursts(16, 0),
+        oktest: statsOk((res) => res.limitedBy === "latency" && res.slotLimit < 1000 && res.slotLimit >= 256)
+    }
+];
+
+const adaptiveRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, adaptivetests, "adaptive");
+adaptiveRunner(() => {
+    process.stdout.write("\nAll tests done!\n\n");
+});
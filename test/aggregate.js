@@ -0,0 +1,50 @@
+"use strict";
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const outfile = path.join(os.tmpdir(), "logpp_aggregate_" + process.pid + ".txt");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+let lines = [];
+function parseLine(line) {
+    const timeStart = line.indexOf(" @ ") + " @ ".length;
+    const msgStart = line.indexOf(" | ") + " | ".length;
+    const parts = line.substring(msgStart).split(" ");
+    return { time: Date.parse(line.substring(timeStart, line.indexOf(" ", timeStart))), name: JSON.parse(parts[0]), value: Number.parseInt(parts[1]) };
+}
+
+function producerSequenceOk(name) {
+    const values = lines.filter((entry) => entry.name === name).map((entry) => entry.value);
+    return values.length === 100 && values.every((value, i) => value === i);
+}
+
+const aggregatetests = [
+    {
+        name: "aggregate.run", action: () => {
+            childProcess.execFileSync(process.execPath, [path.join(__dirname, "aggregate_app.js"), outfile]);
+            lines = fs.readFileSync(outfile).toString().trim().split("\n").map(parseLine);
+            fs.unlinkSync(outfile);
+            return lines.length;
+        }, oktest: (res) => res === 300
+    },
+    { name: "aggregate.ordered", action: () => lines.every((entry, i) => i === 0 || lines[i - 1].time <= entry.time), oktest: (res) => res === true },
+    { name: "aggregate.main", action: () => producerSequenceOk("main"), oktest: (res) => res === true },
+    { name: "aggregate.worker0", action: () => producerSequenceOk("worker0"), oktest: (res) => res === true },
+    { name: "aggregate.worker1", action: () => producerSequenceOk("worker1"), oktest: (res) => res === true }
+];
+
+const aggregateRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, aggregatetests, "aggregate");
+aggregateRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,22 @@
+////
+//An app that logs from the main thread and 2 worker_threads into a single aggregated file (run by aggregate.js)
+
+"use strict";
+
+const { Worker, isMainThread, workerData } = require("worker_threads");
+
+const outfile = isMainThread ? process.argv[2] : workerData.outfile;
+const logpp = require("../src/logger")(isMainThread ? "aggregate" : "aggregate.worker", { flushMode: "SYNC", flushTarget: "aggregate", aggregateFile: outfile, aggregateWindow: 60000 });
+
+logpp.addFormat("Msg", "%s %n");
+
+const name = isMainThread ? "main" : ("worker" + workerData.id);
+for (let i = 0; i < 100; ++i) {
+    logpp.info(logpp.$Msg, name, i);
+}
+
+if (isMainThread) {
+    for (let w = 0; w < 2; ++w) {
+        new Worker(__filename, { workerData: { outfile: outfile, id: w } });
+    }
+}
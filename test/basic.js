@@ -70,6 +70,13 @@ const basictests = [
     { fmt: "$Basic_Number", arg: [1], oktest: (res) => res === "1" },
     { fmt: "$Basic_Number", arg: [323.86], oktest: (res) => res === "323.86" },
     { fmt: "$Basic_Number", arg: [-11.11], oktest: (res) => res === "-11.11" },
+    { fmt: "$Basic_Number", arg: [-7], oktest: (res) => res === "-7" },
+    { fmt: "$Basic_Number", arg: [1234567890123], oktest: (res) => res === "1234567890123" },
+    { fmt: "$Basic_Number", arg: [9007199254740991], oktest: (res) => res === "9007199254740991" },
+    { fmt: "$Basic_Number", arg: [999999999999999900], oktest: (res) => res === "999999999999999872" },
+    { fmt: "$Basic_Number", arg: [1e18], oktest: (res) => res === "1000000000000000000" },
+    { fmt: "$Basic_Number", arg: [-1e18], oktest: (res) => res === "-1000000000000000000" },
+    { fmt: "$Basic_Number", arg: [9223372036854774784], oktest: (res) => res === "9223372036854774784" },
     { fmt: "$Basic_Number", arg: [NaN], oktest: (res) => res === "null" },
     { fmt: "$Basic_Number", arg: [Infinity], oktest: (res) => res === "null" },
     { fmt: "$Basic_String", arg: ["ok"], oktest: (res) => res === "\"ok\"" },
@@ -110,6 +117,8 @@ const basictests = [
     { fmt: "$Basic_General", arg: [[[1], 2]], oktest: (res) => res === "[[1], 2]" },
     { fmt: "$Basic_General", arg: [[{ p1: 1 }, 2]], oktest: (res) => res === "[{\"p1\": 1}, 2]" },
     { fmt: "$Basic_General", noprint: true, arg: [(() => { const r = [2]; r.push(r); return r; })()], oktest: (res) => res === "[2, \"<Cycle>\"]" },
+    { fmt: "$Basic_General", arg: [{ p1: 1, "q\"k": { p1: 2 } }], oktest: (res) => res === "{\"p1\": 1, \"q\\\"k\": {\"p1\": 2}}" },
+    { fmt: "$Basic_General", arg: [{ p1: 3, "q\"k": {} }], oktest: (res) => res === "{\"p1\": 3, \"q\\\"k\": {}}" },
 
     { fmt: "$Basic_ObjectWDepth", arg: [{ x: { p1: 1 }, y: 1 }], oktest: (res) => res === "{\"x\": \"{...}\", \"y\": 1}" },
     { fmt: "$Basic_ObjectWDepth", arg: [{ x: [1], y: 1 }], oktest: (res) => res === "{\"x\": \"[...]\", \"y\": 1}" },
@@ -124,6 +133,7 @@ const basictests = [
     { fmt: "$Compound_Object", arg: ["Bob", true], oktest: (msg) => msg === "{ \"name\": \"Bob\", \"msg\": \"Hello\", \"args\": [ \"basic\", 4, true, true ] }" },
     { fmt: "$Compound_Object_Object", arg: ["Bob", [3, 4]], oktest: (msg) => msg === "{ \"name\": \"Bob\", \"msg\": \"Hello\", \"args\": [ 4, [3, 4], true ] }" },
 
+    { fmt: "$Basic_String", arg: ["say \"hi\""], oktest: (res) => res === "\"say \\\"hi\\\"\"" },
     { fmt: "$Basic_String", arg: ["\u00A2"], oktest: (res) => res === "\"\\u00a2\"" },
     { fmt: "$Basic_String", arg: ["\u03A9"], oktest: (res) => res === "\"\\u03a9\"" },
     { fmt: "$Basic_String", arg: ["\u20AC"], oktest: (res) => res === "\"\\u20ac\"" },
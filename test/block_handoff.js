@@ -0,0 +1,66 @@
+"use strict";
+
+const childProcess = require("child_process");
+const path = require("path");
+const runner = require("./runner");
+
+const logpp = require("../src/logger")("block_handoff", { flushMode: "NOP", prefix: false });
+
+//The output along with how many blocks were handed off (read in place) and given back to JS while the test ran
+function runSingleTest(test) {
+    const before = logpp.getMemoryUsage();
+    const msg = test.action();
+    const output = (msg !== undefined) ? msg : logpp.emitLogSync(true, false).trim();
+
+    const after = logpp.getMemoryUsage();
+    return { output: output, handoffs: after.handoffBlocks - before.handoffBlocks, reclaimed: after.reclaimedBlocks - before.reclaimedBlocks };
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+logpp.addFormat("Action", "Action %n %s");
+logpp.addFormat("Obj", "Obj %j");
+
+function logActions(count, withDebug) {
+    for (let i = 0; i < count; ++i) {
+        logpp.info(logpp.$Action, i, "name" + (i % 7));
+        if (withDebug) {
+            logpp.debug(logpp.$Action, -i, "hidden");
+        }
+    }
+}
+
+function expectedActions(count) {
+    const lines = [];
+    for (let i = 0; i < count; ++i) {
+        lines.push(`Action ${i} "name${i % 7}"`);
+    }
+    return lines.join("\n");
+}
+
+let asyncLines = [];
+
+const handofftests = [
+    { name: "handoff.many", action: () => { logActions(500, false); }, oktest: (res) => res.output === expectedActions(500) && res.handoffs > 0 },
+    { name: "handoff.recycled", action: () => { logActions(500, false); }, oktest: (res) => res.output === expectedActions(500) && res.handoffs > 0 && res.reclaimed > 0 },
+    { name: "handoff.recycled.again", action: () => { logActions(2000, false); }, oktest: (res) => res.output === expectedActions(2000) && res.handoffs > 0 && res.reclaimed > 0 },
+    { name: "handoff.mixed", action: () => { logActions(500, true); }, oktest: (res) => res.output === expectedActions(500) && res.handoffs === 0 },
+    { name: "handoff.objects", action: () => { for (let i = 0; i < 300; ++i) { logpp.info(logpp.$Obj, { a: i, b: [true, null] }); } }, oktest: (res) => res.output.split("\n").length === 300 && res.output.split("\n")[299] === "Obj {\"a\": 299, \"b\": [true, null]}" && res.handoffs > 0 },
+    { name: "handoff.small", action: () => { logActions(3, false); }, oktest: (res) => res.output === expectedActions(3) && res.handoffs === 0 },
+    {
+        //the format thread reads the handed off blocks while JS keeps logging
+        name: "handoff.async", action: () => {
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "block_handoff_app.js")]);
+            asyncLines = res.stdout.toString().trim().split("\n");
+            return JSON.parse(asyncLines.pop()).handoffBlocks;
+        }, oktest: (res) => res.output > 0
+    },
+    { name: "handoff.async.order", action: () => asyncLines.join("\n"), oktest: (res) => res.output === expectedActions(2000) }
+];
+
+const handoffRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, handofftests, "block handoff");
+handoffRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,32 @@
+////
+//An app that logs a few rounds of messages with async flushing so the format thread reads the handed off blocks (run by block_handoff.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("block_handoff", { flushMode: "ASYNC", bufferTimeLimit: 0, prefix: false });
+
+logpp.addFormat("Action", "Action %n %s");
+
+let round = 0;
+function logRound() {
+    for (let i = round * 500; i < (round + 1) * 500; ++i) {
+        logpp.info(logpp.$Action, i, "name" + (i % 7));
+    }
+
+    //wait for the messages to be older than the bufferTimeLimit so the flush that was just scheduled processes (and hands off) all of them
+    const loggedTime = Date.now();
+    while (Date.now() <= loggedTime) {
+        ;
+    }
+
+    if (++round < 4) {
+        setImmediate(logRound);
+    }
+}
+
+logRound();
+
+//runs after the logger has written everything out on exit
+process.on("exit", () => {
+    process.stdout.write(JSON.stringify(logpp.getMemoryUsage()) + "\n");
+});
@@ -32,11 +32,28 @@ logpp.configureSubloggers(path.join(__dirname, "configs/subloggerfile.json"));
 
 const log2 = require("./log2");
 
+logpp.addFormats({ Action: "Action %n", Wide: "%j<1,*>" });
+
+//an object too big for a single in-memory block
+const wide = {};
+for (let i = 0; i < 400; ++i) {
+    wide["p" + i] = i;
+}
+
 const loadtests = [
     { name: "log.warn.hi", action: () => { logpp.warn(logpp.$Hello); }, oktest: (res) => res === "hi file" },
     { name: "log.warn.hi.cat1", action: () => { logpp.warn(logpp.$$cat1, logpp.$Hello); }, oktest: (res) => res === "" },
     { name: "log.warn.hi.cat3", action: () => { logpp.warn(logpp.$$cat3, logpp.$Hello); }, oktest: (res) => res === "hi file" },
-    { name: "log2.doit", action: () => { log2.doit(); }, oktest: (res) => res === "Ok Log2!!!" }
+    { name: "log2.doit", action: () => { log2.doit(); }, oktest: (res) => res === "Ok Log2!!!" },
+    {
+        name: "log.chain", action: () => {
+            for (let i = 0; i < 500; ++i) {
+                logpp.info(logpp.$Action, i);
+                logpp.detail(logpp.$Action, -i);
+            }
+        }, oktest: (res) => res.split("\n").length === 500 && res.split("\n").every((line, i) => line === "Action " + i)
+    },
+    { name: "log.chain.split", action: () => { logpp.info(logpp.$Wide, wide); logpp.info(logpp.$Action, 2); }, oktest: (res) => res === JSON.stringify(wide).replace(/[:,]/g, "$& ") + "\nAction 2" }
 ];
 
 const loadRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, loadtests, "bulk load");
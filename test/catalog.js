@@ -0,0 +1,77 @@
+"use strict";
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const logpp = require("../src/logger")("catalog", { flushMode: "NOP", prefix: false });
+
+const catalogfile = path.join(os.tmpdir(), "logpp_catalog_" + process.pid + ".bin");
+const badfile = path.join(os.tmpdir(), "logpp_catalog_bad_" + process.pid + ".bin");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+logpp.addFormat("Hello", "Hello %s!!!");
+logpp.addFormat("Obj", "%j<1,> and %n");
+logpp.addFormat("Mixed", "## %% #app");
+
+let lines = [];
+
+const catalogtests = [
+    { name: "catalog.save", action: () => logpp.saveFormatCatalog(catalogfile), oktest: (res) => res === true },
+    {
+        name: "catalog.load", action: () => {
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "catalog_app.js"), catalogfile]);
+            lines = res.stdout.toString().trim().split("\n");
+            return res.status;
+        }, oktest: (res) => res === 0
+    },
+    { name: "catalog.string", action: () => lines[0], oktest: (res) => res === "Hello \"catalog\"!!!" },
+    { name: "catalog.depth", action: () => lines[1], oktest: (res) => res === "{\"a\": \"{...}\"} and 2" },
+    { name: "catalog.literals", action: () => lines[2], oktest: (res) => res === "# % " + JSON.stringify(path.join(__dirname, "catalog_app.js")) },
+    {
+        name: "catalog.bad", action: () => {
+            fs.writeFileSync(badfile, fs.readFileSync(catalogfile).slice(0, 20));
+            return logpp.loadFormatCatalog(badfile);
+        }, oktest: (res) => res === false
+    },
+    {
+        //the first entry in the catalog gets an unknown kind (skipping the name and format strings of any formats without entries)
+        name: "catalog.badentry", action: () => {
+            const data = fs.readFileSync(catalogfile);
+            const readU32 = (pos) => data["readUInt32" + os.endianness()](pos);
+
+            let pos = 12;
+            do {
+                for (let i = 0; i < 3; ++i) {
+                    pos += 4 + readU32(pos);
+                }
+                pos += 4;
+            } while (readU32(pos - 4) === 0);
+            data[pos] = 0x9;
+
+            fs.writeFileSync(badfile, data);
+            return logpp.loadFormatCatalog(badfile);
+        }, oktest: (res) => res === false
+    },
+    {
+        name: "catalog.cleanup", action: () => {
+            fs.unlinkSync(catalogfile);
+            fs.unlinkSync(badfile);
+            return true;
+        }, oktest: (res) => res === true
+    }
+];
+
+const catalogRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, catalogtests, "catalog");
+catalogRunner(() => {
+    process.stdout.write("\n");
+});
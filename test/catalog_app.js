@@ -0,0 +1,17 @@
+////
+//An app that only loads its formats from a compiled catalog and logs with them (run by catalog.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("catalog_app", { flushMode: "NOP", prefix: false });
+
+if (!logpp.loadFormatCatalog(process.argv[2])) {
+    process.stdout.write("load failed");
+    process.exit(1);
+}
+
+logpp.info(logpp.$Hello, "catalog");
+logpp.info(logpp.$Obj, { a: { b: { c: 1 } } }, 2);
+logpp.info(logpp.$Mixed);
+
+process.stdout.write(logpp.emitLogSync(true, true));
@@ -0,0 +1,64 @@
+"use strict";
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const columnar = require("../src/columnar");
+
+const outdir = path.join(os.tmpdir(), "logpp_columnar_" + process.pid);
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+let segments = [];
+let stats = undefined;
+
+//Concatenate the named column over all the segments for a format (in the order they were written)
+function columnValues(formatName, column) {
+    return segments.filter((seg) => seg.formatName === formatName).reduce((acc, seg) => acc.concat(seg.columns[column]), []);
+}
+
+function sameValues(values, expected) {
+    return values.length === expected.length && values.every((value, i) => value === expected[i]);
+}
+
+const events = [...Array(120).keys()];
+
+const columnartests = [
+    {
+        name: "columnar.run", action: () => {
+            fs.mkdirSync(outdir);
+            stats = JSON.parse(childProcess.execFileSync(process.execPath, [path.join(__dirname, "columnar_app.js"), outdir]).toString());
+
+            const files = fs.readdirSync(outdir).sort((a, b) => Number.parseInt(a.split("-").pop()) - Number.parseInt(b.split("-").pop()));
+            segments = files.map((file) => columnar.readColumnarSegment(path.join(outdir, file)));
+
+            files.forEach((file) => fs.unlinkSync(path.join(outdir, file)));
+            fs.rmdirSync(outdir);
+
+            return segments.length;
+        }, oktest: (res) => res === 4
+    },
+    { name: "columnar.segmentRows", action: () => segments.filter((seg) => seg.formatName === "Event").map((seg) => seg.rows).join(), oktest: (res) => res === "50,50,20" },
+    { name: "columnar.time", action: () => columnValues("Event", "$time").every((time, i, times) => i === 0 || times[i - 1] <= time), oktest: (res) => res === true },
+    { name: "columnar.string", action: () => sameValues(columnValues("Event", "kind"), events.map((i) => (i % 2 === 0) ? "even" : "odd")), oktest: (res) => res === true },
+    { name: "columnar.number", action: () => sameValues(columnValues("Event", "n"), events.map((i) => (i % 10 === 0) ? null : i)), oktest: (res) => res === true },
+    { name: "columnar.bool", action: () => sameValues(columnValues("Event", "ok"), events.map((i) => i % 3 === 0)), oktest: (res) => res === true },
+    { name: "columnar.json", action: () => sameValues(columnValues("Event", "data").map((v) => JSON.parse(v).v), events), oktest: (res) => res === true },
+    { name: "columnar.logger", action: () => columnValues("Event", "$logger").every((logger) => logger === "columnar"), oktest: (res) => res === true },
+    { name: "columnar.stats", action: () => stats.segments + "|" + stats.rows + "|" + stats.failures, oktest: (res) => res === "4|125|0" },
+    { name: "columnar.args", action: () => columnValues("Plain", "arg0").join() + "|" + columnValues("Plain", "arg1").join(), oktest: (res) => res === "plain,plain,plain,plain,plain|0,1,2,3,4" }
+];
+
+const columnarRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, columnartests, "columnar");
+columnarRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,23 @@
+////
+//An app that logs into columnar segment files (run by columnar.js)
+
+"use strict";
+
+const outdir = process.argv[2];
+const logpp = require("../src/logger")("columnar", { flushMode: "SYNC", flushTarget: "columnar", columnarDir: outdir, columnarSegmentRows: 50 });
+
+logpp.addFormat("Event", { kind: "%s", n: "%n", ok: "%b", data: "%j" });
+logpp.addFormat("Plain", "%s %n");
+
+for (let i = 0; i < 120; ++i) {
+    logpp.info(logpp.$Event, (i % 2 === 0) ? "even" : "odd", (i % 10 === 0) ? "bad" : i, i % 3 === 0, { v: i });
+}
+
+for (let i = 0; i < 5; ++i) {
+    logpp.warn(logpp.$Plain, "plain", i);
+}
+
+//runs after the logger has written everything out on exit
+process.on("exit", () => {
+    process.stdout.write(JSON.stringify(logpp.getColumnarStats()));
+});
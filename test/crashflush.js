@@ -0,0 +1,41 @@
+"use strict";
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const outfile = path.join(os.tmpdir(), "logpp_crashflush_" + process.pid + ".txt");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+let signal = undefined;
+let lines = [];
+
+const crashflushtests = [
+    {
+        name: "crashflush.run", action: () => {
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "crashflush_app.js"), outfile]);
+            signal = res.signal;
+
+            lines = fs.readFileSync(outfile).toString().trim().split("\n");
+            fs.unlinkSync(outfile);
+            return lines.length;
+        }, oktest: (res) => res === 10
+    },
+    { name: "crashflush.signal", action: () => signal, oktest: (res) => res === "SIGSEGV" },
+    { name: "crashflush.prefix", action: () => lines.every((line) => line.startsWith("INFO#$default @ ")), oktest: (res) => res === true },
+    { name: "crashflush.messages", action: () => lines.every((line, i) => line.endsWith(" | \"crash\" " + i)), oktest: (res) => res === true }
+];
+
+const crashflushRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, crashflushtests, "crashflush");
+crashflushRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,32 @@
+////
+//An app that logs some messages and then dies from a SIGSEGV before JS can write them (run by crashflush.js)
+
+"use strict";
+
+const fs = require("fs");
+
+const crashfd = fs.openSync(process.argv[2], "w");
+const logpp = require("../src/logger")("crashflush", { flushMode: "ASYNC", flushCount: 0, bufferTimeLimit: 0, crashFlushFd: crashfd });
+
+logpp.addFormat("Msg", "%s %n");
+
+for (let i = 0; i < 10; ++i) {
+    logpp.info(logpp.$Msg, "crash", i);
+}
+
+//wait for the messages to be older than the bufferTimeLimit (so the flush that was just scheduled processes them)
+const loggedTime = Date.now();
+while (Date.now() <= loggedTime) {
+    ;
+}
+
+//runs right after the flush -- the JS thread is kept busy so the formatted output cannot be handed back to JS and we wait for the format thread to
+//finish it (the output is then in the undelivered buffer which the crash flush writes along with any blocks still waiting to be formatted)
+setTimeout(() => {
+    const deadline = Date.now() + 10000;
+    while (logpp.getMemoryUsage().formatterBytes === 0 && Date.now() < deadline) {
+        ;
+    }
+
+    process.kill(process.pid, "SIGSEGV");
+}, 0);
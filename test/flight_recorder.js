@@ -0,0 +1,76 @@
+"use strict";
+
+const runner = require("./runner");
+
+//detail messages are kept in memory but not emitted so they only come out through the flight recorder
+const logpp = require("../src/logger")("flightrecorder", { flushMode: "NOP", prefix: false, flightRecorderSize: 4096 });
+
+logpp.addFormat("Msg", "%s %n");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+function emit() {
+    return logpp.emitLogSync(true, false).trim();
+}
+
+function logDetails(tag, count) {
+    for (let i = 0; i < count; ++i) {
+        logpp.detail(logpp.$Msg, tag, i);
+    }
+}
+
+function expectedLines(tag, start, count) {
+    const lines = [];
+    for (let i = start; i < start + count; ++i) {
+        lines.push("\"" + tag + "\" " + i);
+    }
+    return lines;
+}
+
+const flighttests = [
+    { name: "flightrecorder.discarded", action: () => { logDetails("quiet", 3); return emit(); }, oktest: (res) => res === "" },
+    { name: "flightrecorder.recorded", action: () => logpp.getFlightRecorderStats().messages, oktest: (res) => res === 3 },
+    {
+        name: "flightrecorder.error", action: () => {
+            logDetails("context", 2);
+            logpp.error(logpp.$Msg, "failed", 1);
+            return emit();
+        }, oktest: (res) => res === expectedLines("quiet", 0, 3).concat(expectedLines("context", 0, 2), ["\"failed\" 1"]).join("\n")
+    },
+    { name: "flightrecorder.cleared", action: () => logpp.getFlightRecorderStats().messages, oktest: (res) => res === 0 },
+    { name: "flightrecorder.info", action: () => { logDetails("before", 1); logpp.info(logpp.$Msg, "info", 2); return emit(); }, oktest: (res) => res === "\"info\" 2" },
+    {
+        name: "flightrecorder.dump", action: () => {
+            logDetails("ondemand", 2);
+            emit();
+            const count = logpp.dumpFlightRecorder();
+            return count + "|" + emit();
+        }, oktest: (res) => res === "3|" + expectedLines("before", 0, 1).concat(expectedLines("ondemand", 0, 2)).join("\n")
+    },
+    { name: "flightrecorder.dump.empty", action: () => logpp.dumpFlightRecorder(), oktest: (res) => res === 0 },
+    {
+        //only the newest messages fit in the ring
+        name: "flightrecorder.evict", action: () => {
+            logDetails("evict", 500);
+            emit();
+            const stats = logpp.getFlightRecorderStats();
+            logpp.error(logpp.$Msg, "failed", 2);
+            const lines = emit().split("\n");
+            return stats.evicted > 0 && stats.bytes <= stats.capacity && lines.length === stats.messages + 1
+                && lines.slice(0, -1).join("\n") === expectedLines("evict", 500 - stats.messages, stats.messages).join("\n");
+        }, oktest: (res) => res === true
+    },
+    { name: "flightrecorder.full", action: () => { logDetails("full", 1); return logpp.emitLogSync(true, true).trim(); }, oktest: (res) => res === "\"full\" 0" },
+    { name: "flightrecorder.full.notrecorded", action: () => logpp.getFlightRecorderStats().messages, oktest: (res) => res === 0 }
+];
+
+const flightRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, flighttests, "flightrecorder");
+flightRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,90 @@
+"use strict";
+
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const logpp = require("../src/logger")("merge", { flushMode: "NOP" });
+
+const tmpbase = path.join(os.tmpdir(), "logpp_merge_" + process.pid);
+const outfile = tmpbase + "_out.txt";
+
+function runSingleTest(test) {
+    const files = test.inputs.map((contents, i) => {
+        const file = tmpbase + "_" + i + ".txt";
+        fs.writeFileSync(file, contents);
+        return file;
+    });
+
+    const res = logpp.mergeLogFiles(files, outfile);
+    const output = (res !== false) ? fs.readFileSync(outfile).toString() : undefined;
+
+    files.forEach((file) => fs.unlinkSync(file));
+    if (res !== false) {
+        fs.unlinkSync(outfile);
+    }
+
+    return { res: res, output: output };
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+logpp.addFormat("Msg", "%s %n");
+
+function line(time, name, value) {
+    return `INFO#default @ ${new Date(time).toISOString()} from host::${name} | "${name}" ${value}\n`;
+}
+
+//the real output of a logger for the same messages (so we know the prefix parsing matches what we write)
+function emittedLines(values) {
+    values.forEach((value) => logpp.info(logpp.$Msg, "emitted", value));
+    return logpp.emitLogSync(true, true);
+}
+
+const t0 = Date.parse("2018-03-01T10:00:00.000Z");
+
+const mergetests = [
+    {
+        name: "merge.interleave",
+        inputs: [line(t0, "a", 0) + line(t0 + 2, "a", 1) + line(t0 + 4, "a", 2), line(t0 + 1, "b", 0) + line(t0 + 3, "b", 1)],
+        oktest: (res) => res.output === line(t0, "a", 0) + line(t0 + 1, "b", 0) + line(t0 + 2, "a", 1) + line(t0 + 3, "b", 1) + line(t0 + 4, "a", 2)
+    },
+    {
+        name: "merge.ties",
+        inputs: [line(t0, "a", 0) + line(t0, "a", 1), line(t0, "b", 0)],
+        oktest: (res) => res.output === line(t0, "a", 0) + line(t0, "a", 1) + line(t0, "b", 0)
+    },
+    {
+        name: "merge.continuation",
+        inputs: [line(t0, "a", 0) + "  more a\n" + line(t0 + 2, "a", 1), line(t0 + 1, "b", 0)],
+        oktest: (res) => res.output === line(t0, "a", 0) + "  more a\n" + line(t0 + 1, "b", 0) + line(t0 + 2, "a", 1)
+    },
+    {
+        name: "merge.noTrailingNewline",
+        inputs: [line(t0 + 1, "a", 0).trim(), line(t0, "b", 0)],
+        oktest: (res) => res.output === line(t0, "b", 0) + line(t0 + 1, "a", 0)
+    },
+    {
+        name: "merge.stats",
+        inputs: [line(t0, "a", 0), line(t0, "b", 0) + line(t0 + 1, "b", 1)],
+        oktest: (res) => res.res.lines === 3 && res.res.bytes === res.output.length
+    },
+    {
+        name: "merge.emitted",
+        inputs: [emittedLines([1, 2, 3]), line(0, "b", 0)],
+        oktest: (res) => res.output.startsWith(line(0, "b", 0)) && res.output.split("\n").length === 5
+    },
+    {
+        name: "merge.missingFile",
+        inputs: [],
+        oktest: (res) => logpp.mergeLogFiles([tmpbase + "_missing.txt"], outfile) === false
+    }
+];
+
+const mergeRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, mergetests, "merge");
+mergeRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,98 @@
+"use strict";
+
+const runner = require("./runner");
+
+//info messages are never emitted so the metrics have to come from processing
+const logpp = require("../src/logger")("metrics", { flushMode: "NOP", emitLevel: "WARN" });
+
+logpp.addFormat("Lat", "latency %n size %n for %s");
+logpp.addFormat("Req", { time: "%n", path: "%s", info: "%j" });
+logpp.addFormat("Other", "other %n");
+
+function runSingleTest(test) {
+    return JSON.stringify(test.action());
+}
+
+function metricsOk(check) {
+    return (res) => check(JSON.parse(res));
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+//processing is when the metrics are collected
+function logAndProcess(action) {
+    action();
+    logpp.emitLogSync(true, false);
+    return logpp.getMetrics();
+}
+
+function near(value, expected) {
+    return Math.abs(value - expected) <= Math.abs(expected) * 0.02;
+}
+
+function bucketTotal(sketch) {
+    return sketch.zeros + sketch.positive.concat(sketch.negative).reduce((acc, bucket) => acc + bucket[1], 0);
+}
+
+const metricstests = [
+    { name: "metrics.none", action: () => logAndProcess(() => logpp.info(logpp.$Lat, 1, 2, "a")), oktest: metricsOk((res) => res.length === 0) },
+    { name: "metrics.badformat", action: () => logpp.enableMetrics("Lat"), oktest: metricsOk((res) => res === false) },
+    {
+        name: "metrics.basic", action: () => {
+            logpp.enableMetrics(logpp.$Lat);
+            return logAndProcess(() => {
+                for (let i = 1; i <= 100; ++i) {
+                    logpp.info(logpp.$Lat, i, i * 10, "a");
+                }
+                logpp.info(logpp.$Other, 5);
+            });
+        },
+        oktest: metricsOk((res) => res.length === 2 && res.every((m) => m.format === "Lat" && m.count === 100)
+            && res[0].arg === 0 && res[0].name === "arg0" && res[0].sum === 5050 && res[0].min === 1 && res[0].max === 100 && res[0].mean === 50.5
+            && res[1].arg === 1 && res[1].sum === 50500 && res[1].min === 10 && res[1].max === 1000
+            && near(res[0].quantiles["0.5"], 50) && near(res[0].quantiles["0.9"], 90) && near(res[1].quantiles["0.99"], 990))
+    },
+    {
+        name: "metrics.skipsbad", action: () => logAndProcess(() => logpp.info(logpp.$Lat, "slow", 7, "b")),
+        oktest: metricsOk((res) => res[0].count === 100 && res[1].count === 101 && res[1].min === 7)
+    },
+    {
+        name: "metrics.names", action: () => {
+            logpp.enableMetrics(logpp.$Req);
+            return logAndProcess(() => logpp.warn(logpp.$Req, 12.5, "/home", { a: [1, 2] })).filter((m) => m.format === "Req");
+        },
+        oktest: metricsOk((res) => res.length === 1 && res[0].name === "time" && res[0].arg === 0 && res[0].count === 1 && res[0].sum === 12.5)
+    },
+    {
+        name: "metrics.sketch", action: () => logpp.getMetrics([0, 1]),
+        oktest: metricsOk((res) => res.every((m) => bucketTotal(m.sketch) === m.count && m.sketch.accuracy === 0.01 && m.quantiles["0"] === m.min && m.quantiles["1"] === m.max))
+    },
+    {
+        name: "metrics.reset", action: () => {
+            logpp.resetMetrics();
+            return logAndProcess(() => logpp.info(logpp.$Lat, 3, 4, "c"));
+        },
+        oktest: metricsOk((res) => res.length === 2 && res.every((m) => m.count === 1))
+    },
+    {
+        name: "metrics.all", action: () => {
+            logpp.enableMetrics();
+            return logAndProcess(() => logpp.info(logpp.$Other, -2)).filter((m) => m.format === "Other");
+        },
+        oktest: metricsOk((res) => res.length === 1 && res[0].count === 1 && res[0].min === -2)
+    },
+    {
+        name: "metrics.disable", action: () => {
+            logpp.disableMetrics();
+            return logAndProcess(() => logpp.info(logpp.$Other, 1));
+        },
+        oktest: metricsOk((res) => res.length === 0)
+    }
+];
+
+const metricsRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, metricstests, "metrics");
+metricsRunner(() => {
+    process.stdout.write("\nAll tests done!\n\n");
+});
@@ -36,6 +36,7 @@ const leveltests = [
 
     { name: "enableCategory.awesome.off", action: () => { logpp.enableCategory("awesome", false); }, oktest: (res) => res === "" },
     { name: "log.info.offcategory", action: () => { logpp.info(logpp.$$awesome, logpp.$Hello); }, oktest: (res) => res === "" },
+    { name: "log.info.category.buffered", action: () => { logpp.enableCategory("awesome", true); logpp.info(logpp.$$awesome, logpp.$Hello); logpp.enableCategory("awesome", false); }, oktest: (res) => res === "" },
 
     { name: "log.infoIf.true", action: () => { logpp.infoIf(true, logpp.$Hello); }, oktest: (res) => res === "Hello World!!!" },
     { name: "log.infoIf.false", action: () => { logpp.infoIf(false, logpp.$Hello); }, oktest: (res) => res === "" },
@@ -0,0 +1,64 @@
+"use strict";
+
+const childProcess = require("child_process");
+const path = require("path");
+const runner = require("./runner");
+
+const logpp = require("../src/logger")("outputbuffers", { flushMode: "NOP", outputBuffers: true });
+logpp.addFormat("Msg", "%s %n");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+function logAndEmit(count, tag) {
+    for (let i = 0; i < count; ++i) {
+        logpp.info(logpp.$Msg, tag, i);
+    }
+    return logpp.emitLogSync(true, false);
+}
+
+function linesOk(output, count, tag) {
+    const lines = output.toString().trim().split("\n");
+    return lines.length === count && lines.every((line, i) => line.startsWith("INFO#$default @ ") && line.endsWith(" | \"" + tag + "\" " + i));
+}
+
+let asyncLines = [];
+
+const buffertests = [
+    { name: "outputbuffers.sync", action: () => Buffer.isBuffer(logAndEmit(1, "one")), oktest: (res) => res === true },
+    { name: "outputbuffers.sync.content", action: () => linesOk(logAndEmit(10, "ten"), 10, "ten"), oktest: (res) => res === true },
+    { name: "outputbuffers.empty", action: () => { const output = logpp.emitLogSync(true, false); return Buffer.isBuffer(output) && output.length === 0; }, oktest: (res) => res === true },
+    {
+        //the buffers we drop are reused by later outputs so the earlier ones must not change
+        name: "outputbuffers.reuse", action: () => {
+            const kept = [];
+            let ok = true;
+            for (let i = 0; i < 200; ++i) {
+                const output = logAndEmit(5 + (i % 7), "reuse" + i);
+                if (i % 20 === 0) {
+                    kept.push({ output: output, count: 5 + (i % 7), tag: "reuse" + i });
+                }
+                ok = ok && linesOk(output, 5 + (i % 7), "reuse" + i);
+            }
+            return ok && kept.every((entry) => linesOk(entry.output, entry.count, entry.tag));
+        }, oktest: (res) => res === true
+    },
+    {
+        name: "outputbuffers.async", action: () => {
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "output_buffers_app.js")]);
+            asyncLines = res.stdout.toString().trim().split("\n");
+            return asyncLines.length;
+        }, oktest: (res) => res === 100
+    },
+    { name: "outputbuffers.async.order", action: () => asyncLines.every((line, i) => line.endsWith(" | \"async\" " + i)), oktest: (res) => res === true }
+];
+
+const bufferRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, buffertests, "outputbuffers");
+bufferRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,21 @@
+////
+//An app that logs a few rounds of messages with async flushing and the output handed over as Buffers (run by output_buffers.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("outputbuffers", { flushMode: "ASYNC", bufferSizeLimit: 16, bufferTimeLimit: 0, outputBuffers: true });
+
+logpp.addFormat("Msg", "%s %n");
+
+let round = 0;
+function logRound() {
+    for (let i = 0; i < 20; ++i) {
+        logpp.info(logpp.$Msg, "async", round * 20 + i);
+    }
+
+    if (++round < 5) {
+        setTimeout(logRound, 10);
+    }
+}
+
+logRound();
@@ -0,0 +1,46 @@
+"use strict";
+
+const childProcess = require("child_process");
+const path = require("path");
+const runner = require("./runner");
+
+function runApp(mode) {
+    const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "priority_app.js"), mode]);
+    return { signal: res.signal, lines: res.stdout.toString().trim().split("\n") };
+}
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+let killed = undefined;
+let exited = undefined;
+
+const prioritytests = [
+    {
+        name: "priority.kill", action: () => {
+            killed = runApp("kill");
+            return killed.signal;
+        }, oktest: (res) => res === "SIGKILL"
+    },
+    { name: "priority.kill.written", action: () => killed.lines.length, oktest: (res) => res === 1 },
+    { name: "priority.kill.message", action: () => killed.lines[0], oktest: (res) => res.startsWith("ERROR#$default @ ") && res.endsWith(" | \"urgent\" 10") },
+    {
+        name: "priority.exit", action: () => {
+            exited = runApp("exit");
+            return exited.lines.length;
+        }, oktest: (res) => res === 11
+    },
+    { name: "priority.exit.first", action: () => exited.lines[0], oktest: (res) => res.endsWith(" | \"urgent\" 10") },
+    { name: "priority.exit.once", action: () => exited.lines.filter((line) => line.indexOf("urgent") !== -1).length, oktest: (res) => res === 1 },
+    { name: "priority.exit.batched", action: () => exited.lines.slice(1).every((line, i) => line.startsWith("INFO#$default @ ") && line.endsWith(" | \"batched\" " + i)), oktest: (res) => res === true }
+];
+
+const priorityRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, prioritytests, "priority");
+priorityRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,19 @@
+////
+//An app that logs a batch of INFO messages and then an ERROR on the priority path before either dying (SIGKILL) or exiting normally (run by priority.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("priority", { flushMode: "ASYNC", priorityLevel: "ERROR", prioritySync: true });
+
+logpp.addFormat("Msg", "%s %n");
+
+for (let i = 0; i < 10; ++i) {
+    logpp.info(logpp.$Msg, "batched", i);
+}
+
+logpp.error(logpp.$Msg, "urgent", 10);
+
+if (process.argv[2] === "kill") {
+    //nothing batched gets written -- only the priority message made it out
+    process.kill(process.pid, "SIGKILL");
+}
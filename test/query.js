@@ -0,0 +1,65 @@
+"use strict";
+
+const childProcess = require("child_process");
+const path = require("path");
+const runner = require("./runner");
+
+const logpp = require("../src/logger")("query", { flushMode: "NOP", prefix: false });
+
+function runSingleTest(test) {
+    logpp.emitLogSync(true, true); //start each test with an empty log
+
+    const res = test.action();
+    return (res !== undefined) ? res : logpp.queryLog(test.query).trim();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+logpp.addFormat("Msg1", "Msg1");
+logpp.addFormat("Msg2", "Msg2 %n");
+logpp.addFormat("Req", "Req #request %s");
+logpp.enableCategory("Query");
+
+function logRequests() {
+    for (let i = 0; i < 3; ++i) {
+        logpp.setCurrentRequestId(i);
+        logpp.info(logpp.$Req, "r" + i);
+    }
+}
+
+const querytests = [
+    { name: "query.all", action: () => { logpp.info(logpp.$Msg1); logpp.warn(logpp.$Msg2, 1); }, query: undefined, oktest: (msg) => msg === "Msg1\nMsg2 1" },
+    { name: "query.format", action: () => { logpp.info(logpp.$Msg1); logpp.warn(logpp.$Msg2, 1); logpp.info(logpp.$Msg1); }, query: { format: logpp.$Msg2 }, oktest: (msg) => msg === "Msg2 1" },
+    { name: "query.level", action: () => { logpp.info(logpp.$Msg1); logpp.warn(logpp.$Msg2, 2); logpp.error(logpp.$Msg2, 3); }, query: { level: logpp.Levels.WARN }, oktest: (msg) => msg === "Msg2 2\nMsg2 3" },
+    { name: "query.category", action: () => { logpp.info(logpp.$Msg1); logpp.info(logpp.$$Query, logpp.$Msg2, 4); }, query: { category: "Query" }, oktest: (msg) => msg === "Msg2 4" },
+    { name: "query.category.$$", action: () => { logpp.info(logpp.$$Query, logpp.$Msg1); logpp.info(logpp.$Msg2, 5); }, query: { category: logpp.$$Query }, oktest: (msg) => msg === "Msg1" },
+    { name: "query.time", action: () => { logpp.info(logpp.$Msg1); }, query: { end: new Date(0) }, oktest: (msg) => msg === "" },
+    { name: "query.request", action: logRequests, query: { request: 1 }, oktest: (msg) => msg === "Req 1 \"r1\"" },
+    { name: "query.request.format", action: logRequests, query: { format: logpp.$Msg1, request: 1 }, oktest: (msg) => msg === "" },
+    { name: "query.readonly", action: () => { logpp.info(logpp.$Msg1); logpp.queryLog(); }, query: undefined, oktest: (msg) => msg === "Msg1" },
+    {
+        name: "query.spanblocks", action: () => {
+            for (let i = 0; i < 2000; ++i) {
+                logpp.info(logpp.$Msg2, i);
+            }
+            logpp.warn(logpp.$Msg1);
+        }, query: { level: logpp.Levels.WARN }, oktest: (msg) => msg === "Msg1"
+    },
+    {
+        //a write that throws leaves the rest of the block pending -- a query must not consume it or return what was already written
+        name: "query.writethrows", action: () => {
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "query_app.js")]);
+            return JSON.parse(res.stdout.toString().trim().split("\n").pop());
+        }, query: undefined, oktest: (res) => {
+            const all = res.written.concat(res.rest);
+            return res.written.length !== 0 && all.length === 20001 && all.every((id, i) => id === i) && res.queried.join() === res.rest.join();
+        }
+    }
+];
+
+const queryRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, querytests, "query");
+queryRunner(() => {
+    process.stdout.write("\n");
+});
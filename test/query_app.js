@@ -0,0 +1,43 @@
+////
+//An app whose console write throws in the middle of a sync flush and then queries and flushes the log again (run by query.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("query_app", { flushMode: "SYNC", flushCount: 20000, bufferTimeLimit: 0, prefix: false, blockHandoff: false });
+
+logpp.addFormat("Msg", "Msg %s %n");
+
+//enough output for a few FORMAT_STREAM_CHUNK_SIZE chunks from the one processed block
+const pad = "x".repeat(100);
+for (let i = 0; i < 20000; ++i) {
+    logpp.info(logpp.$Msg, pad, i);
+}
+
+//wait for the messages to be older than the bufferTimeLimit so the flush the next message triggers processes all of them
+const loggedTime = Date.now();
+while (Date.now() <= loggedTime) {
+    ;
+}
+
+//the first chunk is written and then the write throws -- the rest of the block must stay pending
+const written = [];
+const stdoutWrite = process.stdout.write;
+process.stdout.write = function (chunk) {
+    written.push(chunk.toString());
+    if (written.length === 1) {
+        throw new Error("console write failed");
+    }
+    return true;
+};
+
+logpp.info(logpp.$Msg, pad, 20000);
+
+const queried = logpp.queryLog();
+const rest = logpp.emitLogSync(true, false);
+process.stdout.write = stdoutWrite;
+
+function msgIds(output) {
+    return output.trim().split("\n").filter((line) => line !== "").map((line) => Number.parseInt(line.split(" ").pop()));
+}
+
+process.stdout.write(JSON.stringify({ written: msgIds(written.join("")), queried: msgIds(queried), rest: msgIds(rest) }) + "\n");
@@ -0,0 +1,65 @@
+"use strict";
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const outdir = path.join(os.tmpdir(), "logpp_sinks_" + process.pid);
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+let stats = [];
+let stderr = "";
+const outputs = {};
+
+function sameLines(lines, expected) {
+    return lines.length === expected.length && lines.every((line, i) => line === expected[i]);
+}
+
+const sinkstests = [
+    {
+        name: "sinks.run", action: () => {
+            fs.mkdirSync(outdir);
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "sinks_app.js"), outdir]);
+            stats = JSON.parse(res.stdout.toString());
+            stderr = res.stderr.toString();
+
+            ["text.log", "plain.log", "all.ndjson", "net.log"].forEach((file) => {
+                outputs[file] = fs.readFileSync(path.join(outdir, file)).toString().trim().split("\n");
+                fs.unlinkSync(path.join(outdir, file));
+            });
+            fs.rmdirSync(outdir);
+
+            return stats.length;
+        }, oktest: (res) => res === 5
+    },
+    {
+        name: "sinks.text", action: () => outputs["text.log"],
+        oktest: (res) => res.length === 4 && res[0].startsWith("INFO#$default @ ") && res[2].startsWith("ERROR#net @ ") && res.every((line, i) => line.endsWith(" | \"" + "abde"[i] + "\" " + [0, 1, 3, 4][i]))
+    },
+    { name: "sinks.plain", action: () => outputs["plain.log"], oktest: (res) => sameLines(res, ["\"b\" 1", "\"d\" 3"]) },
+    {
+        name: "sinks.ndjson", action: () => outputs["all.ndjson"].map((line) => JSON.parse(line)),
+        oktest: (res) => res.length === 5 && res.every((entry, i) => entry.msg === "\"" + "abcde"[i] + "\" " + i && entry.logger === "sinks" && !Number.isNaN(Date.parse(entry.time)))
+            && sameLines(res.map((entry) => entry.level), ["INFO", "WARN", "DEBUG", "ERROR", "INFO"]) && sameLines(res.map((entry) => entry.category), ["$default", "$default", "$default", "net", "net"])
+    },
+    { name: "sinks.category", action: () => outputs["net.log"], oktest: (res) => sameLines(res, ["\"d\" 3", "\"e\" 4"]) },
+    { name: "sinks.stderr", action: () => stderr.trim().split("\n"), oktest: (res) => res.length === 1 && res[0].startsWith("ERROR#net @ ") && res[0].endsWith(" | \"d\" 3") },
+    {
+        name: "sinks.stats", action: () => stats,
+        oktest: (res) => sameLines(res.map((sink) => sink.messages), [4, 2, 5, 2, 1]) && sameLines(res.map((sink) => sink.mode), ["text", "plain", "ndjson", "plain", "text"]) && res.every((sink) => sink.failures === 0 && sink.bytes > 0)
+    }
+];
+
+const sinksRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, sinkstests, "sinks");
+sinksRunner(() => {
+    process.stdout.write("\n");
+});
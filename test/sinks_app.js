@@ -0,0 +1,36 @@
+////
+//An app that logs to several sinks with different levels/categories/modes (run by sinks.js)
+
+"use strict";
+
+const path = require("path");
+
+const outdir = process.argv[2];
+const logpp = require("../src/logger")("sinks", {
+    flushMode: "SYNC",
+    flushTarget: "sinks",
+    memoryLevel: "TRACE",
+    sinks: [
+        { output: "file", path: path.join(outdir, "text.log") },
+        { output: "file", path: path.join(outdir, "plain.log"), level: "WARN", mode: "plain" },
+        { output: "file", path: path.join(outdir, "all.ndjson"), level: "DEBUG", mode: "ndjson" },
+        { output: "file", path: path.join(outdir, "net.log"), level: "TRACE", categories: ["net"], mode: "plain" },
+        { output: "stderr", level: "ERROR" },
+        { output: "nowhere" }
+    ]
+});
+
+logpp.addFormat("Msg", "%s %n");
+logpp.enableCategory("net");
+
+logpp.info(logpp.$Msg, "a", 0);
+logpp.warn(logpp.$Msg, "b", 1);
+logpp.debug(logpp.$Msg, "c", 2);
+logpp.error(logpp.$$net, logpp.$Msg, "d", 3);
+logpp.info(logpp.$$net, logpp.$Msg, "e", 4);
+logpp.trace(logpp.$Msg, "f", 5);
+
+//runs after the logger has written everything out on exit
+process.on("exit", () => {
+    process.stdout.write(JSON.stringify(logpp.getSinkStats()));
+});
@@ -0,0 +1,100 @@
+"use strict";
+
+const childProcess = require("child_process");
+const net = require("net");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const sockpath = path.join(os.tmpdir(), "logpp_sinks_socket_" + process.pid + ".sock");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+//Each connection gets the frames it received (or null if the framing was broken)
+const connections = [];
+let stats = [];
+
+function parseFrames(data) {
+    const frames = [];
+    let pos = 0;
+    while (pos + 4 <= data.length) {
+        const length = data.readUInt32BE(pos);
+        if (pos + 4 + length > data.length) {
+            break;
+        }
+
+        frames.push(data.slice(pos + 4, pos + 4 + length).toString());
+        pos += 4 + length;
+    }
+
+    return (pos === data.length) ? frames : null;
+}
+
+function messages(frames) {
+    return frames.reduce((acc, frame) => acc.concat(frame.trim().split("\n")), []);
+}
+
+const server = net.createServer((conn) => {
+    const chunks = [];
+    const connection = { frames: [] };
+    connections.push(connection);
+
+    conn.on("data", (chunk) => {
+        chunks.push(chunk);
+        connection.frames = parseFrames(Buffer.concat(chunks));
+
+        //drop the collector once the first batch is in and tell the app to log the second batch while it is down
+        if (connections.length === 1 && connection.frames !== null && messages(connection.frames).length === 10) {
+            conn.destroy();
+            server.close(() => app.send("down"));
+        }
+    });
+});
+
+let app = undefined;
+
+const sockettests = [
+    { name: "socket.connections", action: () => connections.length, oktest: (res) => res === 2 },
+    { name: "socket.framing", action: () => connections.every((connection) => connection.frames !== null && connection.frames.every((frame) => frame.endsWith("\n"))), oktest: (res) => res === true },
+    {
+        name: "socket.messages", action: () => connections.reduce((acc, connection) => acc.concat(messages(connection.frames || [])), []),
+        oktest: (res) => res.length === 30 && res.every((msg, i) => msg === "\"m\" " + i)
+    },
+    { name: "socket.reconnect", action: () => (connections.length > 1 ? messages(connections[1].frames || [])[0] : undefined), oktest: (res) => res === "\"m\" 10" },
+    {
+        name: "socket.stats", action: () => stats[0],
+        oktest: (res) => res.output === "socket" && res.socketType === "stream" && res.messages === 30 && res.connects === 2 && res.pendingBytes === 0 && res.failures === 0
+    }
+];
+
+server.listen(sockpath, () => {
+    app = childProcess.spawn(process.execPath, [path.join(__dirname, "sinks_socket_app.js"), sockpath], { stdio: ["ignore", "pipe", "inherit", "ipc"] });
+
+    //the app holds the second batch (the collector is down) so bring the collector back and have it log the third batch
+    app.on("message", (msg) => {
+        if (msg === "held") {
+            server.listen(sockpath, () => app.send("up"));
+        }
+    });
+
+    let out = "";
+    app.stdout.on("data", (chunk) => {
+        out += chunk.toString();
+    });
+
+    app.on("close", () => {
+        stats = JSON.parse(out);
+        server.close();
+
+        const socketRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, sockettests, "sinks_socket");
+        socketRunner(() => {
+            process.stdout.write("\n");
+        });
+    });
+});
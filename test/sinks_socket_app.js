@@ -0,0 +1,49 @@
+////
+//An app that logs to a Unix-domain socket sink in three batches while the collector drops and restarts (run by sinks_socket.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("sinks_socket", {
+    flushMode: "SYNC",
+    flushCount: 0,
+    bufferTimeLimit: 0,
+    flushTarget: "sinks",
+    sinks: [{ output: "socket", path: process.argv[2], mode: "plain" }]
+});
+
+logpp.addFormat("Msg", "%s %n");
+
+function logBatch(start) {
+    for (let i = start; i < start + 10; ++i) {
+        logpp.info(logpp.$Msg, "m", i);
+    }
+}
+
+//the first batch is sent on the first connection, the second while the collector is down, and the third after it is back (sinks_socket.js drives the phases)
+logBatch(0);
+
+function waitHeld() {
+    //the sink thread could not send the second batch so it is waiting in the retry buffer
+    if (logpp.getSinkStats()[0].pendingBytes !== 0) {
+        process.send("held");
+    }
+    else {
+        setImmediate(waitHeld);
+    }
+}
+
+process.on("message", (msg) => {
+    if (msg === "down") {
+        logBatch(10);
+        waitHeld();
+    }
+    else if (msg === "up") {
+        logBatch(20);
+        process.disconnect();
+    }
+});
+
+//runs after the logger has written everything out on exit
+process.on("exit", () => {
+    process.stdout.write(JSON.stringify(logpp.getSinkStats()));
+});
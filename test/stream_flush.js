@@ -0,0 +1,37 @@
+"use strict";
+
+const childProcess = require("child_process");
+const path = require("path");
+const runner = require("./runner");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+function runApp(mode) {
+    const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "stream_flush_app.js"), mode], { maxBuffer: 64 * 1024 * 1024 });
+    return { lines: res.stdout.toString().trim().split("\n"), writes: JSON.parse(res.stderr.toString()).writes };
+}
+
+function linesOk(lines) {
+    return lines.length === 30000 && lines.every((line, i) => line.endsWith(" | \"stream\" " + i + " with some text to make the messages bigger"));
+}
+
+let nopRun = undefined;
+let asyncRun = undefined;
+
+const streamtests = [
+    { name: "streamflush.exit", action: () => { nopRun = runApp("NOP"); return linesOk(nopRun.lines); }, oktest: (res) => res === true },
+    //~3MB of output is written as it is formatted instead of in one piece
+    { name: "streamflush.exit.chunks", action: () => nopRun.writes, oktest: (res) => res >= 2 },
+    { name: "streamflush.async", action: () => { asyncRun = runApp("ASYNC"); return linesOk(asyncRun.lines); }, oktest: (res) => res === true }
+];
+
+const streamRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, streamtests, "streamflush");
+streamRunner(() => {
+    process.stdout.write("\n");
+});
@@ -0,0 +1,25 @@
+////
+//An app that leaves a big backlog of messages for the exit flush and then reports how many writes it took (run by stream_flush.js)
+
+"use strict";
+
+const mode = process.argv[2] || "NOP";
+
+let writes = 0;
+const write = process.stdout.write;
+process.stdout.write = function (...args) {
+    writes++;
+    return write.apply(process.stdout, args);
+};
+
+const logpp = require("../src/logger")("streamflush", { flushMode: mode });
+logpp.addFormat("Msg", "%s %n with some text to make the messages bigger");
+
+for (let i = 0; i < 30000; ++i) {
+    logpp.info(logpp.$Msg, "stream", i);
+}
+
+//registered after the logger so it runs after the exit flush
+process.on("exit", () => {
+    process.stderr.write(JSON.stringify({ writes: writes }));
+});
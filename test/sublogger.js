@@ -26,6 +26,9 @@ const subtests = [
     { name: "sublogger.up2", action: () => { logpp.setSubLoggerLevel("log2", logpp.Levels.INFO); log2.doit(); }, oktest: (msg) => msg === "Ok Log2!!!" },
     { name: "sublogger.off", action: () => { logpp.disableSubLogger("log2"); log2.doit(); }, oktest: (msg) => msg === "" },
     { name: "sublogger.up3", action: () => { logpp.setSubLoggerLevel("log2", logpp.Levels.INFO); log2.doit(); }, oktest: (msg) => msg === "Ok Log2!!!" },
+    { name: "sublogger.buffered.down", action: () => { log2.doit(); logpp.setSubLoggerLevel("log2", logpp.Levels.WARN); }, oktest: (msg) => msg === "" },
+    { name: "sublogger.buffered.off", action: () => { logpp.setSubLoggerLevel("log2", logpp.Levels.INFO); log2.doit(); logpp.info(logpp.$Hello); logpp.disableSubLogger("log2"); }, oktest: (msg) => msg === "Hello World!!!" },
+    { name: "sublogger.up4", action: () => { logpp.setSubLoggerLevel("log2", logpp.Levels.INFO); log2.doit(); }, oktest: (msg) => msg === "Ok Log2!!!" },
 
     { name: "emit.change.down", action: () => { logpp.setEmitLevel(logpp.Levels.WARN); log2.doit(); logpp.info(logpp.$Hello); }, oktest: (msg) => msg === "Ok Log2!!!" },
     { name: "emit.change.up", action: () => { logpp.setEmitLevel(logpp.Levels.INFO); log2.doit(); logpp.info(logpp.$Hello); }, oktest: (msg) => msg === "Ok Log2!!!\nHello World!!!" },
@@ -0,0 +1,62 @@
+"use strict";
+
+const childProcess = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const runner = require("./runner");
+
+const tracefile = path.join(os.tmpdir(), "logpp_trace_" + process.pid + ".json");
+
+function runSingleTest(test) {
+    return test.action();
+}
+
+function printTestInfo(test) {
+    return test.name;
+}
+
+let lines = [];
+let events = [];
+
+function spans(name) {
+    return events.filter((evt) => evt.name === name && evt.ph === "X");
+}
+
+function asyncBalanced(name) {
+    const begins = events.filter((evt) => evt.name === name && evt.ph === "b").map((evt) => evt.id);
+    const ends = events.filter((evt) => evt.name === name && evt.ph === "e").map((evt) => evt.id);
+    return begins.length !== 0 && begins.length === ends.length && begins.every((id) => ends.indexOf(id) !== -1);
+}
+
+function threadNames() {
+    return events.filter((evt) => evt.ph === "M" && evt.name === "thread_name").map((evt) => evt.args.name);
+}
+
+const tracetests = [
+    {
+        name: "trace.run", action: () => {
+            const res = childProcess.spawnSync(process.execPath, [path.join(__dirname, "trace_app.js"), tracefile]);
+            lines = res.stdout.toString().trim().split("\n");
+
+            //a stopped trace is a complete JSON array
+            events = JSON.parse(fs.readFileSync(tracefile).toString());
+            fs.unlinkSync(tracefile);
+            return lines.length;
+        }, oktest: (res) => res === 101
+    },
+    { name: "trace.threads", action: () => threadNames(), oktest: (res) => res.indexOf("js") !== -1 && res.indexOf("logpp-format") !== -1 },
+    { name: "trace.process", action: () => spans("processMsgChain").length, oktest: (res) => res > 0 },
+    { name: "trace.process.args", action: () => spans("processMsgChain").every((evt) => evt.args.messages >= 0 && evt.args.blocks >= 0), oktest: (res) => res === true },
+    { name: "trace.format", action: () => spans("formatBlock").reduce((acc, evt) => acc + evt.args.messages, 0), oktest: (res) => res === 100 },
+    { name: "trace.flush", action: () => spans("flush").length, oktest: (res) => res > 0 },
+    { name: "trace.priority", action: () => spans("priorityWrite").length, oktest: (res) => res === 1 },
+    { name: "trace.queued", action: () => asyncBalanced("queued"), oktest: (res) => res === true },
+    { name: "trace.write", action: () => asyncBalanced("sinkWrite"), oktest: (res) => res === true },
+    { name: "trace.order", action: () => spans("formatBlock").every((evt) => evt.dur >= 0 && evt.ts >= 0), oktest: (res) => res === true }
+];
+
+const traceRunner = runner.generalSyncRunner(runSingleTest, printTestInfo, tracetests, "trace");
+traceRunner(() => {
+    process.stdout.write("\n");
+});
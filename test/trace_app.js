@@ -0,0 +1,29 @@
+////
+//An app that logs a few rounds of messages (with async flushing and an ERROR on the priority path) while writing a trace to the file given (run by trace.js)
+
+"use strict";
+
+const logpp = require("../src/logger")("trace", { flushMode: "ASYNC", bufferSizeLimit: 16, bufferTimeLimit: 0, priorityLevel: "ERROR", traceFile: process.argv[2] });
+
+logpp.addFormat("Msg", "%s %n");
+
+let round = 0;
+function logRound() {
+    for (let i = 0; i < 20; ++i) {
+        logpp.info(logpp.$Msg, "round", round * 20 + i);
+    }
+
+    if (round === 2) {
+        logpp.error(logpp.$Msg, "urgent", round);
+    }
+
+    if (++round < 5) {
+        setTimeout(logRound, 20);
+    }
+    else {
+        //let the last writes complete so they show up in the trace
+        setTimeout(() => { }, 100);
+    }
+}
+
+logRound();